@@ -12,7 +12,8 @@ LOCAL_SRC_FILES := \
     audio_hw_hal.cpp\
     alsa_mixer.c\
     alsa_route.c\
-    alsa_pcm.c
+    alsa_pcm.c\
+    audio_dsp.c
 
 ifeq ($(BOARD_HAVE_BLUETOOTH),true)
   LOCAL_CFLAGS += -DWITH_A2DP
@@ -56,7 +57,8 @@ LOCAL_SRC_FILES := \
     audio_hw_hal.cpp\
     alsa_mixer.c\
     alsa_route.c\
-    alsa_pcm.c
+    alsa_pcm.c\
+    audio_dsp.c
 
 LOCAL_CFLAGS += -DSUPPORT_USB
 LOCAL_MODULE := audio.alsa_usb.$(TARGET_BOARD_HARDWARE)
@@ -64,6 +64,10 @@
 // A device mask for all audio output devices that are considered "remote" when evaluating
 // active output devices in isStreamActiveRemotely()
 #define APM_AUDIO_OUT_DEVICE_REMOTE_ALL  AUDIO_DEVICE_OUT_REMOTE_SUBMIX
+// Volume curves whose amplification is kept per index by volIndexToAmpl(), and the
+// highest curve index that fits in the table
+#define APM_VOLUME_AMPL_CURVES  32
+#define APM_VOLUME_AMPL_INDEXES 101
 
 #include <inttypes.h>
 #include <math.h>
@@ -3131,6 +3135,11 @@ AudioPolicyManagerBase::device_category AudioPolicyManagerBase::getDeviceCategor
 float AudioPolicyManagerBase::volIndexToAmpl(audio_devices_t device, const StreamDescriptor& streamDesc,
         int indexInUi)
 {
+    // the curves are constant tables, exp() of each of their indexes is computed once
+    static Mutex sAmplLock;
+    static const VolumeCurvePoint *sAmplCurve[APM_VOLUME_AMPL_CURVES];
+    static float sAmpl[APM_VOLUME_AMPL_CURVES][APM_VOLUME_AMPL_INDEXES];
+
     device_category deviceCategory = getDeviceCategory(device);
     const VolumeCurvePoint *curve = streamDesc.mVolumeCurve[deviceCategory];
 
@@ -3154,6 +3163,37 @@ float AudioPolicyManagerBase::volIndexToAmpl(audio_devices_t device, const Strea
         return 1.0f;
     }
 
+    if (curve[VOLMIN].mIndex >= 0 && curve[VOLMAX].mIndex < APM_VOLUME_AMPL_INDEXES) {
+        Mutex::Autolock _l(sAmplLock);
+        int slot;
+        for (slot = 0; slot < APM_VOLUME_AMPL_CURVES; slot++) {
+            if (sAmplCurve[slot] == curve) {
+                return sAmpl[slot][volIdx];
+            }
+            if (sAmplCurve[slot] == NULL) {
+                break;
+            }
+        }
+        if (slot < APM_VOLUME_AMPL_CURVES) {
+            // same interpolation as below, for every index of the curve
+            int seg = 0;
+            for (int idx = curve[VOLMIN].mIndex; idx <= curve[VOLMAX].mIndex; idx++) {
+                while (seg < VOLMAX - 1 && idx >= curve[seg+1].mIndex) {
+                    seg++;
+                }
+                float db = curve[seg].mDBAttenuation +
+                        ((float)(idx - curve[seg].mIndex)) *
+                            ( (curve[seg+1].mDBAttenuation -
+                                    curve[seg].mDBAttenuation) /
+                                ((float)(curve[seg+1].mIndex -
+                                        curve[seg].mIndex)) );
+                sAmpl[slot][idx] = exp( db * 0.115129f);
+            }
+            sAmplCurve[slot] = curve;
+            return sAmpl[slot][volIdx];
+        }
+    }
+
     // linear interpolation in the attenuation table in dB
     float decibels = curve[segment].mDBAttenuation +
             ((float)(volIdx - curve[segment].mIndex)) *
@@ -68,6 +68,7 @@
 #include <linux/ioctl.h>
 
 #include "alsa_audio.h"
+#include "audio_dsp.h"
 
 #define __force
 #define __bitwise
@@ -302,94 +303,11 @@ int pcm_write(struct pcm *pcm, void *data, unsigned count)
     }
 }
 
-/********************************
-	author:charles chen
-	data:2012.09.27
-	parameter 
-	data: the input data buf point
-	len:   the input data len need consider the pcm_format
-	ret: 0:Left and right channel is valid
-		  1:Left      channel is valid
-		  2:Right    channel is valid
-
-defalt the input signal is like LRLRLR,default pcm_format is 16bit
-*********************************/
 #define SAMPLECOUNT 441*5*2*2
 int channalFlags = -1;//mean the channel is not checked now
 
 int startCheckCount = 0;
 
-int channel_check(void * data, unsigned len)
-{
-	short * pcmLeftChannel = (short *)data;
-	short * pcmRightChannel = pcmLeftChannel+1;
-	unsigned index = 0;
-	int leftValid = 0x0;
-	int rightValid = 0x0;
-	short checkValue = 0;
-	
-	checkValue = *pcmLeftChannel;
-
-	//checkleft first
-	for(index = 0; index < len; index += 2)
-	{
-		
-		if((pcmLeftChannel[index] >= checkValue+50)||(pcmLeftChannel[index] <= checkValue-50))
-		{
-			leftValid++;// = 0x01;
-		        //ALOGI("-->pcmLeftChannel[%d] = %d checkValue %d leftValid %d",index,pcmLeftChannel[index],checkValue,leftValid);
-			//break;
-		}	
-	}
-
-	if(leftValid >20)
-		leftValid = 0x01;
-	else
-		leftValid = 0;
-	checkValue = *pcmRightChannel;
-
-		//then check right 
-	for(index = 0; index < len; index += 2)
-	{
-		
-		if((pcmRightChannel[index] >= checkValue+50)||(pcmRightChannel[index] <= checkValue-50))
-		{
-			rightValid++;//= 0x02;
-			//ALOGI("-->pcmRightChannel[%d] = %d checkValue %d rightValid %d",index,pcmRightChannel[index],checkValue,rightValid);
-			//break;
-		}	
-	}
-
-	if(rightValid >20)
-		rightValid = 0x02;
-	else
-		rightValid = 0;
-	ALOGI("leftValid %d rightValid %d",leftValid,rightValid);
-	return leftValid|rightValid;
-}
-
-void channel_fixed(void * data, unsigned len, int chFlag)
-{
-	//we just fixed when chFlag is 1 or 2.
-	if(chFlag <= 0 || chFlag > 2 )
-		return;
-
-	short * pcmValid = (short *)data;
-	short * pcmInvalid = pcmValid;
-	
-	if(chFlag == 1)
-		pcmInvalid += 1;
-	else if (chFlag == 2)
-		pcmValid += 1;
-	
-	unsigned index ;
-	
-	for(index = 0; index < len; index += 2)
-	{
-		pcmInvalid[index] = pcmValid[index];
-	}
-	return;
-}
 int pcm_read(struct pcm *pcm, void *data, unsigned count)
 {
     struct snd_xferi x;
@@ -461,6 +379,7 @@ int pcm_read(struct pcm *pcm, void *data, unsigned count)
 				else
 				{
 					channalFlags = channel_check(data,count/2);
+					ALOGI("leftValid %d rightValid %d",channalFlags & 0x01,channalFlags & 0x02);
 				}
 			}//if(channalFlags == -1)
 
@@ -19,13 +19,25 @@ include $(CLEAR_VARS)
 LOCAL_MODULE := audio.primary.$(TARGET_BOARD_HARDWARE)
 LOCAL_PROPRIETARY_MODULE := true
 LOCAL_MODULE_RELATIVE_PATH := hw
+LOCAL_MODULE_CLASS := SHARED_LIBRARIES
 LOCAL_SRC_FILES := \
         audio_setting.c \
 	audio_bitstream.c \
 	audio_hw.c \
+	audio_slice.c \
+	audio_stats.c \
+	audio_live.c \
+	audio_trace.c \
+	audio_journal.c \
+	audio_glitch.c \
 	alsa_route.c \
 	alsa_mixer.c \
+	route_worker.c \
+	jack_monitor.c \
 	voice_preprocess.c \
+	voice_jitter_buffer.c \
+	voice_speex_process.c \
+	audio_thread.c \
 	audio_hw_hdmi.c
 LOCAL_C_INCLUDES += \
 	external/tinyalsa/include \
@@ -79,15 +91,132 @@ LOCAL_CFLAGS += -DVOICE_SUPPORT
 endif
 LOCAL_CFLAGS += -Wno-error
 LOCAL_SHARED_LIBRARIES := liblog libcutils libtinyalsa libaudioutils libaudioroute libhardware_legacy libspeexresampler
-LOCAL_STATIC_LIBRARIES := libspeex
+LOCAL_STATIC_LIBRARIES := libspeex libaudioroutetables
 LOCAL_MODULE_TAGS := optional
 include $(BUILD_SHARED_LIBRARY)
 
 include $(CLEAR_VARS)
+LOCAL_CFLAGS += -Wno-error -Wno-missing-braces
+LOCAL_SRC_FILES:= codec_config/route_table_gen.c
+LOCAL_MODULE:= route_table_gen
+LOCAL_MODULE_TAGS:= optional
+include $(BUILD_HOST_EXECUTABLE)
+
+# codec route tables, packed from codec_config/config_list.h by route_table_gen.
+# Generated once into this module's own directory and linked by the hal, amix
+# and jack_bench. The pointer size only changes the size the tool reports.
+include $(CLEAR_VARS)
+LOCAL_MODULE := libaudioroutetables
+LOCAL_MODULE_CLASS := STATIC_LIBRARIES
+LOCAL_PROPRIETARY_MODULE := true
 LOCAL_CFLAGS += -Wno-error
-LOCAL_SRC_FILES:= amix.c alsa_mixer.c
+ROUTE_TABLE_GEN := $(HOST_OUT_EXECUTABLES)/route_table_gen$(HOST_EXECUTABLE_SUFFIX)
+ROUTE_TABLE_SRC := $(call local-generated-sources-dir)/route_tables.c
+$(ROUTE_TABLE_SRC): PRIVATE_TOOL := $(ROUTE_TABLE_GEN)
+$(ROUTE_TABLE_SRC): PRIVATE_PTR := $(if $(filter true,$(TARGET_IS_64_BIT)),8,4)
+$(ROUTE_TABLE_SRC): $(ROUTE_TABLE_GEN)
+	@mkdir -p $(dir $@)
+	$(hide) $(PRIVATE_TOOL) -p $(PRIVATE_PTR) $@
+LOCAL_GENERATED_SOURCES += $(ROUTE_TABLE_SRC)
+LOCAL_MODULE_TAGS := optional
+include $(BUILD_STATIC_LIBRARY)
+
+include $(CLEAR_VARS)
+LOCAL_CFLAGS += -Wno-error
+LOCAL_SRC_FILES:= amix.c alsa_mixer.c audio_stats.c
 LOCAL_MODULE:= amix
 LOCAL_PROPRIETARY_MODULE := true
 LOCAL_SHARED_LIBRARIES := liblog libc libcutils
+LOCAL_STATIC_LIBRARIES := libaudioroutetables
+LOCAL_MODULE_TAGS:= debug
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_CFLAGS += -Wno-error
+LOCAL_SRC_FILES:= astat.c audio_live.c audio_stats.c
+LOCAL_MODULE:= astat
+LOCAL_PROPRIETARY_MODULE := true
+LOCAL_SHARED_LIBRARIES := liblog libc libcutils
+LOCAL_MODULE_TAGS:= debug
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_CFLAGS += -Wno-error
+LOCAL_SRC_FILES:= mixer_bench.c alsa_mixer.c audio_stats.c
+LOCAL_MODULE:= mixer_bench
+LOCAL_PROPRIETARY_MODULE := true
+LOCAL_SHARED_LIBRARIES := liblog libc libcutils
+LOCAL_MODULE_TAGS:= debug
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_CFLAGS += -Wno-error
+LOCAL_SRC_FILES:= volume_check.c alsa_mixer.c
+LOCAL_MODULE:= volume_check
+LOCAL_PROPRIETARY_MODULE := true
+LOCAL_SHARED_LIBRARIES := liblog libc libcutils
+LOCAL_MODULE_TAGS:= debug
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_CFLAGS += -Wno-error
+LOCAL_SRC_FILES:= jack_bench.c jack_monitor.c audio_thread.c route_worker.c alsa_route.c alsa_mixer.c \
+	audio_trace.c audio_stats.c
+LOCAL_C_INCLUDES += external/tinyalsa/include
+LOCAL_MODULE:= jack_bench
+LOCAL_PROPRIETARY_MODULE := true
+LOCAL_SHARED_LIBRARIES := liblog libc libcutils libtinyalsa
+LOCAL_STATIC_LIBRARIES := libaudioroutetables
+LOCAL_MODULE_TAGS:= debug
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_CFLAGS += -Wno-error
+LOCAL_SRC_FILES:= voice_bench.c voice_preprocess.c voice_jitter_buffer.c voice_speex_process.c \
+	audio_thread.c audio_live.c audio_stats.c
+LOCAL_C_INCLUDES += $(call include-path-for, speex)
+LOCAL_MODULE:= voice_bench
+LOCAL_PROPRIETARY_MODULE := true
+LOCAL_SHARED_LIBRARIES := liblog libc libcutils libdl libspeexresampler
+LOCAL_STATIC_LIBRARIES := libspeex
+LOCAL_MODULE_TAGS:= debug
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_CFLAGS += -Wno-error
+LOCAL_SRC_FILES:= dsp_bench.c audio_slice.c audio_bitstream.c voice_preprocess.c voice_jitter_buffer.c \
+	voice_speex_process.c audio_thread.c audio_live.c audio_stats.c ../legacy_hal/audio_dsp.c
+LOCAL_C_INCLUDES += $(call include-path-for, speex)
+LOCAL_MODULE:= dsp_bench
+LOCAL_PROPRIETARY_MODULE := true
+LOCAL_SHARED_LIBRARIES := liblog libc libcutils libdl libspeexresampler
+LOCAL_STATIC_LIBRARIES := libspeex
+LOCAL_MODULE_TAGS:= debug
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_CFLAGS += -Wno-error
+LOCAL_SRC_FILES:= hal_replay.c audio_journal.c audio_stats.c audio_thread.c
+LOCAL_MODULE:= hal_replay
+LOCAL_PROPRIETARY_MODULE := true
+LOCAL_SHARED_LIBRARIES := liblog libc libcutils libhardware
+LOCAL_MODULE_TAGS:= debug
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_CFLAGS += -Wno-error
+LOCAL_SRC_FILES:= hal_stress.c audio_stats.c
+LOCAL_MODULE:= hal_stress
+LOCAL_PROPRIETARY_MODULE := true
+LOCAL_SHARED_LIBRARIES := liblog libc libcutils libhardware
+LOCAL_MODULE_TAGS:= debug
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+LOCAL_CFLAGS += -Wno-error
+LOCAL_SRC_FILES:= hal_loopback.c audio_stats.c
+LOCAL_MODULE:= hal_loopback
+LOCAL_PROPRIETARY_MODULE := true
+LOCAL_SHARED_LIBRARIES := liblog libc libcutils libhardware
 LOCAL_MODULE_TAGS:= debug
 include $(BUILD_EXECUTABLE)
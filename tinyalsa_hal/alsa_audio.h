@@ -126,6 +126,18 @@ struct mixer_ctl {
     struct snd_ctl_elem_info *info;
     struct snd_ctl_tlv *tlv;
     char **ename;
+    int shadow_valid;       // shadow holds the value last written by us
+    long long shadow[2];    // left and right, or the enum item
+    struct mixer_volume *volume;    // voice volume steps, built on first use
+};
+
+/* voice volume 0.0 - 1.0 is applied in steps 1 - MIXER_VOLUME_STEPS */
+#define MIXER_VOLUME_STEPS 6
+
+/* per step values of a volume control, step 0 is the bottom of the curve */
+struct mixer_volume {
+    long long raw[MIXER_VOLUME_STEPS + 1];  // value written to the control
+    float dB[MIXER_VOLUME_STEPS + 1];       // gain of that value from the TLV
 };
 
 struct mixer {
@@ -133,11 +145,14 @@ struct mixer {
     struct snd_ctl_elem_info *info;
     struct mixer_ctl *ctl;
     unsigned count;
+    unsigned *hash;         // open addressed name/index -> control + 1, 0 is empty
+    unsigned hash_mask;
 };
 
 struct mixer *mixer_open_legacy(unsigned card);
 void mixer_close_legacy(struct mixer *mixer);
 void mixer_dump(struct mixer *mixer);
+int mixer_build_index(struct mixer *mixer);
 
 struct mixer_ctl *mixer_get_control(struct mixer *mixer,
                                     const char *name, unsigned index);
@@ -149,17 +164,55 @@ int mixer_ctl_select(struct mixer_ctl *ctl, const char *value);
 void mixer_ctl_print(struct mixer_ctl *ctl);
 int mixer_ctl_set_int_double(struct mixer_ctl *ctl, long long left, long long right);
 int mixer_ctl_set_int(struct mixer_ctl *ctl, long long value);
+int mixer_ctl_is_current(struct mixer_ctl *ctl, const char *str_val, long long left, long long right);
+void mixer_shadow_invalidate(struct mixer *mixer);
+int mixer_ctl_shadow_sync(struct mixer_ctl *ctl);
 int mixer_tlv_get_dB_range(unsigned int *tlv, long rangemin, long rangemax,
                            long *min, long *max);
 int mixer_get_ctl_minmax(struct mixer_ctl *ctl, long long *min, long long *max);
 int mixer_get_dB_range(struct mixer_ctl *ctl, long rangemin, long rangemax,
                        float *dB_min, float *dB_max, float *dB_step);
+unsigned mixer_volume_step(float volume);
+const struct mixer_volume *mixer_ctl_get_volume(struct mixer_ctl *ctl);
+int mixer_ctl_set_volume(struct mixer_ctl *ctl, float volume);
 
 int route_init(void);
 void route_uninit(void);
+struct mixer *route_mixer_get(unsigned card);
 int route_set_input_source(const char *source);
 int route_set_voice_volume(const char *ctlName, float volume);
 int route_set_controls(unsigned route);
+int route_prepare(unsigned route);
+void route_ctl_changed(unsigned card, unsigned numid);
+void route_mixer_invalidate(void);
 void route_pcm_open(unsigned route);
 int route_pcm_close(unsigned route);
+
+/* route requests applied by the route worker thread, times in us */
+struct route_worker_stats {
+    unsigned requests;
+    unsigned coalesced;         // requests replaced by a newer one before they ran
+    unsigned executed;
+    long long last_ready_us;    // from the request to the route being programmed
+    long long max_ready_us;
+    long long total_ready_us;
+    long long last_program_us;  // spent writing the controls
+    unsigned standby_ms;        // media.audio.route.standby_ms
+    unsigned standby_held;      // standby closes held back
+    unsigned standby_avoided;   // held paths reopened before the close, no power cycle
+    unsigned standby_expired;   // held paths closed when the hold ran out
+    unsigned prepared;          // routes prepared ahead of their open
+};
+
+int route_worker_start(void);
+void route_worker_stop(void);
+void route_worker_open(unsigned route);
+void route_worker_close(unsigned route);
+void route_worker_standby(unsigned route);
+void route_worker_prepare(unsigned route);
+void route_worker_sync(void);
+void route_worker_lock(void);
+void route_worker_unlock(void);
+int route_worker_pending(void);
+void route_worker_get_stats(struct route_worker_stats *stats);
 #endif
@@ -63,7 +63,9 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <ctype.h>
+#include <math.h>
 
+#include <sys/ioctl.h>
 #include <linux/ioctl.h>
 #define __force
 #define __bitwise
@@ -167,13 +169,13 @@ void mixer_close_legacy(struct mixer *mixer)
         for (n = 0; n < mixer->count; n++) {
             if (mixer->ctl[n].tlv)
                 free(mixer->ctl[n].tlv);
+            free(mixer->ctl[n].volume);
             if (mixer->ctl[n].ename) {
                 unsigned max = mixer->ctl[n].info->value.enumerated.items;
                 for (m = 0; m < max; m++)
                     if(mixer->ctl[n].ename[m])
                         free(mixer->ctl[n].ename[m]);
-                if(mixer->ctl[n].ename[m])
-                    free(mixer->ctl[n].ename);
+                free(mixer->ctl[n].ename);
             }
         }
         free(mixer->ctl);
@@ -182,6 +184,9 @@ void mixer_close_legacy(struct mixer *mixer)
     if (mixer->info)
         free(mixer->info);
 
+    if (mixer->hash)
+        free(mixer->hash);
+
     free(mixer);
 }
 
@@ -298,6 +303,10 @@ struct mixer *mixer_open_legacy(unsigned card)
     }
 
     free(eid);
+
+    if (mixer_build_index(mixer) < 0)
+        ALOGW("mixer_open() no control index, lookups will scan");
+
     return mixer;
 
 fail:
@@ -405,6 +414,61 @@ void mixer_dump(struct mixer *mixer)
     }
 }
 
+/**
+ * @brief mixer_ctl_hash
+ *        FNV-1a of the control name, mixed with the control index
+ *
+ * @param name
+ * @param index
+ *
+ * @returns
+ */
+static unsigned mixer_ctl_hash(const char *name, unsigned index)
+{
+    unsigned h = 2166136261u;
+
+    while (*name) {
+        h ^= (unsigned char)*name++;
+        h *= 16777619u;
+    }
+    return h ^ (index * 0x9e3779b1u);
+}
+
+/**
+ * @brief mixer_build_index
+ *        build the name lookup table of an enumerated mixer, the table is
+ *        kept at most half full so probe sequences stay short
+ *
+ * @param mixer
+ *
+ * @returns 0 on success, -ENOMEM
+ */
+int mixer_build_index(struct mixer *mixer)
+{
+    unsigned size = 16;
+    unsigned n, slot;
+
+    while (size < mixer->count * 2)
+        size <<= 1;
+
+    if (mixer->hash)
+        free(mixer->hash);
+    mixer->hash = calloc(size, sizeof(unsigned));
+    if (!mixer->hash) {
+        mixer->hash_mask = 0;
+        return -ENOMEM;
+    }
+    mixer->hash_mask = size - 1;
+
+    for (n = 0; n < mixer->count; n++) {
+        slot = mixer_ctl_hash((char*) mixer->info[n].id.name, mixer->info[n].id.index) & mixer->hash_mask;
+        while (mixer->hash[slot])
+            slot = (slot + 1) & mixer->hash_mask;
+        mixer->hash[slot] = n + 1;
+    }
+    return 0;
+}
+
 /**
  * @brief mixer_get_control
  *
@@ -418,6 +482,22 @@ struct mixer_ctl *mixer_get_control(struct mixer *mixer,
                                     const char *name, unsigned index)
 {
     unsigned n;
+
+    if (mixer->hash) {
+        unsigned slot = mixer_ctl_hash(name, index) & mixer->hash_mask;
+
+        while (mixer->hash[slot]) {
+            n = mixer->hash[slot] - 1;
+            if ((mixer->info[n].id.index == index) &&
+                !strcmp(name, (char*) mixer->info[n].id.name)) {
+                ALOGV("mixer_get_control() %s access 0x%08x",mixer->info[n].id.name,mixer->info[n].access);
+                return mixer->ctl + n;
+            }
+            slot = (slot + 1) & mixer->hash_mask;
+        }
+        return 0;
+    }
+
     for (n = 0; n < mixer->count; n++) {
         if (mixer->info[n].id.index == index) {
             if (!strcmp(name, (char*) mixer->info[n].id.name)) {
@@ -520,6 +600,7 @@ defalut:
         errno = EINVAL;
         return -1;
     }
+    ctl->shadow_valid = 0;
     return ioctl(ctl->mixer->fd, SNDRV_CTL_IOCTL_ELEM_WRITE, &ev);
 }
 
@@ -560,9 +641,169 @@ int mixer_ctl_set(struct mixer_ctl *ctl, unsigned percent)
         return -1;
     }
 
+    ctl->shadow_valid = 0;
     return ioctl(ctl->mixer->fd, SNDRV_CTL_IOCTL_ELEM_WRITE, &ev);
 }
 
+/**
+ * @brief mixer_ctl_shadow_store
+ *        remember what a write left in the control, or forget it when the
+ *        write failed and the control state is unknown
+ *
+ * @param ctl
+ * @param ret result of the write
+ * @param left
+ * @param right
+ */
+static void mixer_ctl_shadow_store(struct mixer_ctl *ctl, int ret, long long left, long long right)
+{
+    ctl->shadow_valid = (ret == 0);
+    ctl->shadow[0] = left;
+    ctl->shadow[1] = ctl->info->count > 1 ? right : left;
+}
+
+/**
+ * @brief mixer_ctl_normalize
+ *        the values mixer_ctl_set_int_double() writes for left and right
+ *
+ * @param ctl
+ * @param left
+ * @param right
+ * @param value receives left and right
+ *
+ * @returns 0, or -1 for a type it does not write
+ */
+static int mixer_ctl_normalize(struct mixer_ctl *ctl, long long left, long long right, long long *value)
+{
+    long long max, min;
+
+    switch (ctl->info->type) {
+    case SNDRV_CTL_ELEM_TYPE_BOOLEAN:
+        left = !!left;
+        right = !!right;
+        break;
+    case SNDRV_CTL_ELEM_TYPE_INTEGER:
+    case SNDRV_CTL_ELEM_TYPE_INTEGER64:
+        if (ctl->info->type == SNDRV_CTL_ELEM_TYPE_INTEGER) {
+            max = ctl->info->value.integer.max;
+            min = ctl->info->value.integer.min;
+        } else {
+            max = ctl->info->value.integer64.max;
+            min = ctl->info->value.integer64.min;
+        }
+        left = left > max ? max : left;
+        left = left < min ? min : left;
+        right = right > max ? max : right;
+        right = right < min ? min : right;
+        break;
+    default:
+        return -1;
+    }
+
+    value[0] = left;
+    value[1] = ctl->info->count > 1 ? right : left;
+    return 0;
+}
+
+/**
+ * @brief mixer_ctl_is_current
+ *        tell whether the control already holds a value, as far as the
+ *        shadow of our own writes knows
+ *
+ * @param ctl
+ * @param str_val enum item name, or NULL to compare left and right
+ * @param left
+ * @param right
+ *
+ * @returns 1 if writing the value would not change the control
+ */
+int mixer_ctl_is_current(struct mixer_ctl *ctl, const char *str_val, long long left, long long right)
+{
+    long long value[2];
+    unsigned n, max;
+
+    if (!ctl->shadow_valid)
+        return 0;
+
+    if (ctl->info->type == SNDRV_CTL_ELEM_TYPE_ENUMERATED) {
+        max = ctl->info->value.enumerated.items;
+        if (str_val) {
+            for (n = 0; n < max; n++) {
+                if (!strcmp(str_val, ctl->ename[n]))
+                    break;
+            }
+        } else {
+            n = left > max ? max : left;
+        }
+        return (n < max) && (ctl->shadow[0] == n);
+    }
+
+    if (str_val || (mixer_ctl_normalize(ctl, left, right, value) < 0))
+        return 0;
+    return (ctl->shadow[0] == value[0]) && (ctl->shadow[1] == value[1]);
+}
+
+/**
+ * @brief mixer_shadow_invalidate
+ *        forget every shadowed value, for when the controls may have been
+ *        changed behind our back
+ *
+ * @param mixer
+ */
+void mixer_shadow_invalidate(struct mixer *mixer)
+{
+    unsigned n;
+
+    for (n = 0; n < mixer->count; n++)
+        mixer->ctl[n].shadow_valid = 0;
+}
+
+/**
+ * @brief mixer_ctl_shadow_sync
+ *        read the control and make the shadow hold its value
+ *
+ * @param ctl
+ *
+ * @returns 1 if the shadow was valid and differed from the control,
+ *          0 otherwise, -1 if the control could not be read
+ */
+int mixer_ctl_shadow_sync(struct mixer_ctl *ctl)
+{
+    struct snd_ctl_elem_value ev;
+    long long value[2];
+    int changed;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.id.numid = ctl->info->id.numid;
+    if (ioctl(ctl->mixer->fd, SNDRV_CTL_IOCTL_ELEM_READ, &ev)) {
+        ctl->shadow_valid = 0;
+        return -1;
+    }
+
+    switch (ctl->info->type) {
+    case SNDRV_CTL_ELEM_TYPE_BOOLEAN:
+    case SNDRV_CTL_ELEM_TYPE_INTEGER:
+        value[0] = ev.value.integer.value[0];
+        value[1] = ev.value.integer.value[ctl->info->count > 1 ? 1 : 0];
+        break;
+    case SNDRV_CTL_ELEM_TYPE_INTEGER64:
+        value[0] = ev.value.integer64.value[0];
+        value[1] = ev.value.integer64.value[ctl->info->count > 1 ? 1 : 0];
+        break;
+    case SNDRV_CTL_ELEM_TYPE_ENUMERATED:
+        value[0] = value[1] = ev.value.enumerated.item[0];
+        break;
+    default:
+        ctl->shadow_valid = 0;
+        return -1;
+    }
+
+    changed = ctl->shadow_valid &&
+              ((ctl->shadow[0] != value[0]) || (ctl->shadow[1] != value[1]));
+    mixer_ctl_shadow_store(ctl, 0, value[0], value[1]);
+    return changed;
+}
+
 /**
  * @brief mixer_ctl_select
  *
@@ -587,8 +828,11 @@ int mixer_ctl_select(struct mixer_ctl *ctl, const char *value)
             memset(&ev, 0, sizeof(ev));
             ev.value.enumerated.item[0] = n;
             ev.id.numid = ctl->info->id.numid;
-            if (ioctl(ctl->mixer->fd, SNDRV_CTL_IOCTL_ELEM_WRITE, &ev) < 0)
+            if (ioctl(ctl->mixer->fd, SNDRV_CTL_IOCTL_ELEM_WRITE, &ev) < 0) {
+                mixer_ctl_shadow_store(ctl, -1, n, n);
                 return -1;
+            }
+            mixer_ctl_shadow_store(ctl, 0, n, n);
             return 0;
         }
     }
@@ -663,7 +907,12 @@ int mixer_ctl_set_int_double(struct mixer_ctl *ctl, long long left, long long ri
         return -1;
     }
 
-    return ioctl(ctl->mixer->fd, SNDRV_CTL_IOCTL_ELEM_WRITE, &ev);
+    long long shadow[2];
+    int ret = ioctl(ctl->mixer->fd, SNDRV_CTL_IOCTL_ELEM_WRITE, &ev);
+
+    mixer_ctl_normalize(ctl, left, right, shadow);
+    mixer_ctl_shadow_store(ctl, ret, shadow[0], shadow[1]);
+    return ret;
 }
 
 /**
@@ -818,3 +1067,112 @@ int mixer_get_dB_range(struct mixer_ctl *ctl, long rangemin, long rangemax,
 
     return 0;
 }
+
+/**
+ * @brief mixer_volume_step
+ *        voice volume to step, as route_set_voice_volume() always did
+ *
+ * @param volume 0.0 - 1.0
+ *
+ * @returns 1 - MIXER_VOLUME_STEPS
+ */
+unsigned mixer_volume_step(float volume)
+{
+    if (!(volume > 0.0f))
+        volume = 0.0f;
+    else if (volume > 1.0f)
+        volume = 1.0f;
+
+    return (unsigned)(volume * (MIXER_VOLUME_STEPS - 1) + 1);
+}
+
+/**
+ * @brief mixer_volume_build
+ *        the steps are spread evenly in amplitude between the ends of the
+ *        control's dB range, on the curve
+ *        20 * ln((N * e^(max / 20) + (Nmax - N) * e^(min / 20)) / Nmax),
+ *        and rounded to the nearest control value. That is the curve
+ *        route_set_voice_volume() always wrote; its e base is not the
+ *        10 of the TLV dB, so the steps are not evenly spaced in linear
+ *        amplitude, but shipped devices are tuned to these values.
+ *
+ * @param ctl
+ *
+ * @returns the table, NULL if the control has no usable dB range
+ */
+static struct mixer_volume *mixer_volume_build(struct mixer_ctl *ctl)
+{
+    struct mixer_volume *vol;
+    long long vol_min, vol_max, raw;
+    float dB_min, dB_max, dB_step;
+    double amp_min, amp_max, dB, pos;
+    unsigned n;
+
+    if (mixer_get_ctl_minmax(ctl, &vol_min, &vol_max) < 0) {
+        ALOGE("mixer_volume_build() get control min max value fail");
+        return NULL;
+    }
+    if ((vol_max <= vol_min) ||
+        (mixer_get_dB_range(ctl, (long)vol_min, (long)vol_max, &dB_min, &dB_max, &dB_step) < 0) ||
+        (dB_step <= 0.0f))
+        return NULL;
+
+    vol = calloc(1, sizeof(*vol));
+    if (!vol)
+        return NULL;
+
+    amp_min = exp(dB_min / 20.0);
+    amp_max = exp(dB_max / 20.0);
+    for (n = 0; n <= MIXER_VOLUME_STEPS; n++) {
+        dB = 20.0 * log((MIXER_VOLUME_STEPS * amp_min + n * (amp_max - amp_min)) / MIXER_VOLUME_STEPS);
+        pos = (dB - dB_min) / dB_step;
+        raw = vol_min + (long long)floor(pos + 0.5);
+        if (raw < vol_min)
+            raw = vol_min;
+        else if (raw > vol_max)
+            raw = vol_max;
+
+        vol->raw[n] = raw;
+        vol->dB[n] = dB_min + (raw - vol_min) * dB_step;
+        ALOGV("control %s : step %u value %lld, %f dB", ctl->info->id.name, n, raw, vol->dB[n]);
+    }
+
+    return vol;
+}
+
+/**
+ * @brief mixer_ctl_get_volume
+ *        the TLV was read when the mixer was opened, the table is built
+ *        from it once and kept with the control
+ *
+ * @param ctl
+ *
+ * @returns the voice volume steps of the control, NULL if it has none
+ */
+const struct mixer_volume *mixer_ctl_get_volume(struct mixer_ctl *ctl)
+{
+    if (!ctl->volume)
+        ctl->volume = mixer_volume_build(ctl);
+    return ctl->volume;
+}
+
+/**
+ * @brief mixer_ctl_set_volume
+ *
+ * @param ctl
+ * @param volume 0.0 - 1.0
+ *
+ * @returns
+ */
+int mixer_ctl_set_volume(struct mixer_ctl *ctl, float volume)
+{
+    const struct mixer_volume *vol = mixer_ctl_get_volume(ctl);
+    unsigned n = mixer_volume_step(volume);
+
+    if (!vol)
+        return -EINVAL;
+
+    ALOGV("mixer_ctl_set_volume() %s step %u value %lld, %f dB",
+          ctl->info->id.name, n, vol->raw[n], vol->dB[n]);
+    return mixer_ctl_set_int(ctl, vol->raw[n]);
+}
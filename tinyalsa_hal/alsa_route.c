@@ -56,6 +56,8 @@
 #include <errno.h>
 #include <ctype.h>
 #include <math.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
 
 #include <linux/ioctl.h>
 #include "alsa_audio.h"
@@ -65,7 +67,8 @@
 #define __user
 #include "asound.h"
 
-#include "codec_config/config_list.h"
+#include "codec_config/route_table_packed.h"
+#include "audio_trace.h"
 
 #define PCM_DEVICE0_PLAYBACK 0
 #define PCM_DEVICE0_CAPTURE 1
@@ -76,12 +79,211 @@
 
 #define PCM_MAX PCM_DEVICE2_CAPTURE
 
+#define MIXER_CARD_MAX 10
+
 const struct config_route_table *route_table;
+/* route_table is the default one, missing controls are expected then */
+static int route_table_default;
 
 struct pcm* mPcm[PCM_MAX + 1];
 struct mixer* mMixerPlayback;
 struct mixer* mMixerCapture;
 
+/*
+ * mixers stay open for the device lifetime, one per card, so a route
+ * switch does not enumerate all the controls again. id is the card id
+ * the mixer was enumerated for.
+ */
+struct route_mixer {
+    struct mixer *mixer;
+    char id[16];
+};
+
+static struct route_mixer mMixerCache[MIXER_CARD_MAX];
+static pthread_mutex_t mMixerCacheLock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * controls of each route resolved against mRouteCtlMixer[route], so a
+ * route applied again skips the name lookups. Flushed whenever a cached
+ * mixer is closed.
+ */
+static struct mixer_ctl **mRouteCtlCache[MAX_ROUTE];
+static struct mixer *mRouteCtlMixer[MAX_ROUTE];
+
+/**
+ * @brief route_ctl_cache_flush
+ */
+static void route_ctl_cache_flush(void)
+{
+    unsigned i;
+
+    for (i = 0; i < MAX_ROUTE; i++) {
+        if (mRouteCtlCache[i]) {
+            free(mRouteCtlCache[i]);
+            mRouteCtlCache[i] = NULL;
+        }
+        mRouteCtlMixer[i] = NULL;
+    }
+}
+
+/**
+ * @brief route_ctl_cache_get
+ *
+ * @param route
+ * @param mixer the mixer the route is applied to
+ * @param count controls in the route
+ *
+ * @returns the control slots of the route, NULL entries are unresolved,
+ *          or NULL without a cache
+ */
+static struct mixer_ctl **route_ctl_cache_get(unsigned route, struct mixer *mixer, unsigned count)
+{
+    if (mRouteCtlMixer[route] != mixer) {
+        if (mRouteCtlCache[route])
+            free(mRouteCtlCache[route]);
+        mRouteCtlCache[route] = calloc(count, sizeof(struct mixer_ctl *));
+        mRouteCtlMixer[route] = mRouteCtlCache[route] ? mixer : NULL;
+    }
+    return mRouteCtlCache[route];
+}
+
+/**
+ * @brief route_mixer_card_id
+ *
+ * @param mixer
+ * @param id receives the card id, 16 bytes
+ *
+ * @returns 0 if the card behind the mixer is still present
+ */
+static int route_mixer_card_id(struct mixer *mixer, char *id)
+{
+    struct snd_ctl_card_info info;
+
+    memset(&info, 0, sizeof(info));
+    if (ioctl(mixer->fd, SNDRV_CTL_IOCTL_CARD_INFO, &info) < 0)
+        return -errno;
+    memcpy(id, info.id, sizeof(info.id));
+    return 0;
+}
+
+/**
+ * @brief route_mixer_get
+ *        get the mixer of a card, it is enumerated on first use and again
+ *        only when the card went away or was replaced by another one.
+ *        mMixerPlayback and mMixerCapture still holding a replaced mixer
+ *        are moved to the new one before it is closed.
+ *
+ * @param card
+ *
+ * @returns the mixer, owned by the cache, or NULL
+ */
+struct mixer *route_mixer_get(unsigned card)
+{
+    struct route_mixer *entry;
+    struct mixer *old;
+    char id[16];
+
+    if (card >= MIXER_CARD_MAX) {
+        ALOGE("route_mixer_get() card %u out of range", card);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&mMixerCacheLock);
+    entry = &mMixerCache[card];
+    old = entry->mixer;
+    if (old) {
+        if ((route_mixer_card_id(old, id) == 0) &&
+            (memcmp(id, entry->id, sizeof(id)) == 0))
+            goto __exit;
+
+        ALOGD("route_mixer_get() card %u changed, enumerate again", card);
+        route_ctl_cache_flush();
+    }
+
+    entry->mixer = mixer_open_legacy(card);
+    if (entry->mixer && (route_mixer_card_id(entry->mixer, entry->id) < 0))
+        memset(entry->id, 0, sizeof(entry->id));
+
+    if (old) {
+        if (mMixerPlayback == old)
+            mMixerPlayback = entry->mixer;
+        if (mMixerCapture == old)
+            mMixerCapture = entry->mixer;
+        mixer_close_legacy(old);
+    }
+
+__exit:
+    pthread_mutex_unlock(&mMixerCacheLock);
+    return entry->mixer;
+}
+
+/**
+ * @brief route_mixer_release_all
+ *        close every cached mixer
+ */
+static void route_mixer_release_all(void)
+{
+    unsigned i;
+
+    pthread_mutex_lock(&mMixerCacheLock);
+    route_ctl_cache_flush();
+    mMixerPlayback = NULL;
+    mMixerCapture = NULL;
+    for (i = 0; i < MIXER_CARD_MAX; i++) {
+        if (mMixerCache[i].mixer) {
+            mixer_close_legacy(mMixerCache[i].mixer);
+            mMixerCache[i].mixer = NULL;
+        }
+    }
+    pthread_mutex_unlock(&mMixerCacheLock);
+}
+
+/**
+ * @brief route_table_expand
+ *        build the route table of one card from the packed tables, the
+ *        table and its controls are one allocation, the strings stay in
+ *        the packed pool
+ *
+ * @param card
+ *
+ * @returns the table, free() it, or NULL
+ */
+static struct config_route_table *route_table_expand(const struct route_packed_card *card)
+{
+    const struct route_packed_route *packed = route_packed_routes + card->routes;
+    struct config_route_table *table;
+    struct config_route *routes;
+    struct config_control *ctls;
+    unsigned total = 0, i, j;
+
+    for (i = 0; i < ROUTE_PACKED_ROUTES; i++)
+        total += packed[i].controls_count;
+
+    table = calloc(1, sizeof(struct config_route_table) + total * sizeof(struct config_control));
+    if (!table)
+        return NULL;
+
+    // the routes in member order, as route_table_gen packed them
+    routes = (struct config_route *)table;
+    ctls = (struct config_control *)(table + 1);
+    for (i = 0; i < ROUTE_PACKED_ROUTES; i++) {
+        const struct route_packed_control *pc = route_packed_controls + packed[i].controls;
+
+        routes[i].sound_card = packed[i].sound_card;
+        routes[i].devices = packed[i].devices;
+        routes[i].controls_count = packed[i].controls_count;
+        routes[i].controls = packed[i].controls_count ? ctls : NULL;
+        for (j = 0; j < packed[i].controls_count; j++, ctls++) {
+            ctls->ctl_name = route_packed_strings + pc[j].name;
+            ctls->str_val = pc[j].str_val == ROUTE_PACKED_NO_STR ? NULL : route_packed_strings + pc[j].str_val;
+            ctls->int_val[0] = pc[j].int_val[0];
+            ctls->int_val[1] = pc[j].int_val[1];
+        }
+    }
+
+    return table;
+}
+
 /**
  * @brief route_init 
  *
@@ -91,17 +293,22 @@ int route_init(void)
 {
     char soundCardID[20] = "";
     static FILE * fp;
-    unsigned i, config_count = sizeof(sound_card_config_list) / sizeof(struct alsa_sound_card_config);
+    const struct route_packed_card *card = NULL;
+    unsigned i;
     size_t read_size;
 
     ALOGV("route_init()");
+    audio_trace_begin("route_init");
 
+    audio_trace_begin("read card0 id");
     fp = fopen("/proc/asound/card0/id", "rt");
     if (!fp) {
         ALOGE("Open sound card0 id error!");
+        audio_trace_end("read card0 id");
     } else {
         read_size = fread(soundCardID, sizeof(char), sizeof(soundCardID), fp);
         fclose(fp);
+        audio_trace_end("read card0 id");
 
         if (soundCardID[read_size - 1] == '\n') {
             read_size--;
@@ -110,27 +317,38 @@ int route_init(void)
 
         ALOGV("Sound card0 is %s", soundCardID);
 
-        for (i = 0; i < config_count; i++) {
-            if (!(sound_card_config_list + i) || !sound_card_config_list[i].sound_card_name ||
-                !sound_card_config_list[i].route_table)
+        for (i = 0; i < route_packed_card_count; i++) {
+            if (route_packed_cards[i].name == ROUTE_PACKED_NO_STR)
                 continue;
 
-            if (strncmp(sound_card_config_list[i].sound_card_name, soundCardID, 
+            if (strncmp(route_packed_strings + route_packed_cards[i].name, soundCardID,
                 read_size) == 0) {
-                route_table = sound_card_config_list[i].route_table;
+                card = route_packed_cards + i;
                 ALOGD("Get route table for sound card0 %s", soundCardID);
             }
         }
     }
 
-    if (!route_table) {
-        route_table = &default_config_table;
+    route_table_default = (card == NULL);
+    if (!card) {
+        // the generator puts the default table first
+        card = route_packed_cards;
         ALOGD("Can not get config table for sound card0 %s, so get default config table.", soundCardID);
     }
 
+    // the resolved controls belong to the old table
+    pthread_mutex_lock(&mMixerCacheLock);
+    route_ctl_cache_flush();
+    pthread_mutex_unlock(&mMixerCacheLock);
+    free((void *)route_table);
+    route_table = route_table_expand(card);
+    if (!route_table)
+        ALOGE("route_init() can not expand the route table");
+
     for (i = PCM_DEVICE0_PLAYBACK; i < PCM_MAX; i++)
          mPcm[i] = NULL;
 
+    audio_trace_end("route_init");
     return 0;
 }
 
@@ -143,6 +361,8 @@ void route_uninit(void)
     route_pcm_close(PLAYBACK_OFF_ROUTE);
 
 	route_pcm_close(CAPTURE_OFF_ROUTE);
+
+    route_mixer_release_all();
 }
 
 /**
@@ -240,36 +460,15 @@ int route_set_voice_volume(const char *ctlName, float volume)
     if (ctl == NULL)
         return 0;
 
-    long long vol, vol_min, vol_max;
-    unsigned int Nmax = 6, N = volume * 5 + 1;
-    float e = 2.71828, dB_min, dB_max, dB_vol, dB_step, volFloat;
-
     ALOGD("route_set_voice_volume() set incall voice volume %f to control %s", volume, ctlName);
 
-    if (mixer_get_ctl_minmax(ctl, &vol_min, &vol_max) < 0) {
-        ALOGE("mixer_get_dB_range() get control min max value fail");
+    // the steps are computed from the control's TLV once, then looked up
+    if (mixer_ctl_get_volume(ctl) == NULL) {
+        ALOGE("route_set_voice_volume() control %s has no dB range", ctlName);
         return 0;
     }
 
-    mixer_get_dB_range(ctl, (long)vol_min, (long)vol_max, &dB_min, &dB_max, &dB_step);
-
-    dB_vol = 20 * log((Nmax * pow(e, dB_min / 20) + N * (pow(e, dB_max / 20) - pow(e, dB_min / 20))) / Nmax);
-
-    volFloat = vol_min + (dB_vol - dB_min) / dB_step;
-    vol = (long long)volFloat;
-
-    if (((unsigned)(volFloat * 10) % 10) >= 5)
-        vol++;
-
-    ALOGV("dB_min = %f, dB_step = %f, dB_max = %f, dB_vol = %f",
-        dB_min,
-        dB_step,
-        dB_max,
-        dB_vol);
-
-    ALOGV("N = %u, volFloat = %f, vol = %lld", N, volFloat, vol);
-
-    return mixer_ctl_set_int(ctl, vol);
+    return mixer_ctl_set_volume(ctl, volume);
 }
 
 /**
@@ -368,17 +567,24 @@ const struct config_route *get_route_config(unsigned route)
 
 /**
  * @brief set_controls 
+ *        apply the entries in table order, skipping the ones that would
+ *        not change the control. A control listed more than once, as a
+ *        switch turned off before a path changes and on again after it,
+ *        is written each time its value changes.
  *
  * @param mixer
  * @param ctls
  * @param ctls_count
+ * @param cache controls resolved by earlier calls for the same ctls and
+ *        mixer, filled in as they are looked up, may be NULL
  *
  * @returns 
  */
-int set_controls(struct mixer *mixer, const struct config_control *ctls, const unsigned ctls_count)
+int set_controls(struct mixer *mixer, const struct config_control *ctls, const unsigned ctls_count,
+                 struct mixer_ctl **cache)
 {
     struct mixer_ctl *ctl;
-    unsigned i;
+    unsigned i, written = 0;
 
     ALOGV("set_controls() ctls_count %d", ctls_count);
 
@@ -388,10 +594,15 @@ int set_controls(struct mixer *mixer, const struct config_control *ctls, const u
     }
 
     for (i = 0; i < ctls_count; i++) {
-        ctl = mixer_get_control(mixer, ctls[i].ctl_name, 0);
+        ctl = cache ? cache[i] : NULL;
         if (!ctl) {
-            ALOGE_IF(route_table != &default_config_table, "set_controls() Can not get ctl : %s", ctls[i].ctl_name);
-            ALOGV_IF(route_table == &default_config_table, "set_controls() Can not get ctl : %s", ctls[i].ctl_name);
+            ctl = mixer_get_control(mixer, ctls[i].ctl_name, 0);
+            if (cache)
+                cache[i] = ctl;
+        }
+        if (!ctl) {
+            ALOGE_IF(!route_table_default, "set_controls() Can not get ctl : %s", ctls[i].ctl_name);
+            ALOGV_IF(route_table_default, "set_controls() Can not get ctl : %s", ctls[i].ctl_name);
             return -EINVAL;
         }
 
@@ -403,11 +614,17 @@ int set_controls(struct mixer *mixer, const struct config_control *ctls, const u
             return -EINVAL;
         }
 
+        if (ctls[i].str_val && ctl->info->type != SNDRV_CTL_ELEM_TYPE_ENUMERATED) {
+            ALOGE("set_controls() ctl %s is not a type of ENUMERATED", ctls[i].ctl_name);
+            return -EINVAL;
+        }
+
+        // already there, the shadow follows the writes made so far
+        if (mixer_ctl_is_current(ctl, ctls[i].str_val, ctls[i].int_val[0], ctls[i].int_val[1]))
+            continue;
+        written++;
+
         if (ctls[i].str_val) {
-            if (ctl->info->type != SNDRV_CTL_ELEM_TYPE_ENUMERATED) {
-                ALOGE("set_controls() ctl %s is not a type of ENUMERATED", ctls[i].ctl_name);
-                return -EINVAL;
-            }
             if (mixer_ctl_select(ctl, ctls[i].str_val) != 0) {
                 ALOGE("set_controls() Can not set ctl %s to %s", ctls[i].ctl_name, ctls[i].str_val);
                 return -EINVAL;
@@ -422,6 +639,7 @@ int set_controls(struct mixer *mixer, const struct config_control *ctls, const u
         }
     }
 
+    ALOGV("set_controls() wrote %u of %u controls", written, ctls_count);
     return 0;
 }
 
@@ -479,11 +697,139 @@ int route_set_controls(unsigned route)
     }
 
     if (route_info->controls_count > 0)
-        set_controls(mMixer, route_info->controls, route_info->controls_count);
+        set_controls(mMixer, route_info->controls, route_info->controls_count,
+                     route_ctl_cache_get(route, mMixer, route_info->controls_count));
 
     return 0;
 }
 
+/**
+ * @brief route_prepare_one
+ *        resolve the controls of a route and read back the ones whose
+ *        value we do not know, must be called with the route worker lock
+ *
+ * @returns controls read back
+ */
+static unsigned route_prepare_one(unsigned route, struct mixer *mixer)
+{
+    const struct config_route *route_info = get_route_config(route);
+    struct mixer_ctl **cache;
+    unsigned i, synced = 0;
+
+    if (!route_info || (route_info->controls_count == 0))
+        return 0;
+
+    cache = route_ctl_cache_get(route, mixer, route_info->controls_count);
+    if (!cache)
+        return 0;
+    for (i = 0; i < route_info->controls_count; i++) {
+        if (!cache[i])
+            cache[i] = mixer_get_control(mixer, route_info->controls[i].ctl_name, 0);
+        if (cache[i] && !cache[i]->shadow_valid && (mixer_ctl_shadow_sync(cache[i]) >= 0))
+            synced++;
+    }
+    return synced;
+}
+
+/**
+ * @brief route_prepare
+ *        get a playback or capture route ready to be applied: the mixer
+ *        is opened, the controls of the route and of the off routes
+ *        route_pcm_open() applies before it are resolved, and controls
+ *        whose value is unknown are read back, so applying the route
+ *        later only writes what actually differs
+ *
+ * @param route
+ *
+ * @returns 0, or -EINVAL for a route that cannot be prepared
+ */
+int route_prepare(unsigned route)
+{
+    const struct config_route *route_info;
+    struct mixer *mixer;
+    unsigned synced;
+
+    if (route >= MAX_ROUTE) {
+        ALOGE("route_prepare() route %d error!", route);
+        return -EINVAL;
+    }
+
+    if (!route_table)
+        route_init();
+
+    route_info = get_route_config(route);
+    if (!route_info)
+        return -EINVAL;
+
+    mixer = route_mixer_get(route_info->sound_card == 1 ? 0 : route_info->sound_card);
+    if (!mixer)
+        return -EINVAL;
+
+    synced = route_prepare_one(route, mixer);
+    if (is_playback_route(route)) {
+        synced += route_prepare_one(PLAYBACK_OFF_ROUTE, mixer);
+        synced += route_prepare_one(INCALL_OFF_ROUTE, mixer);
+        synced += route_prepare_one(VOIP_OFF_ROUTE, mixer);
+    } else {
+        synced += route_prepare_one(CAPTURE_OFF_ROUTE, mixer);
+    }
+
+    ALOGV("route_prepare() route %u ready, %u controls read back", route, synced);
+    return 0;
+}
+
+/**
+ * @brief route_ctl_changed
+ *        a control of a card changed, bring its shadow up to date so the
+ *        next route does not skip a write it needs. Called for our own
+ *        writes as well, the read back then finds the shadow right.
+ *        must be called with the route worker lock
+ *
+ * @param card
+ * @param numid
+ */
+void route_ctl_changed(unsigned card, unsigned numid)
+{
+    struct mixer *mixer = NULL;
+    unsigned n;
+
+    pthread_mutex_lock(&mMixerCacheLock);
+    if (card < MIXER_CARD_MAX)
+        mixer = mMixerCache[card].mixer;
+    pthread_mutex_unlock(&mMixerCacheLock);
+    if (!mixer)
+        return;
+
+    for (n = 0; n < mixer->count; n++) {
+        if (mixer->info[n].id.numid != numid)
+            continue;
+        if (mixer_ctl_shadow_sync(mixer->ctl + n) > 0)
+            ALOGD("route_ctl_changed() %s changed outside the route code",
+                  (char *)mixer->info[n].id.name);
+        break;
+    }
+}
+
+/**
+ * @brief route_mixer_invalidate
+ *        forget the shadowed values of every cached mixer, the next routes
+ *        write all their controls. Called when a stream starts, as amix,
+ *        tinymix or another process may have changed controls while the
+ *        streams were idle and only the jack monitor reports such writes.
+ *        must be called with the route worker lock
+ */
+void route_mixer_invalidate(void)
+{
+    unsigned i;
+
+    pthread_mutex_lock(&mMixerCacheLock);
+    for (i = 0; i < MIXER_CARD_MAX; i++) {
+        if (mMixerCache[i].mixer)
+            mixer_shadow_invalidate(mMixerCache[i].mixer);
+    }
+    pthread_mutex_unlock(&mMixerCacheLock);
+}
+
 /**
  * @brief route_pcm_open 
  *
@@ -525,6 +871,7 @@ void route_pcm_open(uint32_t route)
 #endif
 
     ALOGV("route_pcm_open() route %d", route);
+    audio_trace_begin("route_pcm_open");
 
     is_playback = is_playback_route(route);
 
@@ -535,6 +882,7 @@ void route_pcm_open(uint32_t route)
     const struct config_route *route_info = get_route_config(route);
     if (!route_info) {
         ALOGE("route_pcm_open() Can not get config of route");
+        audio_trace_end("route_pcm_open");
         goto __exit;
     }
 
@@ -561,17 +909,22 @@ void route_pcm_open(uint32_t route)
     }
 
     //update mMixer
+    audio_trace_begin("route mixer open");
     if (is_playback) {
         if (mMixerPlayback == NULL)
-            mMixerPlayback = mixer_open_legacy(route_info->sound_card == 1 ? 0 : route_info->sound_card);
+            mMixerPlayback = route_mixer_get(route_info->sound_card == 1 ? 0 : route_info->sound_card);
     } else {
         if (mMixerCapture == NULL)
-            mMixerCapture = mixer_open_legacy(route_info->sound_card == 1 ? 0 : route_info->sound_card);
+            mMixerCapture = route_mixer_get(route_info->sound_card == 1 ? 0 : route_info->sound_card);
     }
+    audio_trace_end("route mixer open");
 
     //set controls
+    audio_trace_begin("route controls");
     if (route_info->controls_count > 0)
         route_set_controls(route);
+    audio_trace_end("route controls");
+    audio_trace_end("route_pcm_open");
 __exit:
 	ALOGV("route_pcm_open exit");
 }
@@ -602,17 +955,11 @@ int route_pcm_close(unsigned route)
     if (is_playback_route(route) ? mMixerPlayback : mMixerCapture)
         route_set_controls(route);
 
-    //close mixer
+    //release mixer, it stays open in the cache for the next route
     if (route == PLAYBACK_OFF_ROUTE) {
-        if (mMixerPlayback) {
-            mixer_close_legacy(mMixerPlayback);
-            mMixerPlayback = NULL;
-        }
+        mMixerPlayback = NULL;
     } else if (route == CAPTURE_OFF_ROUTE) {
-        if (mMixerCapture) {
-            mixer_close_legacy(mMixerCapture);
-            mMixerCapture = NULL;
-        }
+        mMixerCapture = NULL;
     }
 
     return 0;
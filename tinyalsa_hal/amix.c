@@ -49,19 +49,52 @@
 */
 /**
  * @file amix.c
- * @brief 
+ * @brief list, get and set mixer controls, apply a batch with -f, follow
+ *        changes with --watch, or time them with --bench
  * @author  RkAudio
  * @version 1.0.8
  * @date 2015-08-24
  */
 
 #include <stdio.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
 
 #include "alsa_audio.h"
+#include "audio_stats.h"
+#include "codec_config/route_table_packed.h"
+
+#define __force
+#define __bitwise
+#define __user
+#include "asound.h"
+
+#define BENCH_RUNS_DEFAULT (100)
+
+/* members of struct config_route_table, in order */
+static const char *bench_route_names[] = {
+    "speaker_normal", "speaker_incall", "speaker_ringtone", "speaker_voip",
+    "earpiece_normal", "earpiece_incall", "earpiece_ringtone", "earpiece_voip",
+    "headphone_normal", "headphone_incall", "headphone_ringtone",
+    "speaker_headphone_normal", "speaker_headphone_ringtone", "headphone_voip",
+    "headset_normal", "headset_incall", "headset_ringtone", "headset_voip",
+    "bluetooth_normal", "bluetooth_incall", "bluetooth_voip",
+    "main_mic_capture", "hands_free_mic_capture", "bluetooth_sco_mic_capture",
+    "playback_off", "capture_off", "incall_off", "voip_off",
+    "hdmi_normal",
+    "usb_normal", "usb_capture",
+    "spdif_normal",
+    "hdmiin_normal", "hdmiin_off", "hdmiin_captrue", "hdmiin_captrue_off",
+};
+
+typedef char bench_route_names_check[
+    sizeof(bench_route_names) / sizeof(bench_route_names[0]) == ROUTE_PACKED_ROUTES ? 1 : -1];
 
 
 /**
@@ -89,6 +122,387 @@ struct mixer_ctl *get_ctl(struct mixer *mixer, char *name)
     return mixer_get_control(mixer, name, idx);
 }
 
+/**
+ * @brief bench_report
+ *        print min, percentiles and max of the samples in us, sorts them
+ */
+static void bench_report(const char *what, int64_t *ns, unsigned count)
+{
+    if (!count) {
+        printf("%-14s no samples\n", what);
+        return;
+    }
+    audio_stats_sort(ns, count);
+    printf("%-14s %6u %10.1f %10.1f %10.1f %10.1f %10.1f\n", what, count,
+           ns[0] / 1000.0, audio_stats_percentile(ns, count, 500) / 1000.0,
+           audio_stats_percentile(ns, count, 900) / 1000.0,
+           audio_stats_percentile(ns, count, 990) / 1000.0, ns[count - 1] / 1000.0);
+}
+
+static void bench_header(void)
+{
+    printf("%-14s %6s %10s %10s %10s %10s %10s\n", "us", "runs", "min", "p50", "p90", "p99", "max");
+}
+
+static int bench_is_int(const char *value)
+{
+    return isdigit(value[0]) || ((value[0] == '-') && isdigit(value[1]));
+}
+
+static int bench_write(struct mixer_ctl *ctl, const char *value)
+{
+    if (bench_is_int(value))
+        return mixer_ctl_set_int(ctl, atoll(value));
+    return mixer_ctl_select(ctl, value);
+}
+
+/**
+ * @brief bench_route_find
+ *        the packed route of the table route_init() would expand for
+ *        this card
+ *
+ * @returns the route or NULL
+ */
+static const struct route_packed_route *bench_route_find(int card, const char *name)
+{
+    const struct route_packed_card *table = route_packed_cards;
+    char path[64], id[20] = "";
+    size_t len = 0;
+    unsigned i;
+    FILE *fp;
+
+    snprintf(path, sizeof(path), "/proc/asound/card%d/id", card);
+    fp = fopen(path, "r");
+    if (fp) {
+        len = fread(id, 1, sizeof(id) - 1, fp);
+        fclose(fp);
+        while (len && (id[len - 1] == '\n'))
+            id[--len] = '\0';
+    }
+    for (i = 0; len && (i < route_packed_card_count); i++) {
+        if ((route_packed_cards[i].name != ROUTE_PACKED_NO_STR) &&
+            !strncmp(route_packed_strings + route_packed_cards[i].name, id, len)) {
+            table = route_packed_cards + i;
+            break;
+        }
+    }
+    printf("route table: %s\n", table->name == ROUTE_PACKED_NO_STR ? "default" :
+           route_packed_strings + table->name);
+
+    for (i = 0; i < ROUTE_PACKED_ROUTES; i++) {
+        if (!strcmp(bench_route_names[i], name))
+            return route_packed_routes + table->routes + i;
+    }
+    return NULL;
+}
+
+/**
+ * @brief bench_route
+ *        replay the control sequence of a route as route_pcm_open() on a
+ *        cold cache would: look every control up and write it. Every
+ *        entry is written, the shadow is not consulted.
+ *
+ * @returns 0 or -1
+ */
+static int bench_route(struct mixer *mixer, const struct route_packed_route *route, int runs,
+                       int64_t *samples)
+{
+    const struct route_packed_control *pc = route_packed_controls + route->controls;
+    unsigned count = route->controls_count, i;
+    int64_t *ctl_total, *ctl_max, start, t, dt;
+    unsigned errors = 0;
+    struct mixer_ctl *ctl;
+    char value[24];
+    int r, ret;
+
+    ctl_total = calloc(count ? count : 1, sizeof(int64_t));
+    ctl_max = calloc(count ? count : 1, sizeof(int64_t));
+    if (!ctl_total || !ctl_max) {
+        free(ctl_total);
+        free(ctl_max);
+        return -1;
+    }
+
+    for (r = 0; r < runs; r++) {
+        start = t = audio_stats_now_ns();
+        for (i = 0; i < count; i++) {
+            ctl = mixer_get_control(mixer, route_packed_strings + pc[i].name, 0);
+            if (!ctl) {
+                if (!r)
+                    printf("can't find control %s, skipped\n", route_packed_strings + pc[i].name);
+                continue;
+            }
+            if (pc[i].str_val != ROUTE_PACKED_NO_STR) {
+                ret = mixer_ctl_select(ctl, route_packed_strings + pc[i].str_val);
+            } else {
+                ret = mixer_ctl_set_int_double(ctl, pc[i].int_val[0], pc[i].int_val[1]);
+            }
+            if (ret)
+                errors++;
+            dt = audio_stats_now_ns() - t;
+            t += dt;
+            ctl_total[i] += dt;
+            if (dt > ctl_max[i])
+                ctl_max[i] = dt;
+        }
+        samples[r] = audio_stats_now_ns() - start;
+    }
+
+    printf("\n%-32s %-24s %10s %10s\n", "control", "value", "avg us", "max us");
+    for (i = 0; i < count; i++) {
+        if (pc[i].str_val != ROUTE_PACKED_NO_STR)
+            snprintf(value, sizeof(value), "%s", route_packed_strings + pc[i].str_val);
+        else
+            snprintf(value, sizeof(value), "%d", pc[i].int_val[0]);
+        printf("%-32s %-24s %10.1f %10.1f\n", route_packed_strings + pc[i].name, value,
+               ctl_total[i] / 1000.0 / runs, ctl_max[i] / 1000.0);
+    }
+    if (errors)
+        printf("%u writes failed\n", errors);
+    printf("\n");
+
+    free(ctl_total);
+    free(ctl_max);
+    return 0;
+}
+
+/**
+ * @brief bench
+ *        amix --bench [-n runs] [-r route] [control value...]
+ *        times ELEM_WRITE of the control cycling through the values, a
+ *        full mixer open, and the sequence of a compiled in route
+ *
+ * @returns 0 or -1
+ */
+static int bench(int card, int argc, char **argv)
+{
+    struct mixer *mixer;
+    struct mixer_ctl *ctl = NULL;
+    const struct route_packed_route *route = NULL;
+    const char *route_name = NULL;
+    char *control = NULL;
+    char **values = NULL;
+    unsigned errors = 0;
+    int64_t *samples, start;
+    int runs = BENCH_RUNS_DEFAULT;
+    int nvalues = 0;
+    int i, r;
+
+    for (i = 0; i < argc; i++) {
+        if (!strcmp(argv[i], "-n") && (i + 1 < argc)) {
+            runs = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-r") && (i + 1 < argc)) {
+            route_name = argv[++i];
+        } else if (!control) {
+            control = argv[i];
+            values = argv + i + 1;
+        } else {
+            nvalues++;
+        }
+    }
+    if ((runs <= 0) || (control && !nvalues)) {
+        printf("usage: amix [-c card] --bench [-n runs] [-r route] [control value...]\n");
+        return -1;
+    }
+    if (route_name) {
+        route = bench_route_find(card, route_name);
+        if (!route) {
+            printf("unknown route %s, one of:", route_name);
+            for (i = 0; i < (int)ROUTE_PACKED_ROUTES; i++)
+                printf(" %s", bench_route_names[i]);
+            printf("\n");
+            return -1;
+        }
+    }
+
+    samples = calloc(runs, sizeof(int64_t));
+    if (!samples)
+        return -1;
+
+    bench_header();
+
+    // full enumeration, the cost of the first route_mixer_get()
+    for (r = 0; r < runs; r++) {
+        start = audio_stats_now_ns();
+        mixer = mixer_open_legacy(card);
+        samples[r] = audio_stats_now_ns() - start;
+        if (!mixer) {
+            printf("can't open mixer of card %d\n", card);
+            free(samples);
+            return -1;
+        }
+        mixer_close_legacy(mixer);
+    }
+    bench_report("mixer open", samples, runs);
+
+    mixer = mixer_open_legacy(card);
+    if (!mixer) {
+        free(samples);
+        return -1;
+    }
+
+    if (control) {
+        ctl = get_ctl(mixer, control);
+        if (!ctl) {
+            printf("can't find control\n");
+            mixer_close_legacy(mixer);
+            free(samples);
+            return -1;
+        }
+        for (r = 0; r < runs; r++) {
+            start = audio_stats_now_ns();
+            if (bench_write(ctl, values[r % nvalues]))
+                errors++;
+            samples[r] = audio_stats_now_ns() - start;
+        }
+        bench_report("ELEM_WRITE", samples, runs);
+        if (errors)
+            printf("%u writes failed: %s\n", errors, strerror(errno));
+    }
+
+    if (route && !bench_route(mixer, route, runs, samples)) {
+        bench_header();
+        bench_report(route_name, samples, runs);
+    }
+
+    mixer_close_legacy(mixer);
+    free(samples);
+    return 0;
+}
+
+static char *batch_trim(char *str)
+{
+    char *end;
+
+    while (isspace((unsigned char)*str))
+        str++;
+    end = str + strlen(str);
+    while ((end > str) && isspace((unsigned char)end[-1]))
+        *--end = '\0';
+    return str;
+}
+
+/**
+ * @brief batch
+ *        amix -f file, apply name=value lines over one open mixer. A
+ *        value is an enum item, an integer, or left,right integers.
+ *        Empty lines and lines starting with '#' are skipped, "-" reads
+ *        stdin.
+ *
+ * @returns 0, or -1 if a line could not be applied
+ */
+static int batch(struct mixer *mixer, const char *path)
+{
+    struct mixer_ctl *ctl;
+    char line[256], *name, *value, *right;
+    unsigned lineno = 0, applied = 0, failed = 0;
+    int64_t start, total = 0, dt;
+    FILE *fp;
+    int r;
+
+    fp = strcmp(path, "-") ? fopen(path, "r") : stdin;
+    if (!fp) {
+        printf("can't open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp)) {
+        lineno++;
+        name = batch_trim(line);
+        if (!*name || (*name == '#'))
+            continue;
+        value = strchr(name, '=');
+        if (!value) {
+            printf("%s:%u: expected name=value\n", path, lineno);
+            failed++;
+            continue;
+        }
+        *value++ = '\0';
+        name = batch_trim(name);
+        value = batch_trim(value);
+
+        start = audio_stats_now_ns();
+        ctl = get_ctl(mixer, name);
+        if (!ctl) {
+            r = -1;
+            errno = ENOENT;
+        } else if ((right = strchr(value, ',')) != NULL) {
+            r = mixer_ctl_set_int_double(ctl, atoll(value), atoll(right + 1));
+        } else {
+            r = bench_write(ctl, value);
+        }
+        dt = audio_stats_now_ns() - start;
+        total += dt;
+
+        printf("%10.1f us  %s = %s%s%s\n", dt / 1000.0, name, value,
+               r ? "  failed: " : "", r ? strerror(errno) : "");
+        if (r)
+            failed++;
+        else
+            applied++;
+    }
+
+    if (fp != stdin)
+        fclose(fp);
+    printf("%u applied, %u failed, %.1f us\n", applied, failed, total / 1000.0);
+    return failed ? -1 : 0;
+}
+
+/**
+ * @brief watch
+ *        amix --watch, print every control change with its monotonic
+ *        time and the time since the previous change, until interrupted
+ *
+ * @returns -1 when reading the events fails
+ */
+static int watch(struct mixer *mixer)
+{
+    struct snd_ctl_event ev;
+    struct mixer_ctl *ctl;
+    int64_t now, last = 0;
+    int subscribe = 1;
+    unsigned n;
+
+    if (ioctl(mixer->fd, SNDRV_CTL_IOCTL_SUBSCRIBE_EVENTS, &subscribe) < 0) {
+        printf("can't subscribe to control events: %s\n", strerror(errno));
+        return -1;
+    }
+
+    for (;;) {
+        if (read(mixer->fd, &ev, sizeof(ev)) != sizeof(ev)) {
+            if (errno == EINTR)
+                continue;
+            printf("reading control events failed: %s\n", strerror(errno));
+            return -1;
+        }
+        now = audio_stats_now_ns();
+        if (ev.type != SNDRV_CTL_EVENT_ELEM)
+            continue;
+
+        printf("[%6lld.%06lld] %+10.3f ms  ", (long long)(now / 1000000000LL),
+               (long long)(now % 1000000000LL / 1000), last ? (now - last) / 1000000.0 : 0.0);
+        last = now;
+
+        if (ev.data.elem.mask == SNDRV_CTL_EVENT_MASK_REMOVE) {
+            printf("%s: removed\n", ev.data.elem.id.name);
+            continue;
+        }
+        ctl = NULL;
+        for (n = 0; n < mixer->count; n++) {
+            if (mixer->info[n].id.numid == ev.data.elem.id.numid) {
+                ctl = mixer->ctl + n;
+                break;
+            }
+        }
+        if (!ctl || !(ev.data.elem.mask & SNDRV_CTL_EVENT_MASK_VALUE)) {
+            printf("%s: changed (mask 0x%x)\n", ev.data.elem.id.name, ev.data.elem.mask);
+            continue;
+        }
+        mixer_ctl_print(ctl);
+    }
+    return 0;
+}
+
 int main(int argc, char **argv)
 {
     struct mixer *mixer;
@@ -116,7 +530,9 @@ int main(int argc, char **argv)
 
     printf("Card:%i\n", card);
 
-    
+    if ((argc > 1) && !strcmp(argv[1], "--bench"))
+        return bench(card, argc - 2, argv + 2);
+
 	mixer = mixer_open_legacy(card);
 
     if (!mixer)
@@ -127,6 +543,18 @@ int main(int argc, char **argv)
         return 0;
     }
 
+    if ((argc > 2) && !strcmp(argv[1], "-f")) {
+        r = batch(mixer, argv[2]);
+        mixer_close_legacy(mixer);
+        return r;
+    }
+
+    if (!strcmp(argv[1], "--watch")) {
+        r = watch(mixer);
+        mixer_close_legacy(mixer);
+        return r;
+    }
+
     ctl = get_ctl(mixer, argv[1]);
     argc -= 2;
     argv += 2;
@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file    astat.c
+ * @brief   live view of the counters the hal publishes in its live page
+ *
+ * Start the hal with media.audio.live set, astat then maps the page read
+ * only and redraws the streams and the voice process queues at the given
+ * rate. Reading takes no lock and the hal never waits for astat, so it can
+ * run at 100 Hz next to a glitch without moving it.
+ *
+ * usage: astat [-p page] [-r hz] [-n refreshes]
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <cutils/properties.h>
+
+#include "alsa_audio.h"
+#include "audio_live.h"
+#include "audio_stats.h"
+
+#define ASTAT_RATE_DEFAULT (10)
+#define ASTAT_RATE_MAX (1000)
+
+/* AudioRoute, in order */
+static const char *astat_route_names[] = {
+    "speaker_normal", "speaker_incall", "speaker_ringtone", "speaker_voip",
+    "earpiece_normal", "earpiece_incall", "earpiece_ringtone", "earpiece_voip",
+    "headphone_normal", "headphone_incall", "headphone_ringtone",
+    "speaker_headphone_normal", "speaker_headphone_ringtone", "headphone_voip",
+    "headset_normal", "headset_incall", "headset_ringtone", "headset_voip",
+    "bluetooth_normal", "bluetooth_incall", "bluetooth_voip",
+    "main_mic_capture", "hands_free_mic_capture", "bluetooth_sco_mic_capture",
+    "playback_off", "capture_off", "incall_off", "voip_off",
+    "hdmi_normal",
+    "spdif_normal",
+    "usb_normal", "usb_capture",
+    "hdmiin_normal", "hdmiin_off", "hdmiin_capture", "hdmiin_capture_off",
+};
+
+typedef char astat_route_names_check[
+    sizeof(astat_route_names) / sizeof(astat_route_names[0]) == MAX_ROUTE ? 1 : -1];
+
+/* what the previous refresh saw of a record, for the rates */
+struct astat_prev {
+    uint32_t id;
+    uint64_t total_bytes;
+    uint64_t transfers;
+    int64_t  ns;
+};
+
+static const char *astat_route_name(uint32_t route)
+{
+    return route < MAX_ROUTE ? astat_route_names[route] : "?";
+}
+
+/**
+ * @brief astat_stream
+ *        one line of a stream: state, ring fill, transfer sizes and rates
+ */
+static void astat_stream(int slot, const struct audio_live_stream *s, struct astat_prev *prev,
+                         int64_t now_ns)
+{
+    double secs = (now_ns - prev->ns) / 1e9;
+    double kbps = 0, tps = 0;
+    char fill[32];
+
+    if ((prev->id == s->id) && (prev->ns != 0) && (secs > 0)) {
+        kbps = (s->total_bytes - prev->total_bytes) / secs / 1000;
+        tps = (s->transfers - prev->transfers) / secs;
+    }
+    prev->id = s->id;
+    prev->total_bytes = s->total_bytes;
+    prev->transfers = s->transfers;
+    prev->ns = now_ns;
+
+    if ((s->fill_frames >= 0) && s->buffer_frames)
+        snprintf(fill, sizeof(fill), "%5d/%-5u %3u%%", s->fill_frames, s->buffer_frames,
+                 (unsigned)s->fill_frames * 100 / s->buffer_frames);
+    else
+        snprintf(fill, sizeof(fill), "%5s/%-5u %3s ", "-", s->buffer_frames, "-");
+
+    printf("%d %-3s #%-3u %-24s 0x%08x %-7s %6u/%u %4u | fill %s | xfer %6u [%u-%u] B %7.1f/s %8.1f kB/s"
+           " | xruns %u err %u | %lld ms\n",
+           slot, s->kind == AUDIO_LIVE_OUT ? "out" : "in", s->id, astat_route_name(s->route),
+           s->device, s->standby ? "standby" : "active", s->rate, s->channels, s->period_size,
+           fill, s->last_bytes, s->min_bytes, s->max_bytes, tps, kbps, s->xruns, s->errors,
+           s->update_ns ? (long long)((now_ns - s->update_ns) / 1000000) : -1LL);
+}
+
+static void astat_voice(const struct audio_live_voice *v, int64_t now_ns)
+{
+    if (!v->active) {
+        printf("voice: not running\n");
+        return;
+    }
+    printf("voice: %u blocks | raw queued cap %d ply %d B | out cap %d/%d ply %d/%d frames"
+           " | underruns cap %u ply %u | echo delay %d | %lld ms\n",
+           v->blocks, v->capture_queued, v->playback_queued, v->capture_depth, v->capture_target,
+           v->playback_depth, v->playback_target, v->capture_underruns, v->playback_underruns,
+           v->echo_delay, (long long)((now_ns - v->update_ns) / 1000000));
+}
+
+int main(int argc, char **argv)
+{
+    char path[PROPERTY_VALUE_MAX];
+    const struct audio_live_page *page = NULL;
+    struct astat_prev prev[AUDIO_LIVE_STREAMS];
+    struct timespec period;
+    int rate = ASTAT_RATE_DEFAULT;
+    int refreshes = 0, n;
+    bool tty = isatty(STDOUT_FILENO);
+    int i;
+
+    property_get("media.audio.live.path", path, AUDIO_LIVE_DEFAULT_PATH);
+    for (i = 1; i < argc - 1 && argv[i][0] == '-'; i += 2) {
+        if (!strcmp(argv[i], "-p"))
+            snprintf(path, sizeof(path), "%s", argv[i + 1]);
+        else if (!strcmp(argv[i], "-r"))
+            rate = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-n"))
+            refreshes = atoi(argv[i + 1]);
+        else
+            break;
+    }
+    if ((i < argc) || (rate <= 0) || (rate > ASTAT_RATE_MAX) || (refreshes < 0)) {
+        printf("usage: astat [-p page] [-r hz] [-n refreshes]\n"
+               "  page defaults to media.audio.live.path or %s,\n"
+               "  the hal publishes it when media.audio.live is set\n", AUDIO_LIVE_DEFAULT_PATH);
+        return -1;
+    }
+
+    memset(prev, 0, sizeof(prev));
+    period.tv_sec = 1 / rate;
+    period.tv_nsec = (1000000000L / rate) % 1000000000L;
+    for (n = 0; !refreshes || n < refreshes; n++) {
+        struct audio_live_stream s;
+        struct audio_live_voice v;
+        int64_t now_ns;
+
+        if (n)
+            nanosleep(&period, NULL);
+
+        /* a restarted hal lays the page out again, map it anew */
+        if (page && (__atomic_load_n(&page->magic, __ATOMIC_ACQUIRE) != AUDIO_LIVE_MAGIC)) {
+            munmap((void *)page, sizeof(*page));
+            page = NULL;
+        }
+        if (!page) {
+            page = audio_live_map(path);
+            if (!page) {
+                printf("%s: %s\n", path, strerror(errno));
+                if (refreshes == 1)
+                    return -1;
+                continue;
+            }
+            memset(prev, 0, sizeof(prev));
+        }
+
+        now_ns = audio_stats_now_ns();
+        if (tty)
+            printf("\033[H\033[J");
+        printf("hal pid %d, %s, %d Hz\n", page->pid, path, rate);
+        for (i = 0; i < AUDIO_LIVE_STREAMS; i++) {
+            if (audio_live_read(&page->stream[i], &s, sizeof(s)) < 0) {
+                printf("%d busy\n", i);
+                continue;
+            }
+            if (s.kind != AUDIO_LIVE_FREE)
+                astat_stream(i, &s, &prev[i], now_ns);
+        }
+        if (audio_live_read(&page->voice, &v, sizeof(v)) == 0)
+            astat_voice(&v, now_ns);
+        if (!tty)
+            printf("\n");
+        fflush(stdout);
+    }
+    return 0;
+}
@@ -309,7 +309,7 @@ void fill_hdmi_bitstream_buf(void * in, void* out,void* chan, int length)
     int temp, p, j = 0;
     char *ptr = (char *)in;
     char *ptr_end = (char *)in+length;
-    char *newptr = (char *)out;
+    unsigned char *newptr = (unsigned char *)out;
     char* channel = (char *)chan;
     if((ptr == NULL) || (newptr == NULL) || (channel == NULL) || (length <= 0))
         return ;
@@ -319,7 +319,7 @@ void fill_hdmi_bitstream_buf(void * in, void* out,void* chan, int length)
         newptr[1] = ((ptr[0]&0xe0)>>5)|((ptr[1]&0x1f)<<3);
         newptr[2] = (ptr[1]&0xe0)>>5;
         newptr[2] |= channel[scount];
-        temp = (newptr[2]<<24) | (newptr[1]<<16) | (newptr[0]<<8);
+        temp = ((unsigned)newptr[2]<<24) | (newptr[1]<<16) | (newptr[0]<<8);
         j=0;
         p=0;
         while (j<31) {
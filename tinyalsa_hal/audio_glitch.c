@@ -0,0 +1,438 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file    audio_glitch.c
+ * @brief   glitch detector on the playback written to the cards
+ *
+ * Two consecutive samples of a sine of known frequency give its phasor,
+ * amplitude and phase. The phasor turns by GLITCH_SPAN times the step of
+ * the tone between a sample and the one GLITCH_SPAN before, whatever the
+ * gain does meanwhile, so a fade or a volume change goes by but any
+ * splice in the tone doesn't. The phase change across the break, once
+ * the tone is clean again, tells what the splice was.
+ *
+ * A few multiplies per frame while it runs, and nothing at all without
+ * the property. Events take a lock, the dump takes it too.
+ */
+
+#define LOG_TAG "audio_glitch"
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <cutils/log.h>
+#include <cutils/properties.h>
+#include <tinyalsa/asoundlib.h>
+
+#include "audio_glitch.h"
+
+#define GLITCH_SPAN         (8)         // samples the phase advance is checked over
+#define GLITCH_LOCK         (1024)      // clean samples before the tone is followed
+#define GLITCH_SETTLE       (32)        // clean samples for the tone to be back
+#define GLITCH_GIVE_UP      (16384)     // samples without it, the test tone is over
+#define GLITCH_MIN_AMP      (32.0f)     // below is no tone, about -60 dBFS
+#define GLITCH_EVENTS       (16)
+
+struct glitch_phasor {
+    float re;
+    float im;
+};
+
+struct audio_glitch {
+    char name[16];
+    unsigned hz;
+
+    /* the tone at the rate it was set up for */
+    unsigned rate;
+    float step;                 // radians per sample
+    float cos_step;
+    float sin_step;
+    struct glitch_phasor back;  // turns a phasor back by GLITCH_SPAN steps
+    float tolerance;            // tangent of the phase error allowed over the span
+
+    /* following it */
+    float last;                 // previous sample
+    struct glitch_phasor span[GLITCH_SPAN];
+    uint64_t n;                 // samples seen since the start
+    bool locked;
+    bool broken;
+    unsigned clean;             // clean samples in a row
+    unsigned silent;            // quiet samples in the break
+    float amp2;                 // square of the amplitude of the tone
+    struct glitch_phasor ref;   // before the break
+    uint64_t ref_n;
+    uint64_t break_n;
+
+    /* the card time line */
+    bool timeline;
+    int64_t played_ns;          // of the last timestamp
+    uint64_t played;            // frames the card played by then
+    bool mapped;
+    int64_t map_ns;             // when the card plays sample map_n
+    uint64_t map_n;
+
+    pthread_mutex_t lock;
+    uint32_t count[AUDIO_GLITCH_KINDS];
+    uint64_t frames_dropped;
+    uint64_t frames_repeated;
+    uint32_t losses;            // times the tone went away for good
+    struct audio_glitch_event events[GLITCH_EVENTS];
+    unsigned nevents;           // ever, the last GLITCH_EVENTS are kept
+};
+
+static const char *glitch_kind_names[AUDIO_GLITCH_KINDS] = {
+    [AUDIO_GLITCH_CLICK] = "click",
+    [AUDIO_GLITCH_PHASE_JUMP] = "phase jump",
+    [AUDIO_GLITCH_DROPPED] = "dropped",
+    [AUDIO_GLITCH_REPEATED] = "repeated",
+    [AUDIO_GLITCH_DROPOUT] = "dropout",
+    [AUDIO_GLITCH_UNDERRUN] = "underrun",
+    [AUDIO_GLITCH_DISCARDED] = "discarded",
+    [AUDIO_GLITCH_WRITE_ERROR] = "write error",
+};
+
+struct audio_glitch *audio_glitch_open(const char *name)
+{
+    char value[PROPERTY_VALUE_MAX];
+    struct audio_glitch *glitch;
+    int hz;
+
+    property_get("media.audio.glitch.hz", value, "0");
+    hz = atoi(value);
+    if (hz <= 0)
+        return NULL;
+
+    glitch = calloc(1, sizeof(*glitch));
+    if (!glitch)
+        return NULL;
+    snprintf(glitch->name, sizeof(glitch->name), "%s", name);
+    glitch->hz = hz;
+    pthread_mutex_init(&glitch->lock, NULL);
+    ALOGD("%s: card %s, looking for a %d Hz tone", __func__, name, hz);
+    return glitch;
+}
+
+void audio_glitch_close(struct audio_glitch *glitch)
+{
+    if (!glitch)
+        return;
+    pthread_mutex_destroy(&glitch->lock);
+    free(glitch);
+}
+
+void audio_glitch_reset(struct audio_glitch *glitch)
+{
+    if (!glitch)
+        return;
+    glitch->n = 0;
+    glitch->locked = false;
+    glitch->broken = false;
+    glitch->clean = 0;
+    glitch->timeline = false;
+    glitch->mapped = false;
+}
+
+static void glitch_setup(struct audio_glitch *glitch, unsigned rate)
+{
+    float span_step;
+
+    audio_glitch_reset(glitch);
+    glitch->rate = rate;
+    glitch->step = 2.0f * (float)M_PI * glitch->hz / rate;
+    glitch->cos_step = cosf(glitch->step);
+    glitch->sin_step = sinf(glitch->step);
+    span_step = glitch->step * GLITCH_SPAN;
+    glitch->back.re = cosf(span_step);
+    glitch->back.im = -sinf(span_step);
+    /* a frame off must show, whatever the tone */
+    glitch->tolerance = tanf(glitch->step * 0.4f);
+    if (glitch->tolerance > 0.2f)
+        glitch->tolerance = 0.2f;
+}
+
+static int64_t glitch_play_ns(const struct audio_glitch *glitch, uint64_t n)
+{
+    if (!glitch->mapped)
+        return 0;
+    return glitch->map_ns + ((int64_t)n - (int64_t)glitch->map_n) * 1000000000LL / glitch->rate;
+}
+
+static void glitch_event(struct audio_glitch *glitch, enum audio_glitch_kind kind, uint64_t n,
+                         int64_t play_ns, int frames, float radians)
+{
+    struct audio_glitch_event *event;
+
+    pthread_mutex_lock(&glitch->lock);
+    event = &glitch->events[glitch->nevents++ % GLITCH_EVENTS];
+    event->play_ns = play_ns;
+    event->frame = n;
+    event->kind = kind;
+    event->frames = frames;
+    event->radians = radians;
+    glitch->count[kind]++;
+    if (kind == AUDIO_GLITCH_DROPPED)
+        glitch->frames_dropped += frames;
+    else if (kind == AUDIO_GLITCH_REPEATED)
+        glitch->frames_repeated += frames;
+    pthread_mutex_unlock(&glitch->lock);
+
+    ALOGW("card %s: %s, %d frames, %.2f rad at frame %llu, played at %lld.%06lld s", glitch->name,
+          glitch_kind_names[kind], frames, radians, (unsigned long long)n,
+          (long long)(play_ns / 1000000000LL), (long long)(play_ns % 1000000000LL / 1000));
+}
+
+/**
+ * @brief glitch_classify
+ *        the tone is back at sample n with phasor z, tell what the break was
+ */
+static void glitch_classify(struct audio_glitch *glitch, uint64_t n, struct glitch_phasor z)
+{
+    float jump = atan2f(z.im, z.re) - atan2f(glitch->ref.im, glitch->ref.re) -
+                 fmodf(glitch->step * (float)(n - glitch->ref_n), 2.0f * (float)M_PI);
+    float frames;
+    long whole;
+
+    jump = remainderf(jump, 2.0f * (float)M_PI);
+    frames = jump / glitch->step;
+    whole = lroundf(frames);
+
+    if (glitch->silent > 1)
+        glitch_event(glitch, AUDIO_GLITCH_DROPOUT, glitch->break_n,
+                     glitch_play_ns(glitch, glitch->break_n), glitch->silent, jump);
+    else if (whole && (fabsf(frames - whole) < 0.1f))
+        glitch_event(glitch, whole > 0 ? AUDIO_GLITCH_DROPPED : AUDIO_GLITCH_REPEATED,
+                     glitch->break_n, glitch_play_ns(glitch, glitch->break_n),
+                     whole > 0 ? whole : -whole, jump);
+    else if ((fabsf(frames) < 0.1f) || (fabsf(jump) < 0.01f))
+        glitch_event(glitch, AUDIO_GLITCH_CLICK, glitch->break_n,
+                     glitch_play_ns(glitch, glitch->break_n), 0, jump);
+    else
+        glitch_event(glitch, AUDIO_GLITCH_PHASE_JUMP, glitch->break_n,
+                     glitch_play_ns(glitch, glitch->break_n), 0, jump);
+}
+
+static void glitch_sample(struct audio_glitch *glitch, float x)
+{
+    struct glitch_phasor z, old, turned;
+    float mag2;
+    bool clean;
+
+    /* x = A sin(p), last = A sin(p - step) */
+    z.re = (x * glitch->cos_step - glitch->last) / glitch->sin_step;
+    z.im = x;
+    glitch->last = x;
+    old = glitch->span[glitch->n % GLITCH_SPAN];
+    glitch->span[glitch->n % GLITCH_SPAN] = z;
+    if (++glitch->n <= GLITCH_SPAN + 1)
+        return;
+
+    /* z times the conjugate of old, turned back by the span, is about real and positive */
+    turned.re = z.re * old.re + z.im * old.im;
+    turned.im = z.im * old.re - z.re * old.im;
+    mag2 = z.re * z.re + z.im * z.im;
+    {
+        float re = turned.re * glitch->back.re - turned.im * glitch->back.im;
+        float im = turned.re * glitch->back.im + turned.im * glitch->back.re;
+
+        /* plus the phase noise of the quantization, of a few lsb over the amplitude */
+        float noise = 3.0f / (glitch->sin_step * sqrtf(mag2 + 1.0f));
+
+        clean = (mag2 > GLITCH_MIN_AMP * GLITCH_MIN_AMP) && (re > 0) &&
+                (fabsf(im) <= (glitch->tolerance + noise) * re);
+    }
+    if (glitch->locked && (mag2 < glitch->amp2 / 16))
+        clean = false;
+
+    if (!glitch->locked) {
+        glitch->clean = clean ? glitch->clean + 1 : 0;
+        if (glitch->clean >= GLITCH_LOCK) {
+            glitch->locked = true;
+            glitch->amp2 = mag2;
+        }
+    } else if (!glitch->broken) {
+        if (clean) {
+            glitch->amp2 += (mag2 - glitch->amp2) / 256;
+            return;
+        }
+        /* the break is in the span, the phasor leaving it predates it */
+        glitch->broken = true;
+        glitch->ref = old;
+        glitch->ref_n = glitch->n - 1 - GLITCH_SPAN;
+        glitch->break_n = glitch->n - 1;
+        glitch->clean = 0;
+        glitch->silent = 0;
+    } else {
+        if (mag2 < glitch->amp2 / 16)
+            glitch->silent++;
+        glitch->clean = clean ? glitch->clean + 1 : 0;
+        if (glitch->clean >= GLITCH_SETTLE) {
+            glitch->broken = false;
+            glitch_classify(glitch, glitch->n - 1, z);
+            glitch->amp2 = mag2;
+        } else if (glitch->n - glitch->break_n > GLITCH_GIVE_UP) {
+            /* the test tone stopped, or the stream plays something else */
+            glitch->locked = false;
+            glitch->broken = false;
+            glitch->clean = 0;
+            pthread_mutex_lock(&glitch->lock);
+            glitch->losses++;
+            pthread_mutex_unlock(&glitch->lock);
+        }
+    }
+}
+
+/**
+ * @brief glitch_timeline
+ *        date the frames just written, and look for a gap in what the card
+ *        played since the last write
+ */
+static void glitch_timeline(struct audio_glitch *glitch, struct pcm *pcm, unsigned frames)
+{
+    unsigned int avail, size = pcm_get_buffer_size(pcm);
+    struct timespec ts;
+    uint64_t queued, played;
+    int64_t now_ns;
+
+    if (pcm_get_htimestamp(pcm, &avail, &ts) < 0)
+        return;
+    now_ns = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    queued = avail < size ? size - avail : 0;
+    played = glitch->n > queued ? glitch->n - queued : 0;
+
+    if (glitch->timeline) {
+        int64_t gap = (now_ns - glitch->played_ns) * glitch->rate / 1000000000LL -
+                      (int64_t)(played - glitch->played);
+
+        /* the position moves by periods on most cards, a quarter buffer is no jitter */
+        if (gap > size / 4)
+            glitch_event(glitch, AUDIO_GLITCH_UNDERRUN, glitch->played,
+                         glitch->played_ns + (int64_t)(played - glitch->played) * 1000000000LL /
+                         glitch->rate, (int)gap, 0);
+        else if (gap < -(int64_t)(size / 4))
+            glitch_event(glitch, AUDIO_GLITCH_DISCARDED, glitch->played, glitch->played_ns,
+                         (int)-gap, 0);
+    }
+    glitch->timeline = true;
+    glitch->played_ns = now_ns;
+    glitch->played = played;
+
+    glitch->mapped = true;
+    glitch->map_n = glitch->n - frames;
+    glitch->map_ns = now_ns + ((int64_t)queued - (int64_t)frames) * 1000000000LL / glitch->rate;
+}
+
+void audio_glitch_feed(struct audio_glitch *glitch, struct pcm *pcm, const int16_t *data,
+                       unsigned frames, unsigned channels, unsigned rate)
+{
+    uint64_t first;
+    unsigned i;
+
+    if (!glitch || !rate || !channels)
+        return;
+    if (rate != glitch->rate)
+        glitch_setup(glitch, rate);
+
+    /* dated before the samples, a break found in them is played by this write */
+    if (pcm) {
+        first = glitch->n;
+        glitch->n += frames;
+        glitch_timeline(glitch, pcm, frames);
+        glitch->n = first;
+    }
+
+    for (i = 0; i < frames; i++)
+        glitch_sample(glitch, data[i * channels]);
+}
+
+void audio_glitch_error(struct audio_glitch *glitch, unsigned frames, int err)
+{
+    if (!glitch)
+        return;
+    glitch_event(glitch, AUDIO_GLITCH_WRITE_ERROR, glitch->n, glitch_play_ns(glitch, glitch->n),
+                 frames, 0);
+    ALOGW("card %s: pcm_write of %u frames failed, %d", glitch->name, frames, err);
+}
+
+unsigned audio_glitch_events(struct audio_glitch *glitch, struct audio_glitch_event *events,
+                             unsigned max)
+{
+    unsigned i, first, count = 0;
+
+    if (!glitch)
+        return 0;
+    pthread_mutex_lock(&glitch->lock);
+    first = glitch->nevents > GLITCH_EVENTS ? glitch->nevents - GLITCH_EVENTS : 0;
+    for (i = first; (i < glitch->nevents) && (count < max); i++)
+        events[count++] = glitch->events[i % GLITCH_EVENTS];
+    pthread_mutex_unlock(&glitch->lock);
+    return count;
+}
+
+void audio_glitch_dump(struct audio_glitch *glitch, int fd)
+{
+    unsigned i, first;
+
+    /* the cards the stream never played on */
+    if (!glitch || !glitch->rate)
+        return;
+    pthread_mutex_lock(&glitch->lock);
+    dprintf(fd, "    glitches on card %s, %u Hz tone: click %u, phase jump %u, dropped %u (%llu frames), "
+            "repeated %u (%llu frames), dropout %u, underrun %u, discarded %u, write error %u, "
+            "tone lost %u\n",
+            glitch->name, glitch->hz, glitch->count[AUDIO_GLITCH_CLICK],
+            glitch->count[AUDIO_GLITCH_PHASE_JUMP], glitch->count[AUDIO_GLITCH_DROPPED],
+            (unsigned long long)glitch->frames_dropped, glitch->count[AUDIO_GLITCH_REPEATED],
+            (unsigned long long)glitch->frames_repeated, glitch->count[AUDIO_GLITCH_DROPOUT],
+            glitch->count[AUDIO_GLITCH_UNDERRUN], glitch->count[AUDIO_GLITCH_DISCARDED],
+            glitch->count[AUDIO_GLITCH_WRITE_ERROR],
+            glitch->losses);
+    first = glitch->nevents > GLITCH_EVENTS ? glitch->nevents - GLITCH_EVENTS : 0;
+    for (i = first; i < glitch->nevents; i++) {
+        const struct audio_glitch_event *event = &glitch->events[i % GLITCH_EVENTS];
+
+        dprintf(fd, "      %lld.%06lld s  frame %-10llu %-11s %6d frames %6.2f rad\n",
+                (long long)(event->play_ns / 1000000000LL),
+                (long long)(event->play_ns % 1000000000LL / 1000),
+                (unsigned long long)event->frame, glitch_kind_names[event->kind], event->frames,
+                event->radians);
+    }
+    pthread_mutex_unlock(&glitch->lock);
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file    audio_glitch.h
+ * @brief   glitch detector on the playback written to the cards, for soak
+ *          tests playing a sine
+ *
+ * With media.audio.glitch.hz set, every card of an output gets a detector
+ * that follows the phase of a tone of that frequency in the first channel
+ * of what out_write() hands to pcm_write(), after the slice and the mute.
+ * A break in the tone is reported once it is clean again, as the frames
+ * dropped or repeated that explain the phase change, a phase jump, a
+ * dropout or a click with no phase change. Independently, the card time
+ * line read with pcm_get_htimestamp() after each write tells the
+ * underruns and the restarts that threw queued frames away, which never
+ * show in the data. Every event is dated on the
+ * monotonic clock of the timestamps, at the moment the card plays it.
+ *
+ * Dropped and repeated frames are only told apart modulo the period of
+ * the tone, pick a frequency the rate isn't a multiple of, 997 Hz, in the
+ * range of 200 Hz to a quarter of the rate and above -40 dBFS.
+ */
+
+#ifndef AUDIO_GLITCH_H_
+#define AUDIO_GLITCH_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct pcm;
+struct audio_glitch;
+
+enum audio_glitch_kind {
+    AUDIO_GLITCH_CLICK,         // the tone broke and came back in phase
+    AUDIO_GLITCH_PHASE_JUMP,    // came back out of phase, not by whole frames
+    AUDIO_GLITCH_DROPPED,       // came back ahead by frames
+    AUDIO_GLITCH_REPEATED,      // came back behind by frames
+    AUDIO_GLITCH_DROPOUT,       // went silent for frames
+    AUDIO_GLITCH_UNDERRUN,      // the card played frames of nothing
+    AUDIO_GLITCH_DISCARDED,     // the card restarted without playing frames queued to it
+    AUDIO_GLITCH_WRITE_ERROR,   // pcm_write() failed, the frames are lost
+    AUDIO_GLITCH_KINDS
+};
+
+struct audio_glitch_event {
+    int64_t play_ns;            // when the card plays it, 0 if unknown
+    uint64_t frame;             // since the stream started
+    enum audio_glitch_kind kind;
+    int frames;
+    float radians;              // of the phase jump
+};
+
+/**
+ * @brief audio_glitch_open
+ *        a detector for the card called name, NULL unless
+ *        media.audio.glitch.hz is set. All the calls take NULL.
+ */
+struct audio_glitch *audio_glitch_open(const char *name);
+void audio_glitch_close(struct audio_glitch *glitch);
+
+/**
+ * @brief audio_glitch_reset
+ *        the stream stopped, what comes next is a new tone
+ */
+void audio_glitch_reset(struct audio_glitch *glitch);
+
+/**
+ * @brief audio_glitch_feed
+ *        check frames of 16 bit samples pcm_write() just took, pcm may be
+ *        NULL to check the data only, without the card time line
+ */
+void audio_glitch_feed(struct audio_glitch *glitch, struct pcm *pcm, const int16_t *data,
+                       unsigned frames, unsigned channels, unsigned rate);
+
+/**
+ * @brief audio_glitch_error
+ *        pcm_write() of that many frames failed with err
+ */
+void audio_glitch_error(struct audio_glitch *glitch, unsigned frames, int err);
+
+/**
+ * @brief audio_glitch_events
+ *        copy out at most max of the events kept, oldest first
+ *
+ * @returns the number copied
+ */
+unsigned audio_glitch_events(struct audio_glitch *glitch, struct audio_glitch_event *events,
+                             unsigned max);
+
+void audio_glitch_dump(struct audio_glitch *glitch, int fd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -79,13 +79,22 @@
 #include <system/audio.h>
 #include "codec_config/config.h"
 #include "audio_bitstream.h"
+#include "audio_journal.h"
 #include "audio_setting.h"
+#include "audio_slice.h"
+#include "audio_trace.h"
+#include "jack_monitor.h"
 #include <unistd.h>
 #include <fcntl.h>
 #include <ctype.h>
 
 #define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
 #define SND_CARDS_NODE          "/proc/asound/cards"
+
+/* by enum snd_out_sound_cards, for the logs and dumps */
+static const char *const out_card_names[SND_OUT_SOUND_CARD_MAX] = {
+    "speaker", "hdmi", "spdif", "bt",
+};
 /*
  * if current audio stream bitstream over hdmi,
  * and hdmi is removed and reconnected later,
@@ -770,9 +779,12 @@ static int mixer_mode_set(struct stream_out *out)
     struct mixer *mMixer = NULL;
     struct mixer_ctl *pctl;
     struct audio_device *adev = out->dev;
-    mMixer = mixer_open_legacy(adev->out_card[SND_OUT_SOUND_CARD_HDMI]);
+    // a single write, taken between two route programs rather than after them
+    route_worker_lock();
+    mMixer = route_mixer_get(adev->out_card[SND_OUT_SOUND_CARD_HDMI]);
     if(!mMixer) {
         ALOGE("mMixer is a null point %s %d,CARD = %d",__func__, __LINE__,adev->out_card[SND_OUT_SOUND_CARD_HDMI]);
+        route_worker_unlock();
 	return ret;
     }
     pctl = mixer_get_control(mMixer,"AUDIO MODE",0 );
@@ -788,8 +800,8 @@ static int mixer_mode_set(struct stream_out *out)
         ret = mixer_ctl_set_val(pctl , out->output_direct_mode);
         break;
     }
+    route_worker_unlock();
 
-    mixer_close_legacy(mMixer);
     if (ret!=0) {
         ALOGE("set_controls() can not set ctl!");
         return -EINVAL;
@@ -836,7 +848,7 @@ static void open_sound_card_policy(struct stream_out *out)
         out->device &= ~AUDIO_DEVICE_OUT_AUX_DIGITAL;
     }
 #endif
-    out_dump(out, 0);
+    out_dump(&out->stream.common, -1);
 }
 
 /**
@@ -864,7 +876,9 @@ static int start_output_stream(struct stream_out *out)
         return 0;
     }
     out->disabled = false;
+    audio_trace_begin("read_out_sound_card");
     read_out_sound_card(out);
+    audio_trace_end("read_out_sound_card");
 
     int device = getOutputDevice();
     if (device == SPDIF_PASSTHROUGH_MODE) {
@@ -877,7 +891,13 @@ static int start_output_stream(struct stream_out *out)
 #ifdef BOX_HAL
     open_sound_card_policy(out);
 #endif
-    route_pcm_open(getRouteFromDevice(out->device));
+    // the controls may have been changed from outside while in standby
+    route_worker_lock();
+    route_mixer_invalidate();
+    route_worker_unlock();
+    audio_trace_begin("route_worker_open");
+    route_worker_open(getRouteFromDevice(out->device));
+    audio_trace_end("route_worker_open");
 
     if (out->device & AUDIO_DEVICE_OUT_AUX_DIGITAL) {
         if (true) {
@@ -893,8 +913,10 @@ static int start_output_stream(struct stream_out *out)
 #endif
             card = adev->out_card[SND_OUT_SOUND_CARD_HDMI];
             if(card != (int)SND_OUT_SOUND_CARD_UNKNOWN) {
+                audio_trace_begin("pcm_open hdmi");
                 out->pcm[SND_OUT_SOUND_CARD_HDMI] = pcm_open(card, out->pcm_device,
                                                 PCM_OUT | PCM_MONOTONIC, &out->config);
+                audio_trace_end("pcm_open hdmi");
                 if (out->pcm[SND_OUT_SOUND_CARD_HDMI] &&
                         !pcm_is_ready(out->pcm[SND_OUT_SOUND_CARD_HDMI])) {
                     ALOGE("pcm_open(PCM_CARD_HDMI) failed: %s, card number = %d",
@@ -917,8 +939,10 @@ static int start_output_stream(struct stream_out *out)
                        AUDIO_DEVICE_OUT_ALL_SCO)) {
         card = adev->out_card[SND_OUT_SOUND_CARD_SPEAKER];
         if(card != (int)SND_OUT_SOUND_CARD_UNKNOWN) {
+            audio_trace_begin("pcm_open speaker");
             out->pcm[SND_OUT_SOUND_CARD_SPEAKER] = pcm_open(card, out->pcm_device,
                                           PCM_OUT | PCM_MONOTONIC, &out->config);
+            audio_trace_end("pcm_open speaker");
             if (out->pcm[SND_OUT_SOUND_CARD_SPEAKER] && !pcm_is_ready(out->pcm[SND_OUT_SOUND_CARD_SPEAKER])) {
                 ALOGE("pcm_open(PCM_CARD) failed: %s,card number = %d",
                       pcm_get_error(out->pcm[SND_OUT_SOUND_CARD_SPEAKER]),card);
@@ -932,8 +956,10 @@ static int start_output_stream(struct stream_out *out)
     //if (out->device & AUDIO_DEVICE_OUT_SPDIF) {
         card = adev->out_card[SND_OUT_SOUND_CARD_SPDIF];
         if(card != (int)SND_OUT_SOUND_CARD_UNKNOWN) {
+            audio_trace_begin("pcm_open spdif");
             out->pcm[SND_OUT_SOUND_CARD_SPDIF] = pcm_open(card, out->pcm_device,
                                                 PCM_OUT | PCM_MONOTONIC, &out->config);
+            audio_trace_end("pcm_open spdif");
 
             if (out->pcm[SND_OUT_SOUND_CARD_SPDIF] &&
                     !pcm_is_ready(out->pcm[SND_OUT_SOUND_CARD_SPDIF])) {
@@ -966,11 +992,62 @@ static int start_output_stream(struct stream_out *out)
 
     if(adev->hdmiin_state){
        ALOGD("%s HDMIin state open hdmiin route",__FUNCTION__);
-       route_pcm_open(HDMI_IN_NORMAL_ROUTE);
+       route_worker_open(HDMI_IN_NORMAL_ROUTE);
     }
     return 0;
 }
 
+/**
+ * @brief pcm_ring_avail
+ * frames free in the ring of a playback, queued in the ring of a capture.
+ * A whole ring of them means it drained, or filled up for a capture, since
+ * the last transfer: an xrun tinyalsa recovers from without reporting it
+ *
+ * @param pcm
+ *
+ * @returns the frames, -1 if the pcm isn't running
+ */
+static int pcm_ring_avail(struct pcm *pcm)
+{
+    unsigned int avail;
+    struct timespec ts;
+
+    if (pcm_get_htimestamp(pcm, &avail, &ts) != 0)
+        return -1;
+    return (int)avail;
+}
+
+/**
+ * @brief out_live_update
+ * publish the configuration, device and state of an output, called with
+ * out->lock held whenever one of them changes
+ *
+ * @param out
+ */
+static void out_live_update(struct stream_out *out)
+{
+    audio_live_stream_config(out->live, out->config.rate, out->config.channels,
+                             out->config.period_size,
+                             out->config.period_size * out->config.period_count);
+    audio_live_stream_route(out->live, out->device, getRouteFromDevice(out->device), out->standby);
+}
+
+/**
+ * @brief in_live_update
+ * the same for an input, called with in->lock held
+ *
+ * @param in
+ */
+static void in_live_update(struct stream_in *in)
+{
+    if (in->config != NULL)
+        audio_live_stream_config(in->live, in->config->rate, in->config->channels,
+                                 in->config->period_size,
+                                 in->config->period_size * in->config->period_count);
+    audio_live_stream_route(in->live, in->device,
+                            getRouteFromDevice(in->device | AUDIO_DEVICE_BIT_IN), in->standby);
+}
+
 /**
  * @brief get_next_buffer
  *
@@ -999,9 +1076,20 @@ static int get_next_buffer(struct resampler_buffer_provider *buffer_provider,
     }
 
     if (in->frames_in == 0) {
+        int64_t xfer_ns, end_ns;
+        int fill;
+
         size = pcm_frames_to_bytes(in->pcm,pcm_get_buffer_size(in->pcm));
+        fill = pcm_ring_avail(in->pcm);
+        if (fill >= (int)pcm_get_buffer_size(in->pcm))
+            audio_stats_inc(&in->stats.xruns);
+        xfer_ns = audio_stats_now_ns();
         in->read_status = pcm_read(in->pcm,
                                    (void*)in->buffer,pcm_frames_to_bytes(in->pcm, in->config->period_size));
+        end_ns = audio_stats_now_ns();
+        audio_stats_xfer(&in->stats, xfer_ns, end_ns, in->read_status);
+        audio_live_stream_xfer(in->live, pcm_frames_to_bytes(in->pcm, in->config->period_size), fill,
+                               in->read_status, in->stats.xruns, end_ns);
         if (in->read_status != 0) {
             ALOGE("get_next_buffer() pcm_read error %d", in->read_status);
             buffer->raw = NULL;
@@ -1064,9 +1152,14 @@ static int start_input_stream(struct stream_in *in)
     struct audio_device *adev = in->dev;
     int  ret = 0;
 
-    in_dump(in, 0);
+    in_dump(&in->stream.common, -1);
+    audio_trace_begin("read_in_sound_card");
     read_in_sound_card(in);
-    route_pcm_open(getRouteFromDevice(in->device | AUDIO_DEVICE_BIT_IN));
+    audio_trace_end("read_in_sound_card");
+    route_worker_lock();
+    route_mixer_invalidate();
+    route_worker_unlock();
+    route_worker_open(getRouteFromDevice(in->device | AUDIO_DEVICE_BIT_IN));
     int card = (int)SND_OUT_SOUND_CARD_UNKNOWN;
 #ifdef RK3399_LAPTOP //HARD CODE FIXME
     if ((in->device & AUDIO_DEVICE_IN_BLUETOOTH_SCO_HEADSET) &&
@@ -1078,7 +1171,7 @@ static int start_input_stream(struct stream_in *in)
             return -1;
         }
 
-        in->pcm = pcm_open(card, PCM_DEVICE, PCM_IN, in->config);
+        in->pcm = pcm_open(card, PCM_DEVICE, PCM_IN | PCM_MONOTONIC, in->config);
         if (in->resampler) {
             release_resampler(in->resampler);
 
@@ -1105,7 +1198,7 @@ static int start_input_stream(struct stream_in *in)
             return -1;
         }
 		
-        in->pcm = pcm_open(card, PCM_DEVICE, PCM_IN, in->config);
+        in->pcm = pcm_open(card, PCM_DEVICE, PCM_IN | PCM_MONOTONIC, in->config);
         if (in->resampler) {
             release_resampler(in->resampler);
 
@@ -1126,7 +1219,7 @@ static int start_input_stream(struct stream_in *in)
 #else
      card = (int)adev->in_card[SND_IN_SOUND_CARD_HDMI];
      if (in->device & AUDIO_DEVICE_IN_HDMI && (card != (int)SND_OUT_SOUND_CARD_UNKNOWN)) {
-        in->pcm = pcm_open(card, PCM_DEVICE, PCM_IN, in->config);
+        in->pcm = pcm_open(card, PCM_DEVICE, PCM_IN | PCM_MONOTONIC, in->config);
         ALOGD("open HDMIIN %d", card);
      } else if (in->device & AUDIO_DEVICE_IN_BLUETOOTH_SCO_HEADSET){
         start_bt_sco(adev);
@@ -1137,7 +1230,7 @@ static int start_input_stream(struct stream_in *in)
             ALOGE("%s: the number of mic is invalid,please check");
             return -1;
         }
-        in->pcm = pcm_open(card, PCM_DEVICE, PCM_IN, in->config);
+        in->pcm = pcm_open(card, PCM_DEVICE, PCM_IN | PCM_MONOTONIC, in->config);
      }
 #endif
     if (in->pcm && !pcm_is_ready(in->pcm)) {
@@ -1378,6 +1471,10 @@ static void do_out_standby(struct stream_out *out)
             }
         }
         out->standby = true;
+        audio_stats_standby(&out->stats);
+        for (i = 0; i < SND_OUT_SOUND_CARD_MAX; i++)
+            audio_glitch_reset(out->glitch[i]);
+        out_live_update(out);
         out->nframes = 0;
 		property_set("media.audio.slice", "0");
         if (out == adev->outputs[OUTPUT_HDMI_MULTI]) {
@@ -1401,17 +1498,71 @@ static void do_out_standby(struct stream_out *out)
             adev->voice_api->flush();
         }
 #endif
-        route_pcm_close(PLAYBACK_OFF_ROUTE);
+        /* another stream keeps the path up, otherwise hold it for a quick restart */
+        if (adev->out_device)
+            route_worker_close(PLAYBACK_OFF_ROUTE);
+        else
+            route_worker_standby(PLAYBACK_OFF_ROUTE);
         ALOGD("close device");
 
         /* Skip resetting the mixer if no output device is active */
         if (adev->out_device) {
-            route_pcm_open(getRouteFromDevice(adev->out_device));
+            route_worker_open(getRouteFromDevice(adev->out_device));
             ALOGD("change device");
         }
     }
 }
 
+/**
+ * @brief out_commit_staged_route
+ * switch a running codec output between speaker and the wired jacks without
+ * going through standby, when the jack monitor already prepared that route.
+ * must be called with hw device outputs list, all out streams, and hw device mutex locked
+ *
+ * @param out
+ * @param device
+ *
+ * @returns true if the stream now plays on device
+ */
+static bool out_commit_staged_route(struct stream_out *out, audio_devices_t device)
+{
+    struct audio_device *adev = out->dev;
+    const audio_devices_t codec = AUDIO_DEVICE_OUT_SPEAKER |
+                                  AUDIO_DEVICE_OUT_WIRED_HEADSET |
+                                  AUDIO_DEVICE_OUT_WIRED_HEADPHONE;
+    int64_t event_ns;
+    struct timespec ts;
+    long long us;
+
+    if (!adev->jack_monitor || out->standby || (out == adev->outputs[OUTPUT_HDMI_MULTI]) ||
+        (out->device & ~codec) || (device & ~codec))
+        return false;
+
+    pthread_mutex_lock(&adev->jack_lock);
+    if (adev->jack_device != device) {
+        pthread_mutex_unlock(&adev->jack_lock);
+        return false;
+    }
+    event_ns = adev->jack_event_ns;
+    adev->jack_event_ns = 0;
+    pthread_mutex_unlock(&adev->jack_lock);
+
+    /* same codec card, the pcm keeps running and only the path changes */
+    adev->out_device = output_devices(out) | device;
+    route_worker_open(getRouteFromDevice(device));
+
+    if (event_ns) {
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        us = ((long long)ts.tv_sec * 1000000000LL + ts.tv_nsec - event_ns) / 1000;
+        adev->jack_commits++;
+        adev->jack_commit_last_us = us;
+        if (us > adev->jack_commit_max_us)
+            adev->jack_commit_max_us = us;
+        ALOGD("%s: device %x committed %lld us after the jack event", __FUNCTION__, device, us);
+    }
+    return true;
+}
+
 /**
  * @brief lock_all_outputs
  * lock outputs list, all output streams, and device
@@ -1482,6 +1633,7 @@ static int out_standby(struct audio_stream *stream)
 int out_dump(const struct audio_stream *stream, int fd)
 {
     struct stream_out *out = (struct stream_out *)stream;
+    int i;
 
     ALOGD("out->Device     : 0x%x", out->device);
     ALOGD("out->SampleRate : %d", out->config.rate);
@@ -1490,6 +1642,15 @@ int out_dump(const struct audio_stream *stream, int fd)
     ALOGD("out->PreiodSize : %d", out->config.period_size);
     ALOGD("out->flags : %d", out->config.flag);
 
+    if (fd < 0)
+        return 0;
+    dprintf(fd, "  output %p: device 0x%x, %u Hz, %u ch, period %u x %u, %s, %llu frames written\n",
+            out, out->device, out->config.rate, out->config.channels, out->config.period_size,
+            out->config.period_count, out->standby ? "standby" : "active",
+            (unsigned long long)out->written);
+    audio_stats_dump(&out->stats, fd);
+    for (i = 0; i < SND_OUT_SOUND_CARD_MAX; i++)
+        audio_glitch_dump(out->glitch[i], fd);
     return 0;
 }
 /**
@@ -1509,6 +1670,8 @@ static int out_set_parameters(struct audio_stream *stream, const char *kvpairs)
     int ret;
     int status = 0;
     unsigned int val;
+    int64_t route_ns;
+    bool routed = false;
     if(adev->hdmiin_state)
 	    return 0;
 
@@ -1526,10 +1689,14 @@ static int out_set_parameters(struct audio_stream *stream, const char *kvpairs)
 
     ret = str_parms_get_str(parms, AUDIO_PARAMETER_STREAM_ROUTING,
                             value, sizeof(value));
+    route_ns = audio_stats_now_ns();
     lock_all_outputs(adev);
     if (ret >= 0) {
         val = atoi(value);
-        if ((val != 0) && ((out->device & val) != val)) {
+        if ((val != 0) && ((out->device & val) != val) && out_commit_staged_route(out, val)) {
+            out->device = val;
+            routed = true;
+        } else if ((val != 0) && ((out->device & val) != val)) {
             /* Force standby if moving to/from SPDIF or if the output
              * device changes when in SPDIF mode */
             if (((val & AUDIO_DEVICE_OUT_DGTL_DOCK_HEADSET) ^
@@ -1552,8 +1719,13 @@ static int out_set_parameters(struct audio_stream *stream, const char *kvpairs)
 
             }
             out->device = val;
+            routed = true;
         }
     }
+    if (routed) {
+        audio_hist_add(&out->stats.route, audio_stats_now_ns() - route_ns);
+        out_live_update(out);
+    }
     unlock_all_outputs(adev, NULL);
 
     str_parms_destroy(parms);
@@ -1711,63 +1883,6 @@ static void reset_bitstream_buf(struct stream_out *out)
         }
     }
 }
-const float volume_slice[]={0.8012, 0.6419, 0.5309, 0.4254,
-                            0.3408, 0.2828, 0.1773, 0.1116,
-                            0.0750, 0.0472, 0.0297, 0.0200,
-                            0.0078, 0.0031, 0.0010, 0.0000};
-
-const float delta_slice[] = {0.8, 0.6, 0.48, 0.3, 0.17, 0.1, 0.05, 0};
-
-float get_len_posi(struct stream_out *out,int len)
-{
-    int len_max = out->out_data_size / 2;
-	int ret = 0;
-	
-	if (len < len_max / 8)
-		ret = 0;
-	else if ((len > len_max/8)&&(len < len_max/4))
-		ret = 1;
-    else if ((len > len_max/4) && (len < (len_max*3) /8))
-		ret = 2;
-	else if ((len > (len_max*3) /8) && (len < len_max/2))
-		ret = 3;
-	else if ((len > len_max/2) && (len < (len_max*5) /8))
-		ret = 4;
-	else if ((len > (len_max*5) /8) && (len < (len_max*3) /4))
-		ret = 5;
-	else if ((len > (len_max*3) /4) && (len < (len_max*7) /8))
-		ret = 6;
-	else
-		ret = 7;
-	
-	return delta_slice[ret];
-
-}
-static int cal_data_slice(struct stream_out *out,void *data,int len,int times,bool down)
-{
-    
-    int16_t *raw =(int16_t *)data;
-	len /=2;
-	if (times > 15)times =15;
-	else if (times < 0)times =0;
-	while (len--){
-		float tmp = (float)(*(raw+len));
-		if (down)
-			tmp *=(volume_slice[times] -
-			          (volume_slice[times]-volume_slice[times+1]*(1-get_len_posi(out,len))));
-		else{
-			if (times >=1)
-				tmp *=(volume_slice[times] +
-				         ((volume_slice[times-1] - volume_slice[times]) * (1-get_len_posi(out,len))));
-			else
-				tmp *=(volume_slice[times] +
-				         ((1 - volume_slice[times]) * (1-get_len_posi(out,len))));
-	    }
-		*(raw + len)=(int16_t) tmp;
-	}
-    return 0;
-}
-
 static void set_data_slice(void *in_data,struct stream_out *out,size_t length)
 {
     //Resolve the broken sound when cut the table
@@ -1784,7 +1899,7 @@ static void set_data_slice(void *in_data,struct stream_out *out,size_t length)
     if(slice_mode ==1){
         out->slice_time_up = 0;
         ALOGD("for audio slice slicetime = %d,slice_mode =%d",out->slice_time_down,slice_mode);
-        cal_data_slice (out,(void *)in_data, length, out->slice_time_down,true);
+        cal_data_slice(out->out_data_size, (void *)in_data, length, out->slice_time_down,true);
         out->slice_time_down++;
         if (out->slice_time_down >= 50){
             property_set("media.audio.slice","0");
@@ -1795,7 +1910,7 @@ static void set_data_slice(void *in_data,struct stream_out *out,size_t length)
         if(out->slice_time_up==0)
             out->slice_time_up =15;
         ALOGD("for audio slice slicetime = %d,slice_mode =%d",out->slice_time_up,slice_mode);
-        cal_data_slice (out,(void *)in_data, length, out->slice_time_up,false);
+        cal_data_slice(out->out_data_size, (void *)in_data, length, out->slice_time_up,false);
         out->slice_time_up--;
         if (out->slice_time_up <= 0){
             property_set("media.audio.slice","0");
@@ -1878,6 +1993,36 @@ static void check_hdmi_reconnect(struct stream_out *out)
 }
 
 
+#ifdef AUDIO_3A
+/**
+ * @brief out_get_next_present_ns
+ * monotonic time at which the next frame written to the output will be
+ * presented, the 3A process uses it to timestamp the echo reference
+ *
+ * @param out
+ *
+ * @returns time in ns, -1 if no pcm can report it
+ */
+static int64_t out_get_next_present_ns(struct stream_out *out)
+{
+    size_t kernel_buffer_size = out->config.period_size * out->config.period_count;
+    unsigned int avail;
+    struct timespec ts;
+    int i;
+
+    for (i = 0; i < SND_OUT_SOUND_CARD_MAX; i++) {
+        if ((out->pcm[i] == NULL) || (i == SND_OUT_SOUND_CARD_BT))
+            continue;
+        if (pcm_get_htimestamp(out->pcm[i], &avail, &ts) == 0) {
+            int64_t queued = kernel_buffer_size > avail ? kernel_buffer_size - avail : 0;
+            return ts.tv_sec * 1000000000LL + ts.tv_nsec +
+                   queued * 1000000000LL / out->config.rate;
+        }
+    }
+    return -1;
+}
+#endif
+
 /**
  * @brief out_write
  *
@@ -1896,6 +2041,8 @@ static ssize_t out_write(struct audio_stream_out *stream, const void* buffer,
     struct audio_device *adev = out->dev;
     size_t newbytes = bytes * 2;
     int i,card;
+    int64_t start_ns, lock_ns, xfer_ns = 0;
+    int fill = -1;
     /* FIXME This comment is no longer correct
      * acquiring hw device mutex systematically is useful if a low
      * priority thread is waiting on the output stream mutex - e.g.
@@ -1908,23 +2055,33 @@ static ssize_t out_write(struct audio_stream_out *stream, const void* buffer,
     check_hdmi_reconnect(out);
 #endif
 
+    lock_ns = audio_stats_now_ns();
     pthread_mutex_lock(&out->lock);
+    lock_ns = audio_stats_now_ns() - lock_ns;
     if (out->standby) {
         pthread_mutex_unlock(&out->lock);
+        start_ns = audio_stats_now_ns();
         lock_all_outputs(adev);
+        lock_ns += audio_stats_now_ns() - start_ns;
         if (!out->standby) {
             unlock_all_outputs(adev, out);
             goto false_alarm;
         }
+        start_ns = audio_stats_now_ns();
+        audio_trace_begin("start_output_stream");
         ret = start_output_stream(out);
+        audio_trace_end("start_output_stream");
         if (ret < 0) {
-            unlock_all_outputs(adev, NULL);
-            goto final_exit;
+            unlock_all_outputs(adev, out);
+            goto exit;
         }
         out->standby = false;
+        audio_hist_add(&out->stats.start, audio_stats_now_ns() - start_ns);
+        out_live_update(out);
         unlock_all_outputs(adev, out);
     }
 false_alarm:
+    audio_hist_add(&out->stats.lock, lock_ns);
 
     if (out->disabled) {
         ret = -EPIPE;
@@ -1951,8 +2108,8 @@ false_alarm:
 #ifdef AUDIO_3A
     if (adev->voice_api != NULL) {
         int ret = 0;
-        adev->voice_api->queuePlaybackBuffer(buffer, bytes);
-        ret = adev->voice_api->getPlaybackBuffer(buffer, bytes);
+        adev->voice_api->queuePlaybackBuffer((void *)buffer, bytes);
+        ret = adev->voice_api->getPlaybackBufferTs((void *)buffer, bytes, out_get_next_present_ns(out));
         if (ret < 0) {
             memset((char *)buffer, 0x00, bytes);
         }
@@ -1961,6 +2118,24 @@ false_alarm:
 
     dump_out_data(buffer, bytes);
 
+    for (i = 0; i < SND_OUT_SOUND_CARD_MAX; i++) {
+        int avail, size;
+
+        if (!out->pcm[i] || (i == SND_OUT_SOUND_CARD_BT))
+            continue;
+        avail = pcm_ring_avail(out->pcm[i]);
+        if (avail < 0)
+            continue;
+        size = (int)pcm_get_buffer_size(out->pcm[i]);
+        if (fill < 0)
+            fill = size - avail;
+        if (avail >= size) {
+            audio_stats_inc(&out->stats.xruns);
+            break;
+        }
+    }
+    xfer_ns = audio_stats_now_ns();
+
     /* Write to all active PCMs */
     if (is_bitstream(out) && (out->device & AUDIO_DEVICE_OUT_AUX_DIGITAL)) {
         int card = adev->out_card[SND_OUT_SOUND_CARD_HDMI];
@@ -1991,7 +2166,7 @@ false_alarm:
                     memset(out_buffer, 0x00, outFrameCount*2);
 
                     out->resampler->resample_from_input(out->resampler,
-                                                        (const int16_t *)buffer,
+                                                        (int16_t *)buffer,
                                                         &inFrameCount,
                                                         out_buffer,
                                                         &outFrameCount);
@@ -2000,23 +2175,37 @@ false_alarm:
                     if (ret != 0)
                         break;
                 } else {
+                    size_t frames = bytes / (out->config.channels * sizeof(short));
+
                     ret = pcm_write(out->pcm[i], (void *)buffer, bytes);
-                    if (ret != 0)
+                    if (ret != 0) {
+                        audio_glitch_error(out->glitch[i], frames, ret);
                         break;
+                    }
+                    audio_glitch_feed(out->glitch[i], out->pcm[i], (const int16_t *)buffer,
+                                      frames, out->config.channels, out->config.rate);
                 }
             }
     }
 exit:
-    pthread_mutex_unlock(&out->lock);
-final_exit:
+    if (xfer_ns) {
+        int64_t end_ns = audio_stats_now_ns();
+
+        if ((ret == 0) && !out->stats.last_xfer_ns)
+            audio_trace_first_sound();
+        audio_stats_xfer(&out->stats, xfer_ns, end_ns, ret);
+        audio_live_stream_xfer(out->live, bytes, fill, ret, out->stats.xruns, end_ns);
+    }
     {
         /*
          * For PCM we always consume the buffer and return #bytes regardless of ret.
          * And format = IEC6137 can be see a special pcm format also need record frames
+         * Under the lock, do_out_standby() resets nframes.
          */
         out->written += bytes / (out->config.channels * sizeof(short));
         out->nframes = out->written;
     }
+    pthread_mutex_unlock(&out->lock);
     if (ret != 0) {
         ALOGV("AudioData write  error , keep slience! ret = %d", ret);
         // only pcm datas can caculate the sleep time like this
@@ -2112,7 +2301,7 @@ static int out_get_presentation_position(const struct audio_stream_out *stream,
     {
         for (i = 0; i < SND_OUT_SOUND_CARD_MAX; i++) {
             if (out->pcm[i]) {
-                size_t avail;
+                unsigned int avail;
                 //ALOGD("===============%s,%d==============",__FUNCTION__,__LINE__);
                 if (pcm_get_htimestamp(out->pcm[i], &avail, timestamp) == 0) {
                     size_t kernel_buffer_size = out->config.period_size * out->config.period_count;
@@ -2236,18 +2425,20 @@ static void do_in_standby(struct stream_in *in)
     if (!in->standby) {
         pcm_close(in->pcm);
         in->pcm = NULL;
+        audio_stats_standby(&in->stats);
 
         if (in->device & AUDIO_DEVICE_IN_BLUETOOTH_SCO_HEADSET) {
             stop_bt_sco(adev);
         } else if (in->device & AUDIO_DEVICE_IN_HDMI) {
-            route_pcm_close(HDMI_IN_CAPTURE_OFF_ROUTE);
+            route_worker_close(HDMI_IN_CAPTURE_OFF_ROUTE);
         }
 
         in->dev->input_source = AUDIO_SOURCE_DEFAULT;
         in->dev->in_device = AUDIO_DEVICE_NONE;
         in->dev->in_channel_mask = 0;
         in->standby = true;
-        route_pcm_close(CAPTURE_OFF_ROUTE);
+        in_live_update(in);
+        route_worker_standby(CAPTURE_OFF_ROUTE);
     }
 
 }
@@ -2292,6 +2483,13 @@ int in_dump(const struct audio_stream *stream, int fd)
     ALOGD("in->Formate    : %d", in->config->format);
     ALOGD("in->PreiodSize : %d", in->config->period_size);
 
+    if (fd < 0)
+        return 0;
+    dprintf(fd, "  input %p: device 0x%x, %u Hz (%u requested), %u ch, period %u x %u, %s\n",
+            in, in->device, in->config->rate, in->requested_rate, in->config->channels,
+            in->config->period_size, in->config->period_count,
+            in->standby ? "standby" : "active");
+    audio_stats_dump(&in->stats, fd);
     return 0;
 }
 
@@ -2313,6 +2511,7 @@ static int in_set_parameters(struct audio_stream *stream, const char *kvpairs)
     int status = 0;
     unsigned int val;
     bool apply_now = false;
+    int64_t route_ns;
 
     ALOGV("%s: kvpairs = %s", __func__, kvpairs);
 
@@ -2321,6 +2520,7 @@ static int in_set_parameters(struct audio_stream *stream, const char *kvpairs)
 
     parms = str_parms_create_str(kvpairs);
 
+    route_ns = audio_stats_now_ns();
     pthread_mutex_lock(&in->lock);
     pthread_mutex_lock(&adev->lock);
     ret = str_parms_get_str(parms, AUDIO_PARAMETER_STREAM_INPUT_SOURCE,
@@ -2354,7 +2554,9 @@ static int in_set_parameters(struct audio_stream *stream, const char *kvpairs)
     if (apply_now) {
         adev->input_source = in->input_source;
         adev->in_device = in->device;
-        route_pcm_open(getRouteFromDevice(in->device | AUDIO_DEVICE_BIT_IN));
+        route_worker_open(getRouteFromDevice(in->device | AUDIO_DEVICE_BIT_IN));
+        audio_hist_add(&in->stats.route, audio_stats_now_ns() - route_ns);
+        in_live_update(in);
     }
 
     pthread_mutex_unlock(&adev->lock);
@@ -2426,6 +2628,35 @@ static void in_apply_ramp(struct stream_in *in, int16_t *buffer, size_t frames)
     in->ramp_frames -= frames;
 }
 
+#ifdef AUDIO_3A
+/**
+ * @brief in_get_capture_ns
+ * monotonic time at which the first frame of the chunk just returned by
+ * read_frames() was captured, the 3A process uses it to align the echo
+ * reference. Frames still in the kernel buffer or waiting in the
+ * resampler input were captured after the chunk.
+ *
+ * @param in
+ * @param frames frames of the chunk, at the requested rate
+ *
+ * @returns time in ns, -1 if the pcm can not report it
+ */
+static int64_t in_get_capture_ns(struct stream_in *in, size_t frames)
+{
+    unsigned int avail;
+    struct timespec ts;
+    int64_t ns;
+
+    if ((in->pcm == NULL) || (pcm_get_htimestamp(in->pcm, &avail, &ts) != 0))
+        return -1;
+
+    ns = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+    ns -= (int64_t)(avail + in->frames_in) * 1000000000LL / in->config->rate;
+    ns -= (int64_t)frames * 1000000000LL / in->requested_rate;
+    return ns;
+}
+#endif
+
 /**
  * @brief in_read
  *
@@ -2442,6 +2673,7 @@ static ssize_t in_read(struct audio_stream_in *stream, void* buffer,
     struct stream_in *in = (struct stream_in *)stream;
     struct audio_device *adev = in->dev;
     size_t frames_rq = bytes / audio_stream_in_frame_size(stream);
+    int64_t lock_ns;
 
     /*
      * acquiring hw device mutex systematically is useful if a low
@@ -2449,20 +2681,30 @@ static ssize_t in_read(struct audio_stream_in *stream, void* buffer,
      * executing in_set_parameters() while holding the hw device
      * mutex
      */
+    lock_ns = audio_stats_now_ns();
     pthread_mutex_lock(&in->lock);
+    lock_ns = audio_stats_now_ns() - lock_ns;
     if (in->standby) {
+        int64_t start_ns = audio_stats_now_ns();
+
         pthread_mutex_lock(&adev->lock);
+        lock_ns += audio_stats_now_ns() - start_ns;
+        audio_trace_begin("start_input_stream");
         ret = start_input_stream(in);
+        audio_trace_end("start_input_stream");
         pthread_mutex_unlock(&adev->lock);
         if (ret < 0)
             goto exit;
         in->standby = false;
+        audio_hist_add(&in->stats.start, audio_stats_now_ns() - start_ns);
+        in_live_update(in);
 #ifdef AUDIO_3A
         if (adev->voice_api != NULL) {
             adev->voice_api->start();
         }
 #endif
     }
+    audio_hist_add(&in->stats.lock, lock_ns);
 
     /*if (in->num_preprocessors != 0)
         ret = process_frames(in, buffer, frames_rq);
@@ -2476,7 +2718,8 @@ static ssize_t in_read(struct audio_stream_in *stream, void* buffer,
     do {
         if (adev->voice_api != NULL) {
             int ret  = 0;
-            ret = adev->voice_api->quueCaputureBuffer(buffer, bytes);
+            ret = adev->voice_api->queueCaptureBufferTs(buffer, bytes,
+                                                        in_get_capture_ns(in, frames_rq));
             if (ret < 0) break;
             ret = adev->voice_api->getCapureBuffer(buffer, bytes);
             if (ret < 0) memset(buffer, 0x00, bytes);
@@ -2627,7 +2870,7 @@ static int adev_open_output_stream(struct audio_hw_device *dev,
 {
     struct audio_device *adev = (struct audio_device *)dev;
     struct stream_out *out;
-    int ret;
+    int ret, i;
     enum output_type type = OUTPUT_LOW_LATENCY;
 
     /*
@@ -2814,6 +3057,10 @@ static int adev_open_output_stream(struct audio_hw_device *dev,
     }
     adev->outputs[type] = out;
     pthread_mutex_unlock(&adev->lock_outputs);
+    out->live = audio_live_stream_get(AUDIO_LIVE_OUT);
+    out_live_update(out);
+    for (i = 0; i < SND_OUT_SOUND_CARD_MAX; i++)
+        out->glitch[i] = audio_glitch_open(out_card_names[i]);
 
     *stream_out = &out->stream;
 
@@ -2836,6 +3083,7 @@ static void adev_close_output_stream(struct audio_hw_device *dev,
 {
     struct audio_device *adev;
     enum output_type type;
+    int i;
 
     ALOGD("adev_close_output_stream!");
     out_standby(&stream->common);
@@ -2849,6 +3097,12 @@ static void adev_close_output_stream(struct audio_hw_device *dev,
     }
     {
         struct stream_out *out = (struct stream_out *)stream;
+        audio_live_stream_put(out->live);
+        out->live = NULL;
+        for (i = 0; i < SND_OUT_SOUND_CARD_MAX; i++) {
+            audio_glitch_close(out->glitch[i]);
+            out->glitch[i] = NULL;
+        }
         if(out->bitstream_buffer != NULL){
             free(out->bitstream_buffer);
             out->bitstream_buffer = NULL;
@@ -2891,12 +3145,14 @@ static int adev_set_parameters(struct audio_hw_device *dev, const char *kvpairs)
     if (0 <= val) {
         if (strcmp(value, "true") == 0) {
             ALOGD("Enable HFP client feature!");
-            route_pcm_open(SPEAKER_INCALL_ROUTE);
+            route_worker_open(SPEAKER_INCALL_ROUTE);
+            // the hfp pcms need the codec path in place before they start
+            route_worker_sync();
             start_bt_hfp(adev);
         } else if (strcmp(value, "false") == 0) {
             ALOGD("Disable HFP client feature!");
             stop_bt_hfp(adev);
-            route_pcm_open(INCALL_OFF_ROUTE);
+            route_worker_open(INCALL_OFF_ROUTE);
         } else {
             ALOGE("Unknown HFP client state %s!!!", value);
             ret = -EINVAL;
@@ -2908,10 +3164,11 @@ static int adev_set_parameters(struct audio_hw_device *dev, const char *kvpairs)
     if (0 <= val) {
         if (strcmp(value, "true") == 0) {
             adev->hdmiin_state = true;
-            route_pcm_open(HDMI_IN_NORMAL_ROUTE);
+            route_worker_open(HDMI_IN_NORMAL_ROUTE);
+            route_worker_sync();
             ALOGD("Enable HDMIin");
         } else if (strcmp(value, "false") == 0) {
-            route_pcm_open(HDMI_IN_OFF_ROUTE);
+            route_worker_open(HDMI_IN_OFF_ROUTE);
             adev->hdmiin_state = false;
             ALOGD("Disable HDMIin");
         } else {
@@ -3000,7 +3257,11 @@ static int adev_set_voice_volume(struct audio_hw_device *dev, float volume)
         }
 
         const char *mixer_ctl_name = "Speaker Playback Volume";
+        // the incall route may still be queued
+        route_worker_sync();
+        route_worker_lock();
         ret = route_set_voice_volume(mixer_ctl_name,volume);
+        route_worker_unlock();
     }
 
     return ret;
@@ -3239,6 +3500,11 @@ static int adev_open_input_stream(struct audio_hw_device *dev,
 
 #endif
 
+    pthread_mutex_lock(&adev->lock);
+    adev->input = in;
+    pthread_mutex_unlock(&adev->lock);
+    in->live = audio_live_stream_get(AUDIO_LIVE_IN);
+    in_live_update(in);
     *stream_in = &in->stream;
 
     ALOGD("create new input stream for dev(0x%08X), rate(%d), channel(0x%08X)",
@@ -3269,6 +3535,12 @@ static void adev_close_input_stream(struct audio_hw_device *dev,
     struct audio_device *adev = (struct audio_device *)dev;
 
     in_standby(&stream->common);
+    pthread_mutex_lock(&adev->lock);
+    if (adev->input == in)
+        adev->input = NULL;
+    pthread_mutex_unlock(&adev->lock);
+    audio_live_stream_put(in->live);
+    in->live = NULL;
     if (in->resampler) {
         release_resampler(in->resampler);
         in->resampler = NULL;
@@ -3305,9 +3577,146 @@ static void adev_close_input_stream(struct audio_hw_device *dev,
  */
 static int adev_dump(const audio_hw_device_t *device, int fd)
 {
+    struct audio_device *adev = (struct audio_device *)device;
+    struct route_worker_stats route_stats;
+    int i;
+
+    /* a stuck stream must not hang dumpsys, skip the streams rather than wait */
+    if (pthread_mutex_trylock(&adev->lock_outputs) == 0) {
+        for (i = 0; i < OUTPUT_TOTAL; i++)
+            if (adev->outputs[i])
+                out_dump(&adev->outputs[i]->stream.common, fd);
+        if (pthread_mutex_trylock(&adev->lock) == 0) {
+            if (adev->input)
+                in_dump(&adev->input->stream.common, fd);
+            pthread_mutex_unlock(&adev->lock);
+        } else {
+            dprintf(fd, "  input: device busy, skipped\n");
+        }
+        pthread_mutex_unlock(&adev->lock_outputs);
+    } else {
+        dprintf(fd, "  streams: outputs busy, skipped\n");
+    }
+
+    route_worker_get_stats(&route_stats);
+    dprintf(fd, "route worker: requests %u coalesced %u executed %u, ready last %lld max %lld "
+            "avg %lld us, last programmed in %lld us\n",
+            route_stats.requests, route_stats.coalesced, route_stats.executed,
+            route_stats.last_ready_us, route_stats.max_ready_us,
+            route_stats.executed ? route_stats.total_ready_us / route_stats.executed : 0LL,
+            route_stats.last_program_us);
+    dprintf(fd, "route standby: hold %u ms, held %u reopened %u closed %u\n",
+            route_stats.standby_ms, route_stats.standby_held,
+            route_stats.standby_avoided, route_stats.standby_expired);
+    if (adev->jack_monitor) {
+        struct jack_monitor_stats jack_stats;
+
+        jack_monitor_get_stats(&jack_stats);
+        dprintf(fd, "jack monitor: jacks 0x%x, ctl events %u input events %u changes %u, "
+                "dispatch last %lld max %lld us, routes prepared %u\n",
+                jack_stats.jacks, jack_stats.ctl_events, jack_stats.input_events,
+                jack_stats.jack_changes, jack_stats.last_dispatch_us,
+                jack_stats.max_dispatch_us, route_stats.prepared);
+        dprintf(fd, "jack commits: %u, jack to routing last %lld max %lld us\n",
+                adev->jack_commits, adev->jack_commit_last_us, adev->jack_commit_max_us);
+    }
+
+    audio_trace_dump(fd);
+
+#ifdef AUDIO_3A
+    if ((adev->voice_api != NULL) && (adev->voice_api->getJitterStats != NULL)) {
+        rk_jitter_stats stats[2];
+        const char *name[2] = { "playback", "capture" };
+        int i;
+
+        adev->voice_api->getJitterStats(&stats[0], &stats[1]);
+        for (i = 0; i < 2; i++)
+            dprintf(fd, "3A %s queue: depth %d target %d frames, reads %u underruns %u "
+                    "concealed %u stretched %u compressed %u overflows %u\n",
+                    name[i], stats[i].depth, stats[i].target, stats[i].reads,
+                    stats[i].underruns, stats[i].concealed, stats[i].stretched,
+                    stats[i].compressed, stats[i].overflows);
+    }
+    if ((adev->voice_api != NULL) && (adev->voice_api->getThreadStats != NULL)) {
+        audio_thread_stats ts;
+
+        if (adev->voice_api->getThreadStats(&ts) == 0)
+            dprintf(fd, "3A thread: %s priority %d cpus 0x%x, wakeups %u late %u "
+                    "latency avg %lld max %lld us\n",
+                    ts.policy == SCHED_FIFO ? "fifo" : "other", ts.priority, ts.cpuMask,
+                    ts.wakeups, ts.late,
+                    ts.wakeups ? (long long)(ts.latencyTotalNs / ts.wakeups / 1000) : 0LL,
+                    (long long)(ts.latencyMaxNs / 1000));
+    }
+#endif
     return 0;
 }
 
+/**
+ * @brief adev_jack_changed
+ * runs on the jack monitor thread: remember where the framework will route
+ * the output and prepare that route, the routing call then only commits it
+ *
+ * @param arg
+ * @param jacks
+ * @param event_ns
+ */
+static void adev_jack_changed(void *arg, unsigned jacks, int64_t event_ns)
+{
+    struct audio_device *adev = (struct audio_device *)arg;
+    audio_devices_t device = AUDIO_DEVICE_OUT_SPEAKER;
+
+    if (jacks & JACK_HEADPHONE)
+        device = (jacks & JACK_MICROPHONE) ? AUDIO_DEVICE_OUT_WIRED_HEADSET :
+                 AUDIO_DEVICE_OUT_WIRED_HEADPHONE;
+
+    pthread_mutex_lock(&adev->jack_lock);
+    adev->jack_device = device;
+    adev->jack_event_ns = event_ns;
+    pthread_mutex_unlock(&adev->jack_lock);
+
+    route_worker_prepare(getRouteFromDevice(device));
+}
+
+/**
+ * @brief adev_ctl_changed
+ * runs on the jack monitor thread for value changes of other controls
+ *
+ * @param arg
+ * @param card
+ * @param numid
+ */
+static void adev_ctl_changed(void *arg, unsigned card, unsigned numid)
+{
+    route_worker_lock();
+    route_ctl_changed(card, numid);
+    route_worker_unlock();
+}
+
+/**
+ * @brief adev_jack_monitor_start
+ * media.audio.jack.monitor enables it, media.audio.jack.card is the codec card
+ *
+ * @param adev
+ */
+static void adev_jack_monitor_start(struct audio_device *adev)
+{
+    struct jack_monitor_callbacks cb;
+    char value[PROPERTY_VALUE_MAX];
+
+    pthread_mutex_init(&adev->jack_lock, NULL);
+    adev->jack_device = AUDIO_DEVICE_NONE;
+    if (!property_get_bool("media.audio.jack.monitor", false))
+        return;
+
+    property_get("media.audio.jack.card", value, "0");
+    cb.jack_changed = adev_jack_changed;
+    cb.ctl_changed = adev_ctl_changed;
+    cb.arg = adev;
+    adev->jack_monitor = (jack_monitor_start(atoi(value), &cb) == 0);
+    ALOGD("jack monitor %s", adev->jack_monitor ? "started" : "failed to start");
+}
+
 /**
  * @brief adev_close
  *
@@ -3321,7 +3730,10 @@ static int adev_close(hw_device_t *device)
 
     //audio_route_free(adev->ar);
 
+    if (adev->jack_monitor)
+        jack_monitor_stop();
 
+    route_worker_stop();
     route_uninit();
 
     free(device);
@@ -3348,9 +3760,12 @@ static int adev_open(const hw_module_t* module, const char* name,
     if (strcmp(name, AUDIO_HARDWARE_INTERFACE) != 0)
         return -EINVAL;
 
+    audio_trace_begin("adev_open");
     adev = calloc(1, sizeof(struct audio_device));
-    if (!adev)
+    if (!adev) {
+        audio_trace_end("adev_open");
         return -ENOMEM;
+    }
 
     adev->hw_device.common.tag = HARDWARE_DEVICE_TAG;
     adev->hw_device.common.version = AUDIO_DEVICE_API_VERSION_2_0;
@@ -3373,7 +3788,14 @@ static int adev_open(const hw_module_t* module, const char* name,
     adev->hw_device.dump = adev_dump;
 
     //adev->ar = audio_route_init(MIXER_CARD, NULL);
+    audio_live_open();
     route_init();
+    audio_trace_begin("route_worker_start");
+    route_worker_start();
+    audio_trace_end("route_worker_start");
+    audio_trace_begin("jack_monitor_start");
+    adev_jack_monitor_start(adev);
+    audio_trace_end("jack_monitor_start");
 
     adev->input_source = AUDIO_SOURCE_DEFAULT;
     /* adev->cur_route_id initial value is 0 and such that first device
@@ -3405,6 +3827,8 @@ static int adev_open(const hw_module_t* module, const char* name,
     if (property_get("audio_hal.in_period_size", value, NULL) > 0)
         pcm_config_in.period_size = atoi(value);
 
+    audio_journal_attach(&adev->hw_device);
+    audio_trace_end("adev_open");
     return 0;
 }
 
@@ -107,6 +107,9 @@
 #include <hardware_legacy/uevent.h>
 
 #include "voice_preprocess.h"
+#include "audio_stats.h"
+#include "audio_live.h"
+#include "audio_glitch.h"
 
 #define AUDIO_HAL_VERSION "ALSA Audio Version: V1.1.0"
 
@@ -355,6 +358,17 @@ struct audio_device {
     int out_card[SND_OUT_SOUND_CARD_MAX];
     // store the sound card number of input devices
     int in_card[SND_IN_SOUND_CARD_MAX];
+
+    // output the wired jacks point to, prepared ahead of the framework routing
+    pthread_mutex_t jack_lock; /* leaf lock, taken by the jack monitor thread */
+    bool jack_monitor;
+    audio_devices_t jack_device;
+    int64_t jack_event_ns; /* when the jacks changed, 0 once a stream committed to it */
+    unsigned int jack_commits;
+    long long jack_commit_last_us;
+    long long jack_commit_max_us;
+
+    struct stream_in *input; /* the open input for adev_dump, the hal runs one at a time */
 };
 
 struct stream_out {
@@ -390,6 +404,9 @@ struct stream_out {
     char* channel_buffer;
     char* bitstream_buffer;
     bool   snd_reopen;
+    struct audio_stream_stats stats;
+    struct audio_live_stream *live;
+    struct audio_glitch *glitch[SND_OUT_SOUND_CARD_MAX];   // media.audio.glitch.hz only
 };
 
 struct stream_in {
@@ -421,6 +438,8 @@ struct stream_in {
     int mSpeexFrameSize;
     int16_t *mSpeexPcmIn;
 #endif
+    struct audio_stream_stats stats;
+    struct audio_live_stream *live;
 };
 
 #define STRING_TO_ENUM(string) { #string, string }
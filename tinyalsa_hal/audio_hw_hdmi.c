@@ -55,6 +55,9 @@
  * @date 2015-08-24
  */
 
+#include <pthread.h>
+#include <unistd.h>
+
 #include "audio_hw_hdmi.h"
 
 #define LOG_TAG "audio_hdmi_monitor"
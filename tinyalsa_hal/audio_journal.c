@@ -0,0 +1,722 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file    audio_journal.c
+ * @brief   journal of the hal entry points, see audio_journal.h
+ *
+ * The journal wraps the function pointers of the device and of every
+ * stream it opens, so the hal itself is untouched and pays nothing when
+ * the journal is off. A wrapper times the hal call and copies a record,
+ * and the audio in data mode, into a memory ring without taking a lock:
+ * it claims its bytes with a compare and swap and commits the length
+ * word of the entry last. A writer thread drains the committed entries
+ * in order to a buffered file every JOURNAL_DRAIN_MS, and flushes it
+ * after standby and close, so no call waits on the storage. A record
+ * that finds the ring full is dropped and counted, never waited for.
+ */
+
+#define LOG_TAG "audio_journal"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cutils/log.h>
+#include <cutils/properties.h>
+
+#include <hardware/audio.h>
+#include <hardware/hardware.h>
+
+#include "audio_journal.h"
+#include "audio_thread.h"
+
+#define JOURNAL_STREAMS (16)
+#define JOURNAL_BUFFER (256 * 1024)
+#define JOURNAL_RING (4 * 1024 * 1024)      // power of two, about 20 s of 48 kHz stereo audio
+#define JOURNAL_DRAIN_MS (20)
+
+/*
+ * an entry of the ring, 8 byte aligned so the length word never wraps,
+ * the payload follows the record
+ */
+struct journal_entry {
+    uint32_t len;               // bytes of the entry, 0 until it is committed
+    uint32_t reserved;
+    struct audio_journal_rec rec;
+};
+
+struct journal_stream {
+    const void *stream;         // the hal stream, NULL when the entry is free
+    uint16_t id;
+    union {
+        struct audio_stream_out out;
+        struct audio_stream_in in;
+    } hal;                      // its own entry points
+};
+
+static struct {
+    pthread_mutex_t lock;       // the stream table, attach and close
+    FILE *file;                 // written by the writer thread only
+    uint8_t *ring;              // NULL when not journaling
+    uint64_t claimed;           // ring bytes claimed by the calls
+    uint64_t drained;           // ring bytes written out and free again
+    uint32_t dropped;           // records that found the ring full
+    int flush;                  // a standby or close asks for the file to be flushed
+    int stop;
+    audio_thread writer;
+    bool data;
+    int64_t start_ns;
+    uint16_t next_id;
+    struct audio_hw_device hal;
+    struct journal_stream streams[JOURNAL_STREAMS];
+} journal = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static const char *journal_op_names[AJ_OPS] = {
+    [AJ_SET_PARAMETERS] = "set_parameters",
+    [AJ_GET_PARAMETERS] = "get_parameters",
+    [AJ_SET_MODE] = "set_mode",
+    [AJ_SET_MIC_MUTE] = "set_mic_mute",
+    [AJ_SET_VOICE_VOLUME] = "set_voice_volume",
+    [AJ_SET_MASTER_VOLUME] = "set_master_volume",
+    [AJ_OPEN_OUTPUT] = "open_output_stream",
+    [AJ_CLOSE_OUTPUT] = "close_output_stream",
+    [AJ_OPEN_INPUT] = "open_input_stream",
+    [AJ_CLOSE_INPUT] = "close_input_stream",
+    [AJ_OUT_WRITE] = "out_write",
+    [AJ_OUT_STANDBY] = "out_standby",
+    [AJ_OUT_SET_PARAMETERS] = "out_set_parameters",
+    [AJ_OUT_GET_PARAMETERS] = "out_get_parameters",
+    [AJ_OUT_SET_VOLUME] = "out_set_volume",
+    [AJ_OUT_GET_RENDER_POSITION] = "out_get_render_position",
+    [AJ_OUT_GET_PRESENTATION_POSITION] = "out_get_presentation_position",
+    [AJ_IN_READ] = "in_read",
+    [AJ_IN_STANDBY] = "in_standby",
+    [AJ_IN_SET_PARAMETERS] = "in_set_parameters",
+    [AJ_IN_GET_PARAMETERS] = "in_get_parameters",
+    [AJ_IN_SET_GAIN] = "in_set_gain",
+};
+
+const char *audio_journal_op_name(unsigned op)
+{
+    return (op < AJ_OPS) && journal_op_names[op] ? journal_op_names[op] : "unknown";
+}
+
+static int64_t journal_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static uint32_t journal_float(float value)
+{
+    uint32_t bits;
+
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+/* copy in and out of the ring at a position that may wrap */
+static void journal_ring_put(uint8_t *ring, uint64_t pos, const void *src, size_t bytes)
+{
+    size_t offset = pos & (JOURNAL_RING - 1);
+    size_t first = bytes < JOURNAL_RING - offset ? bytes : JOURNAL_RING - offset;
+
+    memcpy(ring + offset, src, first);
+    memcpy(ring, (const uint8_t *)src + first, bytes - first);
+}
+
+static void journal_ring_get(const uint8_t *ring, uint64_t pos, void *dst, size_t bytes)
+{
+    size_t offset = pos & (JOURNAL_RING - 1);
+    size_t first = bytes < JOURNAL_RING - offset ? bytes : JOURNAL_RING - offset;
+
+    memcpy(dst, ring + offset, first);
+    memcpy((uint8_t *)dst + first, ring, bytes - first);
+}
+
+static void journal_ring_out(const uint8_t *ring, uint64_t pos, size_t bytes, FILE *file)
+{
+    size_t offset = pos & (JOURNAL_RING - 1);
+    size_t first = bytes < JOURNAL_RING - offset ? bytes : JOURNAL_RING - offset;
+
+    fwrite(ring + offset, first, 1, file);
+    if (bytes > first)
+        fwrite(ring, bytes - first, 1, file);
+}
+
+/* free an entry, no stale byte may later pass for a length word */
+static void journal_ring_clear(uint8_t *ring, uint64_t pos, size_t bytes)
+{
+    size_t offset = pos & (JOURNAL_RING - 1);
+    size_t first = bytes < JOURNAL_RING - offset ? bytes : JOURNAL_RING - offset;
+
+    memset(ring + offset, 0, first);
+    memset(ring, 0, bytes - first);
+}
+
+/**
+ * @brief journal_write
+ *        append a record of a call entered at start_ns, and its payload,
+ *        to the ring, or drop it if the writer is too far behind
+ */
+static void journal_write(unsigned op, uint16_t stream, int64_t start_ns, int ret,
+                          const uint32_t *arg, const void *payload, size_t size)
+{
+    uint8_t *ring = __atomic_load_n(&journal.ring, __ATOMIC_ACQUIRE);
+    struct journal_entry entry;
+    int64_t end_ns = journal_now_ns();
+    uint64_t pos, len;
+
+    if (!ring)
+        return;
+    memset(&entry, 0, sizeof(entry));
+    entry.rec.op = op;
+    entry.rec.stream = stream;
+    entry.rec.size = payload ? size : 0;
+    entry.rec.ns = start_ns - journal.start_ns;
+    entry.rec.dur_us = (uint32_t)((end_ns - start_ns) / 1000);
+    entry.rec.ret = ret;
+    if (arg)
+        memcpy(entry.rec.arg, arg, sizeof(entry.rec.arg));
+
+    len = (sizeof(entry) + entry.rec.size + 7) & ~7ULL;
+    pos = __atomic_load_n(&journal.claimed, __ATOMIC_RELAXED);
+    do {
+        if ((len > JOURNAL_RING / 2) ||
+            (pos + len - __atomic_load_n(&journal.drained, __ATOMIC_ACQUIRE) > JOURNAL_RING)) {
+            __atomic_add_fetch(&journal.dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    } while (!__atomic_compare_exchange_n(&journal.claimed, &pos, pos + len, true,
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+    // the length word stays 0 until everything behind it is in place
+    journal_ring_put(ring, pos + offsetof(struct journal_entry, reserved), &entry.reserved,
+                     sizeof(entry) - offsetof(struct journal_entry, reserved));
+    if (entry.rec.size)
+        journal_ring_put(ring, pos + sizeof(entry), payload, entry.rec.size);
+    __atomic_store_n((uint32_t *)(ring + (pos & (JOURNAL_RING - 1))), (uint32_t)len,
+                     __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief journal_drain
+ *        write out the committed entries in claim order, up to the first
+ *        one still being filled in
+ */
+static void journal_drain(void)
+{
+    uint8_t *ring = journal.ring;
+    uint64_t pos = journal.drained;
+    struct journal_entry entry;
+
+    for (;;) {
+        entry.len = __atomic_load_n((uint32_t *)(ring + (pos & (JOURNAL_RING - 1))),
+                                    __ATOMIC_ACQUIRE);
+        if (!entry.len)
+            break;
+        journal_ring_get(ring, pos + offsetof(struct journal_entry, rec), &entry.rec,
+                         sizeof(entry.rec));
+        fwrite(&entry.rec, sizeof(entry.rec), 1, journal.file);
+        if (entry.rec.size)
+            journal_ring_out(ring, pos + sizeof(entry), entry.rec.size, journal.file);
+        journal_ring_clear(ring, pos, entry.len);
+        pos += entry.len;
+        __atomic_store_n(&journal.drained, pos, __ATOMIC_RELEASE);
+    }
+}
+
+static void *journal_writer_loop(void *arg)
+{
+    int stop;
+
+    (void)arg;
+    do {
+        stop = __atomic_load_n(&journal.stop, __ATOMIC_ACQUIRE);
+        journal_drain();
+        if (__atomic_exchange_n(&journal.flush, 0, __ATOMIC_ACQ_REL) || stop)
+            fflush(journal.file);
+        if (!stop)
+            usleep(JOURNAL_DRAIN_MS * 1000);
+    } while (!stop);
+    return NULL;
+}
+
+static void journal_flush(void)
+{
+    __atomic_store_n(&journal.flush, 1, __ATOMIC_RELEASE);
+}
+
+static size_t journal_strlen(const char *s)
+{
+    return s ? strlen(s) : 0;
+}
+
+/**
+ * @brief journal_find
+ *        the entry of a stream, without the lock: an entry is filled in
+ *        before its stream is published and a stream is not called once
+ *        it is closed
+ */
+static struct journal_stream *journal_find(const void *stream)
+{
+    int i;
+
+    for (i = 0; i < JOURNAL_STREAMS; i++)
+        if (__atomic_load_n(&journal.streams[i].stream, __ATOMIC_ACQUIRE) == stream)
+            return &journal.streams[i];
+    return NULL;
+}
+
+static struct journal_stream *journal_add(const void *stream, const void *hal, size_t size)
+{
+    struct journal_stream *entry = NULL;
+    int i;
+
+    pthread_mutex_lock(&journal.lock);
+    for (i = 0; i < JOURNAL_STREAMS; i++) {
+        if (journal.streams[i].stream == NULL) {
+            entry = &journal.streams[i];
+            entry->id = ++journal.next_id;
+            memcpy(&entry->hal, hal, size);
+            __atomic_store_n(&entry->stream, stream, __ATOMIC_RELEASE);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&journal.lock);
+    if (!entry)
+        ALOGW("journal: too many streams, %p is not journaled", stream);
+    return entry;
+}
+
+static void journal_remove(struct journal_stream *entry)
+{
+    pthread_mutex_lock(&journal.lock);
+    __atomic_store_n(&entry->stream, NULL, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&journal.lock);
+}
+
+/* output stream entry points */
+
+static ssize_t journal_out_write(struct audio_stream_out *stream, const void *buffer, size_t bytes)
+{
+    struct journal_stream *entry = journal_find(stream);
+    uint32_t arg[6] = { bytes };
+    int64_t start_ns = journal_now_ns();
+    ssize_t ret = entry->hal.out.write(stream, buffer, bytes);
+
+    journal_write(AJ_OUT_WRITE, entry->id, start_ns, (int)ret, arg,
+                  journal.data ? buffer : NULL, bytes);
+    return ret;
+}
+
+static int journal_out_standby(struct audio_stream *stream)
+{
+    struct journal_stream *entry = journal_find(stream);
+    int64_t start_ns = journal_now_ns();
+    int ret = entry->hal.out.common.standby(stream);
+
+    journal_write(AJ_OUT_STANDBY, entry->id, start_ns, ret, NULL, NULL, 0);
+    journal_flush();
+    return ret;
+}
+
+static int journal_out_set_parameters(struct audio_stream *stream, const char *kv_pairs)
+{
+    struct journal_stream *entry = journal_find(stream);
+    int64_t start_ns = journal_now_ns();
+    int ret = entry->hal.out.common.set_parameters(stream, kv_pairs);
+
+    journal_write(AJ_OUT_SET_PARAMETERS, entry->id, start_ns, ret, NULL, kv_pairs,
+                  journal_strlen(kv_pairs));
+    return ret;
+}
+
+static char *journal_out_get_parameters(const struct audio_stream *stream, const char *keys)
+{
+    struct journal_stream *entry = journal_find(stream);
+    int64_t start_ns = journal_now_ns();
+    char *ret = entry->hal.out.common.get_parameters(stream, keys);
+
+    journal_write(AJ_OUT_GET_PARAMETERS, entry->id, start_ns, 0, NULL, keys, journal_strlen(keys));
+    return ret;
+}
+
+static int journal_out_set_volume(struct audio_stream_out *stream, float left, float right)
+{
+    struct journal_stream *entry = journal_find(stream);
+    uint32_t arg[6] = { journal_float(left), journal_float(right) };
+    int64_t start_ns = journal_now_ns();
+    int ret = entry->hal.out.set_volume(stream, left, right);
+
+    journal_write(AJ_OUT_SET_VOLUME, entry->id, start_ns, ret, arg, NULL, 0);
+    return ret;
+}
+
+static int journal_out_get_render_position(const struct audio_stream_out *stream,
+                                           uint32_t *dsp_frames)
+{
+    struct journal_stream *entry = journal_find(stream);
+    int64_t start_ns = journal_now_ns();
+    int ret = entry->hal.out.get_render_position(stream, dsp_frames);
+
+    journal_write(AJ_OUT_GET_RENDER_POSITION, entry->id, start_ns, ret, NULL, NULL, 0);
+    return ret;
+}
+
+static int journal_out_get_presentation_position(const struct audio_stream_out *stream,
+                                                 uint64_t *frames, struct timespec *timestamp)
+{
+    struct journal_stream *entry = journal_find(stream);
+    int64_t start_ns = journal_now_ns();
+    int ret = entry->hal.out.get_presentation_position(stream, frames, timestamp);
+
+    journal_write(AJ_OUT_GET_PRESENTATION_POSITION, entry->id, start_ns, ret, NULL, NULL, 0);
+    return ret;
+}
+
+/* input stream entry points */
+
+static ssize_t journal_in_read(struct audio_stream_in *stream, void *buffer, size_t bytes)
+{
+    struct journal_stream *entry = journal_find(stream);
+    uint32_t arg[6] = { bytes };
+    int64_t start_ns = journal_now_ns();
+    ssize_t ret = entry->hal.in.read(stream, buffer, bytes);
+
+    journal_write(AJ_IN_READ, entry->id, start_ns, (int)ret, arg, NULL, 0);
+    return ret;
+}
+
+static int journal_in_standby(struct audio_stream *stream)
+{
+    struct journal_stream *entry = journal_find(stream);
+    int64_t start_ns = journal_now_ns();
+    int ret = entry->hal.in.common.standby(stream);
+
+    journal_write(AJ_IN_STANDBY, entry->id, start_ns, ret, NULL, NULL, 0);
+    journal_flush();
+    return ret;
+}
+
+static int journal_in_set_parameters(struct audio_stream *stream, const char *kv_pairs)
+{
+    struct journal_stream *entry = journal_find(stream);
+    int64_t start_ns = journal_now_ns();
+    int ret = entry->hal.in.common.set_parameters(stream, kv_pairs);
+
+    journal_write(AJ_IN_SET_PARAMETERS, entry->id, start_ns, ret, NULL, kv_pairs,
+                  journal_strlen(kv_pairs));
+    return ret;
+}
+
+static char *journal_in_get_parameters(const struct audio_stream *stream, const char *keys)
+{
+    struct journal_stream *entry = journal_find(stream);
+    int64_t start_ns = journal_now_ns();
+    char *ret = entry->hal.in.common.get_parameters(stream, keys);
+
+    journal_write(AJ_IN_GET_PARAMETERS, entry->id, start_ns, 0, NULL, keys, journal_strlen(keys));
+    return ret;
+}
+
+static int journal_in_set_gain(struct audio_stream_in *stream, float gain)
+{
+    struct journal_stream *entry = journal_find(stream);
+    uint32_t arg[6] = { journal_float(gain) };
+    int64_t start_ns = journal_now_ns();
+    int ret = entry->hal.in.set_gain(stream, gain);
+
+    journal_write(AJ_IN_SET_GAIN, entry->id, start_ns, ret, arg, NULL, 0);
+    return ret;
+}
+
+/* device entry points */
+
+static int journal_set_parameters(struct audio_hw_device *dev, const char *kv_pairs)
+{
+    int64_t start_ns = journal_now_ns();
+    int ret = journal.hal.set_parameters(dev, kv_pairs);
+
+    journal_write(AJ_SET_PARAMETERS, 0, start_ns, ret, NULL, kv_pairs, journal_strlen(kv_pairs));
+    return ret;
+}
+
+static char *journal_get_parameters(const struct audio_hw_device *dev, const char *keys)
+{
+    int64_t start_ns = journal_now_ns();
+    char *ret = journal.hal.get_parameters(dev, keys);
+
+    journal_write(AJ_GET_PARAMETERS, 0, start_ns, 0, NULL, keys, journal_strlen(keys));
+    return ret;
+}
+
+static int journal_set_mode(struct audio_hw_device *dev, audio_mode_t mode)
+{
+    uint32_t arg[6] = { (uint32_t)mode };
+    int64_t start_ns = journal_now_ns();
+    int ret = journal.hal.set_mode(dev, mode);
+
+    journal_write(AJ_SET_MODE, 0, start_ns, ret, arg, NULL, 0);
+    return ret;
+}
+
+static int journal_set_mic_mute(struct audio_hw_device *dev, bool state)
+{
+    uint32_t arg[6] = { state };
+    int64_t start_ns = journal_now_ns();
+    int ret = journal.hal.set_mic_mute(dev, state);
+
+    journal_write(AJ_SET_MIC_MUTE, 0, start_ns, ret, arg, NULL, 0);
+    return ret;
+}
+
+static int journal_set_voice_volume(struct audio_hw_device *dev, float volume)
+{
+    uint32_t arg[6] = { journal_float(volume) };
+    int64_t start_ns = journal_now_ns();
+    int ret = journal.hal.set_voice_volume(dev, volume);
+
+    journal_write(AJ_SET_VOICE_VOLUME, 0, start_ns, ret, arg, NULL, 0);
+    return ret;
+}
+
+static int journal_set_master_volume(struct audio_hw_device *dev, float volume)
+{
+    uint32_t arg[6] = { journal_float(volume) };
+    int64_t start_ns = journal_now_ns();
+    int ret = journal.hal.set_master_volume(dev, volume);
+
+    journal_write(AJ_SET_MASTER_VOLUME, 0, start_ns, ret, arg, NULL, 0);
+    return ret;
+}
+
+static int journal_open_output_stream(struct audio_hw_device *dev, audio_io_handle_t handle,
+                                      audio_devices_t devices, audio_output_flags_t flags,
+                                      struct audio_config *config,
+                                      struct audio_stream_out **stream_out, const char *address)
+{
+    uint32_t arg[6] = { (uint32_t)handle, devices, flags, config->sample_rate,
+                        config->channel_mask, config->format };
+    struct journal_stream *entry = NULL;
+    int64_t start_ns = journal_now_ns();
+    int ret = journal.hal.open_output_stream(dev, handle, devices, flags, config, stream_out,
+                                             address);
+
+    if (ret == 0)
+        entry = journal_add(*stream_out, *stream_out, sizeof(struct audio_stream_out));
+    journal_write(AJ_OPEN_OUTPUT, entry ? entry->id : 0, start_ns, ret, arg, NULL, 0);
+    if (entry) {
+        struct audio_stream_out *out = *stream_out;
+
+        out->write = journal_out_write;
+        out->common.standby = journal_out_standby;
+        out->common.set_parameters = journal_out_set_parameters;
+        out->common.get_parameters = journal_out_get_parameters;
+        out->set_volume = journal_out_set_volume;
+        out->get_render_position = journal_out_get_render_position;
+        out->get_presentation_position = journal_out_get_presentation_position;
+    }
+    return ret;
+}
+
+static void journal_close_output_stream(struct audio_hw_device *dev,
+                                        struct audio_stream_out *stream_out)
+{
+    struct journal_stream *entry = journal_find(stream_out);
+    int64_t start_ns = journal_now_ns();
+
+    /* the hal calls its own entry points while it closes, give them back */
+    if (entry)
+        memcpy(stream_out, &entry->hal.out, sizeof(*stream_out));
+    journal.hal.close_output_stream(dev, stream_out);
+    if (entry) {
+        journal_write(AJ_CLOSE_OUTPUT, entry->id, start_ns, 0, NULL, NULL, 0);
+        journal_remove(entry);
+    }
+    journal_flush();
+}
+
+static int journal_open_input_stream(struct audio_hw_device *dev, audio_io_handle_t handle,
+                                     audio_devices_t devices, struct audio_config *config,
+                                     struct audio_stream_in **stream_in,
+                                     audio_input_flags_t flags, const char *address,
+                                     audio_source_t source)
+{
+    uint32_t arg[6] = { (uint32_t)handle, devices, flags, config->sample_rate,
+                        config->channel_mask, (uint32_t)source };
+    struct journal_stream *entry = NULL;
+    int64_t start_ns = journal_now_ns();
+    int ret = journal.hal.open_input_stream(dev, handle, devices, config, stream_in, flags,
+                                            address, source);
+
+    if (ret == 0)
+        entry = journal_add(*stream_in, *stream_in, sizeof(struct audio_stream_in));
+    journal_write(AJ_OPEN_INPUT, entry ? entry->id : 0, start_ns, ret, arg, NULL, 0);
+    if (entry) {
+        struct audio_stream_in *in = *stream_in;
+
+        in->read = journal_in_read;
+        in->common.standby = journal_in_standby;
+        in->common.set_parameters = journal_in_set_parameters;
+        in->common.get_parameters = journal_in_get_parameters;
+        in->set_gain = journal_in_set_gain;
+    }
+    return ret;
+}
+
+static void journal_close_input_stream(struct audio_hw_device *dev,
+                                       struct audio_stream_in *stream_in)
+{
+    struct journal_stream *entry = journal_find(stream_in);
+    int64_t start_ns = journal_now_ns();
+
+    if (entry)
+        memcpy(stream_in, &entry->hal.in, sizeof(*stream_in));
+    journal.hal.close_input_stream(dev, stream_in);
+    if (entry) {
+        journal_write(AJ_CLOSE_INPUT, entry->id, start_ns, 0, NULL, NULL, 0);
+        journal_remove(entry);
+    }
+    journal_flush();
+}
+
+static int journal_close(struct hw_device_t *device)
+{
+    int ret = journal.hal.common.close(device);
+    uint8_t *ring;
+
+    pthread_mutex_lock(&journal.lock);
+    ring = journal.ring;
+    if (ring) {
+        // no call is left running once the device is closed
+        __atomic_store_n(&journal.stop, 1, __ATOMIC_RELEASE);
+        audio_thread_join(&journal.writer);
+        __atomic_store_n(&journal.ring, NULL, __ATOMIC_RELEASE);
+        fclose(journal.file);
+        journal.file = NULL;
+        free(ring);
+        if (journal.dropped)
+            ALOGW("journal: %u records dropped, the writer fell behind", journal.dropped);
+    }
+    pthread_mutex_unlock(&journal.lock);
+    return ret;
+}
+
+void audio_journal_attach(struct audio_hw_device *dev)
+{
+    struct audio_journal_header header;
+    char path[PROPERTY_VALUE_MAX];
+    audio_thread_attr attr;
+    uint8_t *ring;
+    FILE *file;
+
+    if (!property_get_bool("media.audio.journal", false))
+        return;
+    if (journal.ring) {
+        ALOGW("journal: already journaling another device");
+        return;
+    }
+
+    property_get("media.audio.journal.path", path, AUDIO_JOURNAL_DEFAULT_PATH);
+    file = fopen(path, "wbe");
+    if (!file) {
+        ALOGE("journal: open %s failed: %s", path, strerror(errno));
+        return;
+    }
+    ring = calloc(1, JOURNAL_RING);
+    if (!ring) {
+        ALOGE("journal: no memory for the ring");
+        fclose(file);
+        return;
+    }
+    setvbuf(file, NULL, _IOFBF, JOURNAL_BUFFER);
+
+    journal.data = property_get_bool("media.audio.journal.data", false);
+    journal.start_ns = journal_now_ns();
+    journal.next_id = 0;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, AUDIO_JOURNAL_MAGIC, sizeof(header.magic));
+    header.version = AUDIO_JOURNAL_VERSION;
+    header.flags = journal.data ? AUDIO_JOURNAL_DATA : 0;
+    header.record_size = sizeof(struct audio_journal_rec);
+    header.start_ns = journal.start_ns;
+    fwrite(&header, sizeof(header), 1, file);
+
+    pthread_mutex_lock(&journal.lock);
+    journal.file = file;
+    journal.claimed = 0;
+    journal.drained = 0;
+    journal.dropped = 0;
+    journal.flush = 0;
+    journal.stop = 0;
+    journal.ring = ring;
+    audio_thread_attr_init(&attr, "audio_journal");
+    if (audio_thread_create(&journal.writer, &attr, journal_writer_loop, NULL)) {
+        ALOGE("journal: writer thread failed");
+        journal.ring = NULL;
+        journal.file = NULL;
+        pthread_mutex_unlock(&journal.lock);
+        fclose(file);
+        free(ring);
+        return;
+    }
+    pthread_mutex_unlock(&journal.lock);
+
+    memcpy(&journal.hal, dev, sizeof(journal.hal));
+    dev->common.close = journal_close;
+    dev->set_parameters = journal_set_parameters;
+    dev->get_parameters = journal_get_parameters;
+    dev->set_mode = journal_set_mode;
+    dev->set_mic_mute = journal_set_mic_mute;
+    dev->set_voice_volume = journal_set_voice_volume;
+    dev->set_master_volume = journal_set_master_volume;
+    dev->open_output_stream = journal_open_output_stream;
+    dev->close_output_stream = journal_close_output_stream;
+    dev->open_input_stream = journal_open_input_stream;
+    dev->close_input_stream = journal_close_input_stream;
+    ALOGD("journal: recording the hal calls to %s%s", path,
+          journal.data ? " with the audio" : "");
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file    audio_journal.h
+ * @brief   journal of the hal entry points, for hal_replay
+ *
+ * With media.audio.journal set when the hal opens, every device and
+ * stream entry point that changes state or moves data is appended to
+ * media.audio.journal.path: when it was entered, how long it took, what
+ * it returned and its arguments. Parameter strings follow their record,
+ * the audio of writes only when media.audio.journal.data is set.
+ * The calls only copy their record to memory, a writer thread does the
+ * file writes. If the storage falls too far behind, records are dropped
+ * rather than stalling the audio, and the hal logs how many at close.
+ *
+ * The file is a struct audio_journal_header then records, each followed
+ * by size bytes of payload, in host byte order.
+ */
+
+#ifndef AUDIO_JOURNAL_H_
+#define AUDIO_JOURNAL_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUDIO_JOURNAL_MAGIC         "AJNL"
+#define AUDIO_JOURNAL_VERSION       (1)
+#define AUDIO_JOURNAL_DEFAULT_PATH  "/data/vendor/audio/journal.bin"
+
+/* header flags */
+#define AUDIO_JOURNAL_DATA          (1 << 0)    // writes carry their audio
+
+enum audio_journal_op {
+    AJ_SET_PARAMETERS = 1,      // payload: kv pairs
+    AJ_GET_PARAMETERS,          // payload: keys
+    AJ_SET_MODE,                // arg: mode
+    AJ_SET_MIC_MUTE,            // arg: state
+    AJ_SET_VOICE_VOLUME,        // arg: volume as float bits
+    AJ_SET_MASTER_VOLUME,       // arg: volume as float bits
+    AJ_OPEN_OUTPUT,             // stream: the new one, arg: handle, devices, flags, rate, channel mask, format
+    AJ_CLOSE_OUTPUT,
+    AJ_OPEN_INPUT,              // stream: the new one, arg: handle, devices, flags, rate, channel mask, source
+    AJ_CLOSE_INPUT,
+    AJ_OUT_WRITE,               // arg: bytes, payload: the audio if recorded
+    AJ_OUT_STANDBY,
+    AJ_OUT_SET_PARAMETERS,      // payload: kv pairs
+    AJ_OUT_GET_PARAMETERS,      // payload: keys
+    AJ_OUT_SET_VOLUME,          // arg: left, right as float bits
+    AJ_OUT_GET_RENDER_POSITION,
+    AJ_OUT_GET_PRESENTATION_POSITION,
+    AJ_IN_READ,                 // arg: bytes
+    AJ_IN_STANDBY,
+    AJ_IN_SET_PARAMETERS,       // payload: kv pairs
+    AJ_IN_GET_PARAMETERS,       // payload: keys
+    AJ_IN_SET_GAIN,             // arg: gain as float bits
+    AJ_OPS
+};
+
+struct audio_journal_header {
+    char     magic[4];
+    uint32_t version;
+    uint32_t flags;
+    uint32_t record_size;       // sizeof(struct audio_journal_rec)
+    int64_t  start_ns;          // CLOCK_MONOTONIC the record times count from
+};
+
+struct audio_journal_rec {
+    uint16_t op;                // enum audio_journal_op
+    uint16_t stream;            // 1.. in open order, 0 for the device
+    uint32_t size;              // payload bytes after the record
+    int64_t  ns;                // entered, since start_ns
+    uint32_t dur_us;            // spent in the call
+    int32_t  ret;
+    uint32_t arg[6];
+};
+
+struct audio_hw_device;
+
+/**
+ * @brief audio_journal_attach
+ *        journal the calls to dev and to the streams it opens from now on,
+ *        if media.audio.journal is set. Call once the device is set up, it
+ *        wraps its entry points.
+ */
+void audio_journal_attach(struct audio_hw_device *dev);
+
+const char *audio_journal_op_name(unsigned op);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
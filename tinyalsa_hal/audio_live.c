@@ -0,0 +1,269 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file    audio_live.c
+ * @brief   shared page of live stream counters, see audio_live.h
+ */
+
+#define LOG_TAG "audio_live"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cutils/log.h>
+#include <cutils/properties.h>
+
+#include "audio_live.h"
+
+/* attempts of a reader before giving up on a record, a write takes well under a microsecond */
+#define LIVE_READ_TRIES (1000)
+
+static struct audio_live_page *live_page;
+static pthread_once_t live_once = PTHREAD_ONCE_INIT;
+static uint32_t live_ids;
+
+static void live_map_page(void)
+{
+    char path[PROPERTY_VALUE_MAX];
+    struct audio_live_page *page;
+    int fd;
+
+    if (!property_get_bool("media.audio.live", false))
+        return;
+
+    property_get("media.audio.live.path", path, AUDIO_LIVE_DEFAULT_PATH);
+    fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        ALOGE("live stats: open %s failed: %s", path, strerror(errno));
+        return;
+    }
+    if (ftruncate(fd, sizeof(*page)) < 0) {
+        ALOGE("live stats: truncate %s failed: %s", path, strerror(errno));
+        close(fd);
+        return;
+    }
+    page = mmap(NULL, sizeof(*page), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (page == MAP_FAILED) {
+        ALOGE("live stats: mmap %s failed: %s", path, strerror(errno));
+        return;
+    }
+
+    /* a viewer still mapping the page of a previous hal sees it invalid first */
+    __atomic_store_n(&page->magic, 0, __ATOMIC_RELAXED);
+    memset((char *)page + sizeof(page->magic), 0, sizeof(*page) - sizeof(page->magic));
+    page->version = AUDIO_LIVE_VERSION;
+    page->size = sizeof(*page);
+    page->pid = getpid();
+    __atomic_store_n(&page->magic, AUDIO_LIVE_MAGIC, __ATOMIC_RELEASE);
+
+    live_page = page;
+    ALOGD("live stats published at %s", path);
+}
+
+struct audio_live_page *audio_live_open(void)
+{
+    pthread_once(&live_once, live_map_page);
+    return live_page;
+}
+
+static inline void live_write_begin(uint32_t *seq)
+{
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void live_write_end(uint32_t *seq)
+{
+    __atomic_store_n(seq, *seq + 1, __ATOMIC_RELEASE);
+}
+
+struct audio_live_stream *audio_live_stream_get(enum audio_live_kind kind)
+{
+    struct audio_live_page *page = audio_live_open();
+    int i;
+
+    if (page == NULL)
+        return NULL;
+
+    for (i = 0; i < AUDIO_LIVE_STREAMS; i++) {
+        struct audio_live_stream *live = &page->stream[i];
+        uint32_t expected = AUDIO_LIVE_FREE;
+
+        if (!__atomic_compare_exchange_n(&live->kind, &expected, kind, false,
+                                         __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            continue;
+
+        live_write_begin(&live->seq);
+        memset((char *)live + sizeof(live->seq) + sizeof(live->kind), 0,
+               sizeof(*live) - sizeof(live->seq) - sizeof(live->kind));
+        live->id = __atomic_add_fetch(&live_ids, 1, __ATOMIC_RELAXED);
+        live->standby = 1;
+        live->fill_frames = -1;
+        live_write_end(&live->seq);
+        return live;
+    }
+    ALOGW("live stats: no free record for a new stream");
+    return NULL;
+}
+
+void audio_live_stream_put(struct audio_live_stream *live)
+{
+    if (live == NULL)
+        return;
+
+    live_write_begin(&live->seq);
+    live->standby = 1;
+    live_write_end(&live->seq);
+    __atomic_store_n(&live->kind, AUDIO_LIVE_FREE, __ATOMIC_RELEASE);
+}
+
+void audio_live_stream_config(struct audio_live_stream *live, uint32_t rate, uint32_t channels,
+                              uint32_t period_size, uint32_t buffer_frames)
+{
+    if (live == NULL)
+        return;
+
+    live_write_begin(&live->seq);
+    live->rate = rate;
+    live->channels = channels;
+    live->period_size = period_size;
+    live->buffer_frames = buffer_frames;
+    live_write_end(&live->seq);
+}
+
+void audio_live_stream_route(struct audio_live_stream *live, uint32_t device, uint32_t route,
+                             bool standby)
+{
+    if (live == NULL)
+        return;
+
+    live_write_begin(&live->seq);
+    live->device = device;
+    live->route = route;
+    live->standby = standby;
+    if (standby)
+        live->fill_frames = -1;
+    live_write_end(&live->seq);
+}
+
+void audio_live_stream_xfer(struct audio_live_stream *live, uint32_t bytes, int fill,
+                            int ret, uint32_t xruns, int64_t now_ns)
+{
+    if (live == NULL)
+        return;
+
+    live_write_begin(&live->seq);
+    live->transfers++;
+    live->total_bytes += bytes;
+    live->last_bytes = bytes;
+    if ((live->min_bytes == 0) || (bytes < live->min_bytes))
+        live->min_bytes = bytes;
+    if (bytes > live->max_bytes)
+        live->max_bytes = bytes;
+    live->fill_frames = fill;
+    live->xruns = xruns;
+    if (ret != 0)
+        live->errors++;
+    live->update_ns = now_ns;
+    live_write_end(&live->seq);
+}
+
+void audio_live_voice_update(const struct audio_live_voice *voice)
+{
+    struct audio_live_page *page = live_page;
+    uint32_t *seq;
+
+    if (page == NULL)
+        return;
+
+    seq = &page->voice.seq;
+    live_write_begin(seq);
+    memcpy((char *)&page->voice + sizeof(*seq), (const char *)voice + sizeof(*seq),
+           sizeof(*voice) - sizeof(*seq));
+    live_write_end(seq);
+}
+
+const struct audio_live_page *audio_live_map(const char *path)
+{
+    const struct audio_live_page *page;
+    struct stat st;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+    if ((fstat(fd, &st) < 0) || (st.st_size < (off_t)sizeof(*page))) {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+    page = mmap(NULL, sizeof(*page), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (page == MAP_FAILED)
+        return NULL;
+
+    if ((__atomic_load_n(&page->magic, __ATOMIC_ACQUIRE) != AUDIO_LIVE_MAGIC) ||
+        (page->version != AUDIO_LIVE_VERSION) || (page->size != sizeof(*page))) {
+        munmap((void *)page, sizeof(*page));
+        errno = EPROTO;
+        return NULL;
+    }
+    return page;
+}
+
+int audio_live_read(const void *record, void *copy, size_t size)
+{
+    const uint32_t *seq = record;
+    int i;
+
+    for (i = 0; i < LIVE_READ_TRIES; i++) {
+        uint32_t begin = __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+
+        if (begin & 1)
+            continue;
+        memcpy(copy, record, size);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(seq, __ATOMIC_RELAXED) == begin)
+            return 0;
+    }
+    return -EAGAIN;
+}
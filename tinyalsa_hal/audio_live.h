@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file    audio_live.h
+ * @brief   live counters of the streams and the voice process, published
+ *          in a shared page for astat to poll while audio runs
+ *
+ * The page is a file mapped by the hal when media.audio.live is set, at
+ * media.audio.live.path. Every record starts with a sequence count the
+ * writer makes odd while it updates the record, a reader copies the
+ * record and retries if the count was odd or moved meanwhile. Updating
+ * is a few plain stores, the hal never makes a system call for it.
+ */
+
+#ifndef AUDIO_LIVE_H_
+#define AUDIO_LIVE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUDIO_LIVE_MAGIC        (0x45564c41)   /* "ALVE" */
+#define AUDIO_LIVE_VERSION      (1)
+#define AUDIO_LIVE_STREAMS      (8)
+#define AUDIO_LIVE_DEFAULT_PATH "/data/vendor/audio/live_stats"
+
+enum audio_live_kind {
+    AUDIO_LIVE_FREE = 0,
+    AUDIO_LIVE_OUT,
+    AUDIO_LIVE_IN,
+};
+
+struct audio_live_stream {
+    uint32_t seq;
+    uint32_t kind;              // enum audio_live_kind
+    uint32_t id;                // changes when the slot is given to another stream
+    uint32_t device;
+    uint32_t route;             // AudioRoute of the device
+    uint32_t standby;
+    uint32_t rate;
+    uint32_t channels;
+    uint32_t period_size;
+    uint32_t buffer_frames;     // ring size of the pcm
+    int32_t  fill_frames;       // queued in the ring before the last transfer, -1 unknown
+    uint32_t last_bytes;
+    uint32_t min_bytes;
+    uint32_t max_bytes;
+    uint32_t xruns;
+    uint32_t errors;
+    uint64_t transfers;
+    uint64_t total_bytes;
+    int64_t  update_ns;         // CLOCK_MONOTONIC of the last update
+};
+
+/* queues of the voice process thread, AUDIO_3A builds only */
+struct audio_live_voice {
+    uint32_t seq;
+    uint32_t active;
+    uint32_t blocks;            // process blocks done
+    int32_t  capture_queued;    // raw capture bytes waiting for the thread
+    int32_t  playback_queued;   // raw playback bytes waiting for the thread
+    int32_t  capture_depth;     // processed capture queue, frames
+    int32_t  capture_target;
+    int32_t  playback_depth;    // processed playback queue, frames
+    int32_t  playback_target;
+    int32_t  echo_delay;        // reference delay, samples at the process rate
+    uint32_t capture_underruns;
+    uint32_t playback_underruns;
+    int64_t  update_ns;
+};
+
+struct audio_live_page {
+    uint32_t magic;             // stored last, once the page is laid out
+    uint32_t version;
+    uint32_t size;              // sizeof(struct audio_live_page)
+    int32_t  pid;               // of the hal that owns the page
+    struct audio_live_voice voice;
+    struct audio_live_stream stream[AUDIO_LIVE_STREAMS];
+};
+
+/**
+ * @brief audio_live_open
+ *        map the page if media.audio.live is set, once per process. The
+ *        page stays mapped until the process exits, so the records handed
+ *        out below never dangle.
+ *
+ * @returns the page or NULL when disabled or the file can't be mapped
+ */
+struct audio_live_page *audio_live_open(void);
+
+/**
+ * @brief audio_live_stream_get
+ *        claim a free stream record
+ *
+ * @param kind AUDIO_LIVE_OUT or AUDIO_LIVE_IN
+ *
+ * @returns the record, NULL if the page is off or full
+ */
+struct audio_live_stream *audio_live_stream_get(enum audio_live_kind kind);
+void audio_live_stream_put(struct audio_live_stream *live);
+
+/*
+ * The updates below accept a NULL record and do nothing then. A record
+ * has a single writer: the stream, under its lock.
+ */
+void audio_live_stream_config(struct audio_live_stream *live, uint32_t rate, uint32_t channels,
+                              uint32_t period_size, uint32_t buffer_frames);
+void audio_live_stream_route(struct audio_live_stream *live, uint32_t device, uint32_t route,
+                             bool standby);
+
+/**
+ * @brief audio_live_stream_xfer
+ *        account one transfer of bytes that returned ret, with fill frames
+ *        queued in the ring before it and xruns counted by the stream so far
+ */
+void audio_live_stream_xfer(struct audio_live_stream *live, uint32_t bytes, int fill,
+                            int ret, uint32_t xruns, int64_t now_ns);
+
+/**
+ * @brief audio_live_voice_update
+ *        publish the voice process queues, seq of voice is ignored.
+ *        Written by the voice process thread only.
+ */
+void audio_live_voice_update(const struct audio_live_voice *voice);
+
+/**
+ * @brief audio_live_map
+ *        map the page of a running hal read only, for the viewer
+ *
+ * @returns the page, NULL with errno set if it is missing or not valid
+ */
+const struct audio_live_page *audio_live_map(const char *path);
+
+/**
+ * @brief audio_live_read
+ *        copy a consistent snapshot of a record, stream or voice
+ *
+ * @param record the record in the page, starting with its sequence count
+ * @param copy
+ * @param size of the record
+ *
+ * @returns 0, or -EAGAIN if the writer kept it busy
+ */
+int audio_live_read(const void *record, void *copy, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file    audio_slice.c
+ * @brief   volume ramp applied to the output when media.audio.slice asks
+ *          for a fade out or fade in
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "audio_slice.h"
+
+static const float volume_slice[]={0.8012, 0.6419, 0.5309, 0.4254,
+                            0.3408, 0.2828, 0.1773, 0.1116,
+                            0.0750, 0.0472, 0.0297, 0.0200,
+                            0.0078, 0.0031, 0.0010, 0.0000};
+
+static const float delta_slice[] = {0.8, 0.6, 0.48, 0.3, 0.17, 0.1, 0.05, 0};
+
+/**
+ * @brief get_len_posi
+ * position of sample len within the stream write, in eighths mapped to
+ * the fade delta
+ *
+ * @param data_size size of the stream write in bytes
+ * @param len sample index
+ *
+ * @returns
+ */
+float get_len_posi(size_t data_size, int len)
+{
+    int len_max = data_size / 2;
+	int ret = 0;
+	
+	if (len < len_max / 8)
+		ret = 0;
+	else if ((len > len_max/8)&&(len < len_max/4))
+		ret = 1;
+    else if ((len > len_max/4) && (len < (len_max*3) /8))
+		ret = 2;
+	else if ((len > (len_max*3) /8) && (len < len_max/2))
+		ret = 3;
+	else if ((len > len_max/2) && (len < (len_max*5) /8))
+		ret = 4;
+	else if ((len > (len_max*5) /8) && (len < (len_max*3) /4))
+		ret = 5;
+	else if ((len > (len_max*3) /4) && (len < (len_max*7) /8))
+		ret = 6;
+	else
+		ret = 7;
+	
+	return delta_slice[ret];
+
+}
+
+/**
+ * @brief cal_data_slice
+ * scale the 16 bit samples of data along the fade step times, the gain
+ * moving towards the next step over the buffer
+ *
+ * @param data_size size of the stream write the buffer belongs to
+ * @param data
+ * @param len bytes
+ * @param times fade step, 0..15
+ * @param down fading out, else fading in
+ *
+ * @returns 0
+ */
+int cal_data_slice(size_t data_size, void *data, int len, int times, bool down)
+{
+    
+    int16_t *raw =(int16_t *)data;
+	len /=2;
+	if (times > 15)times =15;
+	else if (times < 0)times =0;
+	while (len--){
+		float tmp = (float)(*(raw+len));
+		if (down)
+			tmp *=(volume_slice[times] -
+			          (volume_slice[times]-volume_slice[times+1]*(1-get_len_posi(data_size,len))));
+		else{
+			if (times >=1)
+				tmp *=(volume_slice[times] +
+				         ((volume_slice[times-1] - volume_slice[times]) * (1-get_len_posi(data_size,len))));
+			else
+				tmp *=(volume_slice[times] +
+				         ((1 - volume_slice[times]) * (1-get_len_posi(data_size,len))));
+	    }
+		*(raw + len)=(int16_t) tmp;
+	}
+    return 0;
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file    audio_stats.c
+ * @brief   per stream transfer counters and log2 latency histograms
+ *
+ * Two clock reads and a handful of relaxed atomic adds per transfer,
+ * nothing is allocated and no lock is taken, so the stream can keep
+ * them on all the time and a dump can read them while it runs.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "audio_stats.h"
+
+static inline uint32_t stats_load32(const uint32_t *p)
+{
+    return __atomic_load_n(p, __ATOMIC_RELAXED);
+}
+
+int64_t audio_stats_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int stats_cmp(const void *a, const void *b)
+{
+    int64_t x = *(const int64_t *)a, y = *(const int64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+void audio_stats_sort(int64_t *samples, unsigned count)
+{
+    qsort(samples, count, sizeof(*samples), stats_cmp);
+}
+
+int64_t audio_stats_percentile(const int64_t *sorted, unsigned count, unsigned permille)
+{
+    unsigned index;
+
+    if (!count)
+        return 0;
+    index = ((uint64_t)count * permille + 999) / 1000;
+    return sorted[index ? index - 1 : 0];
+}
+
+void audio_stats_inc(uint32_t *counter)
+{
+    __atomic_fetch_add(counter, 1, __ATOMIC_RELAXED);
+}
+
+void audio_hist_add(struct audio_hist *hist, int64_t ns)
+{
+    uint32_t us = ns > 0 ? (uint32_t)(ns / 1000) : 0;
+    int bucket = us > 1 ? 31 - __builtin_clz(us) : 0;
+
+    if (bucket >= AUDIO_HIST_BUCKETS)
+        bucket = AUDIO_HIST_BUCKETS - 1;
+    __atomic_fetch_add(&hist->count[bucket], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->samples, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hist->total_us, us, __ATOMIC_RELAXED);
+    if (us > stats_load32(&hist->max_us))
+        __atomic_store_n(&hist->max_us, us, __ATOMIC_RELAXED);
+}
+
+void audio_stats_xfer(struct audio_stream_stats *stats, int64_t start_ns, int64_t end_ns, int ret)
+{
+    int64_t last = __atomic_load_n(&stats->last_xfer_ns, __ATOMIC_RELAXED);
+
+    audio_hist_add(&stats->xfer, end_ns - start_ns);
+    if (last)
+        audio_hist_add(&stats->interval, start_ns - last);
+    __atomic_store_n(&stats->last_xfer_ns, start_ns, __ATOMIC_RELAXED);
+
+    if (ret == -EPIPE)
+        audio_stats_inc(&stats->xruns);
+    if (ret != 0)
+        audio_stats_inc(&stats->errors);
+}
+
+void audio_stats_standby(struct audio_stream_stats *stats)
+{
+    audio_stats_inc(&stats->standbys);
+    __atomic_store_n(&stats->last_xfer_ns, 0, __ATOMIC_RELAXED);
+}
+
+static void stats_dump_hist(const struct audio_hist *hist, int fd, const char *name)
+{
+    uint32_t samples = stats_load32(&hist->samples);
+    uint64_t total = __atomic_load_n(&hist->total_us, __ATOMIC_RELAXED);
+    char line[512];
+    int len, i;
+
+    len = snprintf(line, sizeof(line), "    %-9s %8u  avg %7llu max %7u us |", name, samples,
+                   samples ? (unsigned long long)(total / samples) : 0ULL,
+                   stats_load32(&hist->max_us));
+    for (i = 0; i < AUDIO_HIST_BUCKETS && len < (int)sizeof(line); i++) {
+        uint32_t count = stats_load32(&hist->count[i]);
+        uint32_t upper = 2u << i;
+
+        if (!count)
+            continue;
+        if (i == AUDIO_HIST_BUCKETS - 1)
+            len += snprintf(line + len, sizeof(line) - len, " >=%ums:%u", (upper / 2) / 1000, count);
+        else if (upper < 1000)
+            len += snprintf(line + len, sizeof(line) - len, " <%uus:%u", upper, count);
+        else
+            len += snprintf(line + len, sizeof(line) - len, " <%ums:%u", upper / 1000, count);
+    }
+    dprintf(fd, "%s\n", line);
+}
+
+void audio_stats_dump(const struct audio_stream_stats *stats, int fd)
+{
+    dprintf(fd, "    xruns %u, errors %u, standbys %u\n", stats_load32(&stats->xruns),
+            stats_load32(&stats->errors), stats_load32(&stats->standbys));
+    stats_dump_hist(&stats->xfer, fd, "transfer");
+    stats_dump_hist(&stats->interval, fd, "interval");
+    stats_dump_hist(&stats->start, fd, "start");
+    stats_dump_hist(&stats->route, fd, "route");
+    stats_dump_hist(&stats->lock, fd, "lock");
+}
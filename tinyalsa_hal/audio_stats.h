@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file    audio_stats.h
+ * @brief   per stream transfer counters and log2 latency histograms,
+ *          shown by the stream and device dumps
+ */
+
+#ifndef AUDIO_STATS_H_
+#define AUDIO_STATS_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* bucket n counts [2^n, 2^(n+1)) us, the first one everything under 2 us, the last one the rest */
+#define AUDIO_HIST_BUCKETS  (22)
+
+struct audio_hist {
+    uint32_t count[AUDIO_HIST_BUCKETS];
+    uint32_t samples;
+    uint32_t max_us;
+    uint64_t total_us;
+};
+
+/*
+ * updated by the stream under its lock, read by the dumps without it:
+ * every field is stored atomically, a dump may only mix two transfers
+ */
+struct audio_stream_stats {
+    struct audio_hist xfer;         // in pcm_write or pcm_read
+    struct audio_hist interval;     // between the starts of two transfers
+    struct audio_hist start;        // leaving standby, routing included
+    struct audio_hist route;        // routing changes from set_parameters
+    struct audio_hist lock;         // waiting for the stream and device locks in write or read
+    uint32_t xruns;                 // EPIPE, or the ring found empty / full
+    uint32_t errors;                // failed transfers
+    uint32_t standbys;
+    int64_t  last_xfer_ns;          // 0 after standby, no interval across it
+};
+
+int64_t audio_stats_now_ns(void);
+
+/**
+ * @brief audio_stats_sort
+ *        sort timing samples of the debug tools, for audio_stats_percentile()
+ */
+void audio_stats_sort(int64_t *samples, unsigned count);
+
+/**
+ * @brief audio_stats_percentile
+ *        the sorted sample under which permille of them are, 0 without samples
+ */
+int64_t audio_stats_percentile(const int64_t *sorted, unsigned count, unsigned permille);
+
+void audio_stats_inc(uint32_t *counter);
+void audio_hist_add(struct audio_hist *hist, int64_t ns);
+
+/**
+ * @brief audio_stats_xfer
+ *        account one pcm_write or pcm_read that ran from start_ns to end_ns
+ *        and returned ret
+ */
+void audio_stats_xfer(struct audio_stream_stats *stats, int64_t start_ns, int64_t end_ns, int ret);
+
+/**
+ * @brief audio_stats_standby
+ *        the stream stopped, the next transfer starts a new interval
+ */
+void audio_stats_standby(struct audio_stream_stats *stats);
+
+void audio_stats_dump(const struct audio_stream_stats *stats, int fd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
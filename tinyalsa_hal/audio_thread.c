@@ -0,0 +1,293 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file    audio_thread.c
+ * @brief   creation of HAL worker threads with scheduling policy, cpu
+ *          affinity and utilization clamp hints
+ *
+ * The settings are applied by the new thread to itself before it runs
+ * the caller's function, so a refused setting never keeps it from
+ * starting: SCHED_FIFO falls back to the nice value, and the nice value
+ * to the inherited one, when the process lacks CAP_SYS_NICE. Utilization
+ * clamps need sched_setattr from linux 5.3 and are skipped on older
+ * kernels.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "audio_thread"
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include <cutils/log.h>
+#include <cutils/properties.h>
+
+#include "audio_thread.h"
+
+#define SCHED_FLAG_KEEP_POLICY      0x08
+#define SCHED_FLAG_KEEP_PARAMS      0x10
+#define SCHED_FLAG_UTIL_CLAMP_MIN   0x20
+#define SCHED_FLAG_UTIL_CLAMP_MAX   0x40
+#define UCLAMP_SCALE                1024
+
+/* struct sched_attr of linux 5.3, not exported by every libc */
+struct audio_sched_attr {
+    uint32_t size;
+    uint32_t sched_policy;
+    uint64_t sched_flags;
+    int32_t  sched_nice;
+    uint32_t sched_priority;
+    uint64_t sched_runtime;
+    uint64_t sched_deadline;
+    uint64_t sched_period;
+    uint32_t sched_util_min;
+    uint32_t sched_util_max;
+};
+
+static int64_t now_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int prop_get_int(const char *prefix, const char *key, int base, int *val)
+{
+    char name[PROPERTY_KEY_MAX + 32];
+    char value[PROPERTY_VALUE_MAX] = "";
+    char *end;
+    long v;
+
+    snprintf(name, sizeof(name), "%s.%s", prefix, key);
+    if (property_get(name, value, NULL) <= 0)
+        return -1;
+    v = strtol(value, &end, base);
+    if ((end == value) || (*end != '\0')) {
+        ALOGW("ignore %s=%s", name, value);
+        return -1;
+    }
+    *val = (int)v;
+    return 0;
+}
+
+void audio_thread_attr_init(audio_thread_attr *attr, const char *name)
+{
+    memset(attr, 0, sizeof(*attr));
+    attr->name = name;
+    attr->uclampMin = -1;
+    attr->uclampMax = -1;
+}
+
+void audio_thread_attr_from_props(audio_thread_attr *attr, const char *prefix)
+{
+    int val;
+
+    if (prop_get_int(prefix, "rt_prio", 10, &val) == 0)
+        attr->rtPriority = val;
+    if (prop_get_int(prefix, "nice", 10, &val) == 0)
+        attr->nice = val;
+    if (prop_get_int(prefix, "cpus", 16, &val) == 0)
+        attr->cpuMask = (unsigned int)val;
+    if (prop_get_int(prefix, "uclamp_min", 10, &val) == 0)
+        attr->uclampMin = val;
+    if (prop_get_int(prefix, "uclamp_max", 10, &val) == 0)
+        attr->uclampMax = val;
+}
+
+/**
+ * @brief thread_apply_policy
+ *        SCHED_FIFO if asked for and allowed, otherwise the nice value
+ */
+static void thread_apply_policy(audio_thread *thread)
+{
+    const audio_thread_attr *attr = &thread->attr;
+
+    thread->stats.policy = SCHED_OTHER;
+    thread->stats.priority = getpriority(PRIO_PROCESS, thread->tid);
+
+    if (attr->rtPriority > 0) {
+        struct sched_param param;
+        int max = sched_get_priority_max(SCHED_FIFO);
+
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = attr->rtPriority < max ? attr->rtPriority : max;
+        if (sched_setscheduler(thread->tid, SCHED_FIFO, &param) == 0) {
+            thread->stats.policy = SCHED_FIFO;
+            thread->stats.priority = param.sched_priority;
+            return;
+        }
+        ALOGW("%s: SCHED_FIFO %d refused (%s), use nice %d",
+              thread->name, param.sched_priority, strerror(errno), attr->nice);
+    }
+
+    if (attr->nice != 0) {
+        if (setpriority(PRIO_PROCESS, thread->tid, attr->nice) == 0)
+            thread->stats.priority = attr->nice;
+        else
+            ALOGW("%s: nice %d refused (%s)", thread->name, attr->nice, strerror(errno));
+    }
+}
+
+static void thread_apply_affinity(audio_thread *thread)
+{
+    unsigned int mask = thread->attr.cpuMask;
+    cpu_set_t set;
+    unsigned int cpu;
+
+    if (mask == 0)
+        return;
+
+    CPU_ZERO(&set);
+    for (cpu = 0; cpu < sizeof(mask) * 8; cpu++) {
+        if (mask & (1u << cpu))
+            CPU_SET(cpu, &set);
+    }
+    if (sched_setaffinity(thread->tid, sizeof(set), &set) == 0)
+        thread->stats.cpuMask = mask;
+    else
+        ALOGW("%s: cpu mask 0x%x refused (%s)", thread->name, mask, strerror(errno));
+}
+
+static void thread_apply_uclamp(audio_thread *thread)
+{
+    const audio_thread_attr *attr = &thread->attr;
+    struct audio_sched_attr sa;
+
+    if ((attr->uclampMin < 0) && (attr->uclampMax < 0))
+        return;
+
+#ifdef __NR_sched_setattr
+    memset(&sa, 0, sizeof(sa));
+    sa.size = sizeof(sa);
+    sa.sched_flags = SCHED_FLAG_KEEP_POLICY | SCHED_FLAG_KEEP_PARAMS;
+    if (attr->uclampMin >= 0) {
+        sa.sched_flags |= SCHED_FLAG_UTIL_CLAMP_MIN;
+        sa.sched_util_min = attr->uclampMin < UCLAMP_SCALE ? attr->uclampMin : UCLAMP_SCALE;
+    }
+    if (attr->uclampMax >= 0) {
+        sa.sched_flags |= SCHED_FLAG_UTIL_CLAMP_MAX;
+        sa.sched_util_max = attr->uclampMax < UCLAMP_SCALE ? attr->uclampMax : UCLAMP_SCALE;
+    }
+    if (syscall(__NR_sched_setattr, thread->tid, &sa, 0) != 0)
+        ALOGW("%s: uclamp %d..%d refused (%s)", thread->name,
+              attr->uclampMin, attr->uclampMax, strerror(errno));
+#else
+    ALOGW("%s: uclamp not supported", thread->name);
+#endif
+}
+
+static void* thread_trampoline(void *arg)
+{
+    audio_thread *thread = (audio_thread *)arg;
+
+    thread->tid = (pid_t)syscall(__NR_gettid);
+    pthread_setname_np(pthread_self(), thread->name);
+
+    thread_apply_policy(thread);
+    thread_apply_affinity(thread);
+    thread_apply_uclamp(thread);
+
+    ALOGD("%s: tid %d policy %s priority %d cpus 0x%x", thread->name, thread->tid,
+          thread->stats.policy == SCHED_FIFO ? "fifo" : "other",
+          thread->stats.priority, thread->stats.cpuMask);
+
+    return thread->func(thread->arg);
+}
+
+int audio_thread_create(audio_thread *thread, const audio_thread_attr *attr,
+                        void *(*func)(void *arg), void *arg)
+{
+    int ret;
+
+    memset(thread, 0, sizeof(*thread));
+    thread->attr = *attr;
+    strncpy(thread->name, attr->name ? attr->name : "audio_thread", sizeof(thread->name) - 1);
+    thread->attr.name = thread->name;
+    thread->func = func;
+    thread->arg = arg;
+
+    ret = pthread_create(&thread->thread, NULL, thread_trampoline, thread);
+    if (ret != 0)
+        ALOGE("%s: create failed (%s)", thread->name, strerror(ret));
+    return ret;
+}
+
+int audio_thread_join(audio_thread *thread)
+{
+    return pthread_join(thread->thread, NULL);
+}
+
+void audio_thread_wake(audio_thread *thread)
+{
+    int64_t expected = 0;
+
+    // keep the oldest pending request, that is the one the thread serves
+    __atomic_compare_exchange_n(&thread->wakeNs, &expected, now_ns(), 0,
+                                __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+}
+
+void audio_thread_woken(audio_thread *thread)
+{
+    int64_t wake_ns = __atomic_exchange_n(&thread->wakeNs, 0, __ATOMIC_ACQUIRE);
+    int64_t latency;
+
+    if (wake_ns == 0)
+        return;
+
+    latency = now_ns() - wake_ns;
+    thread->stats.wakeups++;
+    thread->stats.latencyTotalNs += latency;
+    if (latency > thread->stats.latencyMaxNs)
+        thread->stats.latencyMaxNs = latency;
+    if (latency > AUDIO_THREAD_LATE_NS)
+        thread->stats.late++;
+}
+
+void audio_thread_get_stats(audio_thread *thread, audio_thread_stats *stats)
+{
+    *stats = thread->stats;
+}
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file    audio_thread.h
+ * @brief   creation of HAL worker threads with scheduling policy, cpu
+ *          affinity and utilization clamp hints
+ */
+
+#ifndef AUDIO_THREAD_H_
+#define AUDIO_THREAD_H_
+
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* a wakeup that takes longer than this is counted as late */
+#define AUDIO_THREAD_LATE_NS    (1000000LL)
+
+typedef struct audio_thread_attr_ {
+    const char  *name;          // thread name, at most 15 characters are kept
+    int         rtPriority;     // SCHED_FIFO priority, 0 keeps SCHED_OTHER
+    int         nice;           // nice for SCHED_OTHER or when SCHED_FIFO is refused
+    unsigned int cpuMask;       // allowed cpus, bit n is cpu n, 0 for all
+    int         uclampMin;      // utilization clamp 0..1024, -1 to leave unset
+    int         uclampMax;
+} audio_thread_attr;
+
+typedef struct audio_thread_stats_ {
+    int         policy;         // policy that was applied
+    int         priority;       // rt priority, or nice for SCHED_OTHER
+    unsigned int cpuMask;       // affinity that was applied, 0 if none
+    unsigned int wakeups;
+    unsigned int late;          // wakeups over AUDIO_THREAD_LATE_NS
+    int64_t     latencyTotalNs;
+    int64_t     latencyMaxNs;
+} audio_thread_stats;
+
+typedef struct audio_thread_ {
+    pthread_t   thread;
+    pid_t       tid;
+    audio_thread_attr attr;
+    char        name[16];
+    void*       (*func)(void *arg);
+    void        *arg;
+    int64_t     wakeNs;         // when the pending wakeup was requested, 0 if none
+    audio_thread_stats stats;
+} audio_thread;
+
+/**
+ * @brief audio_thread_attr_init
+ *        defaults: SCHED_OTHER at nice 0, all cpus, no clamp
+ */
+void audio_thread_attr_init(audio_thread_attr *attr, const char *name);
+
+/**
+ * @brief audio_thread_attr_from_props
+ *        override attr from <prefix>.rt_prio, <prefix>.nice,
+ *        <prefix>.cpus (hex mask), <prefix>.uclamp_min and <prefix>.uclamp_max
+ */
+void audio_thread_attr_from_props(audio_thread_attr *attr, const char *prefix);
+
+/**
+ * @brief audio_thread_create
+ *        start func(arg) on a new thread that applies attr to itself
+ *        first. Settings the process is not allowed to use are dropped
+ *        with a warning, the thread always starts.
+ *
+ * @returns 0 on success, otherwise the pthread_create error
+ */
+int audio_thread_create(audio_thread *thread, const audio_thread_attr *attr,
+                        void *(*func)(void *arg), void *arg);
+
+int audio_thread_join(audio_thread *thread);
+
+/**
+ * @brief audio_thread_wake
+ *        note that the thread is about to be woken, call right before
+ *        posting whatever the thread waits on
+ */
+void audio_thread_wake(audio_thread *thread);
+
+/**
+ * @brief audio_thread_woken
+ *        called by the thread once its wait returned, accounts the time
+ *        since the matching audio_thread_wake
+ */
+void audio_thread_woken(audio_thread *thread);
+
+void audio_thread_get_stats(audio_thread *thread, audio_thread_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
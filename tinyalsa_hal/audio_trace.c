@@ -0,0 +1,244 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file    audio_trace.c
+ * @brief   ring of phase timestamps behind audio_trace.h
+ *
+ * Any thread may record. A writer takes a slot with one atomic add, fills
+ * it and publishes it by storing its sequence number last, a reader skips
+ * the slots whose sequence isn't the one it expects. Nothing is recorded,
+ * and no clock read, unless media.audio.trace was set when the hal
+ * started.
+ */
+
+#define LOG_TAG "audio_trace"
+#define ATRACE_TAG ATRACE_TAG_AUDIO
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <cutils/log.h>
+#include <cutils/properties.h>
+#include <cutils/trace.h>
+
+#include "audio_trace.h"
+
+#define TRACE_EVENTS (512)
+
+enum {
+    TRACE_BEGIN,
+    TRACE_END,
+    TRACE_MARK,
+};
+
+struct trace_event {
+    uint32_t seq;           // index + 1 once published, 0 while written
+    uint32_t type;
+    int32_t tid;
+    const char *name;
+    int64_t ns;
+};
+
+static struct trace_event trace_ring[TRACE_EVENTS];
+static uint32_t trace_next;
+static bool trace_enabled;
+static bool trace_first_sound;
+static pthread_once_t trace_once = PTHREAD_ONCE_INIT;
+
+static void trace_init(void)
+{
+    trace_enabled = property_get_bool("media.audio.trace", false);
+}
+
+static void trace_record(uint32_t type, const char *name)
+{
+    struct trace_event *e;
+    struct timespec ts;
+    uint32_t idx;
+
+    pthread_once(&trace_once, trace_init);
+    if (!trace_enabled)
+        return;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    idx = __atomic_fetch_add(&trace_next, 1, __ATOMIC_RELAXED);
+    e = &trace_ring[idx % TRACE_EVENTS];
+    __atomic_store_n(&e->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&e->type, type, __ATOMIC_RELAXED);
+    __atomic_store_n(&e->tid, (int32_t)syscall(__NR_gettid), __ATOMIC_RELAXED);
+    __atomic_store_n(&e->name, name, __ATOMIC_RELAXED);
+    __atomic_store_n(&e->ns, ts.tv_sec * 1000000000LL + ts.tv_nsec, __ATOMIC_RELAXED);
+    __atomic_store_n(&e->seq, idx + 1, __ATOMIC_RELEASE);
+}
+
+void audio_trace_begin(const char *name)
+{
+    ATRACE_BEGIN(name);
+    trace_record(TRACE_BEGIN, name);
+}
+
+void audio_trace_end(const char *name)
+{
+    trace_record(TRACE_END, name);
+    ATRACE_END();
+}
+
+void audio_trace_mark(const char *name)
+{
+    ATRACE_BEGIN(name);
+    ATRACE_END();
+    trace_record(TRACE_MARK, name);
+}
+
+void audio_trace_first_sound(void)
+{
+    audio_trace_mark("first sound");
+    if (trace_enabled && !__atomic_exchange_n(&trace_first_sound, true, __ATOMIC_RELAXED))
+        audio_trace_dump(-1);
+}
+
+/**
+ * @brief trace_snapshot
+ *        copy the published events of the ring, oldest first
+ *
+ * @returns the number copied
+ */
+static int trace_snapshot(struct trace_event *events)
+{
+    uint32_t next = __atomic_load_n(&trace_next, __ATOMIC_ACQUIRE);
+    uint32_t idx = next > TRACE_EVENTS ? next - TRACE_EVENTS : 0;
+    int count = 0;
+
+    for (; idx != next; idx++) {
+        const struct trace_event *e = &trace_ring[idx % TRACE_EVENTS];
+        struct trace_event *copy = &events[count];
+
+        if (__atomic_load_n(&e->seq, __ATOMIC_ACQUIRE) != idx + 1)
+            continue;
+        copy->type = __atomic_load_n(&e->type, __ATOMIC_RELAXED);
+        copy->tid = __atomic_load_n(&e->tid, __ATOMIC_RELAXED);
+        copy->name = __atomic_load_n(&e->name, __ATOMIC_RELAXED);
+        copy->ns = __atomic_load_n(&e->ns, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&e->seq, __ATOMIC_RELAXED) == idx + 1)
+            count++;
+    }
+    return count;
+}
+
+/**
+ * @brief trace_match
+ *        pair every begin with the first end of the same name on its thread
+ *        after it, match[i] is the index of the end or -1
+ */
+static void trace_match(const struct trace_event *events, int count, int *match)
+{
+    int i, j;
+
+    for (i = 0; i < count; i++)
+        match[i] = -1;
+    for (i = 0; i < count; i++) {
+        if (events[i].type != TRACE_BEGIN)
+            continue;
+        for (j = i + 1; j < count; j++) {
+            if ((events[j].type == TRACE_END) && (events[j].tid == events[i].tid) &&
+                (events[j].name == events[i].name) && (match[j] < 0)) {
+                match[i] = j;
+                match[j] = i;
+                break;
+            }
+        }
+    }
+}
+
+void audio_trace_dump(int fd)
+{
+    static struct trace_event events[TRACE_EVENTS];
+    static int match[TRACE_EVENTS];
+    static pthread_mutex_t dump_lock = PTHREAD_MUTEX_INITIALIZER;
+    int count, i, j;
+
+    pthread_once(&trace_once, trace_init);
+    if (!trace_enabled) {
+        if (fd >= 0)
+            dprintf(fd, "trace: off, set media.audio.trace before the hal starts\n");
+        return;
+    }
+
+    pthread_mutex_lock(&dump_lock);
+    count = trace_snapshot(events);
+    trace_match(events, count, match);
+    if (fd >= 0)
+        dprintf(fd, "trace: %d events, ms since the first, [duration ms], tid\n", count);
+    else
+        ALOGI("trace: %d events, ms since the first, [duration ms], tid", count);
+
+    for (i = 0; i < count; i++) {
+        const struct trace_event *e = &events[i];
+        char duration[24] = "";
+        int depth = 0;
+
+        if (e->type == TRACE_END)
+            continue;
+
+        /* the phases of this thread still open around it */
+        for (j = 0; j < i; j++)
+            if ((events[j].type == TRACE_BEGIN) && (events[j].tid == e->tid) &&
+                ((match[j] < 0) || (match[j] > i)))
+                depth++;
+
+        if (e->type == TRACE_BEGIN) {
+            if (match[i] < 0)
+                snprintf(duration, sizeof(duration), "[running]");
+            else
+                snprintf(duration, sizeof(duration), "[%8.3f]", (events[match[i]].ns - e->ns) / 1e6);
+        }
+
+        if (fd >= 0)
+            dprintf(fd, "  %10.3f %-10s %5d %*s%s\n", (e->ns - events[0].ns) / 1e6, duration,
+                    e->tid, depth * 2, "", e->name);
+        else
+            ALOGI("  %10.3f %-10s %5d %*s%s", (e->ns - events[0].ns) / 1e6, duration,
+                  e->tid, depth * 2, "", e->name);
+    }
+    pthread_mutex_unlock(&dump_lock);
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file    audio_trace.h
+ * @brief   timeline of the cold start and first sound phases
+ *
+ * Phases are marked with begin/end pairs that nest per thread. Each mark
+ * goes to ATRACE under the audio tag, and to a ring of timestamps when
+ * media.audio.trace is set: adev_dump prints the ring, and the timeline up
+ * to the first sound after adev_open is logged once.
+ *
+ * Names must be string literals, the ring keeps the pointers.
+ */
+
+#ifndef AUDIO_TRACE_H_
+#define AUDIO_TRACE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void audio_trace_begin(const char *name);
+void audio_trace_end(const char *name);
+
+/**
+ * @brief audio_trace_mark
+ *        an instant, a begin and end at the same time
+ */
+void audio_trace_mark(const char *name);
+
+/**
+ * @brief audio_trace_first_sound
+ *        the first frames of a stream reached the driver, log the timeline
+ *        the first time it happens in the process
+ */
+void audio_trace_first_sound(void);
+
+/**
+ * @brief audio_trace_dump
+ *        print the ring, oldest first, phases with their duration
+ *
+ * @param fd where to, the log if < 0
+ */
+void audio_trace_dump(int fd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,334 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file route_table_gen.c
+ * @brief build time generator of the packed route tables
+ *
+ * Reads every table of config_list.h plus the default table and writes
+ * them in the route_table_packed.h form: strings interned, control
+ * sequences stored once (a sequence found inside an already stored one
+ * reuses it), identical route tables shared. Prints the size of the
+ * tables before and after so the saving shows in the build output.
+ *
+ * usage: route_table_gen [-p target_pointer_bytes] output.c
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "config_list.h"
+#include "route_table_packed.h"
+
+#define GEN_MAX_CARDS   64
+#define GEN_MAX_ROUTES  (GEN_MAX_CARDS * 64)
+#define GEN_MAX_CTLS    0xfffe
+#define GEN_MAX_STRINGS 0xfffe
+
+static char gen_strings[GEN_MAX_STRINGS];
+static unsigned gen_strings_size;
+static struct route_packed_control gen_ctls[GEN_MAX_CTLS];
+static unsigned gen_ctls_count;
+static struct route_packed_route gen_routes[GEN_MAX_ROUTES];
+static unsigned gen_routes_count;
+static struct route_packed_card gen_cards[GEN_MAX_CARDS];
+static unsigned gen_cards_count;
+static unsigned gen_ctl_entries;
+
+static void gen_fail(const char *what)
+{
+    fprintf(stderr, "route_table_gen: %s\n", what);
+    exit(1);
+}
+
+/**
+ * @brief gen_intern
+ *
+ * @returns offset of the string in the pool, added if not there yet
+ */
+static uint16_t gen_intern(const char *str)
+{
+    unsigned pos = 0, len = strlen(str) + 1;
+
+    if (strpbrk(str, "\"\\"))
+        gen_fail("quote or backslash in a control string");
+    while (pos < gen_strings_size) {
+        if (!strcmp(gen_strings + pos, str))
+            return pos;
+        pos += strlen(gen_strings + pos) + 1;
+    }
+    if (gen_strings_size + len > GEN_MAX_STRINGS)
+        gen_fail("string pool overflow");
+    memcpy(gen_strings + gen_strings_size, str, len);
+    gen_strings_size += len;
+    return pos;
+}
+
+static int16_t gen_int(int value)
+{
+    if ((value < INT16_MIN) || (value > INT16_MAX))
+        gen_fail("control value does not fit in 16 bits");
+    return (int16_t)value;
+}
+
+/**
+ * @brief gen_sequence
+ *
+ * @returns offset of the packed control sequence, reusing any stored
+ *          run that matches it
+ */
+static uint16_t gen_sequence(const struct config_control *ctls, unsigned count)
+{
+    struct route_packed_control seq[count ? count : 1];
+    unsigned i;
+
+    if (count == 0)
+        return 0;
+    gen_ctl_entries += count;
+
+    memset(seq, 0, sizeof(seq));
+    for (i = 0; i < count; i++) {
+        seq[i].name = gen_intern(ctls[i].ctl_name);
+        seq[i].str_val = ctls[i].str_val ? gen_intern(ctls[i].str_val) : ROUTE_PACKED_NO_STR;
+        seq[i].int_val[0] = gen_int(ctls[i].int_val[0]);
+        seq[i].int_val[1] = gen_int(ctls[i].int_val[1]);
+    }
+
+    for (i = 0; i + count <= gen_ctls_count; i++) {
+        if (!memcmp(gen_ctls + i, seq, sizeof(seq)))
+            return i;
+    }
+    if (gen_ctls_count + count > GEN_MAX_CTLS)
+        gen_fail("control pool overflow");
+    memcpy(gen_ctls + gen_ctls_count, seq, sizeof(seq));
+    gen_ctls_count += count;
+    return gen_ctls_count - count;
+}
+
+/**
+ * @brief gen_table
+ *
+ * @returns offset of the packed routes of table, shared with an
+ *          identical table packed before
+ */
+static uint16_t gen_table(const struct config_route_table *table)
+{
+    const struct config_route *routes = (const struct config_route *)table;
+    struct route_packed_route packed[ROUTE_PACKED_ROUTES];
+    unsigned i;
+
+    memset(packed, 0, sizeof(packed));
+    for (i = 0; i < ROUTE_PACKED_ROUTES; i++) {
+        packed[i].sound_card = gen_int(routes[i].sound_card);
+        packed[i].devices = routes[i].devices;
+        packed[i].controls_count = routes[i].controls ? routes[i].controls_count : 0;
+        packed[i].controls = gen_sequence(routes[i].controls, packed[i].controls_count);
+    }
+
+    for (i = 0; i + ROUTE_PACKED_ROUTES <= gen_routes_count; i += ROUTE_PACKED_ROUTES) {
+        if (!memcmp(gen_routes + i, packed, sizeof(packed)))
+            return i;
+    }
+    if (gen_routes_count + ROUTE_PACKED_ROUTES > GEN_MAX_ROUTES)
+        gen_fail("route pool overflow");
+    memcpy(gen_routes + gen_routes_count, packed, sizeof(packed));
+    gen_routes_count += ROUTE_PACKED_ROUTES;
+    return gen_routes_count - ROUTE_PACKED_ROUTES;
+}
+
+static void gen_card(const char *name, const struct config_route_table *table)
+{
+    if (gen_cards_count >= GEN_MAX_CARDS)
+        gen_fail("too many cards");
+    gen_cards[gen_cards_count].name = name ? gen_intern(name) : ROUTE_PACKED_NO_STR;
+    gen_cards[gen_cards_count].routes = gen_table(table);
+    gen_cards_count++;
+}
+
+/**
+ * @brief gen_original_size
+ *        bytes the tables take as compiled from the headers, for a
+ *        target with the given pointer size: each control array, each
+ *        route table, the card list and every distinct string
+ */
+static unsigned long gen_original_size(const struct config_route_table **tables, unsigned count,
+                                       unsigned ptr)
+{
+    const void *seen[GEN_MAX_ROUTES];
+    unsigned seen_count = 0, i, j, k, n;
+    unsigned long size = 0;
+    unsigned control_size = 2 * ptr + 2 * sizeof(int);
+    unsigned route_size = (2 * sizeof(int) + ptr + sizeof(unsigned) + ptr - 1) / ptr * ptr;
+    char *strings = calloc(1, GEN_MAX_STRINGS * 4);
+    unsigned strings_size = 0;
+
+    if (!strings)
+        gen_fail("out of memory");
+
+    for (i = 0; i < count; i++) {
+        const struct config_route *routes = (const struct config_route *)tables[i];
+
+        for (k = 0; k < seen_count; k++)
+            if (seen[k] == tables[i])
+                break;
+        if (k < seen_count)
+            continue;
+        seen[seen_count++] = tables[i];
+        size += ROUTE_PACKED_ROUTES * route_size;
+
+        for (j = 0; j < ROUTE_PACKED_ROUTES; j++) {
+            if (!routes[j].controls)
+                continue;
+            for (k = 0; k < seen_count; k++)
+                if (seen[k] == routes[j].controls)
+                    break;
+            if (k < seen_count)
+                continue;
+            seen[seen_count++] = routes[j].controls;
+            size += routes[j].controls_count * control_size;
+
+            for (n = 0; n < routes[j].controls_count * 2; n++) {
+                const char *str = n & 1 ? routes[j].controls[n / 2].str_val
+                                        : routes[j].controls[n / 2].ctl_name;
+                unsigned pos = 0;
+
+                if (!str)
+                    continue;
+                while (pos < strings_size) {
+                    if (!strcmp(strings + pos, str))
+                        break;
+                    pos += strlen(strings + pos) + 1;
+                }
+                if (pos < strings_size)
+                    continue;
+                strcpy(strings + strings_size, str);
+                strings_size += strlen(str) + 1;
+            }
+        }
+    }
+    free(strings);
+
+    // the card list and the card names
+    size += count * 2 * ptr;
+    for (i = 0; i < sizeof(sound_card_config_list) / sizeof(sound_card_config_list[0]); i++)
+        size += strlen(sound_card_config_list[i].sound_card_name) + 1;
+
+    return size + strings_size;
+}
+
+static void gen_write(FILE *out)
+{
+    unsigned i;
+
+    fprintf(out, "/* generated by route_table_gen from codec_config/config_list.h, do not edit */\n\n");
+    fprintf(out, "#include \"codec_config/route_table_packed.h\"\n\n");
+
+    fprintf(out, "const char route_packed_strings[] =");
+    for (i = 0; i < gen_strings_size; i += strlen(gen_strings + i) + 1)
+        fprintf(out, "\n    \"%s\\0\"", gen_strings + i);
+    fprintf(out, ";\n\n");
+
+    fprintf(out, "const struct route_packed_control route_packed_controls[] = {\n");
+    for (i = 0; i < gen_ctls_count; i++)
+        fprintf(out, "    { %u, %u, { %d, %d } },\n", gen_ctls[i].name, gen_ctls[i].str_val,
+                gen_ctls[i].int_val[0], gen_ctls[i].int_val[1]);
+    if (gen_ctls_count == 0)
+        fprintf(out, "    { 0, 0, { 0, 0 } },\n");
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "const struct route_packed_route route_packed_routes[] = {\n");
+    for (i = 0; i < gen_routes_count; i++)
+        fprintf(out, "    { %d, %u, %u, %u },\n", gen_routes[i].sound_card, gen_routes[i].devices,
+                gen_routes[i].controls, gen_routes[i].controls_count);
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "const struct route_packed_card route_packed_cards[] = {\n");
+    for (i = 0; i < gen_cards_count; i++)
+        fprintf(out, "    { %u, %u },\n", gen_cards[i].name, gen_cards[i].routes);
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "const unsigned route_packed_card_count = %u;\n", gen_cards_count);
+}
+
+int main(int argc, char **argv)
+{
+    const struct config_route_table *tables[GEN_MAX_CARDS];
+    unsigned count = 0, i, ptr = sizeof(void *);
+    unsigned long original, packed;
+    FILE *out;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:")) != -1) {
+        switch (opt) {
+        case 'p':
+            ptr = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: route_table_gen [-p target_pointer_bytes] output.c\n");
+            return 1;
+        }
+    }
+    if ((optind != argc - 1) || ((ptr != 4) && (ptr != 8))) {
+        fprintf(stderr, "usage: route_table_gen [-p target_pointer_bytes] output.c\n");
+        return 1;
+    }
+
+    // the default table comes first, route_init() falls back to it
+    gen_card(NULL, &default_config_table);
+    tables[count++] = &default_config_table;
+    for (i = 0; i < sizeof(sound_card_config_list) / sizeof(sound_card_config_list[0]); i++) {
+        gen_card(sound_card_config_list[i].sound_card_name, sound_card_config_list[i].route_table);
+        tables[count++] = sound_card_config_list[i].route_table;
+    }
+
+    out = fopen(argv[optind], "w");
+    if (!out)
+        gen_fail("can not open the output");
+    gen_write(out);
+    if (fclose(out) != 0)
+        gen_fail("can not write the output");
+
+    original = gen_original_size(tables, count, ptr);
+    packed = gen_strings_size + gen_ctls_count * sizeof(struct route_packed_control)
+             + gen_routes_count * sizeof(struct route_packed_route)
+             + gen_cards_count * sizeof(struct route_packed_card);
+    printf("route tables: %u cards, %u route tables packed into %u, %u controls packed into %u\n",
+           gen_cards_count, count, gen_routes_count / (unsigned)ROUTE_PACKED_ROUTES,
+           gen_ctl_entries, gen_ctls_count);
+    printf("route tables: %lu bytes as headers (%u bit), %lu bytes packed (%lu%%)\n",
+           original, ptr * 8, packed, packed * 100 / original);
+    return 0;
+}
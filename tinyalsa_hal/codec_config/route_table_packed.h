@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file route_table_packed.h
+ * @brief compact form of the codec route tables
+ *
+ * route_table_gen builds it from config_list.h at build time: the
+ * control names and enum values are interned into one string pool, a
+ * control sequence shared by several routes or codecs is stored once,
+ * and identical route tables share their routes. route_init() expands
+ * the table of the detected card only.
+ */
+
+#ifndef _ROUTE_TABLE_PACKED_H_
+#define _ROUTE_TABLE_PACKED_H_
+
+#include <stdint.h>
+
+#include "config.h"
+
+/* str_val of an integer control, name of the default table */
+#define ROUTE_PACKED_NO_STR     0xffff
+
+/* routes of a table, in the member order of struct config_route_table */
+#define ROUTE_PACKED_ROUTES     (sizeof(struct config_route_table) / sizeof(struct config_route))
+
+struct route_packed_control {
+    uint16_t name;              // offset in route_packed_strings
+    uint16_t str_val;           // offset in route_packed_strings, or ROUTE_PACKED_NO_STR
+    int16_t  int_val[2];
+};
+
+struct route_packed_route {
+    int16_t  sound_card;
+    uint16_t devices;
+    uint16_t controls;          // first control in route_packed_controls
+    uint16_t controls_count;
+};
+
+struct route_packed_card {
+    uint16_t name;              // sound card id, ROUTE_PACKED_NO_STR for the default table
+    uint16_t routes;            // first of ROUTE_PACKED_ROUTES in route_packed_routes
+};
+
+extern const char route_packed_strings[];
+extern const struct route_packed_control route_packed_controls[];
+extern const struct route_packed_route route_packed_routes[];
+extern const struct route_packed_card route_packed_cards[];
+extern const unsigned route_packed_card_count;
+
+#endif //_ROUTE_TABLE_PACKED_H_
@@ -0,0 +1,566 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file    dsp_bench.c
+ * @brief   microbenchmark of the per sample kernels of the HALs
+ *
+ * Runs every kernel over fixed buffer sizes on the same synthetic
+ * signal and reports the median and best time per frame, and the cycles
+ * per frame from the cpu cycle counter when perf events are allowed, or
+ * estimated from the cpu frequency otherwise. The input is restored
+ * outside of the timed region before each run, as most kernels work in
+ * place.
+ *
+ * -j writes the results as JSON, one result per line, and -c compares
+ * the run against such a file and fails when a kernel got slower than
+ * the tolerance, so the loops can be gated on regressions.
+ *
+ * usage: dsp_bench [-n iterations] [-f frames,...] [-j out.json|-]
+ *                  [-c baseline.json] [-t tolerance_%] [kernel...]
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <linux/perf_event.h>
+
+#include <speex/speex_resampler.h>
+
+#include "audio_bitstream.h"
+#include "audio_slice.h"
+#include "audio_stats.h"
+#include "voice_preprocess.h"
+#include "../legacy_hal/audio_dsp.h"
+
+#define BENCH_ITERATIONS_DEFAULT (200)
+#define BENCH_WARMUP (10)
+#define BENCH_TOLERANCE_DEFAULT (20)
+#define BENCH_SIZES_MAX (8)
+#define BENCH_RATE (48000)
+#define BENCH_VOICE_RATE (16000)
+
+/* 10, 20 and 100 ms at 48 kHz, the first one still holds a 441 block of resample_441_320 */
+static const int bench_sizes_default[] = { 480, 960, 4800 };
+
+/* 2.30 taps of the legacy 44.1 -> 22.05 kHz halfband, fir_convolve is timed on its own */
+static const int32_t bench_fir_coeff[] = {
+    2089257, 2898328, -5820678, -10484531,
+    19038724, 30542725, -50469415, -81505260,
+    152544464, 478517512, 478517512, 152544464,
+    -81505260, -50469415, 30542725, 19038724,
+    -10484531, -5820678, 2898328, 2089257,
+};
+#define BENCH_FIR_TAPS (int)(sizeof(bench_fir_coeff) / sizeof(bench_fir_coeff[0]))
+
+/*
+ * every kernel gets a buffer of frames stereo 16 bit frames plus headroom,
+ * filled with the signal, and returns a value so the work is not dropped
+ */
+struct bench_ctx {
+    int frames;
+    int16_t *buf;
+    int16_t *out;
+    char chan[CHASTA_SUB_NUM];
+    SpeexResamplerState *down;
+    SpeexResamplerState *up;
+};
+
+struct bench_kernel {
+    const char *name;
+    int (*run)(struct bench_ctx *ctx);
+};
+
+struct bench_result {
+    const char *name;
+    int frames;
+    double ns_p50;
+    double ns_min;
+    double cycles_p50;          // < 0 when no cycle source
+};
+
+static uint32_t bench_seed = 1;
+static int bench_cycles_fd = -1;
+static double bench_cpu_hz;     // frequency estimate when there is no counter
+
+static short bench_noise(int amplitude)
+{
+    bench_seed = bench_seed * 1103515245 + 12345;
+    return (short)((int)((bench_seed >> 16) & 0xffff) - 32768) * amplitude / 32768;
+}
+
+/**
+ * @brief bench_cycles_open
+ * user space cycle counter of this thread, falls back to the frequency
+ * of cpu0 to estimate cycles from time
+ *
+ * @returns the name of the cycle source, NULL if there is none
+ */
+static const char *bench_cycles_open(void)
+{
+    struct perf_event_attr attr;
+    FILE *f;
+    long khz = 0;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CPU_CYCLES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    bench_cycles_fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+    if (bench_cycles_fd >= 0)
+        return "perf";
+
+    f = fopen("/sys/devices/system/cpu/cpu0/cpufreq/cpuinfo_max_freq", "r");
+    if (f) {
+        if (fscanf(f, "%ld", &khz) != 1)
+            khz = 0;
+        fclose(f);
+    }
+    if (khz > 0) {
+        bench_cpu_hz = khz * 1000.0;
+        return "cpufreq";
+    }
+    return NULL;
+}
+
+static int64_t bench_cycles(void)
+{
+    uint64_t count = 0;
+
+    if (bench_cycles_fd < 0 || read(bench_cycles_fd, &count, sizeof(count)) != sizeof(count))
+        return 0;
+    return (int64_t)count;
+}
+
+static int bench_cal_data_slice(struct bench_ctx *ctx)
+{
+    int bytes = ctx->frames * 4;
+
+    return cal_data_slice(bytes, ctx->buf, bytes, 8, true);
+}
+
+static int bench_get_len_posi(struct bench_ctx *ctx)
+{
+    int samples = ctx->frames * 2;
+    float sum = 0;
+    int i;
+
+    for (i = 0; i < samples; i++)
+        sum += get_len_posi(samples * 2, i);
+    return (int)sum;
+}
+
+static int bench_fill_hdmi_bitstream_buf(struct bench_ctx *ctx)
+{
+    fill_hdmi_bitstream_buf(ctx->buf, ctx->out, ctx->chan, ctx->frames * 4);
+    return ctx->out[0];
+}
+
+static int bench_to_mono(struct bench_ctx *ctx)
+{
+    return processBuffertoMono(ctx->buf, ctx->frames * 4);
+}
+
+static int bench_to_stereo(struct bench_ctx *ctx)
+{
+    return processBuffertoStereo(ctx->buf, ctx->frames * 2);
+}
+
+static int bench_resample_down(struct bench_ctx *ctx)
+{
+    spx_uint32_t in = ctx->frames;
+    spx_uint32_t out = ctx->frames;
+
+    speex_resampler_process_interleaved_int(ctx->down, ctx->buf, &in, ctx->out, &out);
+    return out;
+}
+
+static int bench_resample_up(struct bench_ctx *ctx)
+{
+    spx_uint32_t in = ctx->frames * BENCH_VOICE_RATE / BENCH_RATE;
+    spx_uint32_t out = ctx->frames;
+
+    speex_resampler_process_interleaved_int(ctx->up, ctx->buf, &in, ctx->out, &out);
+    return out;
+}
+
+static int bench_channel_check(struct bench_ctx *ctx)
+{
+    return channel_check(ctx->buf, ctx->frames * 2);
+}
+
+static int bench_channel_fixed(struct bench_ctx *ctx)
+{
+    channel_fixed(ctx->buf, ctx->frames * 2, 1);
+    return ctx->buf[1];
+}
+
+static int bench_fir_convolve(struct bench_ctx *ctx)
+{
+    int32_t sum = 0;
+    int i;
+
+    for (i = 0; i < ctx->frames; i++)
+        sum += fir_convolve(ctx->buf + i, bench_fir_coeff, BENCH_FIR_TAPS);
+    return sum;
+}
+
+static int bench_resample_2_1(struct bench_ctx *ctx)
+{
+    int in = ctx->frames, out = 0;
+
+    resample_2_1(ctx->buf, ctx->out, &in, &out);
+    return out;
+}
+
+static int bench_resample_441_320(struct bench_ctx *ctx)
+{
+    int in = ctx->frames, out = 0;
+
+    resample_441_320(ctx->buf, ctx->out, &in, &out);
+    return out;
+}
+
+static const struct bench_kernel bench_kernels[] = {
+    { "cal_data_slice", bench_cal_data_slice },
+    { "get_len_posi", bench_get_len_posi },
+    { "fill_hdmi_bitstream_buf", bench_fill_hdmi_bitstream_buf },
+    { "voice_to_mono", bench_to_mono },
+    { "voice_to_stereo", bench_to_stereo },
+    { "voice_resample_down", bench_resample_down },
+    { "voice_resample_up", bench_resample_up },
+    { "channel_check", bench_channel_check },
+    { "channel_fixed", bench_channel_fixed },
+    { "fir_convolve", bench_fir_convolve },
+    { "resample_2_1", bench_resample_2_1 },
+    { "resample_441_320", bench_resample_441_320 },
+};
+#define BENCH_KERNELS (int)(sizeof(bench_kernels) / sizeof(bench_kernels[0]))
+
+/**
+ * @brief bench_run
+ * time iterations runs of kernel over frames frames, after a warm up
+ *
+ * @param kernel
+ * @param ctx
+ * @param src the signal the buffer is restored from before every run
+ * @param iterations
+ * @param result
+ *
+ * @returns 0 on success, -1 when out of memory
+ */
+static int bench_run(const struct bench_kernel *kernel, struct bench_ctx *ctx,
+                     const int16_t *src, int iterations, struct bench_result *result)
+{
+    int64_t *ns = malloc(iterations * sizeof(int64_t));
+    int64_t *cycles = malloc(iterations * sizeof(int64_t));
+    size_t bytes = ctx->frames * 4 + BENCH_FIR_TAPS * 2;
+    volatile int sink = 0;
+    int i;
+
+    if (!ns || !cycles) {
+        free(ns);
+        free(cycles);
+        return -1;
+    }
+
+    for (i = -BENCH_WARMUP; i < iterations; i++) {
+        int64_t start, c;
+
+        memcpy(ctx->buf, src, bytes);
+        c = bench_cycles();
+        start = audio_stats_now_ns();
+        sink += kernel->run(ctx);
+        if (i < 0)
+            continue;
+        ns[i] = audio_stats_now_ns() - start;
+        cycles[i] = bench_cycles() - c;
+    }
+
+    audio_stats_sort(ns, iterations);
+    audio_stats_sort(cycles, iterations);
+    result->name = kernel->name;
+    result->frames = ctx->frames;
+    result->ns_min = (double)ns[0] / ctx->frames;
+    result->ns_p50 = (double)audio_stats_percentile(ns, iterations, 500) / ctx->frames;
+    if (bench_cycles_fd >= 0)
+        result->cycles_p50 = (double)audio_stats_percentile(cycles, iterations, 500) / ctx->frames;
+    else if (bench_cpu_hz > 0)
+        result->cycles_p50 = result->ns_p50 * bench_cpu_hz / 1e9;
+    else
+        result->cycles_p50 = -1;
+
+    free(ns);
+    free(cycles);
+    return 0;
+}
+
+static void bench_json(FILE *f, const struct bench_result *results, int count,
+                       int iterations, const char *cycles_source)
+{
+    int i;
+
+    fprintf(f, "{\n  \"tool\": \"dsp_bench\",\n  \"iterations\": %d,\n", iterations);
+    if (cycles_source)
+        fprintf(f, "  \"cycles_source\": \"%s\",\n", cycles_source);
+    else
+        fprintf(f, "  \"cycles_source\": null,\n");
+    fprintf(f, "  \"results\": [\n");
+    for (i = 0; i < count; i++) {
+        fprintf(f, "    {\"kernel\": \"%s\", \"frames\": %d, \"ns_per_frame\": %.3f, "
+                "\"ns_per_frame_min\": %.3f, ",
+                results[i].name, results[i].frames, results[i].ns_p50, results[i].ns_min);
+        if (results[i].cycles_p50 >= 0)
+            fprintf(f, "\"cycles_per_frame\": %.3f}", results[i].cycles_p50);
+        else
+            fprintf(f, "\"cycles_per_frame\": null}");
+        fprintf(f, "%s\n", i < count - 1 ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+}
+
+/**
+ * @brief bench_compare
+ * check the results against a file written by -j, the lines of the
+ * results array are read back one by one
+ *
+ * @param path
+ * @param results
+ * @param count
+ * @param tolerance allowed slow down in percent
+ *
+ * @returns number of regressions, -1 if the baseline can't be read
+ */
+static int bench_compare(const char *path, const struct bench_result *results, int count,
+                         int tolerance)
+{
+    FILE *f = fopen(path, "r");
+    char line[512];
+    int regressions = 0, matched = 0;
+    int i;
+
+    if (!f) {
+        fprintf(stderr, "can't open baseline %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), f)) {
+        char name[64];
+        int frames;
+        double base;
+        char *p = strstr(line, "\"kernel\": \"");
+        char *q = strstr(line, "\"frames\": ");
+        char *r = strstr(line, "\"ns_per_frame\": ");
+
+        if (!p || !q || !r || sscanf(p + 11, "%63[^\"]", name) != 1
+                || sscanf(q + 10, "%d", &frames) != 1 || sscanf(r + 16, "%lf", &base) != 1)
+            continue;
+
+        for (i = 0; i < count; i++) {
+            double limit = base * (100 + tolerance) / 100;
+
+            if (strcmp(results[i].name, name) || results[i].frames != frames)
+                continue;
+            matched++;
+            if (results[i].ns_p50 > limit) {
+                fprintf(stderr, "REGRESSION %-24s %5d  %8.3f ns/frame, baseline %8.3f (+%.0f%%)\n",
+                       name, frames, results[i].ns_p50, base,
+                       (results[i].ns_p50 / base - 1) * 100);
+                regressions++;
+            }
+        }
+    }
+    fclose(f);
+
+    fprintf(stderr, "compared %d results against %s, %d regressions over %d%%\n",
+           matched, path, regressions, tolerance);
+    return regressions;
+}
+
+static int bench_parse_sizes(char *arg, int *sizes)
+{
+    int count = 0;
+    char *tok;
+
+    for (tok = strtok(arg, ","); tok && count < BENCH_SIZES_MAX; tok = strtok(NULL, ",")) {
+        sizes[count] = atoi(tok);
+        if (sizes[count] <= 0)
+            return -1;
+        count++;
+    }
+    return count;
+}
+
+static bool bench_selected(const char *name, int argc, char **argv)
+{
+    int i;
+
+    if (argc == 0)
+        return true;
+    for (i = 0; i < argc; i++)
+        if (!strcmp(argv[i], name))
+            return true;
+    return false;
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = BENCH_ITERATIONS_DEFAULT;
+    int tolerance = BENCH_TOLERANCE_DEFAULT;
+    int sizes[BENCH_SIZES_MAX];
+    int nsizes = sizeof(bench_sizes_default) / sizeof(bench_sizes_default[0]);
+    const char *json = NULL, *baseline = NULL, *cycles_source;
+    struct bench_result *results;
+    struct bench_ctx ctx;
+    int16_t *src;
+    int count = 0, ret = 0;
+    int i, s, k, max_frames = 0;
+
+    memcpy(sizes, bench_sizes_default, sizeof(bench_sizes_default));
+    for (i = 1; i < argc - 1 && argv[i][0] == '-'; i += 2) {
+        if (!strcmp(argv[i], "-n"))
+            iterations = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-f"))
+            nsizes = bench_parse_sizes(argv[i + 1], sizes);
+        else if (!strcmp(argv[i], "-j"))
+            json = argv[i + 1];
+        else if (!strcmp(argv[i], "-c"))
+            baseline = argv[i + 1];
+        else if (!strcmp(argv[i], "-t"))
+            tolerance = atoi(argv[i + 1]);
+        else
+            break;
+    }
+    if ((i < argc && argv[i][0] == '-') || iterations <= 0 || nsizes <= 0 || tolerance < 0) {
+        printf("usage: dsp_bench [-n iterations] [-f frames,...] [-j out.json|-]\n"
+               "                 [-c baseline.json] [-t tolerance_%%] [kernel...]\n");
+        printf("kernels:");
+        for (k = 0; k < BENCH_KERNELS; k++)
+            printf(" %s", bench_kernels[k].name);
+        printf("\n");
+        return -1;
+    }
+    argc -= i;
+    argv += i;
+
+    for (s = 0; s < nsizes; s++)
+        if (sizes[s] > max_frames)
+            max_frames = sizes[s];
+
+    /* stereo frames, room for the filter overlap, and twice that for the stereo up mix */
+    memset(&ctx, 0, sizeof(ctx));
+    src = malloc((max_frames * 2 + BENCH_FIR_TAPS) * sizeof(int16_t));
+    ctx.buf = malloc((max_frames * 2 + BENCH_FIR_TAPS) * sizeof(int16_t));
+    ctx.out = malloc(max_frames * 4 * sizeof(int16_t));
+    results = calloc(BENCH_KERNELS * nsizes, sizeof(*results));
+    ctx.down = speex_resampler_init(1, BENCH_RATE, BENCH_VOICE_RATE, SPEEX_RESAMPLER_QUALITY_DESKTOP, NULL);
+    ctx.up = speex_resampler_init(1, BENCH_VOICE_RATE, BENCH_RATE, SPEEX_RESAMPLER_QUALITY_DESKTOP, NULL);
+    if (!src || !ctx.buf || !ctx.out || !results || !ctx.down || !ctx.up) {
+        printf("out of memory\n");
+        ret = -1;
+        goto exit;
+    }
+
+    for (i = 0; i < max_frames * 2 + BENCH_FIR_TAPS; i++)
+        src[i] = (short)(sin(2 * M_PI * 440 * (i / 2) / BENCH_RATE) * 8000) + bench_noise(500);
+    initchnsta(ctx.chan);
+    setChanSta(ctx.chan, BENCH_RATE, 2);
+
+    cycles_source = bench_cycles_open();
+    if (!json || strcmp(json, "-"))
+        printf("%-24s %6s %12s %12s %12s   (%d iterations, cycles from %s)\n",
+               "kernel", "frames", "ns/frame", "min", "cycles/frame",
+               iterations, cycles_source ? cycles_source : "nowhere");
+
+    for (k = 0; k < BENCH_KERNELS; k++) {
+        if (!bench_selected(bench_kernels[k].name, argc, argv))
+            continue;
+        for (s = 0; s < nsizes; s++) {
+            struct bench_result *r = &results[count];
+
+            ctx.frames = sizes[s];
+            if (bench_run(&bench_kernels[k], &ctx, src, iterations, r) < 0) {
+                printf("out of memory\n");
+                ret = -1;
+                goto exit;
+            }
+            count++;
+            if (json && !strcmp(json, "-"))
+                continue;
+            printf("%-24s %6d %12.3f %12.3f ", r->name, r->frames, r->ns_p50, r->ns_min);
+            if (r->cycles_p50 >= 0)
+                printf("%12.2f\n", r->cycles_p50);
+            else
+                printf("%12s\n", "-");
+        }
+    }
+
+    if (json) {
+        FILE *f = strcmp(json, "-") ? fopen(json, "w") : stdout;
+
+        if (!f) {
+            printf("can't write %s: %s\n", json, strerror(errno));
+            ret = -1;
+            goto exit;
+        }
+        bench_json(f, results, count, iterations, cycles_source);
+        if (f != stdout)
+            fclose(f);
+    }
+    if (baseline && bench_compare(baseline, results, count, tolerance) != 0)
+        ret = 1;
+
+exit:
+    if (bench_cycles_fd >= 0)
+        close(bench_cycles_fd);
+    if (ctx.down)
+        speex_resampler_destroy(ctx.down);
+    if (ctx.up)
+        speex_resampler_destroy(ctx.up);
+    free(results);
+    free(ctx.out);
+    free(ctx.buf);
+    free(src);
+    return ret;
+}
@@ -0,0 +1,429 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file    hal_loopback.c
+ * @brief   measure the round trip latency of each output with a loopback
+ *
+ * Plays a maximum length sequence on an output, captures it back on an
+ * input through a cable from the headphone jack to the mic, or the
+ * host.pcm.loopback of the host build, and finds it in the capture by
+ * cross correlation. The round trip runs from the write() that handed the
+ * first sample of the burst to the hal to the moment the read() holding
+ * it would have returned if it stopped at that sample, so the size of the
+ * transfers of this tool doesn't count.
+ *
+ * Done for the low latency, deep buffer and hdmi outputs in turn, those
+ * the hal opens, and set against the latency out_get_latency() claims.
+ * What is left over is the analog path and the capture side, the input
+ * buffer is shown for reference: a read() of a whole buffer adds up to
+ * that much. The audio server must be stopped on a device.
+ *
+ * usage: hal_loopback [-r rate] [-n bursts] [-w ms] [-o device] [-i device]
+ *        -o and -i take AUDIO_DEVICE_* masks, the headset jack by default
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <hardware/audio.h>
+#include <hardware/hardware.h>
+
+#include "audio_stats.h"
+
+#define LOOP_RATE_DEFAULT   (44100)
+#define LOOP_BURSTS         (3)
+#define LOOP_WINDOW_MS      (1000)
+#define LOOP_WARMUP_MS      (500)
+#define LOOP_OUTPUTS        (3)
+#define LOOP_MLS_ORDER      (10)
+#define LOOP_MLS_LENGTH     ((1 << LOOP_MLS_ORDER) - 1)
+#define LOOP_MLS_TAPS       (0x240)         // x^10 + x^7 + 1
+#define LOOP_AMPLITUDE      (16384)         // -6 dBFS
+/* the correlation peak against its average over the window */
+#define LOOP_PEAK_RATIO     (8)
+
+/* a read() of the input, to date the samples it brought */
+struct loop_read {
+    size_t first;               // index of its first sample in the capture
+    unsigned frames;
+    int64_t end_ns;             // when it returned
+};
+
+/* first channel of everything the input read, filled by the reader thread */
+struct loop_capture {
+    pthread_mutex_t lock;
+    int16_t *samples;
+    size_t count;
+    size_t size;
+    struct loop_read *reads;
+    size_t nreads;
+    size_t reads_size;
+    bool stop;
+};
+
+static const struct {
+    const char *name;
+    audio_output_flags_t flags;
+    audio_channel_mask_t channel_mask;
+    bool hdmi;
+} loop_outputs[LOOP_OUTPUTS] = {
+    { "LOW_LATENCY", AUDIO_OUTPUT_FLAG_PRIMARY, AUDIO_CHANNEL_OUT_STEREO, false },
+    { "DEEP_BUF", AUDIO_OUTPUT_FLAG_DEEP_BUFFER, AUDIO_CHANNEL_OUT_STEREO, false },
+    { "HDMI_MULTI", AUDIO_OUTPUT_FLAG_DIRECT, AUDIO_CHANNEL_OUT_5POINT1, true },
+};
+
+static struct loop_capture capture = { .lock = PTHREAD_MUTEX_INITIALIZER };
+static int16_t mls[LOOP_MLS_LENGTH];
+
+static void loop_mls_init(void)
+{
+    unsigned lfsr = 1, i;
+
+    for (i = 0; i < LOOP_MLS_LENGTH; i++) {
+        mls[i] = (lfsr & 1) ? LOOP_AMPLITUDE : -LOOP_AMPLITUDE;
+        lfsr = (lfsr >> 1) ^ ((lfsr & 1) ? LOOP_MLS_TAPS : 0);
+    }
+}
+
+static void *loop_read_thread(void *arg)
+{
+    struct audio_stream_in *in = arg;
+    size_t bytes = in->common.get_buffer_size(&in->common);
+    size_t frame_size = audio_stream_in_frame_size(in);
+    unsigned frames = bytes / frame_size, i;
+    char *buffer = malloc(bytes);
+
+    while (buffer) {
+        struct loop_read *read;
+
+        if (in->read(in, buffer, bytes) < 0) {
+            usleep(10000);
+            continue;
+        }
+
+        pthread_mutex_lock(&capture.lock);
+        if (capture.stop) {
+            pthread_mutex_unlock(&capture.lock);
+            break;
+        }
+        if (capture.count + frames > capture.size) {
+            size_t size = capture.size * 2 + frames;
+            int16_t *samples = realloc(capture.samples, size * sizeof(*samples));
+
+            if (!samples) {
+                pthread_mutex_unlock(&capture.lock);
+                break;
+            }
+            capture.samples = samples;
+            capture.size = size;
+        }
+        if (capture.nreads == capture.reads_size) {
+            size_t size = capture.reads_size * 2 + 64;
+            struct loop_read *reads = realloc(capture.reads, size * sizeof(*reads));
+
+            if (!reads) {
+                pthread_mutex_unlock(&capture.lock);
+                break;
+            }
+            capture.reads = reads;
+            capture.reads_size = size;
+        }
+        read = &capture.reads[capture.nreads++];
+        read->first = capture.count;
+        read->frames = frames;
+        read->end_ns = audio_stats_now_ns();
+        for (i = 0; i < frames; i++)
+            capture.samples[capture.count++] = *(int16_t *)(buffer + i * frame_size);
+        pthread_mutex_unlock(&capture.lock);
+    }
+    free(buffer);
+    return NULL;
+}
+
+/**
+ * @brief loop_sample_ns
+ *        when the read of a sample would have returned had it ended there,
+ *        call with capture.lock held
+ *
+ * @returns the time, or 0 for a sample not read yet
+ */
+static int64_t loop_sample_ns(size_t index, unsigned rate)
+{
+    size_t lo = 0, hi = capture.nreads;
+
+    /* the last read starting at or before the sample */
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+
+        if (capture.reads[mid].first <= index)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    if (!capture.nreads || (index >= capture.reads[lo].first + capture.reads[lo].frames))
+        return 0;
+    return capture.reads[lo].end_ns -
+           (int64_t)(capture.reads[lo].first + capture.reads[lo].frames - 1 - index) *
+           1000000000LL / rate;
+}
+
+/**
+ * @brief loop_find
+ *        look for the burst in the samples captured after sent_ns
+ *
+ * @returns the round trip in ns, -1 if the burst isn't in there
+ */
+static int64_t loop_find(int64_t sent_ns, unsigned rate)
+{
+    size_t first, last, k, best = 0;
+    double peak = 0, sum = 0;
+    int64_t found_ns = -1;
+
+    pthread_mutex_lock(&capture.lock);
+    /* the first read that returned after the burst was sent */
+    for (k = capture.nreads; k > 0 && capture.reads[k - 1].end_ns > sent_ns; k--)
+        ;
+    if ((k == capture.nreads) || (capture.count < LOOP_MLS_LENGTH))
+        goto out;
+    first = capture.reads[k].first;
+    last = capture.count - LOOP_MLS_LENGTH;
+
+    for (k = first; k <= last; k++) {
+        const int16_t *x = capture.samples + k;
+        double corr = 0;
+        int i;
+
+        for (i = 0; i < LOOP_MLS_LENGTH; i++)
+            corr += (double)x[i] * mls[i];
+        if (corr < 0)
+            corr = -corr;
+        sum += corr;
+        if (corr > peak) {
+            peak = corr;
+            best = k;
+        }
+    }
+    if ((peak > 0) && (peak > LOOP_PEAK_RATIO * sum / (last - first + 1)))
+        found_ns = loop_sample_ns(best, rate) - sent_ns;
+out:
+    pthread_mutex_unlock(&capture.lock);
+    return found_ns;
+}
+
+/**
+ * @brief loop_write
+ *        write a buffer of the burst from sample burst_from on, then silence,
+ *        or only silence for a negative burst_from
+ *
+ * @returns the samples of the burst written, -1 on error
+ */
+static int loop_write(struct audio_stream_out *out, int16_t *buffer, size_t bytes,
+                      int burst_from)
+{
+    size_t channels = audio_stream_out_frame_size(out) / sizeof(int16_t);
+    size_t frames = bytes / audio_stream_out_frame_size(out), i, ch;
+    int written = 0;
+
+    for (i = 0; i < frames; i++) {
+        int16_t v = 0;
+
+        if ((burst_from >= 0) && (burst_from + written < LOOP_MLS_LENGTH))
+            v = mls[burst_from + written++];
+        for (ch = 0; ch < channels; ch++)
+            buffer[i * channels + ch] = v;
+    }
+    return out->write(out, buffer, bytes) < 0 ? -1 : written;
+}
+
+int main(int argc, char **argv)
+{
+    const struct hw_module_t *module;
+    struct audio_hw_device *adev;
+    struct audio_stream_in *in;
+    struct audio_config config;
+    pthread_t reader;
+    unsigned rate = LOOP_RATE_DEFAULT;
+    audio_devices_t out_device = AUDIO_DEVICE_OUT_WIRED_HEADPHONE;
+    audio_devices_t in_device = AUDIO_DEVICE_IN_WIRED_HEADSET;
+    int bursts = LOOP_BURSTS, window_ms = LOOP_WINDOW_MS;
+    double in_ms;
+    int opt, i, b, failed = 0;
+
+    while ((opt = getopt(argc, argv, "r:n:w:o:i:")) != -1) {
+        switch (opt) {
+        case 'r':
+            rate = atoi(optarg);
+            break;
+        case 'n':
+            bursts = atoi(optarg);
+            break;
+        case 'w':
+            window_ms = atoi(optarg);
+            break;
+        case 'o':
+            out_device = strtoul(optarg, NULL, 0);
+            break;
+        case 'i':
+            in_device = strtoul(optarg, NULL, 0);
+            break;
+        default:
+            printf("usage: hal_loopback [-r rate] [-n bursts] [-w ms] [-o device] [-i device]\n"
+                   "  -n  bursts per output, %d by default\n"
+                   "  -w  longest round trip looked for, %d ms by default\n",
+                   LOOP_BURSTS, LOOP_WINDOW_MS);
+            return -1;
+        }
+    }
+    if (!rate || (bursts <= 0) || (window_ms <= 0)) {
+        printf("rate, bursts and window must be positive\n");
+        return -1;
+    }
+    loop_mls_init();
+
+    if (hw_get_module_by_class(AUDIO_HARDWARE_MODULE_ID, AUDIO_HARDWARE_MODULE_ID_PRIMARY,
+                               &module) || audio_hw_device_open(module, &adev)) {
+        printf("can't open the primary hal\n");
+        return -1;
+    }
+
+    memset(&config, 0, sizeof(config));
+    config.sample_rate = rate;
+    config.channel_mask = AUDIO_CHANNEL_IN_STEREO;
+    config.format = AUDIO_FORMAT_PCM_16_BIT;
+    if (adev->open_input_stream(adev, 100, in_device, &config, &in, AUDIO_INPUT_FLAG_NONE, "",
+                                AUDIO_SOURCE_MIC)) {
+        printf("can't open the input\n");
+        audio_hw_device_close(adev);
+        return -1;
+    }
+    in_ms = in->common.get_buffer_size(&in->common) * 1000.0 /
+            audio_stream_in_frame_size(in) / in->common.get_sample_rate(&in->common);
+    pthread_create(&reader, NULL, loop_read_thread, in);
+
+    printf("%-12s %6s %10s %9s %28s %9s\n", "output", "rate", "get_lat ms", "input ms",
+           "round trip ms min/avg/max", "over ms");
+    for (i = 0; i < LOOP_OUTPUTS; i++) {
+        struct audio_stream_out *out;
+        int64_t min_ns = INT64_MAX, max_ns = 0, total_ns = 0;
+        uint32_t latency_ms;
+        unsigned out_rate;
+        int16_t *buffer;
+        size_t bytes;
+        int found = 0;
+
+        memset(&config, 0, sizeof(config));
+        config.sample_rate = rate;
+        config.channel_mask = loop_outputs[i].channel_mask;
+        config.format = AUDIO_FORMAT_PCM_16_BIT;
+        if (adev->open_output_stream(adev, 1 + i,
+                                     loop_outputs[i].hdmi ? AUDIO_DEVICE_OUT_AUX_DIGITAL : out_device,
+                                     loop_outputs[i].flags, &config, &out, "")) {
+            printf("%-12s doesn't open\n", loop_outputs[i].name);
+            continue;
+        }
+        /* the hdmi output opens unconfigured on a card without multi channel or bitstream */
+        out_rate = out->common.get_sample_rate(&out->common);
+        if (!out_rate) {
+            printf("%-12s not on this card\n", loop_outputs[i].name);
+            adev->close_output_stream(adev, out);
+            continue;
+        }
+        bytes = out->common.get_buffer_size(&out->common);
+        buffer = malloc(bytes);
+        latency_ms = out->get_latency(out);
+
+        for (b = 0; buffer && (b < bursts); b++) {
+            int64_t until, sent_ns, rt_ns;
+            int sent = 0, ret = 0;
+
+            /*
+             * silence until the stream is full and steady again, the search
+             * of the last burst may have let it run dry
+             */
+            until = audio_stats_now_ns() + LOOP_WARMUP_MS * 1000000LL;
+            while ((audio_stats_now_ns() < until) && (ret >= 0))
+                ret = loop_write(out, buffer, bytes, -1);
+
+            until = audio_stats_now_ns() + window_ms * 1000000LL;
+            sent_ns = audio_stats_now_ns();
+            while ((audio_stats_now_ns() < until) && (ret >= 0)) {
+                ret = loop_write(out, buffer, bytes, sent < LOOP_MLS_LENGTH ? sent : -1);
+                sent += ret;
+            }
+            rt_ns = loop_find(sent_ns, out_rate);
+            if (rt_ns < 0)
+                continue;
+            found++;
+            total_ns += rt_ns;
+            if (rt_ns < min_ns)
+                min_ns = rt_ns;
+            if (rt_ns > max_ns)
+                max_ns = rt_ns;
+        }
+
+        if (!found) {
+            printf("%-12s %6u %10u %9.1f %28s\n", loop_outputs[i].name, out_rate, latency_ms,
+                   in_ms, "no burst came back");
+            failed = 1;
+        } else {
+            char rt[32];
+            double avg_ms = total_ns / 1e6 / found;
+
+            snprintf(rt, sizeof(rt), "%.1f/%.1f/%.1f", min_ns / 1e6, avg_ms, max_ns / 1e6);
+            printf("%-12s %6u %10u %9.1f %28s %+8.1f%s\n", loop_outputs[i].name, out_rate,
+                   latency_ms, in_ms, rt, avg_ms - latency_ms,
+                   found < bursts ? "  (bursts lost)" : "");
+        }
+        adev->close_output_stream(adev, out);
+        free(buffer);
+    }
+
+    pthread_mutex_lock(&capture.lock);
+    capture.stop = true;
+    pthread_mutex_unlock(&capture.lock);
+    pthread_join(reader, NULL);
+    adev->close_input_stream(adev, in);
+    audio_hw_device_close(adev);
+    free(capture.samples);
+    free(capture.reads);
+    return failed;
+}
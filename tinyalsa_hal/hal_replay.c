@@ -0,0 +1,482 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file    hal_replay.c
+ * @brief   drive the hal with a journal of calls and compare the timings
+ *
+ * Replays the calls of a journal the hal recorded with media.audio.journal
+ * against the hal of this device, or the fake card of the host build: the
+ * same routing changes, standby cycles, parameter strings and transfer
+ * sizes, with the recorded audio when the journal has it and silence
+ * otherwise. Calls are spaced as recorded unless -f is given.
+ *
+ * Reports the time spent per entry point against the recording, and the
+ * calls that slowed down the most. With -c it fails when an entry point
+ * got slower on average than the tolerance, to bisect a regression with
+ * a trace taken in the field. The audio server must be stopped on a
+ * device, the hal is opened by this process.
+ *
+ * usage: hal_replay [-f] [-v] [-c tolerance_%] journal
+ */
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <hardware/audio.h>
+#include <hardware/hardware.h>
+
+#include "audio_journal.h"
+#include "audio_stats.h"
+
+#define REPLAY_WORST (8)
+/* slower than the tolerance and by more than this, a few us are noise */
+#define REPLAY_MIN_DELTA_US (50)
+
+struct replay_stream {
+    struct audio_stream_out *out;
+    struct audio_stream_in *in;
+};
+
+struct replay_op_stats {
+    unsigned calls;
+    unsigned ret_mismatch;      // failed on one side only
+    uint64_t rec_total_us;
+    uint64_t rep_total_us;
+    uint32_t rec_max_us;
+    uint32_t rep_max_us;
+};
+
+struct replay_worst {
+    unsigned index;             // of the record
+    unsigned op;
+    unsigned stream;
+    uint32_t rec_us;
+    uint32_t rep_us;
+};
+
+static float replay_float(uint32_t bits)
+{
+    float value;
+
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+/**
+ * @brief replay_load
+ *        read a journal and check its header
+ *
+ * @returns the file contents, free() them, or NULL
+ */
+static char *replay_load(const char *path, size_t *size)
+{
+    const struct audio_journal_header *header;
+    FILE *file = fopen(path, "rb");
+    char *data = NULL;
+    long len;
+
+    if (!file) {
+        printf("%s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    if ((fseek(file, 0, SEEK_END) < 0) || ((len = ftell(file)) < 0) ||
+        (fseek(file, 0, SEEK_SET) < 0))
+        goto err;
+    data = malloc(len ? len : 1);
+    if (!data || (fread(data, 1, len, file) != (size_t)len))
+        goto err;
+    fclose(file);
+
+    header = (const struct audio_journal_header *)data;
+    if (((size_t)len < sizeof(*header)) ||
+        memcmp(header->magic, AUDIO_JOURNAL_MAGIC, sizeof(header->magic)) ||
+        (header->version != AUDIO_JOURNAL_VERSION) ||
+        (header->record_size != sizeof(struct audio_journal_rec))) {
+        printf("%s: not a journal of this hal\n", path);
+        free(data);
+        return NULL;
+    }
+    *size = len;
+    return data;
+
+err:
+    printf("%s: can't read it\n", path);
+    free(data);
+    fclose(file);
+    return NULL;
+}
+
+/**
+ * @brief replay_next
+ *        the record at *offset, and the offset of the one after it
+ *
+ * @returns the record or NULL at the end, or on a truncated one
+ */
+static const struct audio_journal_rec *replay_next(const char *data, size_t size, size_t *offset)
+{
+    const struct audio_journal_rec *rec;
+
+    if (*offset + sizeof(*rec) > size)
+        return NULL;
+    rec = (const struct audio_journal_rec *)(data + *offset);
+    if (*offset + sizeof(*rec) + rec->size > size)
+        return NULL;
+    *offset += sizeof(*rec) + rec->size;
+    return rec;
+}
+
+/**
+ * @brief replay_call
+ *        make the call of a record
+ *
+ * @returns its result, -ENODEV if the stream it was made on didn't open
+ */
+static int replay_call(struct audio_hw_device *adev, const struct audio_journal_rec *rec,
+                       struct replay_stream *streams, char *buffer, size_t buffer_size)
+{
+    const char *payload = (const char *)(rec + 1);
+    struct replay_stream *s = &streams[rec->stream];
+    struct audio_config config;
+    char *text = NULL;
+    int ret = 0;
+
+    /* parameter strings are recorded without their terminator */
+    if ((rec->op != AJ_OUT_WRITE) && rec->size) {
+        memcpy(buffer, payload, rec->size);
+        buffer[rec->size] = '\0';
+        text = buffer;
+    }
+
+    switch (rec->op) {
+    case AJ_SET_PARAMETERS:
+        return adev->set_parameters(adev, text ? text : "");
+    case AJ_GET_PARAMETERS:
+        free(adev->get_parameters(adev, text ? text : ""));
+        return 0;
+    case AJ_SET_MODE:
+        return adev->set_mode(adev, (audio_mode_t)rec->arg[0]);
+    case AJ_SET_MIC_MUTE:
+        return adev->set_mic_mute(adev, rec->arg[0] != 0);
+    case AJ_SET_VOICE_VOLUME:
+        return adev->set_voice_volume(adev, replay_float(rec->arg[0]));
+    case AJ_SET_MASTER_VOLUME:
+        return adev->set_master_volume(adev, replay_float(rec->arg[0]));
+    case AJ_OPEN_OUTPUT:
+        memset(&config, 0, sizeof(config));
+        config.sample_rate = rec->arg[3];
+        config.channel_mask = rec->arg[4];
+        config.format = rec->arg[5];
+        ret = adev->open_output_stream(adev, (audio_io_handle_t)rec->arg[0], rec->arg[1],
+                                       (audio_output_flags_t)rec->arg[2], &config, &s->out, "");
+        if (ret)
+            s->out = NULL;
+        return ret;
+    case AJ_OPEN_INPUT:
+        memset(&config, 0, sizeof(config));
+        config.sample_rate = rec->arg[3];
+        config.channel_mask = rec->arg[4];
+        config.format = AUDIO_FORMAT_PCM_16_BIT;
+        ret = adev->open_input_stream(adev, (audio_io_handle_t)rec->arg[0], rec->arg[1], &config,
+                                      &s->in, (audio_input_flags_t)rec->arg[2], "",
+                                      (audio_source_t)rec->arg[5]);
+        if (ret)
+            s->in = NULL;
+        return ret;
+    }
+
+    /* the stream didn't open on this hal, or the journal began after it did */
+    if ((rec->op == AJ_CLOSE_INPUT) || (rec->op >= AJ_IN_READ)) {
+        if (!s->in)
+            return -ENODEV;
+    } else if (!s->out) {
+        return -ENODEV;
+    }
+
+    switch (rec->op) {
+    case AJ_CLOSE_OUTPUT:
+        adev->close_output_stream(adev, s->out);
+        s->out = NULL;
+        return 0;
+    case AJ_CLOSE_INPUT:
+        adev->close_input_stream(adev, s->in);
+        s->in = NULL;
+        return 0;
+    case AJ_OUT_WRITE: {
+        size_t bytes = rec->arg[0] < buffer_size ? rec->arg[0] : buffer_size;
+
+        if (rec->size)
+            memcpy(buffer, payload, rec->size < bytes ? rec->size : bytes);
+        else
+            memset(buffer, 0, bytes);
+        return (int)s->out->write(s->out, buffer, bytes);
+    }
+    case AJ_OUT_STANDBY:
+        return s->out->common.standby(&s->out->common);
+    case AJ_OUT_SET_PARAMETERS:
+        return s->out->common.set_parameters(&s->out->common, text ? text : "");
+    case AJ_OUT_GET_PARAMETERS:
+        free(s->out->common.get_parameters(&s->out->common, text ? text : ""));
+        return 0;
+    case AJ_OUT_SET_VOLUME:
+        return s->out->set_volume(s->out, replay_float(rec->arg[0]), replay_float(rec->arg[1]));
+    case AJ_OUT_GET_RENDER_POSITION: {
+        uint32_t frames;
+
+        return s->out->get_render_position(s->out, &frames);
+    }
+    case AJ_OUT_GET_PRESENTATION_POSITION: {
+        uint64_t frames;
+        struct timespec ts;
+
+        return s->out->get_presentation_position(s->out, &frames, &ts);
+    }
+    case AJ_IN_READ: {
+        size_t bytes = rec->arg[0] < buffer_size ? rec->arg[0] : buffer_size;
+
+        return (int)s->in->read(s->in, buffer, bytes);
+    }
+    case AJ_IN_STANDBY:
+        return s->in->common.standby(&s->in->common);
+    case AJ_IN_SET_PARAMETERS:
+        return s->in->common.set_parameters(&s->in->common, text ? text : "");
+    case AJ_IN_GET_PARAMETERS:
+        free(s->in->common.get_parameters(&s->in->common, text ? text : ""));
+        return 0;
+    case AJ_IN_SET_GAIN:
+        return s->in->set_gain(s->in, replay_float(rec->arg[0]));
+    }
+    return -EINVAL;
+}
+
+static void replay_worst_add(struct replay_worst *worst, int *count,
+                             const struct replay_worst *call)
+{
+    int i, slot = *count;
+
+    if (*count == REPLAY_WORST) {
+        /* replace the smallest slowdown if this one is bigger */
+        slot = 0;
+        for (i = 1; i < REPLAY_WORST; i++)
+            if ((int64_t)worst[i].rep_us - worst[i].rec_us <
+                (int64_t)worst[slot].rep_us - worst[slot].rec_us)
+                slot = i;
+        if ((int64_t)call->rep_us - call->rec_us <=
+            (int64_t)worst[slot].rep_us - worst[slot].rec_us)
+            return;
+    } else {
+        (*count)++;
+    }
+    worst[slot] = *call;
+}
+
+static int replay_worst_cmp(const void *a, const void *b)
+{
+    const struct replay_worst *wa = a, *wb = b;
+    int64_t da = (int64_t)wa->rep_us - wa->rec_us;
+    int64_t db = (int64_t)wb->rep_us - wb->rec_us;
+
+    return da < db ? 1 : da > db ? -1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    const struct audio_journal_header *header;
+    const struct audio_journal_rec *rec;
+    const struct hw_module_t *module;
+    struct audio_hw_device *adev;
+    struct replay_stream *streams;
+    struct replay_op_stats stats[AJ_OPS];
+    struct replay_worst worst[REPLAY_WORST];
+    unsigned max_stream = 0, index = 0, skipped = 0;
+    size_t size, offset, buffer_size = 1;
+    int64_t start_ns, late_ns = 0;
+    int tolerance = -1, nworst = 0, failed = 0;
+    bool fast = false, verbose = false;
+    char *data, *buffer;
+    int i, op;
+
+    for (i = 1; i < argc - 1 && argv[i][0] == '-'; i++) {
+        if (!strcmp(argv[i], "-f"))
+            fast = true;
+        else if (!strcmp(argv[i], "-v"))
+            verbose = true;
+        else if (!strcmp(argv[i], "-c") && (i < argc - 2))
+            tolerance = atoi(argv[++i]);
+        else
+            break;
+    }
+    if (i != argc - 1) {
+        printf("usage: hal_replay [-f] [-v] [-c tolerance_%%] journal\n"
+               "  -f  call as fast as the hal allows, not as spaced in the journal\n"
+               "  -v  print every call\n"
+               "  -c  fail if an entry point is slower on average than recorded by more\n"
+               "      than tolerance_%%\n");
+        return -1;
+    }
+
+    data = replay_load(argv[i], &size);
+    if (!data)
+        return -1;
+    header = (const struct audio_journal_header *)data;
+
+    /* size the stream table and the transfer buffer */
+    offset = sizeof(*header);
+    while ((rec = replay_next(data, size, &offset)) != NULL) {
+        if (rec->stream > max_stream)
+            max_stream = rec->stream;
+        if (((rec->op == AJ_OUT_WRITE) || (rec->op == AJ_IN_READ)) && (rec->arg[0] > buffer_size))
+            buffer_size = rec->arg[0];
+        if (rec->size + 1 > buffer_size)
+            buffer_size = rec->size + 1;
+    }
+    streams = calloc(max_stream + 1, sizeof(*streams));
+    buffer = malloc(buffer_size);
+    if (!streams || !buffer) {
+        printf("out of memory\n");
+        return -1;
+    }
+
+    if (hw_get_module_by_class(AUDIO_HARDWARE_MODULE_ID, AUDIO_HARDWARE_MODULE_ID_PRIMARY,
+                               &module) || audio_hw_device_open(module, &adev)) {
+        printf("can't open the primary hal\n");
+        return -1;
+    }
+
+    memset(stats, 0, sizeof(stats));
+    start_ns = audio_stats_now_ns();
+    offset = sizeof(*header);
+    for (; (rec = replay_next(data, size, &offset)) != NULL; index++) {
+        struct replay_worst call;
+        int64_t call_ns;
+        int ret;
+
+        if ((rec->op == 0) || (rec->op >= AJ_OPS)) {
+            skipped++;
+            continue;
+        }
+        if (!fast) {
+            int64_t wait_ns = start_ns + rec->ns - audio_stats_now_ns();
+
+            if (wait_ns > 0) {
+                struct timespec ts = { wait_ns / 1000000000LL, wait_ns % 1000000000LL };
+
+                nanosleep(&ts, NULL);
+            } else {
+                late_ns = -wait_ns;
+            }
+        }
+
+        call_ns = audio_stats_now_ns();
+        ret = replay_call(adev, rec, streams, buffer, buffer_size);
+        call_ns = audio_stats_now_ns() - call_ns;
+        if (ret == -ENODEV) {
+            skipped++;
+            continue;
+        }
+
+        stats[rec->op].calls++;
+        stats[rec->op].rec_total_us += rec->dur_us;
+        stats[rec->op].rep_total_us += call_ns / 1000;
+        if (rec->dur_us > stats[rec->op].rec_max_us)
+            stats[rec->op].rec_max_us = rec->dur_us;
+        if (call_ns / 1000 > stats[rec->op].rep_max_us)
+            stats[rec->op].rep_max_us = call_ns / 1000;
+        if ((ret < 0) != (rec->ret < 0))
+            stats[rec->op].ret_mismatch++;
+
+        call.index = index;
+        call.op = rec->op;
+        call.stream = rec->stream;
+        call.rec_us = rec->dur_us;
+        call.rep_us = call_ns / 1000;
+        replay_worst_add(worst, &nworst, &call);
+
+        if (verbose)
+            printf("%6u %10.3f ms  %-30s %2u  %8u -> %8u us  ret %d/%d\n", index,
+                   rec->ns / 1e6, audio_journal_op_name(rec->op), rec->stream, rec->dur_us,
+                   call.rep_us, rec->ret, ret);
+    }
+
+    /* close what the journal left open, the hal would complain otherwise */
+    for (i = 0; i <= (int)max_stream; i++) {
+        if (streams[i].out)
+            adev->close_output_stream(adev, streams[i].out);
+        if (streams[i].in)
+            adev->close_input_stream(adev, streams[i].in);
+    }
+    audio_hw_device_close(adev);
+
+    printf("%u calls replayed in %.1f ms, %u skipped%s, last call %.1f ms late\n", index - skipped,
+           (audio_stats_now_ns() - start_ns) / 1e6, skipped,
+           (header->flags & AUDIO_JOURNAL_DATA) ? ", recorded audio" : ", silence",
+           late_ns / 1e6);
+    printf("%-30s %6s %10s %10s %10s %10s %7s %5s\n", "call", "count", "rec avg", "replay avg",
+           "rec max", "replay max", "change", "ret!=");
+    for (op = 1; op < AJ_OPS; op++) {
+        const struct replay_op_stats *s = &stats[op];
+        double rec_avg, rep_avg, change;
+
+        if (!s->calls)
+            continue;
+        rec_avg = (double)s->rec_total_us / s->calls;
+        rep_avg = (double)s->rep_total_us / s->calls;
+        change = rec_avg > 0 ? (rep_avg - rec_avg) * 100 / rec_avg : 0;
+        printf("%-30s %6u %10.1f %10.1f %10u %10u %6.1f%% %5u", audio_journal_op_name(op),
+               s->calls, rec_avg, rep_avg, s->rec_max_us, s->rep_max_us, change, s->ret_mismatch);
+        if ((tolerance >= 0) && (change > tolerance) && (rep_avg - rec_avg > REPLAY_MIN_DELTA_US)) {
+            printf("  SLOWER");
+            failed = 1;
+        }
+        printf("\n");
+    }
+
+    qsort(worst, nworst, sizeof(worst[0]), replay_worst_cmp);
+    printf("slowed down the most:\n");
+    for (i = 0; i < nworst; i++)
+        printf("  #%-6u %-30s stream %-2u %8u -> %8u us\n", worst[i].index,
+               audio_journal_op_name(worst[i].op), worst[i].stream, worst[i].rec_us,
+               worst[i].rep_us);
+
+    free(buffer);
+    free(streams);
+    free(data);
+    return failed;
+}
@@ -0,0 +1,527 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file    hal_stress.c
+ * @brief   write through the hal while other threads fight for its locks
+ *
+ * Opens every output the hal accepts (deep buffer, primary and the hdmi
+ * one when the card has it) and one input, and keeps them busy the way
+ * the audio server would. After a quiet baseline, more threads change the
+ * routing of the outputs, set and get device and stream parameters and put
+ * streams in standby, all of which take lock_all_outputs() or adev->lock
+ * while the writers run.
+ *
+ * Reports the time write() blocked, max and p99.9, with and without the
+ * other threads, so what is left is the cost of the lock contention; the
+ * stream dumps add how long write() and read() waited for the locks
+ * themselves. A call that doesn't come back within -t ms is reported with
+ * the calls the other threads are stuck in, and the tool exits with 2.
+ * Lock order inversions are found by the thread sanitizer build of the
+ * host, see host/Makefile. The audio server must be stopped on a device.
+ *
+ * usage: hal_stress [-d ms] [-b ms] [-i ms] [-n outputs] [-t ms] [-l us] [-v]
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <hardware/audio.h>
+#include <hardware/hardware.h>
+
+#include "audio_stats.h"
+
+#define STRESS_MS_DEFAULT       (5000)
+#define STRESS_BASELINE_MS      (2000)
+#define STRESS_INTERVAL_MS      (5)
+#define STRESS_TIMEOUT_MS       (2000)
+#define STRESS_OUTPUTS          (3)
+
+enum stress_phase {
+    PHASE_BASELINE,
+    PHASE_STRESS,
+    PHASE_STOP,
+};
+
+/* a thread and the hal call it is in, read by the watchdog */
+struct stress_thread {
+    pthread_t thread;
+    char name[24];
+    const char *call;           // NULL between calls
+    int64_t since_ns;
+    unsigned calls;
+    unsigned errors;
+    uint32_t max_us;
+};
+
+/* write() or read() times of a phase, in us */
+struct stress_samples {
+    int64_t *us;
+    size_t count;
+    size_t size;
+};
+
+struct stress_output {
+    const char *name;
+    audio_output_flags_t flags;
+    audio_devices_t devices;
+    audio_channel_mask_t channel_mask;
+    struct audio_stream_out *stream;
+    struct stress_thread writer;
+    struct stress_samples samples[PHASE_STOP];
+};
+
+static const struct {
+    const char *name;
+    audio_output_flags_t flags;
+    audio_devices_t devices;
+    audio_channel_mask_t channel_mask;
+} stress_output_kinds[STRESS_OUTPUTS] = {
+    { "primary", AUDIO_OUTPUT_FLAG_PRIMARY, AUDIO_DEVICE_OUT_SPEAKER, AUDIO_CHANNEL_OUT_STEREO },
+    { "deep buffer", AUDIO_OUTPUT_FLAG_DEEP_BUFFER, AUDIO_DEVICE_OUT_SPEAKER,
+      AUDIO_CHANNEL_OUT_STEREO },
+    { "hdmi", AUDIO_OUTPUT_FLAG_DIRECT, AUDIO_DEVICE_OUT_AUX_DIGITAL, AUDIO_CHANNEL_OUT_5POINT1 },
+};
+
+/* the routes the routing thread moves the outputs between */
+static const audio_devices_t stress_routes[] = {
+    AUDIO_DEVICE_OUT_SPEAKER,
+    AUDIO_DEVICE_OUT_WIRED_HEADPHONE,
+    AUDIO_DEVICE_OUT_SPEAKER | AUDIO_DEVICE_OUT_WIRED_HEADPHONE,
+};
+
+static struct audio_hw_device *adev;
+static struct stress_output outputs[STRESS_OUTPUTS];
+static int noutputs;
+static struct audio_stream_in *input;
+static struct stress_thread reader;
+static struct stress_samples read_samples[PHASE_STOP];
+static struct stress_thread routing, params, standby;
+static int phase;
+static int interval_ms = STRESS_INTERVAL_MS;
+
+static void stress_sleep_ms(int ms)
+{
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+
+    nanosleep(&ts, NULL);
+}
+
+static int stress_phase(void)
+{
+    return __atomic_load_n(&phase, __ATOMIC_ACQUIRE);
+}
+
+static void stress_enter(struct stress_thread *t, const char *call)
+{
+    __atomic_store_n(&t->call, call, __ATOMIC_RELAXED);
+    __atomic_store_n(&t->since_ns, audio_stats_now_ns(), __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief stress_leave
+ *        the call of stress_enter() returned ret
+ *
+ * @returns how long it took, in us
+ */
+static uint32_t stress_leave(struct stress_thread *t, int ret)
+{
+    int64_t since = __atomic_load_n(&t->since_ns, __ATOMIC_RELAXED);
+    uint32_t us = (audio_stats_now_ns() - since) / 1000;
+
+    __atomic_store_n(&t->since_ns, 0, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&t->calls, 1, __ATOMIC_RELAXED);
+    if (ret < 0)
+        __atomic_add_fetch(&t->errors, 1, __ATOMIC_RELAXED);
+    if (us > __atomic_load_n(&t->max_us, __ATOMIC_RELAXED))
+        __atomic_store_n(&t->max_us, us, __ATOMIC_RELAXED);
+    return us;
+}
+
+static void stress_sample(struct stress_samples *samples, uint32_t us)
+{
+    if (samples->count == samples->size) {
+        size_t size = samples->size ? samples->size * 2 : 1024;
+        int64_t *grown = realloc(samples->us, size * sizeof(*grown));
+
+        if (!grown)
+            return;
+        samples->us = grown;
+        samples->size = size;
+    }
+    samples->us[samples->count++] = us;
+}
+
+/**
+ * @brief stress_percentile
+ *        the sample under which permille of them are, sorts them
+ */
+static uint32_t stress_percentile(struct stress_samples *samples, unsigned permille)
+{
+    audio_stats_sort(samples->us, samples->count);
+    return (uint32_t)audio_stats_percentile(samples->us, samples->count, permille);
+}
+
+static void *stress_write_loop(void *arg)
+{
+    struct stress_output *o = arg;
+    size_t bytes = o->stream->common.get_buffer_size(&o->stream->common);
+    char *buffer = calloc(1, bytes);
+    int p;
+
+    while (buffer && ((p = stress_phase()) != PHASE_STOP)) {
+        int ret;
+
+        stress_enter(&o->writer, "write");
+        ret = (int)o->stream->write(o->stream, buffer, bytes);
+        stress_sample(&o->samples[p], stress_leave(&o->writer, ret));
+        if (ret < 0)
+            stress_sleep_ms(10);
+    }
+    free(buffer);
+    return NULL;
+}
+
+static void *stress_read_loop(void *arg)
+{
+    size_t bytes = input->common.get_buffer_size(&input->common);
+    char *buffer = malloc(bytes);
+    int p;
+
+    while (buffer && ((p = stress_phase()) != PHASE_STOP)) {
+        int ret;
+
+        stress_enter(&reader, "read");
+        ret = (int)input->read(input, buffer, bytes);
+        stress_sample(&read_samples[p], stress_leave(&reader, ret));
+        if (ret < 0)
+            stress_sleep_ms(10);
+    }
+    free(buffer);
+    return NULL;
+}
+
+/* out_set_parameters() takes lock_all_outputs() */
+static void *stress_routing_loop(void *arg)
+{
+    unsigned n;
+
+    for (n = 0; stress_phase() != PHASE_STOP; n++) {
+        struct stress_output *o = &outputs[n % noutputs];
+        char kvpairs[64];
+
+        if (o->devices != AUDIO_DEVICE_OUT_AUX_DIGITAL) {
+            snprintf(kvpairs, sizeof(kvpairs), "%s=%u", AUDIO_PARAMETER_STREAM_ROUTING,
+                     stress_routes[(n / noutputs) % (sizeof(stress_routes) / sizeof(stress_routes[0]))]);
+            stress_enter(&routing, "out_set_parameters routing");
+            stress_leave(&routing, o->stream->common.set_parameters(&o->stream->common, kvpairs));
+        }
+        stress_sleep_ms(interval_ms);
+    }
+    return NULL;
+}
+
+/* adev_set_parameters() takes adev->lock, the getters whatever they need */
+static void *stress_params_loop(void *arg)
+{
+    unsigned n;
+
+    for (n = 0; stress_phase() != PHASE_STOP; n++) {
+        struct stress_output *o = &outputs[n % noutputs];
+
+        switch (n % 4) {
+        case 0:
+            stress_enter(&params, "adev_set_parameters");
+            stress_leave(&params, adev->set_parameters(adev, "screen_state=on"));
+            break;
+        case 1:
+            stress_enter(&params, "adev_get_parameters");
+            free(adev->get_parameters(adev, "ec_supported"));
+            stress_leave(&params, 0);
+            break;
+        case 2:
+            stress_enter(&params, "out_get_parameters");
+            free(o->stream->common.get_parameters(&o->stream->common,
+                                                  AUDIO_PARAMETER_STREAM_SUP_CHANNELS));
+            stress_leave(&params, 0);
+            break;
+        default:
+            if (!input)
+                break;
+            stress_enter(&params, "in_get_parameters");
+            free(input->common.get_parameters(&input->common, AUDIO_PARAMETER_STREAM_ROUTING));
+            stress_leave(&params, 0);
+            break;
+        }
+        stress_sleep_ms(interval_ms);
+    }
+    return NULL;
+}
+
+/* out_standby() takes lock_all_outputs(), the next write starts the stream again */
+static void *stress_standby_loop(void *arg)
+{
+    unsigned n;
+
+    for (n = 0; stress_phase() != PHASE_STOP; n++) {
+        struct stress_output *o = &outputs[n % noutputs];
+
+        stress_enter(&standby, "out_standby");
+        stress_leave(&standby, o->stream->common.standby(&o->stream->common));
+        if (input && !(n % 4)) {
+            stress_enter(&standby, "in_standby");
+            stress_leave(&standby, input->common.standby(&input->common));
+        }
+        /* give the writers time to get going again */
+        stress_sleep_ms(interval_ms * 10);
+    }
+    return NULL;
+}
+
+/**
+ * @brief stress_stuck
+ *        the threads in a call for longer than timeout_ms
+ *
+ * @returns how many, printed along with the call they are in
+ */
+static int stress_stuck(struct stress_thread **threads, int count, int timeout_ms, bool print)
+{
+    int64_t now = audio_stats_now_ns();
+    int i, stuck = 0;
+
+    for (i = 0; i < count; i++) {
+        int64_t since = __atomic_load_n(&threads[i]->since_ns, __ATOMIC_ACQUIRE);
+        const char *call = __atomic_load_n(&threads[i]->call, __ATOMIC_RELAXED);
+
+        if (!since || (now - since < timeout_ms * 1000000LL))
+            continue;
+        stuck++;
+        if (print)
+            printf("  %-12s in %s for %lld ms\n", threads[i]->name, call,
+                   (long long)((now - since) / 1000000));
+    }
+    return stuck;
+}
+
+static void stress_print_samples(const char *name, const char *phase_name,
+                                 struct stress_samples *samples)
+{
+    uint32_t p99 = stress_percentile(samples, 990);
+    uint32_t p999 = stress_percentile(samples, 999);
+
+    printf("  %-12s %-9s %8zu %10u %10u %10u\n", name, phase_name, samples->count, p99, p999,
+           (uint32_t)audio_stats_percentile(samples->us, samples->count, 1000));
+}
+
+int main(int argc, char **argv)
+{
+    const struct hw_module_t *module;
+    struct stress_thread *threads[STRESS_OUTPUTS + 4];
+    struct audio_config config;
+    int duration_ms = STRESS_MS_DEFAULT, baseline_ms = STRESS_BASELINE_MS;
+    int timeout_ms = STRESS_TIMEOUT_MS, max_outputs = STRESS_OUTPUTS, limit_us = -1;
+    int nthreads = 0, opt, i, waited, failed = 0;
+    bool verbose = false;
+    int64_t stress_ns;
+
+    while ((opt = getopt(argc, argv, "d:b:i:n:t:l:v")) != -1) {
+        switch (opt) {
+        case 'd':
+            duration_ms = atoi(optarg);
+            break;
+        case 'b':
+            baseline_ms = atoi(optarg);
+            break;
+        case 'i':
+            interval_ms = atoi(optarg) > 0 ? atoi(optarg) : 1;
+            break;
+        case 'n':
+            max_outputs = atoi(optarg);
+            break;
+        case 't':
+            timeout_ms = atoi(optarg) > 0 ? atoi(optarg) : STRESS_TIMEOUT_MS;
+            break;
+        case 'l':
+            limit_us = atoi(optarg);
+            break;
+        case 'v':
+            verbose = true;
+            break;
+        default:
+            printf("usage: hal_stress [-d ms] [-b ms] [-i ms] [-n outputs] [-t ms] [-l us] [-v]\n"
+                   "  -d  stress for that long, %d ms by default\n"
+                   "  -b  write without the other threads first, %d ms by default\n"
+                   "  -i  pause between the calls of the other threads, %d ms by default\n"
+                   "  -n  open at most that many outputs\n"
+                   "  -t  report a deadlock when a call takes that long, %d ms by default\n"
+                   "  -l  fail if the p99.9 of write() grew by more than that under stress\n"
+                   "  -v  dump the streams at the end\n",
+                   STRESS_MS_DEFAULT, STRESS_BASELINE_MS, STRESS_INTERVAL_MS, STRESS_TIMEOUT_MS);
+            return -1;
+        }
+    }
+
+    if (hw_get_module_by_class(AUDIO_HARDWARE_MODULE_ID, AUDIO_HARDWARE_MODULE_ID_PRIMARY,
+                               &module) || audio_hw_device_open(module, &adev)) {
+        printf("can't open the primary hal\n");
+        return -1;
+    }
+
+    for (i = 0; (i < STRESS_OUTPUTS) && (noutputs < max_outputs); i++) {
+        struct stress_output *o = &outputs[noutputs];
+
+        memset(&config, 0, sizeof(config));
+        config.sample_rate = 44100;
+        config.channel_mask = stress_output_kinds[i].channel_mask;
+        config.format = AUDIO_FORMAT_PCM_16_BIT;
+        if (adev->open_output_stream(adev, 1 + i, stress_output_kinds[i].devices,
+                                     stress_output_kinds[i].flags, &config, &o->stream, "")) {
+            printf("%s output: doesn't open, left out\n", stress_output_kinds[i].name);
+            continue;
+        }
+        o->name = stress_output_kinds[i].name;
+        o->flags = stress_output_kinds[i].flags;
+        o->devices = stress_output_kinds[i].devices;
+        o->channel_mask = stress_output_kinds[i].channel_mask;
+        snprintf(o->writer.name, sizeof(o->writer.name), "%s", o->name);
+        threads[nthreads++] = &o->writer;
+        noutputs++;
+    }
+    if (!noutputs) {
+        printf("no output opened\n");
+        return -1;
+    }
+
+    memset(&config, 0, sizeof(config));
+    config.sample_rate = 44100;
+    config.channel_mask = AUDIO_CHANNEL_IN_STEREO;
+    config.format = AUDIO_FORMAT_PCM_16_BIT;
+    if (adev->open_input_stream(adev, 100, AUDIO_DEVICE_IN_BUILTIN_MIC, &config, &input,
+                                AUDIO_INPUT_FLAG_NONE, "", AUDIO_SOURCE_MIC)) {
+        printf("input: doesn't open, left out\n");
+        input = NULL;
+    } else {
+        snprintf(reader.name, sizeof(reader.name), "input");
+        threads[nthreads++] = &reader;
+    }
+
+    for (i = 0; i < noutputs; i++)
+        pthread_create(&outputs[i].writer.thread, NULL, stress_write_loop, &outputs[i]);
+    if (input)
+        pthread_create(&reader.thread, NULL, stress_read_loop, NULL);
+
+    /* the watchdog runs on this thread, the phases change here too */
+    stress_ns = audio_stats_now_ns() + baseline_ms * 1000000LL;
+    for (waited = 0; ; waited += 50) {
+        if ((stress_phase() == PHASE_BASELINE) && (audio_stats_now_ns() >= stress_ns)) {
+            snprintf(routing.name, sizeof(routing.name), "routing");
+            snprintf(params.name, sizeof(params.name), "parameters");
+            snprintf(standby.name, sizeof(standby.name), "standby");
+            threads[nthreads++] = &routing;
+            threads[nthreads++] = &params;
+            threads[nthreads++] = &standby;
+            __atomic_store_n(&phase, PHASE_STRESS, __ATOMIC_RELEASE);
+            pthread_create(&routing.thread, NULL, stress_routing_loop, NULL);
+            pthread_create(&params.thread, NULL, stress_params_loop, NULL);
+            pthread_create(&standby.thread, NULL, stress_standby_loop, NULL);
+        }
+        if ((stress_phase() == PHASE_STRESS) &&
+            (audio_stats_now_ns() >= stress_ns + duration_ms * 1000000LL))
+            break;
+        if (stress_stuck(threads, nthreads, timeout_ms, false)) {
+            printf("deadlock: no return within %d ms\n", timeout_ms);
+            stress_stuck(threads, nthreads, timeout_ms, true);
+            /* the dumps only try the locks */
+            adev->dump(adev, STDOUT_FILENO);
+            fflush(stdout);
+            _exit(2);
+        }
+        stress_sleep_ms(50);
+    }
+
+    __atomic_store_n(&phase, PHASE_STOP, __ATOMIC_RELEASE);
+    for (i = 0; i < nthreads; i++)
+        pthread_join(threads[i]->thread, NULL);
+
+    printf("%d outputs%s, %d ms baseline, %d ms under stress, calls every %d ms\n", noutputs,
+           input ? " and an input" : "", baseline_ms, duration_ms, interval_ms);
+    printf("  %-12s %-9s %8s %10s %10s %10s\n", "stream", "phase", "calls", "p99 us",
+           "p99.9 us", "max us");
+    for (i = 0; i < noutputs; i++) {
+        struct stress_output *o = &outputs[i];
+        uint32_t base_p999 = stress_percentile(&o->samples[PHASE_BASELINE], 999);
+
+        stress_print_samples(o->name, "baseline", &o->samples[PHASE_BASELINE]);
+        stress_print_samples(o->name, "stress", &o->samples[PHASE_STRESS]);
+        if ((limit_us >= 0) && o->samples[PHASE_STRESS].count &&
+            (stress_percentile(&o->samples[PHASE_STRESS], 999) > base_p999 + limit_us)) {
+            printf("  %-12s p99.9 of write() grew by more than %d us\n", o->name, limit_us);
+            failed = 1;
+        }
+    }
+    if (input) {
+        stress_print_samples("input", "baseline", &read_samples[PHASE_BASELINE]);
+        stress_print_samples("input", "stress", &read_samples[PHASE_STRESS]);
+    }
+    printf("  %-12s %8s %8s %10s\n", "thread", "calls", "errors", "max us");
+    for (i = 0; i < nthreads; i++)
+        printf("  %-12s %8u %8u %10u\n", threads[i]->name, threads[i]->calls, threads[i]->errors,
+               threads[i]->max_us);
+
+    if (verbose) {
+        for (i = 0; i < noutputs; i++)
+            outputs[i].stream->common.dump(&outputs[i].stream->common, STDOUT_FILENO);
+        if (input)
+            input->common.dump(&input->common, STDOUT_FILENO);
+    }
+
+    for (i = 0; i < noutputs; i++) {
+        adev->close_output_stream(adev, outputs[i].stream);
+        free(outputs[i].samples[PHASE_BASELINE].us);
+        free(outputs[i].samples[PHASE_STRESS].us);
+    }
+    if (input)
+        adev->close_input_stream(adev, input);
+    free(read_samples[PHASE_BASELINE].us);
+    free(read_samples[PHASE_STRESS].us);
+    audio_hw_device_close(adev);
+    return failed;
+}
@@ -0,0 +1,755 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file    fake_ctl.c
+ * @brief   in memory sound card control devices for the host build
+ *
+ * Linked with -Wl,--wrap=open,--wrap=open64,--wrap=close,--wrap=ioctl.
+ * Everything that is not a control device goes to the libc calls.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cutils/log.h>
+#include <cutils/properties.h>
+
+#define __force
+#define __bitwise
+#define __user
+#include "asound.h"
+
+#include "codec_config/route_table_packed.h"
+#include "fake_ctl.h"
+
+#define FAKE_CTL_PATH       "/dev/snd/controlC%u"
+#define FAKE_CTL_CLIENTS    32
+#define FAKE_CTL_ITEMS      32
+#define FAKE_CTL_DB_STEP    150     // 1.5 dB per step, in 0.01 dB
+
+struct fake_elem {
+    struct snd_ctl_elem_info info;
+    long long value[2];
+    char (*enames)[64];
+};
+
+struct fake_card {
+    int populated;
+    struct fake_elem *elems;
+    unsigned count;
+    unsigned space;
+    unsigned writes;
+    unsigned write_us;
+    char id[16];            // CARD_INFO id, HOSTFAKE<n> when empty
+};
+
+struct fake_client {
+    int fd;                 // given to the hal
+    int peer;               // events are sent here
+    unsigned card;
+    int subscribed;
+};
+
+static struct fake_card fake_cards[FAKE_CTL_CARDS];
+static struct fake_client fake_clients[FAKE_CTL_CLIENTS];
+static unsigned fake_client_count;
+static pthread_mutex_t fake_lock = PTHREAD_MUTEX_INITIALIZER;
+
+int __real_open(const char *path, int flags, ...);
+int __real_open64(const char *path, int flags, ...);
+int __real_close(int fd);
+int __real_ioctl(int fd, unsigned long request, ...);
+
+static struct fake_elem *fake_elem_find(struct fake_card *card, const char *name)
+{
+    unsigned n;
+
+    for (n = 0; n < card->count; n++) {
+        if (!strcmp((const char *)card->elems[n].info.id.name, name))
+            return card->elems + n;
+    }
+    return NULL;
+}
+
+static struct fake_elem *fake_elem_numid(struct fake_card *card, const struct snd_ctl_elem_id *id)
+{
+    if (id->numid)
+        return (id->numid <= card->count) ? card->elems + id->numid - 1 : NULL;
+    return fake_elem_find(card, (const char *)id->name);
+}
+
+/**
+ * @brief fake_elem_add
+ *        must be called with fake_lock held
+ *
+ * @returns the new control or NULL, errno is set
+ */
+static struct fake_elem *fake_elem_add(unsigned card_no, const char *name, int type,
+                                       unsigned count)
+{
+    struct fake_card *card;
+    struct fake_elem *elem;
+
+    if ((card_no >= FAKE_CTL_CARDS) || !name || !*name || (count < 1) || (count > 2)) {
+        errno = EINVAL;
+        return NULL;
+    }
+    card = fake_cards + card_no;
+    if (fake_elem_find(card, name)) {
+        errno = EEXIST;
+        return NULL;
+    }
+    if (card->count == card->space) {
+        unsigned space = card->space ? card->space * 2 : 64;
+
+        elem = realloc(card->elems, space * sizeof(*elem));
+        if (!elem) {
+            errno = ENOMEM;
+            return NULL;
+        }
+        card->elems = elem;
+        card->space = space;
+    }
+
+    elem = card->elems + card->count++;
+    memset(elem, 0, sizeof(*elem));
+    elem->info.id.numid = card->count;
+    elem->info.id.iface = SNDRV_CTL_ELEM_IFACE_MIXER;
+    strncpy((char *)elem->info.id.name, name, sizeof(elem->info.id.name) - 1);
+    elem->info.type = type;
+    elem->info.access = SNDRV_CTL_ELEM_ACCESS_READWRITE;
+    elem->info.count = count;
+    return elem;
+}
+
+static int fake_elem_add_int(unsigned card, const char *name, unsigned count, long min, long max,
+                             long value)
+{
+    struct fake_elem *elem;
+
+    if (min > max)
+        return -EINVAL;
+    elem = fake_elem_add(card, name, SNDRV_CTL_ELEM_TYPE_INTEGER, count);
+    if (!elem)
+        return -errno;
+    elem->info.value.integer.min = min;
+    elem->info.value.integer.max = max;
+    elem->info.value.integer.step = 1;
+    // volumes get a dB scale ending at 0 dB, as the codec drivers declare
+    if (strstr(name, "Volume"))
+        elem->info.access |= SNDRV_CTL_ELEM_ACCESS_TLV_READ;
+    elem->value[0] = elem->value[1] = value < min ? min : value > max ? max : value;
+    return 0;
+}
+
+static int fake_elem_add_enum(unsigned card, const char *name, const char * const *items,
+                              unsigned nitems, unsigned value)
+{
+    struct fake_elem *elem;
+    unsigned i;
+
+    if (!nitems || (value >= nitems))
+        return -EINVAL;
+    elem = fake_elem_add(card, name, SNDRV_CTL_ELEM_TYPE_ENUMERATED, 1);
+    if (!elem)
+        return -errno;
+    elem->enames = calloc(nitems, sizeof(*elem->enames));
+    if (!elem->enames) {
+        fake_cards[card].count--;
+        return -ENOMEM;
+    }
+    for (i = 0; i < nitems; i++)
+        strncpy(elem->enames[i], items[i], sizeof(elem->enames[i]) - 1);
+    elem->info.value.enumerated.items = nitems;
+    elem->value[0] = elem->value[1] = value;
+    return 0;
+}
+
+static int fake_elem_add_bool(unsigned card, const char *name, unsigned count, int value)
+{
+    struct fake_elem *elem = fake_elem_add(card, name, SNDRV_CTL_ELEM_TYPE_BOOLEAN, count);
+
+    if (!elem)
+        return -errno;
+    elem->value[0] = elem->value[1] = !!value;
+    return 0;
+}
+
+/* one control named by the route tables, while the tables are scanned */
+struct fake_route_ctl {
+    uint16_t name;
+    uint16_t items[FAKE_CTL_ITEMS];
+    unsigned nitems;
+    long min;
+    long max;
+};
+
+/**
+ * @brief fake_card_populate
+ *        give the card every control the route tables of all codecs
+ *        name: enumerated if any route selects an item by name, boolean
+ *        if only 0 and 1 are written, integer over the written range
+ *        otherwise. Must be called with fake_lock held.
+ */
+static void fake_card_populate(unsigned card_no)
+{
+    static const char * const jacks[] = { "Headphone Jack", "Headset Mic Jack" };
+    struct fake_card *card = fake_cards + card_no;
+    struct fake_route_ctl *ctls = NULL, *ctl;
+    const char *items[FAKE_CTL_ITEMS];
+    unsigned count = 0, space = 0, c, r, i, j;
+    char value[PROPERTY_VALUE_MAX];
+
+    card->populated = 1;
+    property_get("host.ctl.write_us", value, "0");
+    card->write_us = atoi(value);
+    if (card->count)
+        return;
+
+    for (c = 0; c < route_packed_card_count; c++) {
+        for (r = 0; r < ROUTE_PACKED_ROUTES; r++) {
+            const struct route_packed_route *route =
+                route_packed_routes + route_packed_cards[c].routes + r;
+            const struct route_packed_control *pc = route_packed_controls + route->controls;
+
+            for (i = 0; i < route->controls_count; i++) {
+                for (j = 0; j < count; j++) {
+                    if (ctls[j].name == pc[i].name)
+                        break;
+                }
+                if (j == count) {
+                    if (count == space) {
+                        space = space ? space * 2 : 256;
+                        ctl = realloc(ctls, space * sizeof(*ctls));
+                        if (!ctl) {
+                            free(ctls);
+                            return;
+                        }
+                        ctls = ctl;
+                    }
+                    ctl = ctls + count++;
+                    memset(ctl, 0, sizeof(*ctl));
+                    ctl->name = pc[i].name;
+                }
+                ctl = ctls + j;
+                if (pc[i].str_val != ROUTE_PACKED_NO_STR) {
+                    for (j = 0; j < ctl->nitems; j++) {
+                        if (ctl->items[j] == pc[i].str_val)
+                            break;
+                    }
+                    if ((j == ctl->nitems) && (ctl->nitems < FAKE_CTL_ITEMS))
+                        ctl->items[ctl->nitems++] = pc[i].str_val;
+                    continue;
+                }
+                for (j = 0; j < 2; j++) {
+                    if (pc[i].int_val[j] < ctl->min)
+                        ctl->min = pc[i].int_val[j];
+                    if (pc[i].int_val[j] > ctl->max)
+                        ctl->max = pc[i].int_val[j];
+                }
+            }
+        }
+    }
+
+    for (i = 0; i < count; i++) {
+        const char *name = route_packed_strings + ctls[i].name;
+
+        ctl = ctls + i;
+        if (ctl->nitems) {
+            for (j = 0; j < ctl->nitems; j++)
+                items[j] = route_packed_strings + ctl->items[j];
+            fake_elem_add_enum(card_no, name, items, ctl->nitems, 0);
+        } else if ((ctl->min == 0) && (ctl->max <= 1) && !strstr(name, "Volume")) {
+            fake_elem_add_bool(card_no, name, 2, 0);
+        } else {
+            fake_elem_add_int(card_no, name, 2, ctl->min, ctl->max > ctl->min ? ctl->max : ctl->min + 1,
+                              ctl->min);
+        }
+    }
+    free(ctls);
+
+    for (i = 0; i < sizeof(jacks) / sizeof(jacks[0]); i++)
+        fake_elem_add_bool(card_no, jacks[i], 1, 0);
+    ALOGD("fake card %u: %u controls", card_no, card->count);
+}
+
+/**
+ * @brief fake_notify
+ *        queue a value event on every subscribed client of the card,
+ *        must be called with fake_lock held
+ */
+static void fake_notify(unsigned card, const struct fake_elem *elem)
+{
+    struct snd_ctl_event ev;
+    unsigned i;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.type = SNDRV_CTL_EVENT_ELEM;
+    ev.data.elem.mask = SNDRV_CTL_EVENT_MASK_VALUE;
+    ev.data.elem.id = elem->info.id;
+    for (i = 0; i < fake_client_count; i++) {
+        if ((fake_clients[i].card == card) && fake_clients[i].subscribed)
+            send(fake_clients[i].peer, &ev, sizeof(ev), MSG_DONTWAIT | MSG_NOSIGNAL);
+    }
+}
+
+/**
+ * @brief fake_elem_store
+ *        must be called with fake_lock held
+ *
+ * @returns 1 if the value changed, 0 if not, -EINVAL if out of range
+ */
+static int fake_elem_store(struct fake_elem *elem, long long left, long long right)
+{
+    long long v[2] = { left, elem->info.count > 1 ? right : left };
+    int n;
+
+    for (n = 0; n < 2; n++) {
+        switch (elem->info.type) {
+        case SNDRV_CTL_ELEM_TYPE_BOOLEAN:
+            if ((v[n] < 0) || (v[n] > 1))
+                return -EINVAL;
+            break;
+        case SNDRV_CTL_ELEM_TYPE_INTEGER:
+            if ((v[n] < elem->info.value.integer.min) || (v[n] > elem->info.value.integer.max))
+                return -EINVAL;
+            break;
+        case SNDRV_CTL_ELEM_TYPE_ENUMERATED:
+            if ((v[n] < 0) || (v[n] >= elem->info.value.enumerated.items))
+                return -EINVAL;
+            break;
+        default:
+            return -EINVAL;
+        }
+    }
+    if ((v[0] == elem->value[0]) && (v[1] == elem->value[1]))
+        return 0;
+    elem->value[0] = v[0];
+    elem->value[1] = v[1];
+    return 1;
+}
+
+static int fake_ioctl(struct fake_client *client, unsigned long request, void *arg)
+{
+    struct fake_card *card = fake_cards + client->card;
+    struct fake_elem *elem;
+    unsigned n, item;
+    int ret;
+
+    switch (request) {
+    case SNDRV_CTL_IOCTL_PVERSION:
+        *(int *)arg = SNDRV_CTL_VERSION;
+        return 0;
+    case SNDRV_CTL_IOCTL_CARD_INFO: {
+        struct snd_ctl_card_info *info = arg;
+
+        memset(info, 0, sizeof(*info));
+        info->card = client->card;
+        if (card->id[0])
+            memcpy(info->id, card->id, sizeof(info->id));
+        else
+            snprintf((char *)info->id, sizeof(info->id), "HOSTFAKE%u", client->card);
+        snprintf((char *)info->driver, sizeof(info->driver), "fake_ctl");
+        snprintf((char *)info->name, sizeof(info->name), "host fake card %u", client->card);
+        return 0;
+    }
+    case SNDRV_CTL_IOCTL_ELEM_LIST: {
+        struct snd_ctl_elem_list *list = arg;
+
+        list->count = card->count;
+        list->used = 0;
+        for (n = list->offset; (n < card->count) && (list->used < list->space); n++)
+            list->pids[list->used++] = card->elems[n].info.id;
+        return 0;
+    }
+    case SNDRV_CTL_IOCTL_ELEM_INFO: {
+        struct snd_ctl_elem_info *info = arg;
+
+        elem = fake_elem_numid(card, &info->id);
+        if (!elem)
+            return -ENOENT;
+        item = info->value.enumerated.item;
+        *info = elem->info;
+        if (elem->info.type == SNDRV_CTL_ELEM_TYPE_ENUMERATED) {
+            if (item >= elem->info.value.enumerated.items)
+                return -EINVAL;
+            info->value.enumerated.item = item;
+            strncpy(info->value.enumerated.name, elem->enames[item],
+                    sizeof(info->value.enumerated.name) - 1);
+        }
+        return 0;
+    }
+    case SNDRV_CTL_IOCTL_ELEM_READ: {
+        struct snd_ctl_elem_value *ev = arg;
+
+        elem = fake_elem_numid(card, &ev->id);
+        if (!elem)
+            return -ENOENT;
+        ev->id = elem->info.id;
+        for (n = 0; n < elem->info.count; n++) {
+            if (elem->info.type == SNDRV_CTL_ELEM_TYPE_ENUMERATED)
+                ev->value.enumerated.item[n] = elem->value[n];
+            else
+                ev->value.integer.value[n] = elem->value[n];
+        }
+        return 0;
+    }
+    case SNDRV_CTL_IOCTL_ELEM_WRITE: {
+        struct snd_ctl_elem_value *ev = arg;
+        long long v[2];
+
+        elem = fake_elem_numid(card, &ev->id);
+        if (!elem)
+            return -ENOENT;
+        for (n = 0; n < 2; n++) {
+            if (elem->info.type == SNDRV_CTL_ELEM_TYPE_ENUMERATED)
+                v[n] = ev->value.enumerated.item[n];
+            else
+                v[n] = ev->value.integer.value[n];
+        }
+        ret = fake_elem_store(elem, v[0], v[1]);
+        if (ret < 0)
+            return ret;
+        card->writes++;
+        if (ret)
+            fake_notify(client->card, elem);
+        return 0;
+    }
+    case SNDRV_CTL_IOCTL_TLV_READ: {
+        struct snd_ctl_tlv *tlv = arg;
+        long range;
+
+        for (n = 0; n < card->count; n++) {
+            if (card->elems[n].info.id.numid == tlv->numid)
+                break;
+        }
+        if ((n == card->count) || !(card->elems[n].info.access & SNDRV_CTL_ELEM_ACCESS_TLV_READ))
+            return -ENXIO;
+        if (tlv->length < 4 * sizeof(unsigned int))
+            return -ENOMEM;
+        elem = card->elems + n;
+        range = elem->info.value.integer.max - elem->info.value.integer.min;
+        tlv->tlv[0] = SND_CTL_TLVT_DB_SCALE;
+        tlv->tlv[1] = 2 * sizeof(unsigned int);
+        tlv->tlv[2] = (unsigned int)(-range * FAKE_CTL_DB_STEP);
+        tlv->tlv[3] = FAKE_CTL_DB_STEP;
+        return 0;
+    }
+    case SNDRV_CTL_IOCTL_SUBSCRIBE_EVENTS: {
+        int *subscribe = arg;
+
+        if (*subscribe < 0)
+            *subscribe = client->subscribed;
+        else
+            client->subscribed = !!*subscribe;
+        return 0;
+    }
+    default:
+        return -ENOTTY;
+    }
+}
+
+static struct fake_client *fake_client_find(int fd)
+{
+    unsigned i;
+
+    for (i = 0; i < fake_client_count; i++) {
+        if (fake_clients[i].fd == fd)
+            return fake_clients + i;
+    }
+    return NULL;
+}
+
+static int fake_open(unsigned card, int flags)
+{
+    int sv[2];
+
+    if (card >= FAKE_CTL_CARDS) {
+        errno = ENOENT;
+        return -1;
+    }
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0)
+        return -1;
+    if (flags & O_NONBLOCK)
+        fcntl(sv[0], F_SETFL, fcntl(sv[0], F_GETFL) | O_NONBLOCK);
+
+    pthread_mutex_lock(&fake_lock);
+    if (fake_client_count == FAKE_CTL_CLIENTS) {
+        pthread_mutex_unlock(&fake_lock);
+        __real_close(sv[0]);
+        __real_close(sv[1]);
+        errno = EMFILE;
+        return -1;
+    }
+    if (!fake_cards[card].populated)
+        fake_card_populate(card);
+    fake_clients[fake_client_count].fd = sv[0];
+    fake_clients[fake_client_count].peer = sv[1];
+    fake_clients[fake_client_count].card = card;
+    fake_clients[fake_client_count].subscribed = 0;
+    fake_client_count++;
+    pthread_mutex_unlock(&fake_lock);
+    return sv[0];
+}
+
+static int fake_path_card(const char *path, unsigned *card)
+{
+    int len = 0;
+
+    return (sscanf(path, FAKE_CTL_PATH "%n", card, &len) == 1) && len && !path[len];
+}
+
+int __wrap_open(const char *path, int flags, ...)
+{
+    unsigned card;
+    int mode = 0;
+    va_list ap;
+
+    if (fake_path_card(path, &card))
+        return fake_open(card, flags);
+    if (flags & O_CREAT) {
+        va_start(ap, flags);
+        mode = va_arg(ap, int);
+        va_end(ap);
+    }
+    return __real_open(path, flags, mode);
+}
+
+int __wrap_open64(const char *path, int flags, ...)
+{
+    unsigned card;
+    int mode = 0;
+    va_list ap;
+
+    if (fake_path_card(path, &card))
+        return fake_open(card, flags);
+    if (flags & O_CREAT) {
+        va_start(ap, flags);
+        mode = va_arg(ap, int);
+        va_end(ap);
+    }
+    return __real_open64(path, flags, mode);
+}
+
+int __wrap_close(int fd)
+{
+    struct fake_client *client;
+
+    pthread_mutex_lock(&fake_lock);
+    client = fake_client_find(fd);
+    if (client) {
+        __real_close(client->peer);
+        *client = fake_clients[--fake_client_count];
+    }
+    pthread_mutex_unlock(&fake_lock);
+    return __real_close(fd);
+}
+
+int __wrap_ioctl(int fd, unsigned long request, ...)
+{
+    struct fake_client *client;
+    unsigned write_us = 0;
+    void *arg;
+    va_list ap;
+    int ret;
+
+    va_start(ap, request);
+    arg = va_arg(ap, void *);
+    va_end(ap);
+
+    pthread_mutex_lock(&fake_lock);
+    client = fake_client_find(fd);
+    if (client && (request == SNDRV_CTL_IOCTL_ELEM_WRITE))
+        write_us = fake_cards[client->card].write_us;
+    pthread_mutex_unlock(&fake_lock);
+    if (!client)
+        return __real_ioctl(fd, request, arg);
+
+    // the bus transfer, outside the lock like on a real card
+    if (write_us)
+        usleep(write_us);
+
+    pthread_mutex_lock(&fake_lock);
+    client = fake_client_find(fd);
+    ret = client ? fake_ioctl(client, request, arg) : -EBADF;
+    pthread_mutex_unlock(&fake_lock);
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+    return ret;
+}
+
+int fake_ctl_add_bool(unsigned card, const char *name, unsigned count, int value)
+{
+    int ret;
+
+    pthread_mutex_lock(&fake_lock);
+    ret = fake_elem_add_bool(card, name, count, value);
+    pthread_mutex_unlock(&fake_lock);
+    return ret;
+}
+
+int fake_ctl_add_int(unsigned card, const char *name, unsigned count, long min, long max,
+                     long value)
+{
+    int ret;
+
+    pthread_mutex_lock(&fake_lock);
+    ret = fake_elem_add_int(card, name, count, min, max, value);
+    pthread_mutex_unlock(&fake_lock);
+    return ret;
+}
+
+int fake_ctl_add_enum(unsigned card, const char *name, const char * const *items,
+                      unsigned nitems, unsigned value)
+{
+    int ret;
+
+    pthread_mutex_lock(&fake_lock);
+    ret = fake_elem_add_enum(card, name, items, nitems, value);
+    pthread_mutex_unlock(&fake_lock);
+    return ret;
+}
+
+/**
+ * @brief fake_ctl_set
+ *        change a control from the card side, like a jack detection
+ *        would, subscribed clients get the event
+ *
+ * @returns 0 or -errno
+ */
+int fake_ctl_set(unsigned card, const char *name, long left, long right)
+{
+    struct fake_elem *elem;
+    int ret;
+
+    if (card >= FAKE_CTL_CARDS)
+        return -EINVAL;
+    pthread_mutex_lock(&fake_lock);
+    if (!fake_cards[card].populated)
+        fake_card_populate(card);
+    elem = fake_elem_find(fake_cards + card, name);
+    ret = elem ? fake_elem_store(elem, left, right) : -ENOENT;
+    if (ret > 0)
+        fake_notify(card, elem);
+    pthread_mutex_unlock(&fake_lock);
+    return ret < 0 ? ret : 0;
+}
+
+/**
+ * @brief fake_ctl_get
+ *
+ * @returns the value of the channel, the item of an enum, or -1
+ */
+long fake_ctl_get(unsigned card, const char *name, unsigned channel)
+{
+    struct fake_elem *elem;
+    long value = -1;
+
+    if ((card >= FAKE_CTL_CARDS) || (channel > 1))
+        return -1;
+    pthread_mutex_lock(&fake_lock);
+    elem = fake_elem_find(fake_cards + card, name);
+    if (elem)
+        value = elem->value[channel];
+    pthread_mutex_unlock(&fake_lock);
+    return value;
+}
+
+/**
+ * @brief fake_ctl_writes
+ *
+ * @returns the ELEM_WRITE requests served for the card so far
+ */
+unsigned fake_ctl_writes(unsigned card)
+{
+    unsigned writes;
+
+    if (card >= FAKE_CTL_CARDS)
+        return 0;
+    pthread_mutex_lock(&fake_lock);
+    writes = fake_cards[card].writes;
+    pthread_mutex_unlock(&fake_lock);
+    return writes;
+}
+
+/**
+ * @brief fake_ctl_reset
+ *        drop the controls of the card, the next open populates it again
+ */
+void fake_ctl_reset(unsigned card)
+{
+    struct fake_card *c;
+    unsigned n;
+
+    if (card >= FAKE_CTL_CARDS)
+        return;
+    pthread_mutex_lock(&fake_lock);
+    c = fake_cards + card;
+    for (n = 0; n < c->count; n++)
+        free(c->elems[n].enames);
+    free(c->elems);
+    memset(c, 0, sizeof(*c));
+    pthread_mutex_unlock(&fake_lock);
+}
+
+/**
+ * @brief fake_ctl_set_id
+ *        change the id CARD_INFO reports, as another card taking the
+ *        index after a USB card was unplugged and enumerated again
+ *
+ * @param card
+ * @param id NULL or "" for the default
+ */
+void fake_ctl_set_id(unsigned card, const char *id)
+{
+    if (card >= FAKE_CTL_CARDS)
+        return;
+    pthread_mutex_lock(&fake_lock);
+    memset(fake_cards[card].id, 0, sizeof(fake_cards[card].id));
+    if (id)
+        strncpy(fake_cards[card].id, id, sizeof(fake_cards[card].id) - 1);
+    pthread_mutex_unlock(&fake_lock);
+}
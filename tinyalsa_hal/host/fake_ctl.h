@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file    fake_ctl.h
+ * @brief   in memory sound card control devices for the host build
+ *
+ * open("/dev/snd/controlC<n>") made by the hal is answered with one end
+ * of a socket pair and the SNDRV_CTL_IOCTL_* requests on it are served
+ * from a table of controls, so the mixer, route and jack code run
+ * unchanged. Subscribed clients read struct snd_ctl_event from the fd
+ * like from the kernel. A card that has no controls when it is first
+ * opened gets every control named by the compiled in route tables.
+ *
+ * properties, read when a card is first used:
+ *   host.ctl.write_us   time an ELEM_WRITE takes, as a codec on i2c
+ */
+
+#ifndef FAKE_CTL_H_
+#define FAKE_CTL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FAKE_CTL_CARDS      4
+
+int fake_ctl_add_bool(unsigned card, const char *name, unsigned count, int value);
+int fake_ctl_add_int(unsigned card, const char *name, unsigned count, long min, long max,
+                     long value);
+int fake_ctl_add_enum(unsigned card, const char *name, const char * const *items,
+                      unsigned nitems, unsigned value);
+int fake_ctl_set(unsigned card, const char *name, long left, long right);
+long fake_ctl_get(unsigned card, const char *name, unsigned channel);
+unsigned fake_ctl_writes(unsigned card);
+void fake_ctl_reset(unsigned card);
+void fake_ctl_set_id(unsigned card, const char *id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,531 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file    fake_pcm.c
+ * @brief   tinyalsa pcm api for the host build, see fake_pcm.h
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cutils/log.h>
+#include <cutils/properties.h>
+#include <tinyalsa/asoundlib.h>
+
+#include "fake_pcm.h"
+
+#define FAKE_PCM_ERROR_MAX  128
+
+struct pcm {
+    unsigned card;
+    unsigned device;
+    unsigned flags;
+    struct pcm_config config;
+    unsigned frame_bytes;
+    unsigned buffer_size;       // frames
+    int ready;
+    int running;
+    uint64_t appl;              // frames written or read since the start
+    int64_t start_ns;
+    double frames_per_ns;       // rate on the card clock
+    unsigned transfers;
+    unsigned xrun_every;
+    int underruns;
+    FILE *file;
+    int loopback;               // host.pcm.loopback was set at open
+    int64_t loop_delay_ns;      // of the analog path, capture only
+    int16_t *loop;              // first channel of what was written, playback only
+    unsigned loop_size;         // frames of history in loop
+    struct pcm *loop_next;
+    char error[FAKE_PCM_ERROR_MAX];
+};
+
+static struct fake_pcm_stats fake_stats;
+static pthread_mutex_t fake_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * playback streams the loopback captures hear. The lock also covers the
+ * position of these streams, their capture reads it from another thread.
+ */
+static struct pcm *fake_loop_list;
+static pthread_mutex_t fake_loop_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int64_t fake_now_ns(clockid_t clock)
+{
+    struct timespec ts;
+
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void fake_sleep_ns(int64_t ns)
+{
+    struct timespec ts;
+
+    if (ns <= 0)
+        return;
+    ts.tv_sec = ns / 1000000000LL;
+    ts.tv_nsec = ns % 1000000000LL;
+    while (nanosleep(&ts, &ts) < 0 && errno == EINTR)
+        ;
+}
+
+static int oops(struct pcm *pcm, int e, const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(pcm->error, sizeof(pcm->error), fmt, ap);
+    va_end(ap);
+    errno = e;
+    return -1;
+}
+
+/* frames the card has played or captured since the start */
+static uint64_t fake_pcm_hw(struct pcm *pcm)
+{
+    int64_t ns = fake_now_ns(CLOCK_MONOTONIC) - pcm->start_ns;
+
+    return ns > 0 ? (uint64_t)(ns * pcm->frames_per_ns) : 0;
+}
+
+/* time until the card reaches the position */
+static int64_t fake_pcm_ns_until(struct pcm *pcm, uint64_t frames)
+{
+    uint64_t hw = fake_pcm_hw(pcm);
+
+    return frames > hw ? (int64_t)((frames - hw) / pcm->frames_per_ns) + 1 : 0;
+}
+
+static void fake_pcm_start(struct pcm *pcm)
+{
+    if (pcm->loop)
+        pthread_mutex_lock(&fake_loop_lock);
+    pcm->start_ns = fake_now_ns(CLOCK_MONOTONIC);
+    pcm->running = 1;
+    if (pcm->loop)
+        pthread_mutex_unlock(&fake_loop_lock);
+}
+
+static void fake_pcm_reset(struct pcm *pcm)
+{
+    if (pcm->loop)
+        pthread_mutex_lock(&fake_loop_lock);
+    pcm->running = 0;
+    pcm->appl = 0;
+    if (pcm->loop)
+        pthread_mutex_unlock(&fake_loop_lock);
+}
+
+/* first channel of a frame as 16 bits */
+static int16_t fake_loop_sample(struct pcm *pcm, const char *frame)
+{
+    switch (pcm->config.format) {
+    case PCM_FORMAT_S32_LE:
+        return *(const int32_t *)frame >> 16;
+    case PCM_FORMAT_S24_LE:
+        return *(const int32_t *)frame >> 8;
+    case PCM_FORMAT_S24_3LE:
+        return (int16_t)(((uint8_t)frame[2] << 8) | (uint8_t)frame[1]);
+    case PCM_FORMAT_S8:
+        return (int16_t)(frame[0] << 8);
+    default:
+        return *(const int16_t *)frame;
+    }
+}
+
+/**
+ * @brief fake_loop_play
+ *        queue frames of a loopback playback stream, kept until a second
+ *        after the card played them
+ */
+static void fake_loop_play(struct pcm *pcm, const void *data, unsigned frames)
+{
+    const char *frame = data;
+    unsigned i;
+
+    pthread_mutex_lock(&fake_loop_lock);
+    for (i = 0; i < frames; i++, frame += pcm->frame_bytes)
+        pcm->loop[(pcm->appl + i) % pcm->loop_size] = fake_loop_sample(pcm, frame);
+    pcm->appl += frames;
+    pthread_mutex_unlock(&fake_loop_lock);
+}
+
+/**
+ * @brief fake_loop_capture
+ *        add to captured frames what the playback streams played when the
+ *        card captured them, the analog path delay earlier
+ */
+static void fake_loop_capture(struct pcm *pcm, void *data, unsigned frames)
+{
+    unsigned bytes = pcm_format_to_bits(pcm->config.format) / 8;
+    unsigned i, ch;
+
+    if ((bytes != 2) && (bytes != 4))
+        return;
+    pthread_mutex_lock(&fake_loop_lock);
+    for (i = 0; i < frames; i++) {
+        int64_t ns = pcm->start_ns + (int64_t)((pcm->appl + i) / pcm->frames_per_ns) -
+                     pcm->loop_delay_ns;
+        char *frame = (char *)data + i * pcm->frame_bytes;
+        struct pcm *p;
+        int sum = 0;
+
+        for (p = fake_loop_list; p; p = p->loop_next) {
+            int64_t pos;
+
+            if (!p->running || (ns < p->start_ns))
+                continue;
+            pos = (int64_t)((ns - p->start_ns) * p->frames_per_ns);
+            if (((uint64_t)pos < p->appl) && (p->appl - pos <= p->loop_size))
+                sum += p->loop[pos % p->loop_size];
+        }
+        if (!sum)
+            continue;
+        for (ch = 0; ch < pcm->config.channels; ch++) {
+            if (bytes == 2) {
+                int16_t *sample = (int16_t *)frame + ch;
+                int v = *sample + sum;
+
+                *sample = v > 32767 ? 32767 : v < -32768 ? -32768 : v;
+            } else {
+                int32_t *sample = (int32_t *)frame + ch;
+                int64_t v = *sample + ((int64_t)sum << 16);
+
+                *sample = v > INT32_MAX ? INT32_MAX : v < INT32_MIN ? INT32_MIN : v;
+            }
+        }
+    }
+    pthread_mutex_unlock(&fake_loop_lock);
+}
+
+/**
+ * @brief fake_pcm_xrun
+ *        the card ran past the application, or an xrun is forced.
+ *        Counted, the stream is stopped and prepared again.
+ *
+ * @returns 1 if there was an xrun
+ */
+static int fake_pcm_xrun(struct pcm *pcm)
+{
+    int forced = 0, late;
+    uint64_t hw;
+
+    if (!pcm->running)
+        return 0;
+    pcm->transfers++;
+    if (pcm->xrun_every && !(pcm->transfers % pcm->xrun_every))
+        forced = 1;
+    hw = fake_pcm_hw(pcm);
+    if (pcm->flags & PCM_IN)
+        late = hw > pcm->appl + pcm->buffer_size;
+    else
+        late = hw >= pcm->appl;
+    if (!late && !forced)
+        return 0;
+
+    pcm->underruns++;
+    fake_pcm_reset(pcm);
+    pthread_mutex_lock(&fake_stats_lock);
+    fake_stats.xruns++;
+    if (!late)
+        fake_stats.xruns_forced++;
+    pthread_mutex_unlock(&fake_stats_lock);
+    return 1;
+}
+
+struct pcm *pcm_open(unsigned int card, unsigned int device,
+                     unsigned int flags, struct pcm_config *config)
+{
+    char dir[PROPERTY_VALUE_MAX], value[PROPERTY_VALUE_MAX], path[PROPERTY_VALUE_MAX + 32];
+    struct pcm *pcm;
+    int capture = !!(flags & PCM_IN);
+
+    pcm = calloc(1, sizeof(struct pcm));
+    if (!pcm)
+        return NULL;
+    pcm->card = card;
+    pcm->device = device;
+    pcm->flags = flags;
+
+    if (!config || !config->channels || !config->rate || !config->period_size ||
+        !config->period_count) {
+        oops(pcm, EINVAL, "cannot set hw params");
+        return pcm;
+    }
+    pcm->config = *config;
+    pcm->frame_bytes = config->channels * (pcm_format_to_bits(config->format) / 8);
+    pcm->buffer_size = config->period_size * config->period_count;
+    if (!pcm->config.start_threshold)
+        pcm->config.start_threshold = capture ? 1 : pcm->buffer_size / 2;
+
+    property_get("host.pcm.drift_ppm", value, "0");
+    pcm->frames_per_ns = config->rate * (1.0 + atof(value) / 1000000.0) / 1000000000.0;
+    property_get("host.pcm.xrun_every", value, "0");
+    pcm->xrun_every = atoi(value);
+    property_get("host.pcm.loopback", value, "0");
+    pcm->loopback = atoi(value) != 0;
+    property_get("host.pcm.loopback_us", value, "0");
+    pcm->loop_delay_ns = atoll(value) * 1000;
+    // the codec powering its paths up, paid again by every reopen
+    property_get("host.pcm.open_us", value, "0");
+    if (atoi(value) > 0)
+        usleep(atoi(value));
+    if (pcm->loopback && !capture) {
+        pcm->loop_size = pcm->buffer_size + config->rate + pcm->loop_delay_ns * config->rate /
+                         1000000000LL;
+        pcm->loop = calloc(pcm->loop_size, sizeof(*pcm->loop));
+        if (!pcm->loop) {
+            oops(pcm, ENOMEM, "no memory for the loopback");
+            return pcm;
+        }
+    }
+
+    if (property_get("host.pcm.dir", dir, "") > 0) {
+        snprintf(path, sizeof(path), "%s/pcmC%uD%u%c.raw", dir, card, device, capture ? 'c' : 'p');
+        pcm->file = fopen(path, capture ? "rb" : "ab");
+        if (!pcm->file && !capture) {
+            oops(pcm, errno, "cannot open %s: %s", path, strerror(errno));
+            return pcm;
+        }
+    }
+
+    pcm->ready = 1;
+    if (pcm->loop) {
+        pthread_mutex_lock(&fake_loop_lock);
+        pcm->loop_next = fake_loop_list;
+        fake_loop_list = pcm;
+        pthread_mutex_unlock(&fake_loop_lock);
+    }
+    pthread_mutex_lock(&fake_stats_lock);
+    fake_stats.opens++;
+    pthread_mutex_unlock(&fake_stats_lock);
+    ALOGV("fake pcm_open card %u device %u %s rate %u channels %u buffer %u", card, device,
+          capture ? "capture" : "playback", config->rate, config->channels, pcm->buffer_size);
+    return pcm;
+}
+
+int pcm_close(struct pcm *pcm)
+{
+    struct pcm **p;
+
+    if (!pcm)
+        return 0;
+    if (pcm->loop) {
+        pthread_mutex_lock(&fake_loop_lock);
+        for (p = &fake_loop_list; *p; p = &(*p)->loop_next) {
+            if (*p == pcm) {
+                *p = pcm->loop_next;
+                break;
+            }
+        }
+        pthread_mutex_unlock(&fake_loop_lock);
+        free(pcm->loop);
+    }
+    if (pcm->file)
+        fclose(pcm->file);
+    free(pcm);
+    return 0;
+}
+
+int pcm_is_ready(struct pcm *pcm)
+{
+    return pcm && pcm->ready;
+}
+
+const char *pcm_get_error(struct pcm *pcm)
+{
+    return pcm ? pcm->error : "no pcm";
+}
+
+unsigned int pcm_get_buffer_size(struct pcm *pcm)
+{
+    return pcm->buffer_size;
+}
+
+unsigned int pcm_format_to_bits(enum pcm_format format)
+{
+    switch (format) {
+    case PCM_FORMAT_S32_LE:
+    case PCM_FORMAT_S24_LE:
+        return 32;
+    case PCM_FORMAT_S24_3LE:
+        return 24;
+    case PCM_FORMAT_S8:
+        return 8;
+    case PCM_FORMAT_S16_LE:
+    default:
+        return 16;
+    }
+}
+
+unsigned int pcm_frames_to_bytes(struct pcm *pcm, unsigned int frames)
+{
+    return frames * pcm->frame_bytes;
+}
+
+unsigned int pcm_bytes_to_frames(struct pcm *pcm, unsigned int bytes)
+{
+    return bytes / pcm->frame_bytes;
+}
+
+int pcm_get_htimestamp(struct pcm *pcm, unsigned int *avail,
+                       struct timespec *tstamp)
+{
+    uint64_t hw;
+    int64_t ns;
+
+    if (!pcm_is_ready(pcm) || !pcm->running)
+        return -1;
+
+    hw = fake_pcm_hw(pcm);
+    if (pcm->flags & PCM_IN)
+        *avail = hw > pcm->appl ? (unsigned)(hw - pcm->appl) : 0;
+    else
+        *avail = hw >= pcm->appl ? pcm->buffer_size : pcm->buffer_size - (unsigned)(pcm->appl - hw);
+    if (*avail > pcm->buffer_size)
+        *avail = pcm->buffer_size;
+
+    ns = fake_now_ns((pcm->flags & PCM_MONOTONIC) ? CLOCK_MONOTONIC : CLOCK_REALTIME);
+    tstamp->tv_sec = ns / 1000000000LL;
+    tstamp->tv_nsec = ns % 1000000000LL;
+    return 0;
+}
+
+int pcm_write(struct pcm *pcm, const void *data, unsigned int count)
+{
+    unsigned frames;
+
+    if (!pcm_is_ready(pcm) || (pcm->flags & PCM_IN))
+        return -EINVAL;
+    frames = count / pcm->frame_bytes;
+    if (frames > pcm->buffer_size)
+        return oops(pcm, EINVAL, "write of %u frames is larger than the buffer", frames);
+
+    if (fake_pcm_xrun(pcm) && (pcm->flags & PCM_NORESTART))
+        return -EPIPE;
+
+    if (!pcm->running && (pcm->appl + frames > pcm->buffer_size))
+        fake_pcm_start(pcm);
+    // block until the card made room, as a blocking write does
+    if (pcm->running)
+        fake_sleep_ns(fake_pcm_ns_until(pcm, pcm->appl + frames - pcm->buffer_size));
+
+    if (pcm->file)
+        fwrite(data, pcm->frame_bytes, frames, pcm->file);
+    if (pcm->loop)
+        fake_loop_play(pcm, data, frames);
+    else
+        pcm->appl += frames;
+    if (!pcm->running && (pcm->appl >= pcm->config.start_threshold))
+        fake_pcm_start(pcm);
+
+    pthread_mutex_lock(&fake_stats_lock);
+    fake_stats.frames_written += frames;
+    pthread_mutex_unlock(&fake_stats_lock);
+    return 0;
+}
+
+int pcm_read(struct pcm *pcm, void *data, unsigned int count)
+{
+    unsigned frames, done = 0;
+    size_t got;
+
+    if (!pcm_is_ready(pcm) || !(pcm->flags & PCM_IN))
+        return -EINVAL;
+    frames = count / pcm->frame_bytes;
+    if (frames > pcm->buffer_size)
+        return oops(pcm, EINVAL, "read of %u frames is larger than the buffer", frames);
+
+    if (fake_pcm_xrun(pcm) && (pcm->flags & PCM_NORESTART))
+        return -EPIPE;
+    if (!pcm->running)
+        fake_pcm_start(pcm);
+    // block until the card captured the frames
+    fake_sleep_ns(fake_pcm_ns_until(pcm, pcm->appl + frames));
+
+    while (pcm->file && (done < frames)) {
+        got = fread((char *)data + done * pcm->frame_bytes, pcm->frame_bytes, frames - done,
+                    pcm->file);
+        if (!got) {
+            // loop the capture file, give up on an empty one
+            if (!ftell(pcm->file))
+                break;
+            rewind(pcm->file);
+        }
+        done += got;
+    }
+    memset((char *)data + done * pcm->frame_bytes, 0, (frames - done) * pcm->frame_bytes);
+    if (pcm->loopback)
+        fake_loop_capture(pcm, data, frames);
+    pcm->appl += frames;
+
+    pthread_mutex_lock(&fake_stats_lock);
+    fake_stats.frames_read += frames;
+    pthread_mutex_unlock(&fake_stats_lock);
+    return 0;
+}
+
+int pcm_start(struct pcm *pcm)
+{
+    if (!pcm_is_ready(pcm))
+        return -1;
+    if (!pcm->running)
+        fake_pcm_start(pcm);
+    return 0;
+}
+
+int pcm_stop(struct pcm *pcm)
+{
+    if (!pcm_is_ready(pcm))
+        return -1;
+    fake_pcm_reset(pcm);
+    return 0;
+}
+
+void fake_pcm_get_stats(struct fake_pcm_stats *stats)
+{
+    pthread_mutex_lock(&fake_stats_lock);
+    *stats = fake_stats;
+    pthread_mutex_unlock(&fake_stats_lock);
+}
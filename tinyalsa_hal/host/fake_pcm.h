@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file    fake_pcm.h
+ * @brief   tinyalsa pcm api for the host build, driven by the monotonic
+ *          clock and backed by files
+ *
+ * A stream consumes or produces frames at its rate from the moment it
+ * starts, pcm_write() and pcm_read() block like on a card, and a late
+ * write or read is an xrun handled the way tinyalsa does.
+ *
+ * properties, read at pcm_open():
+ *   host.pcm.dir         playback is appended to <dir>/pcmC<card>D<device>p.raw,
+ *                        capture reads <dir>/pcmC<card>D<device>c.raw in a loop.
+ *                        Without it playback is dropped and capture is silence.
+ *   host.pcm.drift_ppm   card clock offset from the system clock
+ *   host.pcm.xrun_every  force an xrun every that many transfers
+ *   host.pcm.loopback    captures hear the first channel of the running
+ *                        playbacks, as played on the card clock, like a
+ *                        cable from the headphone jack to the mic
+ *   host.pcm.loopback_us delay of that cable, the analog path of a codec
+ *   host.pcm.open_us     time pcm_open() takes, a codec powering its paths up
+ */
+
+#ifndef FAKE_PCM_H_
+#define FAKE_PCM_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct fake_pcm_stats {
+    unsigned opens;
+    unsigned long long frames_written;
+    unsigned long long frames_read;
+    unsigned xruns;
+    unsigned xruns_forced;
+};
+
+void fake_pcm_get_stats(struct fake_pcm_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
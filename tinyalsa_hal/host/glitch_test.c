@@ -0,0 +1,208 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file    glitch_test.c
+ * @brief   host test of the glitch detector of audio_glitch.c
+ *
+ * Feeds the detector a 997 Hz tone at 48 kHz, the way out_write() does
+ * after pcm_write(), with one splice of each kind halfway through: a
+ * frame dropped, a frame repeated, a phase jump of a fraction of a
+ * frame and a gap of zeros. A slow fade of the clean tone must go by
+ * without an event. No card is given, so only the data is checked.
+ *
+ * usage: glitch_test
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <cutils/properties.h>
+
+#include "audio_glitch.h"
+
+#define GLITCH_TEST_HZ          (997)
+#define GLITCH_TEST_RATE        (48000)
+#define GLITCH_TEST_CHANNELS    (2)
+#define GLITCH_TEST_FRAMES      (24000)     // half a second
+#define GLITCH_TEST_SPLICE      (12000)     // where the splice goes
+#define GLITCH_TEST_CHUNK       (480)       // frames per write
+#define GLITCH_TEST_GAP         (100)       // frames of zeros
+#define GLITCH_TEST_EVENTS      (8)
+
+static int glitch_test_failed;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("    %s:%d: %s\n", __func__, __LINE__, #cond); \
+            glitch_test_failed = 1; \
+        } \
+    } while (0)
+
+enum glitch_splice {
+    SPLICE_NONE,
+    SPLICE_DROP,
+    SPLICE_REPEAT,
+    SPLICE_PHASE,
+    SPLICE_GAP,
+};
+
+/**
+ * @brief glitch_test_run
+ *        play the tone with the splice through a new detector and copy out
+ *        its events
+ *
+ * @returns the number of events
+ */
+static unsigned glitch_test_run(enum glitch_splice splice, float fade,
+                                struct audio_glitch_event *events)
+{
+    struct audio_glitch *glitch = audio_glitch_open("test");
+    int16_t *pcm = calloc(GLITCH_TEST_FRAMES * GLITCH_TEST_CHANNELS, sizeof(int16_t));
+    double step = 2.0 * M_PI * GLITCH_TEST_HZ / GLITCH_TEST_RATE, phase = 0.0;
+    unsigned i, count = 0;
+
+    CHECK(glitch != NULL);
+    CHECK(pcm != NULL);
+    if (!glitch || !pcm)
+        goto exit;
+
+    for (i = 0; i < GLITCH_TEST_FRAMES; i++) {
+        /* from 12000 down by fade over the whole tone, -7.7 dBFS at the top */
+        double amp = 12000.0 * (1.0 - fade * i / GLITCH_TEST_FRAMES);
+
+        if (i == GLITCH_TEST_SPLICE) {
+            if (splice == SPLICE_DROP)
+                phase += step;
+            else if (splice == SPLICE_REPEAT)
+                phase -= step;
+            else if (splice == SPLICE_PHASE)
+                phase += 1.5;
+        }
+        if ((splice == SPLICE_GAP) && (i >= GLITCH_TEST_SPLICE) &&
+            (i < GLITCH_TEST_SPLICE + GLITCH_TEST_GAP))
+            pcm[i * GLITCH_TEST_CHANNELS] = 0;
+        else
+            pcm[i * GLITCH_TEST_CHANNELS] = (int16_t)lrint(amp * sin(phase));
+        pcm[i * GLITCH_TEST_CHANNELS + 1] = pcm[i * GLITCH_TEST_CHANNELS];
+        phase += step;
+    }
+
+    for (i = 0; i < GLITCH_TEST_FRAMES; i += GLITCH_TEST_CHUNK)
+        audio_glitch_feed(glitch, NULL, pcm + i * GLITCH_TEST_CHANNELS, GLITCH_TEST_CHUNK,
+                          GLITCH_TEST_CHANNELS, GLITCH_TEST_RATE);
+    count = audio_glitch_events(glitch, events, GLITCH_TEST_EVENTS);
+
+exit:
+    free(pcm);
+    audio_glitch_close(glitch);
+    return count;
+}
+
+/* the one event of a splice, found where the splice is */
+static void glitch_test_expect(enum glitch_splice splice, enum audio_glitch_kind kind, int frames)
+{
+    struct audio_glitch_event events[GLITCH_TEST_EVENTS];
+    unsigned count = glitch_test_run(splice, 0.0f, events);
+
+    CHECK(count == 1);
+    if (count != 1)
+        return;
+    CHECK(events[0].kind == kind);
+    CHECK(events[0].frames == frames);
+    CHECK(events[0].frame == GLITCH_TEST_SPLICE);
+    CHECK(events[0].play_ns == 0);
+}
+
+static void test_fade(void)
+{
+    struct audio_glitch_event events[GLITCH_TEST_EVENTS];
+
+    CHECK(glitch_test_run(SPLICE_NONE, 0.0f, events) == 0);
+    // down by 12 dB over half a second
+    CHECK(glitch_test_run(SPLICE_NONE, 0.75f, events) == 0);
+}
+
+static void test_dropped(void)
+{
+    glitch_test_expect(SPLICE_DROP, AUDIO_GLITCH_DROPPED, 1);
+}
+
+static void test_repeated(void)
+{
+    glitch_test_expect(SPLICE_REPEAT, AUDIO_GLITCH_REPEATED, 1);
+}
+
+static void test_phase_jump(void)
+{
+    glitch_test_expect(SPLICE_PHASE, AUDIO_GLITCH_PHASE_JUMP, 0);
+}
+
+static void test_dropout(void)
+{
+    // the first zero still carries the phasor of the sample before it, it is not silent
+    glitch_test_expect(SPLICE_GAP, AUDIO_GLITCH_DROPOUT, GLITCH_TEST_GAP - 1);
+}
+
+static const struct {
+    const char *name;
+    void (*run)(void);
+} glitch_tests[] = {
+    { "fade", test_fade },
+    { "dropped", test_dropped },
+    { "repeated", test_repeated },
+    { "phase_jump", test_phase_jump },
+    { "dropout", test_dropout },
+};
+#define GLITCH_TESTS (int)(sizeof(glitch_tests) / sizeof(glitch_tests[0]))
+
+int main(void)
+{
+    char hz[PROPERTY_VALUE_MAX];
+    int i, failed = 0;
+
+    snprintf(hz, sizeof(hz), "%d", GLITCH_TEST_HZ);
+    property_set("media.audio.glitch.hz", hz);
+    for (i = 0; i < GLITCH_TESTS; i++) {
+        glitch_test_failed = 0;
+        glitch_tests[i].run();
+        printf("%-20s %s\n", glitch_tests[i].name, glitch_test_failed ? "FAIL" : "ok");
+        failed += glitch_test_failed;
+    }
+    printf("%d of %d cases passed\n", GLITCH_TESTS - failed, GLITCH_TESTS);
+    return failed ? 1 : 0;
+}
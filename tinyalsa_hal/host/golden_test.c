@@ -0,0 +1,455 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file    golden_test.c
+ * @brief   golden output regression test of the DSP and bitstream paths
+ *
+ * Feeds deterministic PCM and IEC61937 input through the HDMI bitstream
+ * packer, the output slice ramp and the capture path of in_read, and
+ * compares the result against the references checked in under golden/.
+ *
+ * The bitstream is compared bit exact, and every IEC60958 subframe is
+ * checked on its own as well: the audio bits carry the input word, the
+ * parity bit makes bits 0..30 even, and the channel status and validity
+ * bits follow the channel status block. The float paths are compared
+ * within a tolerance in LSBs.
+ *
+ * Denoise and echo cancellation are not covered: libspeexdsp is not
+ * available to the host build, shims.c stands in with a pass through
+ * preprocessor and a copying canceller. The in_read case only pins how
+ * in_read down mixes, frames and fans out the capture around them.
+ *
+ * usage: golden_test [-d golden_dir] [-u] [case...]
+ *        -u rewrites the references from the current code
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <cutils/properties.h>
+#include <hardware/audio.h>
+#include <hardware/hardware.h>
+
+#include "audio_bitstream.h"
+#include "audio_slice.h"
+
+#define GOLDEN_DIR_DEFAULT "golden"
+
+/* IEC61937 burst preamble */
+#define IEC61937_PA (0xF872)
+#define IEC61937_PB (0x4E1F)
+#define IEC61937_AC3 (0x0001)
+#define IEC61937_EAC3 (0x0015)
+#define IEC61937_TRUEHD (0x0016)
+
+/* IEC60958 subframe as packed by fill_hdmi_bitstream_buf, bits of the last byte */
+#define SUBFRAME_V_BIT (0x08)
+#define SUBFRAME_C_BIT (0x20)
+
+enum golden_kind {
+    GOLDEN_PCM,
+    GOLDEN_IEC61937,
+    GOLDEN_SLICE,
+    GOLDEN_IN_READ,
+};
+
+struct golden_case {
+    const char *name;
+    enum golden_kind kind;
+    int rate;
+    int channels;
+    int frames;
+    int param;          // burst type for IEC61937, fade step for the slice
+    bool down;
+    int tolerance;      // LSBs, 0 is bit exact
+};
+
+static const struct golden_case golden_cases[] = {
+    { "hdmi_pcm_48k", GOLDEN_PCM, 48000, 2, 1000, 0, false, 0 },
+    { "hdmi_pcm_44k1", GOLDEN_PCM, 44100, 2, 1000, 0, false, 0 },
+    { "hdmi_ac3_48k", GOLDEN_IEC61937, 48000, 2, 1536, IEC61937_AC3, false, 0 },
+    { "hdmi_eac3_192k", GOLDEN_IEC61937, 192000, 2, 1536, IEC61937_EAC3, false, 0 },
+    { "hdmi_truehd_hbr", GOLDEN_IEC61937, 192000, 8, 960, IEC61937_TRUEHD, false, 0 },
+    { "slice_down_0", GOLDEN_SLICE, 44100, 2, 441, 0, true, 1 },
+    { "slice_down_8", GOLDEN_SLICE, 44100, 2, 441, 8, true, 1 },
+    { "slice_down_14", GOLDEN_SLICE, 44100, 2, 441, 14, true, 1 },
+    { "slice_up_0", GOLDEN_SLICE, 44100, 2, 441, 0, false, 1 },
+    { "slice_up_8", GOLDEN_SLICE, 44100, 2, 441, 8, false, 1 },
+    { "slice_up_15", GOLDEN_SLICE, 44100, 2, 441, 15, false, 1 },
+    { "in_read_44k1", GOLDEN_IN_READ, 44100, 2, 4410, 0, false, 2 },
+};
+#define GOLDEN_CASES (int)(sizeof(golden_cases) / sizeof(golden_cases[0]))
+
+extern struct audio_module HAL_MODULE_INFO_SYM;
+
+static uint32_t golden_seed;
+
+static short golden_noise(int amplitude)
+{
+    golden_seed = golden_seed * 1103515245 + 12345;
+    return (short)((int)((golden_seed >> 16) & 0xffff) - 32768) * amplitude / 32768;
+}
+
+/* a tone per channel plus noise, loud enough to use all 16 bits */
+static void golden_pcm(int16_t *buf, int frames, int channels, int rate)
+{
+    int i, c;
+
+    for (i = 0; i < frames; i++)
+        for (c = 0; c < channels; c++)
+            buf[i * channels + c] = (short)(sin(2 * M_PI * (440 + 110 * c) * i / rate) * 24000)
+                                    + golden_noise(4000);
+}
+
+/* one IEC61937 burst of type filling the repetition period of frames */
+static void golden_iec61937(int16_t *buf, int frames, int channels, int type)
+{
+    int words = frames * channels;
+    int payload = words / 2;
+    int i;
+
+    memset(buf, 0, words * sizeof(int16_t));
+    buf[0] = (int16_t)IEC61937_PA;
+    buf[1] = (int16_t)IEC61937_PB;
+    buf[2] = (int16_t)type;
+    buf[3] = (int16_t)(type == IEC61937_AC3 ? payload * 16 : payload * 2);
+    for (i = 0; i < payload; i++)
+        buf[4 + i] = golden_noise(32767);
+}
+
+/**
+ * @brief golden_check_subframes
+ * check every subframe against the input word and the channel status
+ * block, independently of the reference
+ *
+ * @returns number of bad subframes
+ */
+static int golden_check_subframes(const int16_t *in, const uint8_t *out, int words,
+                                  const char *chan)
+{
+    int bad = 0;
+    int i, b;
+
+    for (i = 0; i < words; i++) {
+        const uint8_t *s = out + i * 4;
+        uint32_t w = s[0] | (s[1] << 8) | ((uint32_t)s[2] << 16);
+        uint8_t status = chan[i % CHASTA_SUB_NUM];
+        int parity = 0;
+        const char *what = NULL;
+
+        for (b = 0; b < 23; b++)
+            parity ^= (w >> b) & 1;
+        if ((uint16_t)(w >> 3) != (uint16_t)in[i])
+            what = "audio";
+        else if (parity)
+            what = "parity";
+        else if ((s[2] & SUBFRAME_C_BIT) != (status & SUBFRAME_C_BIT))
+            what = "channel status";
+        else if ((s[2] & SUBFRAME_V_BIT) != (status & SUBFRAME_V_BIT))
+            what = "validity";
+        else if (s[3])
+            what = "padding";
+        if (what && bad++ < 4)
+            printf("    subframe %d: bad %s bit(s), %02x %02x %02x %02x\n",
+                   i, what, s[0], s[1], s[2], s[3]);
+    }
+    return bad;
+}
+
+static int golden_bitstream(const struct golden_case *gc, uint8_t **result, size_t *size)
+{
+    int words = gc->frames * gc->channels;
+    int16_t *in = malloc(words * sizeof(int16_t));
+    uint8_t *out = malloc(words * 4);
+    char chan[CHASTA_SUB_NUM];
+    int bad;
+
+    if (!in || !out) {
+        free(in);
+        free(out);
+        return -1;
+    }
+    if (gc->kind == GOLDEN_PCM)
+        golden_pcm(in, gc->frames, gc->channels, gc->rate);
+    else
+        golden_iec61937(in, gc->frames, gc->channels, gc->param);
+
+    initchnsta(chan);
+    setChanSta(chan, gc->rate, gc->channels);
+    fill_hdmi_bitstream_buf(in, out, chan, words * sizeof(int16_t));
+
+    bad = golden_check_subframes(in, out, words, chan);
+    free(in);
+    *result = out;
+    *size = words * 4;
+    return bad ? -1 : 0;
+}
+
+static int golden_slice(const struct golden_case *gc, uint8_t **result, size_t *size)
+{
+    int bytes = gc->frames * gc->channels * sizeof(int16_t);
+    int16_t *buf = malloc(bytes);
+
+    if (!buf)
+        return -1;
+    golden_pcm(buf, gc->frames, gc->channels, gc->rate);
+    cal_data_slice(bytes, buf, bytes, gc->param, gc->down);
+    *result = (uint8_t *)buf;
+    *size = bytes;
+    return 0;
+}
+
+/**
+ * @brief golden_in_read
+ * capture the case through in_read of the hal, the fake card plays the
+ * input back from a file in a scratch directory
+ */
+static int golden_in_read(const struct golden_case *gc, uint8_t **result, size_t *size)
+{
+    char dir[] = "/tmp/golden_XXXXXX";
+    char path[64];
+    struct audio_hw_device *adev = NULL;
+    struct audio_stream_in *in = NULL;
+    struct audio_config config;
+    int16_t *pcm = NULL;
+    uint8_t *out = NULL;
+    size_t total = gc->frames * gc->channels * sizeof(int16_t), done = 0, bytes;
+    FILE *f;
+    int ret = -1;
+
+    if (!mkdtemp(dir))
+        return -1;
+    snprintf(path, sizeof(path), "%s/pcmC0D0c.raw", dir);
+    pcm = malloc(total);
+    out = malloc(total);
+    f = fopen(path, "wb");
+    if (!pcm || !out || !f)
+        goto exit;
+    golden_pcm(pcm, gc->frames, gc->channels, gc->rate);
+    fwrite(pcm, 1, total, f);
+    fclose(f);
+    f = NULL;
+    property_set("host.pcm.dir", dir);
+
+    if (HAL_MODULE_INFO_SYM.common.methods->open(&HAL_MODULE_INFO_SYM.common,
+                                                 AUDIO_HARDWARE_INTERFACE,
+                                                 (struct hw_device_t **)&adev))
+        goto exit;
+    memset(&config, 0, sizeof(config));
+    config.sample_rate = gc->rate;
+    config.channel_mask = AUDIO_CHANNEL_IN_STEREO;
+    config.format = AUDIO_FORMAT_PCM_16_BIT;
+    if (adev->open_input_stream(adev, 0, AUDIO_DEVICE_IN_BUILTIN_MIC, &config, &in,
+                                AUDIO_INPUT_FLAG_NONE, NULL, AUDIO_SOURCE_MIC))
+        goto exit;
+
+    bytes = in->common.get_buffer_size(&in->common);
+    while (done + bytes <= total) {
+        if (in->read(in, out + done, bytes) != (ssize_t)bytes)
+            goto exit;
+        done += bytes;
+    }
+    *result = out;
+    *size = done;
+    out = NULL;
+    ret = 0;
+
+exit:
+    if (in)
+        adev->close_input_stream(adev, in);
+    if (adev)
+        adev->common.close(&adev->common);
+    property_set("host.pcm.dir", "");
+    if (f)
+        fclose(f);
+    unlink(path);
+    rmdir(dir);
+    free(pcm);
+    free(out);
+    return ret;
+}
+
+static int golden_compare(const struct golden_case *gc, const uint8_t *result, size_t size,
+                          const uint8_t *ref, size_t ref_size)
+{
+    const int16_t *a = (const int16_t *)result, *b = (const int16_t *)ref;
+    size_t i, off = 0;
+    int diff, max = 0, count = 0;
+
+    if (size != ref_size) {
+        printf("    %zu bytes, reference has %zu\n", size, ref_size);
+        return -1;
+    }
+    if (!gc->tolerance) {
+        for (i = 0; i < size; i++) {
+            if (result[i] != ref[i]) {
+                printf("    first difference at byte %zu (subframe %zu): %02x, reference %02x\n",
+                       i, i / 4, result[i], ref[i]);
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    for (i = 0; i < size / 2; i++) {
+        diff = abs(a[i] - b[i]);
+        if (diff > gc->tolerance) {
+            if (!count)
+                off = i;
+            count++;
+        }
+        if (diff > max)
+            max = diff;
+    }
+    if (count) {
+        printf("    %d samples over %d LSB, first at %zu, max %d\n",
+               count, gc->tolerance, off, max);
+        return -1;
+    }
+    return 0;
+}
+
+static int golden_run(const struct golden_case *gc, const char *dir, bool update)
+{
+    char path[256];
+    uint8_t *result = NULL, *ref = NULL;
+    size_t size = 0, ref_size = 0;
+    long len;
+    FILE *f;
+    int ret;
+
+    golden_seed = 1;
+    switch (gc->kind) {
+    case GOLDEN_PCM:
+    case GOLDEN_IEC61937:
+        ret = golden_bitstream(gc, &result, &size);
+        break;
+    case GOLDEN_SLICE:
+        ret = golden_slice(gc, &result, &size);
+        break;
+    default:
+        ret = golden_in_read(gc, &result, &size);
+        break;
+    }
+    if (!result) {
+        printf("    can't run the case\n");
+        return -1;
+    }
+    if (ret < 0 && update) {
+        free(result);
+        return -1;
+    }
+
+    snprintf(path, sizeof(path), "%s/%s.raw", dir, gc->name);
+    if (update) {
+        f = fopen(path, "wb");
+        if (!f || fwrite(result, 1, size, f) != size) {
+            printf("    can't write %s: %s\n", path, strerror(errno));
+            ret = -1;
+        }
+        if (f)
+            fclose(f);
+        free(result);
+        return ret;
+    }
+
+    f = fopen(path, "rb");
+    if (!f) {
+        printf("    no reference %s\n", path);
+        free(result);
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    len = ftell(f);
+    rewind(f);
+    ref = malloc(len > 0 ? len : 1);
+    if (ref && len > 0)
+        ref_size = fread(ref, 1, len, f);
+    fclose(f);
+
+    if (!ref || golden_compare(gc, result, size, ref, ref_size) < 0)
+        ret = -1;
+    free(ref);
+    free(result);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    const char *dir = GOLDEN_DIR_DEFAULT;
+    bool update = false;
+    int failed = 0, ran = 0;
+    int i, k;
+
+    for (i = 1; i < argc && argv[i][0] == '-'; i++) {
+        if (!strcmp(argv[i], "-d") && i + 1 < argc)
+            dir = argv[++i];
+        else if (!strcmp(argv[i], "-u"))
+            update = true;
+        else
+            break;
+    }
+    if (i < argc && argv[i][0] == '-') {
+        printf("usage: golden_test [-d golden_dir] [-u] [case...]\n");
+        return -1;
+    }
+
+    for (k = 0; k < GOLDEN_CASES; k++) {
+        int j, selected = (i == argc);
+
+        for (j = i; j < argc; j++)
+            if (!strcmp(argv[j], golden_cases[k].name))
+                selected = 1;
+        if (!selected)
+            continue;
+
+        if (golden_run(&golden_cases[k], dir, update) < 0) {
+            printf("%-20s FAIL\n", golden_cases[k].name);
+            failed++;
+        } else {
+            printf("%-20s %s\n", golden_cases[k].name, update ? "updated" : "ok");
+        }
+        ran++;
+    }
+
+    printf("%d of %d cases %s\n", ran - failed, ran, update ? "updated" : "passed");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file    hal_play.c
+ * @brief   play a tone through the hal on the host build
+ *
+ * Opens the hal the way the audio server does, plays a sine on the
+ * primary output and reports the time spent in write(), the xruns of
+ * the fake card and the control writes the routing cost.
+ *
+ * usage: hal_play [-d ms] [-r rate] [-o device] [-v]
+ *        -o takes an AUDIO_DEVICE_OUT_* mask, -v dumps the hal at the end
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <hardware/audio.h>
+#include <hardware/hardware.h>
+
+#include "fake_ctl.h"
+#include "fake_pcm.h"
+
+#define PLAY_MS_DEFAULT     (2000)
+#define PLAY_RATE_DEFAULT   (44100)
+#define PLAY_TONE_HZ        (1000.0)
+
+extern struct audio_module HAL_MODULE_INFO_SYM;
+
+static int64_t play_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+    struct audio_config config;
+    struct audio_hw_device *adev;
+    struct audio_stream_out *out;
+    struct fake_pcm_stats stats;
+    struct timespec ts;
+    unsigned device = AUDIO_DEVICE_OUT_SPEAKER;
+    unsigned rate = PLAY_RATE_DEFAULT;
+    int play_ms = PLAY_MS_DEFAULT;
+    int verbose = 0;
+    int64_t start, open_ns, first_ns = 0, dt, total_ns = 0, max_ns = 0;
+    uint64_t frames = 0, target, presented;
+    size_t bytes, buffer_frames, i;
+    unsigned writes = 0, ctl_writes;
+    int16_t *buffer;
+    ssize_t ret;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "d:r:o:v")) != -1) {
+        switch (opt) {
+        case 'd':
+            play_ms = atoi(optarg);
+            break;
+        case 'r':
+            rate = atoi(optarg);
+            break;
+        case 'o':
+            device = strtoul(optarg, NULL, 0);
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        default:
+            printf("usage: hal_play [-d ms] [-r rate] [-o device] [-v]\n");
+            return -1;
+        }
+    }
+    if ((play_ms <= 0) || !rate) {
+        printf("duration and rate must be positive\n");
+        return -1;
+    }
+
+    start = play_now_ns();
+    if (HAL_MODULE_INFO_SYM.common.methods->open(&HAL_MODULE_INFO_SYM.common,
+                                                 AUDIO_HARDWARE_INTERFACE,
+                                                 (struct hw_device_t **)&adev)) {
+        printf("can't open the hal\n");
+        return -1;
+    }
+    open_ns = play_now_ns() - start;
+
+    memset(&config, 0, sizeof(config));
+    config.sample_rate = rate;
+    config.channel_mask = AUDIO_CHANNEL_OUT_STEREO;
+    config.format = AUDIO_FORMAT_PCM_16_BIT;
+    if (adev->open_output_stream(adev, 0, device, AUDIO_OUTPUT_FLAG_PRIMARY, &config, &out,
+                                 NULL)) {
+        printf("can't open the output\n");
+        adev->common.close(&adev->common);
+        return -1;
+    }
+
+    bytes = out->common.get_buffer_size(&out->common);
+    buffer_frames = bytes / audio_stream_out_frame_size(out);
+    rate = out->common.get_sample_rate(&out->common);
+    buffer = malloc(bytes);
+    if (!buffer || !buffer_frames) {
+        printf("out of memory\n");
+        return -1;
+    }
+    printf("output: device 0x%x, %u Hz, %zu frames per write, latency %u ms\n", device, rate,
+           buffer_frames, out->get_latency(out));
+
+    ctl_writes = fake_ctl_writes(0);
+    target = (uint64_t)rate * play_ms / 1000;
+    start = play_now_ns();
+    while (frames < target) {
+        for (i = 0; i < buffer_frames; i++)
+            buffer[2 * i] = buffer[2 * i + 1] =
+                (int16_t)(8000 * sin(2 * M_PI * PLAY_TONE_HZ * (frames + i) / rate));
+        dt = play_now_ns();
+        ret = out->write(out, buffer, bytes);
+        dt = play_now_ns() - dt;
+        if (ret < 0) {
+            printf("write failed: %zd\n", ret);
+            break;
+        }
+        if (!writes)
+            first_ns = dt;
+        total_ns += dt;
+        if (dt > max_ns)
+            max_ns = dt;
+        frames += buffer_frames;
+        writes++;
+    }
+    dt = play_now_ns() - start;
+
+    printf("hal open       %10.1f ms\n", open_ns / 1000000.0);
+    printf("first write    %10.1f ms  (stream start and routing)\n", first_ns / 1000000.0);
+    printf("writes         %10u     avg %.1f us, max %.1f us\n", writes,
+           writes ? total_ns / 1000.0 / writes : 0.0, max_ns / 1000.0);
+    printf("played         %10.1f ms  in %.1f ms\n", frames * 1000.0 / rate, dt / 1000000.0);
+    if (!out->get_presentation_position(out, &presented, &ts))
+        printf("presented      %10llu frames\n", (unsigned long long)presented);
+
+    fake_pcm_get_stats(&stats);
+    printf("card           %10u opens, %llu frames, %u xruns (%u forced)\n", stats.opens,
+           stats.frames_written, stats.xruns, stats.xruns_forced);
+    printf("control writes %10u\n", fake_ctl_writes(0) - ctl_writes);
+
+    out->common.standby(&out->common);
+    if (verbose)
+        adev->dump(adev, STDOUT_FILENO);
+    adev->close_output_stream(adev, out);
+    adev->common.close(&adev->common);
+    free(buffer);
+    return 0;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file audio_utils/resampler.h
+ * @brief host build shim for the libaudioutils resampler interface
+ */
+
+#ifndef HOST_AUDIO_UTILS_RESAMPLER_H
+#define HOST_AUDIO_UTILS_RESAMPLER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define RESAMPLER_QUALITY_MAX 10
+#define RESAMPLER_QUALITY_MIN 0
+#define RESAMPLER_QUALITY_DEFAULT 4
+#define RESAMPLER_QUALITY_VOIP 3
+#define RESAMPLER_QUALITY_DESKTOP 5
+
+struct resampler_buffer {
+    union {
+        void *raw;
+        int16_t *i16;
+        int8_t *i8;
+    };
+    size_t frame_count;
+};
+
+struct resampler_buffer_provider {
+    int (*get_next_buffer)(struct resampler_buffer_provider *provider,
+                           struct resampler_buffer *buffer);
+    void (*release_buffer)(struct resampler_buffer_provider *provider,
+                           struct resampler_buffer *buffer);
+};
+
+struct resampler_itfe {
+    void (*reset)(struct resampler_itfe *resampler);
+    int (*resample_from_provider)(struct resampler_itfe *resampler,
+                                  int16_t *out, size_t *outFrameCount);
+    int (*resample_from_input)(struct resampler_itfe *resampler,
+                               int16_t *in, size_t *inFrameCount,
+                               int16_t *out, size_t *outFrameCount);
+    int32_t (*delay_ns)(struct resampler_itfe *resampler);
+};
+
+int create_resampler(uint32_t inSampleRate, uint32_t outSampleRate,
+                     uint32_t channelCount, uint32_t quality,
+                     struct resampler_buffer_provider *provider,
+                     struct resampler_itfe **);
+void release_resampler(struct resampler_itfe *);
+
+#endif
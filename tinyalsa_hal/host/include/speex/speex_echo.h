@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file speex/speex_echo.h
+ * @brief host build shim for the speex acoustic echo canceller
+ */
+
+#ifndef HOST_SPEEX_ECHO_H
+#define HOST_SPEEX_ECHO_H
+
+#include <speex/speex.h>
+
+struct SpeexEchoState_;
+typedef struct SpeexEchoState_ SpeexEchoState;
+
+#define SPEEX_ECHO_GET_FRAME_SIZE 3
+#define SPEEX_ECHO_SET_SAMPLING_RATE 24
+#define SPEEX_ECHO_GET_SAMPLING_RATE 25
+
+SpeexEchoState *speex_echo_state_init(int frame_size, int filter_length);
+void speex_echo_state_destroy(SpeexEchoState *st);
+void speex_echo_cancellation(SpeexEchoState *st, const spx_int16_t *rec,
+                             const spx_int16_t *play, spx_int16_t *out);
+void speex_echo_state_reset(SpeexEchoState *st);
+int speex_echo_ctl(SpeexEchoState *st, int request, void *ptr);
+
+#endif
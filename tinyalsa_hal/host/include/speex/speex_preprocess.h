@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file speex/speex_preprocess.h
+ * @brief host build shim for the speex preprocessor
+ */
+
+#ifndef HOST_SPEEX_PREPROCESS_H
+#define HOST_SPEEX_PREPROCESS_H
+
+#include <speex/speex.h>
+
+struct SpeexPreprocessState_;
+typedef struct SpeexPreprocessState_ SpeexPreprocessState;
+
+#define SPEEX_PREPROCESS_SET_DENOISE 0
+#define SPEEX_PREPROCESS_GET_DENOISE 1
+#define SPEEX_PREPROCESS_SET_AGC 2
+#define SPEEX_PREPROCESS_GET_AGC 3
+#define SPEEX_PREPROCESS_SET_VAD 4
+#define SPEEX_PREPROCESS_GET_VAD 5
+#define SPEEX_PREPROCESS_SET_AGC_LEVEL 6
+#define SPEEX_PREPROCESS_GET_AGC_LEVEL 7
+#define SPEEX_PREPROCESS_SET_DEREVERB 8
+#define SPEEX_PREPROCESS_GET_DEREVERB 9
+#define SPEEX_PREPROCESS_SET_NOISE_SUPPRESS 18
+#define SPEEX_PREPROCESS_GET_NOISE_SUPPRESS 19
+#define SPEEX_PREPROCESS_SET_ECHO_SUPPRESS 20
+#define SPEEX_PREPROCESS_GET_ECHO_SUPPRESS 21
+#define SPEEX_PREPROCESS_SET_ECHO_SUPPRESS_ACTIVE 22
+#define SPEEX_PREPROCESS_GET_ECHO_SUPPRESS_ACTIVE 23
+#define SPEEX_PREPROCESS_SET_ECHO_STATE 24
+#define SPEEX_PREPROCESS_GET_ECHO_STATE 25
+
+SpeexPreprocessState *speex_preprocess_state_init(int frame_size, int sampling_rate);
+void speex_preprocess_state_destroy(SpeexPreprocessState *st);
+int speex_preprocess_run(SpeexPreprocessState *st, spx_int16_t *x);
+int speex_preprocess_ctl(SpeexPreprocessState *st, int request, void *ptr);
+
+#endif
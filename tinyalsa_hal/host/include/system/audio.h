@@ -0,0 +1,219 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file system/audio.h
+ * @brief host build shim, the subset of the android audio types and
+ *        constants the hal uses, with the same values as the platform
+ */
+
+#ifndef HOST_SYSTEM_AUDIO_H
+#define HOST_SYSTEM_AUDIO_H
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/cdefs.h>
+
+#ifndef __unused
+#define __unused __attribute__((__unused__))
+#endif
+
+typedef uint32_t audio_devices_t;
+typedef uint32_t audio_channel_mask_t;
+typedef uint32_t audio_format_t;
+typedef int audio_source_t;
+typedef int audio_mode_t;
+typedef int audio_io_handle_t;
+typedef uint32_t audio_output_flags_t;
+typedef uint32_t audio_input_flags_t;
+
+enum {
+    AUDIO_DEVICE_NONE                          = 0x0,
+    AUDIO_DEVICE_BIT_IN                        = 0x80000000,
+
+    AUDIO_DEVICE_OUT_EARPIECE                  = 0x1,
+    AUDIO_DEVICE_OUT_SPEAKER                   = 0x2,
+    AUDIO_DEVICE_OUT_WIRED_HEADSET             = 0x4,
+    AUDIO_DEVICE_OUT_WIRED_HEADPHONE           = 0x8,
+    AUDIO_DEVICE_OUT_BLUETOOTH_SCO             = 0x10,
+    AUDIO_DEVICE_OUT_BLUETOOTH_SCO_HEADSET     = 0x20,
+    AUDIO_DEVICE_OUT_BLUETOOTH_SCO_CARKIT      = 0x40,
+    AUDIO_DEVICE_OUT_BLUETOOTH_A2DP            = 0x80,
+    AUDIO_DEVICE_OUT_AUX_DIGITAL               = 0x400,
+    AUDIO_DEVICE_OUT_HDMI                      = AUDIO_DEVICE_OUT_AUX_DIGITAL,
+    AUDIO_DEVICE_OUT_ANLG_DOCK_HEADSET         = 0x800,
+    AUDIO_DEVICE_OUT_DGTL_DOCK_HEADSET         = 0x1000,
+    AUDIO_DEVICE_OUT_USB_ACCESSORY             = 0x2000,
+    AUDIO_DEVICE_OUT_USB_DEVICE                = 0x4000,
+    AUDIO_DEVICE_OUT_REMOTE_SUBMIX             = 0x8000,
+    AUDIO_DEVICE_OUT_SPDIF                     = 0x80000,
+    AUDIO_DEVICE_OUT_ALL_SCO                   = (AUDIO_DEVICE_OUT_BLUETOOTH_SCO |
+                                                  AUDIO_DEVICE_OUT_BLUETOOTH_SCO_HEADSET |
+                                                  AUDIO_DEVICE_OUT_BLUETOOTH_SCO_CARKIT),
+
+    AUDIO_DEVICE_IN_COMMUNICATION              = AUDIO_DEVICE_BIT_IN | 0x1,
+    AUDIO_DEVICE_IN_AMBIENT                    = AUDIO_DEVICE_BIT_IN | 0x2,
+    AUDIO_DEVICE_IN_BUILTIN_MIC                = AUDIO_DEVICE_BIT_IN | 0x4,
+    AUDIO_DEVICE_IN_BLUETOOTH_SCO_HEADSET      = AUDIO_DEVICE_BIT_IN | 0x8,
+    AUDIO_DEVICE_IN_WIRED_HEADSET              = AUDIO_DEVICE_BIT_IN | 0x10,
+    AUDIO_DEVICE_IN_AUX_DIGITAL                = AUDIO_DEVICE_BIT_IN | 0x20,
+    AUDIO_DEVICE_IN_HDMI                       = AUDIO_DEVICE_IN_AUX_DIGITAL,
+    AUDIO_DEVICE_IN_VOICE_CALL                 = AUDIO_DEVICE_BIT_IN | 0x40,
+    AUDIO_DEVICE_IN_BACK_MIC                   = AUDIO_DEVICE_BIT_IN | 0x80,
+    AUDIO_DEVICE_IN_ANLG_DOCK_HEADSET          = AUDIO_DEVICE_BIT_IN | 0x200,
+};
+
+enum {
+    AUDIO_CHANNEL_OUT_FRONT_LEFT    = 0x1,
+    AUDIO_CHANNEL_OUT_FRONT_RIGHT   = 0x2,
+    AUDIO_CHANNEL_OUT_FRONT_CENTER  = 0x4,
+    AUDIO_CHANNEL_OUT_LOW_FREQUENCY = 0x8,
+    AUDIO_CHANNEL_OUT_BACK_LEFT     = 0x10,
+    AUDIO_CHANNEL_OUT_BACK_RIGHT    = 0x20,
+    AUDIO_CHANNEL_OUT_SIDE_LEFT     = 0x200,
+    AUDIO_CHANNEL_OUT_SIDE_RIGHT    = 0x400,
+
+    AUDIO_CHANNEL_OUT_MONO     = AUDIO_CHANNEL_OUT_FRONT_LEFT,
+    AUDIO_CHANNEL_OUT_STEREO   = (AUDIO_CHANNEL_OUT_FRONT_LEFT | AUDIO_CHANNEL_OUT_FRONT_RIGHT),
+    AUDIO_CHANNEL_OUT_5POINT1  = (AUDIO_CHANNEL_OUT_STEREO | AUDIO_CHANNEL_OUT_FRONT_CENTER |
+                                  AUDIO_CHANNEL_OUT_LOW_FREQUENCY | AUDIO_CHANNEL_OUT_BACK_LEFT |
+                                  AUDIO_CHANNEL_OUT_BACK_RIGHT),
+    AUDIO_CHANNEL_OUT_7POINT1  = (AUDIO_CHANNEL_OUT_5POINT1 | AUDIO_CHANNEL_OUT_SIDE_LEFT |
+                                  AUDIO_CHANNEL_OUT_SIDE_RIGHT),
+
+    AUDIO_CHANNEL_IN_LEFT      = 0x4,
+    AUDIO_CHANNEL_IN_RIGHT     = 0x8,
+    AUDIO_CHANNEL_IN_FRONT     = 0x10,
+    AUDIO_CHANNEL_IN_BACK      = 0x20,
+    AUDIO_CHANNEL_IN_MONO       = AUDIO_CHANNEL_IN_FRONT,
+    AUDIO_CHANNEL_IN_STEREO     = (AUDIO_CHANNEL_IN_LEFT | AUDIO_CHANNEL_IN_RIGHT),
+    AUDIO_CHANNEL_IN_FRONT_BACK = (AUDIO_CHANNEL_IN_FRONT | AUDIO_CHANNEL_IN_BACK),
+};
+
+enum {
+    AUDIO_FORMAT_DEFAULT    = 0,
+    AUDIO_FORMAT_PCM_16_BIT = 0x1,
+    AUDIO_FORMAT_PCM_8_BIT  = 0x2,
+    AUDIO_FORMAT_PCM_32_BIT = 0x3,
+    AUDIO_FORMAT_PCM_FLOAT  = 0x5,
+    AUDIO_FORMAT_IEC61937   = 0x0D000000,
+};
+
+enum {
+    AUDIO_OUTPUT_FLAG_NONE        = 0x0,
+    AUDIO_OUTPUT_FLAG_DIRECT      = 0x1,
+    AUDIO_OUTPUT_FLAG_PRIMARY     = 0x2,
+    AUDIO_OUTPUT_FLAG_FAST        = 0x4,
+    AUDIO_OUTPUT_FLAG_DEEP_BUFFER = 0x8,
+};
+
+enum {
+    AUDIO_INPUT_FLAG_NONE = 0x0,
+    AUDIO_INPUT_FLAG_FAST = 0x1,
+};
+
+enum {
+    AUDIO_SOURCE_DEFAULT             = 0,
+    AUDIO_SOURCE_MIC                 = 1,
+    AUDIO_SOURCE_VOICE_UPLINK        = 2,
+    AUDIO_SOURCE_VOICE_DOWNLINK      = 3,
+    AUDIO_SOURCE_VOICE_CALL          = 4,
+    AUDIO_SOURCE_CAMCORDER           = 5,
+    AUDIO_SOURCE_VOICE_RECOGNITION   = 6,
+    AUDIO_SOURCE_VOICE_COMMUNICATION = 7,
+};
+
+enum {
+    AUDIO_MODE_NORMAL           = 0,
+    AUDIO_MODE_RINGTONE         = 1,
+    AUDIO_MODE_IN_CALL          = 2,
+    AUDIO_MODE_IN_COMMUNICATION = 3,
+};
+
+typedef struct {
+    uint16_t version;
+    uint16_t size;
+    audio_channel_mask_t channel_mask;
+    uint32_t sample_rate;
+    int64_t duration_us;
+    uint32_t bit_rate;
+    audio_format_t format;
+    int stream_type;
+    bool has_video;
+    bool is_streaming;
+} audio_offload_info_t;
+
+struct audio_config {
+    uint32_t sample_rate;
+    audio_channel_mask_t channel_mask;
+    audio_format_t format;
+    audio_offload_info_t offload_info;
+    size_t frame_count;
+};
+
+static inline int popcount(unsigned int x)
+{
+    return __builtin_popcount(x);
+}
+
+static inline uint32_t audio_channel_count_from_in_mask(audio_channel_mask_t channel)
+{
+    return popcount(channel & (AUDIO_CHANNEL_IN_LEFT | AUDIO_CHANNEL_IN_RIGHT |
+                               AUDIO_CHANNEL_IN_FRONT | AUDIO_CHANNEL_IN_BACK));
+}
+
+static inline uint32_t audio_channel_count_from_out_mask(audio_channel_mask_t channel)
+{
+    return popcount(channel & 0x3ffff);
+}
+
+static inline size_t audio_bytes_per_sample(audio_format_t format)
+{
+    switch (format) {
+    case AUDIO_FORMAT_PCM_32_BIT:
+    case AUDIO_FORMAT_PCM_FLOAT:
+        return 4;
+    case AUDIO_FORMAT_PCM_8_BIT:
+        return 1;
+    case AUDIO_FORMAT_PCM_16_BIT:
+    case AUDIO_FORMAT_IEC61937:
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+#endif
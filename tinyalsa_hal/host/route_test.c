@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file    route_test.c
+ * @brief   host test of the mixers alsa_route.c keeps open per card
+ *
+ * Playback and capture share card 0 of the fake control device. The id
+ * the card reports changes between two route_pcm_open() calls, as when
+ * a USB card is enumerated again under the same index, and the mixer
+ * the other direction still holds must follow the cache to the new one.
+ * Run it in the address sanitizer build to catch a use of the old mixer.
+ * Card 2 holds two test controls for the order set_controls() writes a
+ * table in and for the shadow it skips unchanged values with.
+ *
+ * usage: route_test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "alsa_audio.h"
+#include "codec_config/config.h"
+#include "fake_ctl.h"
+
+extern struct mixer *mMixerPlayback;
+extern struct mixer *mMixerCapture;
+extern int set_controls(struct mixer *mixer, const struct config_control *ctls,
+                        const unsigned ctls_count, struct mixer_ctl **cache);
+
+#define TEST_CARD 2
+
+static const char * const test_mux_items[] = { "A", "B" };
+
+static int route_test_failed;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("    %s:%d: %s\n", __func__, __LINE__, #cond); \
+            route_test_failed = 1; \
+        } \
+    } while (0)
+
+/**
+ * @brief test_swap_playback
+ *        the id changes before a playback route, capture holds the mixer
+ */
+static void test_swap_playback(void)
+{
+    struct mixer *before;
+    unsigned writes;
+
+    route_pcm_open(MAIN_MIC_CAPTURE_ROUTE);
+    route_pcm_open(SPEAKER_NORMAL_ROUTE);
+    before = route_mixer_get(0);
+    CHECK(before && mMixerPlayback == before && mMixerCapture == before);
+
+    fake_ctl_set_id(0, "HOSTSWAPA");
+    route_pcm_open(SPEAKER_NORMAL_ROUTE);
+    CHECK(mMixerPlayback && mMixerPlayback != before);
+    CHECK(mMixerPlayback == route_mixer_get(0));
+    CHECK(mMixerCapture == mMixerPlayback);
+
+    // the capture off route goes through mMixerCapture
+    writes = fake_ctl_writes(0);
+    route_pcm_open(MAIN_MIC_CAPTURE_ROUTE);
+    CHECK(mMixerCapture == route_mixer_get(0));
+    CHECK(fake_ctl_writes(0) > writes);
+}
+
+/**
+ * @brief test_swap_prepare
+ *        the id changes and route_prepare() finds it first, both
+ *        directions hold the mixer
+ */
+static void test_swap_prepare(void)
+{
+    struct mixer *before;
+
+    route_pcm_open(MAIN_MIC_CAPTURE_ROUTE);
+    route_pcm_open(SPEAKER_NORMAL_ROUTE);
+    before = route_mixer_get(0);
+
+    fake_ctl_set_id(0, "HOSTSWAPB");
+    CHECK(route_prepare(SPEAKER_NORMAL_ROUTE) == 0);
+    CHECK(mMixerPlayback && mMixerPlayback != before);
+    CHECK(mMixerPlayback == route_mixer_get(0));
+    CHECK(mMixerCapture == mMixerPlayback);
+
+    route_pcm_open(SPEAKER_NORMAL_ROUTE);
+    route_pcm_open(MAIN_MIC_CAPTURE_ROUTE);
+    CHECK(mMixerPlayback == route_mixer_get(0) && mMixerCapture == mMixerPlayback);
+}
+
+/**
+ * @brief test_same_id
+ *        an unchanged id keeps the mixer across routes
+ */
+static void test_same_id(void)
+{
+    struct mixer *before;
+
+    route_pcm_open(SPEAKER_NORMAL_ROUTE);
+    before = mMixerPlayback;
+    route_pcm_open(MAIN_MIC_CAPTURE_ROUTE);
+    route_pcm_open(SPEAKER_NORMAL_ROUTE);
+    CHECK(before && mMixerPlayback == before && mMixerCapture == before);
+}
+
+/**
+ * @brief test_card_setup
+ *        give the test card its controls once, switch on and mux on "A"
+ */
+static struct mixer *test_card_setup(void)
+{
+    static int added;
+
+    if (!added) {
+        fake_ctl_add_bool(TEST_CARD, "Test Switch", 1, 1);
+        fake_ctl_add_enum(TEST_CARD, "Test Mux", test_mux_items, 2, 0);
+        added = 1;
+    }
+    fake_ctl_set(TEST_CARD, "Test Switch", 1, 1);
+    fake_ctl_set(TEST_CARD, "Test Mux", 0, 0);
+    return route_mixer_get(TEST_CARD);
+}
+
+/**
+ * @brief test_mute_unmute
+ *        a switch turned off around a path change is written both times,
+ *        in table order, although it ends on the value it started with
+ */
+static void test_mute_unmute(void)
+{
+    static const struct config_control table[] = {
+        { .ctl_name = "Test Switch", .int_val = { 0, 0 } },
+        { .ctl_name = "Test Mux", .str_val = "B" },
+        { .ctl_name = "Test Switch", .int_val = { 1, 1 } },
+    };
+    struct mixer *mixer = test_card_setup();
+    unsigned writes;
+
+    CHECK(mixer != NULL);
+    if (!mixer)
+        return;
+    mixer_shadow_invalidate(mixer);
+    writes = fake_ctl_writes(TEST_CARD);
+    CHECK(set_controls(mixer, table, 3, NULL) == 0);
+    CHECK(fake_ctl_writes(TEST_CARD) - writes == 3);
+    CHECK(fake_ctl_get(TEST_CARD, "Test Switch", 0) == 1);
+    CHECK(fake_ctl_get(TEST_CARD, "Test Mux", 0) == 1);
+
+    // the same table again, the mux is already on "B"
+    writes = fake_ctl_writes(TEST_CARD);
+    CHECK(set_controls(mixer, table, 3, NULL) == 0);
+    CHECK(fake_ctl_writes(TEST_CARD) - writes == 2);
+}
+
+/**
+ * @brief test_outside_write
+ *        a control changed behind the shadow is written again once the
+ *        shadows are invalidated, as on a stream start
+ */
+static void test_outside_write(void)
+{
+    static const struct config_control table[] = {
+        { .ctl_name = "Test Mux", .str_val = "B" },
+    };
+    struct mixer *mixer = test_card_setup();
+    unsigned writes;
+
+    CHECK(mixer != NULL);
+    if (!mixer)
+        return;
+    CHECK(set_controls(mixer, table, 1, NULL) == 0);
+    CHECK(fake_ctl_get(TEST_CARD, "Test Mux", 0) == 1);
+
+    fake_ctl_set(TEST_CARD, "Test Mux", 0, 0);
+    writes = fake_ctl_writes(TEST_CARD);
+    CHECK(set_controls(mixer, table, 1, NULL) == 0);
+    CHECK(fake_ctl_writes(TEST_CARD) == writes);
+
+    route_worker_lock();
+    route_mixer_invalidate();
+    route_worker_unlock();
+    CHECK(set_controls(mixer, table, 1, NULL) == 0);
+    CHECK(fake_ctl_writes(TEST_CARD) - writes == 1);
+    CHECK(fake_ctl_get(TEST_CARD, "Test Mux", 0) == 1);
+}
+
+static const struct {
+    const char *name;
+    void (*run)(void);
+} route_tests[] = {
+    { "swap_playback", test_swap_playback },
+    { "swap_prepare", test_swap_prepare },
+    { "same_id", test_same_id },
+    { "mute_unmute", test_mute_unmute },
+    { "outside_write", test_outside_write },
+};
+#define ROUTE_TESTS (int)(sizeof(route_tests) / sizeof(route_tests[0]))
+
+int main(void)
+{
+    int i, failed = 0;
+
+    for (i = 0; i < ROUTE_TESTS; i++) {
+        route_test_failed = 0;
+        fake_ctl_set_id(0, NULL);
+        route_init();
+        route_tests[i].run();
+        route_uninit();
+        printf("%-20s %s\n", route_tests[i].name, route_test_failed ? "FAIL" : "ok");
+        failed += route_test_failed;
+    }
+    printf("%d of %d cases passed\n", ROUTE_TESTS - failed, ROUTE_TESTS);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,660 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file shims.c
+ * @brief host build implementations of the platform libraries the hal
+ *        links against: liblog, the property store, str_parms, the
+ *        libaudioutils and speex resamplers, speex dsp and uevent.
+ *
+ * The resamplers are linear interpolators and the speex echo canceller
+ * and preprocessor pass the capture through, enough to run the data
+ * paths and keep their timing, not to judge audio quality.
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cutils/log.h>
+#include <cutils/properties.h>
+#include <cutils/str_parms.h>
+#include <audio_utils/resampler.h>
+#include <audio_route/audio_route.h>
+#include <hardware/audio.h>
+#include <hardware/hardware.h>
+#include <hardware_legacy/uevent.h>
+#include <speex/speex_echo.h>
+#include <speex/speex_preprocess.h>
+#include <speex/speex_resampler.h>
+
+/* log */
+
+static int host_log_level(void)
+{
+    static int level = -1;
+
+    if (level < 0) {
+        const char *env = getenv("HOST_LOG");
+        level = env ? atoi(env) : 1;
+    }
+    return level;
+}
+
+void host_log_print(char prio, const char *tag, const char *fmt, ...)
+{
+    va_list ap;
+    int level;
+
+    switch (prio) {
+    case 'E': level = 0; break;
+    case 'W': level = 1; break;
+    case 'I':
+    case 'D': level = 2; break;
+    default: level = 3; break;
+    }
+    if (level > host_log_level())
+        return;
+
+    fprintf(stderr, "%c %s: ", prio, tag ? tag : "");
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+}
+
+/* properties */
+
+#define HOST_PROP_MAX 128
+
+struct host_prop {
+    char key[PROPERTY_KEY_MAX * 2];
+    char value[PROPERTY_VALUE_MAX];
+};
+
+static struct host_prop host_props[HOST_PROP_MAX];
+static int host_prop_count;
+static pthread_mutex_t host_prop_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct host_prop *host_prop_find(const char *key)
+{
+    int i;
+
+    for (i = 0; i < host_prop_count; i++)
+        if (!strcmp(host_props[i].key, key))
+            return &host_props[i];
+    return NULL;
+}
+
+int property_get(const char *key, char *value, const char *default_value)
+{
+    char env[PROPERTY_KEY_MAX * 2 + 16] = "HOST_PROP_";
+    struct host_prop *prop;
+    const char *v = NULL;
+    char *p;
+    int len;
+
+    pthread_mutex_lock(&host_prop_lock);
+    prop = host_prop_find(key);
+    if (prop)
+        v = prop->value;
+    pthread_mutex_unlock(&host_prop_lock);
+
+    if (v == NULL) {
+        strncat(env, key, sizeof(env) - strlen(env) - 1);
+        for (p = env; *p; p++)
+            if (!isalnum((unsigned char)*p))
+                *p = '_';
+        v = getenv(env);
+    }
+    if (v == NULL)
+        v = default_value ? default_value : "";
+
+    len = strlen(v);
+    if (len >= PROPERTY_VALUE_MAX)
+        len = PROPERTY_VALUE_MAX - 1;
+    memcpy(value, v, len);
+    value[len] = '\0';
+    return len;
+}
+
+int property_set(const char *key, const char *value)
+{
+    struct host_prop *prop;
+
+    pthread_mutex_lock(&host_prop_lock);
+    prop = host_prop_find(key);
+    if (prop == NULL) {
+        if (host_prop_count == HOST_PROP_MAX) {
+            pthread_mutex_unlock(&host_prop_lock);
+            return -1;
+        }
+        prop = &host_props[host_prop_count++];
+        snprintf(prop->key, sizeof(prop->key), "%s", key);
+    }
+    snprintf(prop->value, sizeof(prop->value), "%s", value ? value : "");
+    pthread_mutex_unlock(&host_prop_lock);
+    return 0;
+}
+
+bool property_get_bool(const char *key, bool default_value)
+{
+    char value[PROPERTY_VALUE_MAX];
+
+    if (property_get(key, value, NULL) == 0)
+        return default_value;
+    if (!strcmp(value, "1") || !strcmp(value, "y") || !strcmp(value, "yes")
+            || !strcmp(value, "on") || !strcmp(value, "true"))
+        return true;
+    if (!strcmp(value, "0") || !strcmp(value, "n") || !strcmp(value, "no")
+            || !strcmp(value, "off") || !strcmp(value, "false"))
+        return false;
+    return default_value;
+}
+
+/* str_parms, kept as an ordered list of key value pairs */
+
+struct str_parm {
+    char *key;
+    char *value;
+    struct str_parm *next;
+};
+
+struct str_parms {
+    struct str_parm *head;
+};
+
+struct str_parms *str_parms_create(void)
+{
+    return calloc(1, sizeof(struct str_parms));
+}
+
+static struct str_parm *str_parms_find(struct str_parms *str_parms, const char *key)
+{
+    struct str_parm *parm;
+
+    for (parm = str_parms->head; parm; parm = parm->next)
+        if (!strcmp(parm->key, key))
+            return parm;
+    return NULL;
+}
+
+int str_parms_add_str(struct str_parms *str_parms, const char *key,
+                      const char *value)
+{
+    struct str_parm *parm = str_parms_find(str_parms, key);
+    struct str_parm **tail;
+    char *v = strdup(value);
+
+    if (v == NULL)
+        return -ENOMEM;
+    if (parm) {
+        free(parm->value);
+        parm->value = v;
+        return 0;
+    }
+    parm = calloc(1, sizeof(*parm));
+    if (parm == NULL || (parm->key = strdup(key)) == NULL) {
+        free(parm);
+        free(v);
+        return -ENOMEM;
+    }
+    parm->value = v;
+    for (tail = &str_parms->head; *tail; tail = &(*tail)->next)
+        ;
+    *tail = parm;
+    return 0;
+}
+
+int str_parms_add_int(struct str_parms *str_parms, const char *key, int value)
+{
+    char buf[16];
+
+    snprintf(buf, sizeof(buf), "%d", value);
+    return str_parms_add_str(str_parms, key, buf);
+}
+
+struct str_parms *str_parms_create_str(const char *_string)
+{
+    struct str_parms *str_parms = str_parms_create();
+    char *str, *tmp, *kvpair;
+
+    if (str_parms == NULL || _string == NULL)
+        return str_parms;
+    str = strdup(_string);
+    if (str == NULL)
+        return str_parms;
+
+    for (kvpair = strtok_r(str, ";", &tmp); kvpair; kvpair = strtok_r(NULL, ";", &tmp)) {
+        char *eq = strchr(kvpair, '=');
+
+        if (eq == kvpair)
+            continue;
+        if (eq) {
+            *eq = '\0';
+            str_parms_add_str(str_parms, kvpair, eq + 1);
+        } else {
+            str_parms_add_str(str_parms, kvpair, "");
+        }
+    }
+    free(str);
+    return str_parms;
+}
+
+void str_parms_del(struct str_parms *str_parms, const char *key)
+{
+    struct str_parm **pp, *parm;
+
+    for (pp = &str_parms->head; (parm = *pp) != NULL; pp = &parm->next) {
+        if (!strcmp(parm->key, key)) {
+            *pp = parm->next;
+            free(parm->key);
+            free(parm->value);
+            free(parm);
+            return;
+        }
+    }
+}
+
+void str_parms_destroy(struct str_parms *str_parms)
+{
+    while (str_parms && str_parms->head)
+        str_parms_del(str_parms, str_parms->head->key);
+    free(str_parms);
+}
+
+int str_parms_has_key(struct str_parms *str_parms, const char *key)
+{
+    return str_parms_find(str_parms, key) != NULL;
+}
+
+int str_parms_get_str(struct str_parms *str_parms, const char *key,
+                      char *out_val, int len)
+{
+    struct str_parm *parm = str_parms_find(str_parms, key);
+
+    if (parm == NULL)
+        return -ENOENT;
+    snprintf(out_val, len, "%s", parm->value);
+    return strlen(out_val);
+}
+
+int str_parms_get_int(struct str_parms *str_parms, const char *key,
+                      int *out_val)
+{
+    struct str_parm *parm = str_parms_find(str_parms, key);
+    char *end;
+
+    if (parm == NULL)
+        return -ENOENT;
+    *out_val = (int)strtol(parm->value, &end, 0);
+    if (*parm->value == '\0' || *end != '\0')
+        return -EINVAL;
+    return 0;
+}
+
+char *str_parms_to_str(struct str_parms *str_parms)
+{
+    struct str_parm *parm;
+    size_t len = 1;
+    char *str;
+
+    for (parm = str_parms->head; parm; parm = parm->next)
+        len += strlen(parm->key) + strlen(parm->value) + 2;
+    str = calloc(1, len);
+    if (str == NULL)
+        return NULL;
+    for (parm = str_parms->head; parm; parm = parm->next) {
+        if (parm != str_parms->head)
+            strcat(str, ";");
+        strcat(str, parm->key);
+        strcat(str, "=");
+        strcat(str, parm->value);
+    }
+    return str;
+}
+
+/* linear interpolating resampler, shared by both resampler apis */
+
+struct linear_resampler {
+    uint32_t in_rate;
+    uint32_t out_rate;
+    uint32_t channels;
+    /* position of the next output frame in input frames, Q32 */
+    uint64_t phase;
+    int16_t last[8];
+};
+
+static void linear_init(struct linear_resampler *lr, uint32_t in_rate,
+                        uint32_t out_rate, uint32_t channels)
+{
+    memset(lr, 0, sizeof(*lr));
+    lr->in_rate = in_rate;
+    lr->out_rate = out_rate;
+    lr->channels = channels > 8 ? 8 : channels;
+}
+
+/* consumes all of in, returns the frames written to out */
+static size_t linear_process(struct linear_resampler *lr, const int16_t *in,
+                             size_t in_frames, int16_t *out, size_t out_frames)
+{
+    uint64_t step = ((uint64_t)lr->in_rate << 32) / lr->out_rate;
+    size_t n = 0;
+    uint32_t c;
+
+    /* phase is relative to lr->last, which sits one frame before in[0] */
+    while (n < out_frames) {
+        uint64_t idx = lr->phase >> 32;
+        uint32_t frac = (uint32_t)(lr->phase >> 16) & 0xffff;
+
+        if (idx >= in_frames)
+            break;
+        for (c = 0; c < lr->channels; c++) {
+            int32_t a = idx == 0 ? lr->last[c] : in[(idx - 1) * lr->channels + c];
+            int32_t b = in[idx * lr->channels + c];
+            out[n * lr->channels + c] = (int16_t)(a + (((b - a) * (int32_t)frac) >> 16));
+        }
+        n++;
+        lr->phase += step;
+    }
+    if (in_frames) {
+        for (c = 0; c < lr->channels; c++)
+            lr->last[c] = in[(in_frames - 1) * lr->channels + c];
+        lr->phase -= (uint64_t)in_frames << 32;
+        if ((int64_t)lr->phase < 0)
+            lr->phase = 0;
+    }
+    return n;
+}
+
+/* libaudioutils resampler */
+
+struct host_resampler {
+    struct resampler_itfe itfe;
+    struct linear_resampler lr;
+    struct resampler_buffer_provider *provider;
+};
+
+static void host_resampler_reset(struct resampler_itfe *resampler)
+{
+    struct host_resampler *hr = (struct host_resampler *)resampler;
+
+    linear_init(&hr->lr, hr->lr.in_rate, hr->lr.out_rate, hr->lr.channels);
+}
+
+static int host_resample_from_input(struct resampler_itfe *resampler,
+                                    int16_t *in, size_t *inFrameCount,
+                                    int16_t *out, size_t *outFrameCount)
+{
+    struct host_resampler *hr = (struct host_resampler *)resampler;
+
+    *outFrameCount = linear_process(&hr->lr, in, *inFrameCount, out, *outFrameCount);
+    return 0;
+}
+
+static int host_resample_from_provider(struct resampler_itfe *resampler,
+                                       int16_t *out, size_t *outFrameCount)
+{
+    struct host_resampler *hr = (struct host_resampler *)resampler;
+    size_t want = *outFrameCount, done = 0;
+
+    if (hr->provider == NULL)
+        return -EINVAL;
+
+    while (done < want) {
+        struct resampler_buffer buf;
+        size_t in_frames = ((uint64_t)(want - done) * hr->lr.in_rate + hr->lr.out_rate - 1)
+                           / hr->lr.out_rate;
+
+        buf.frame_count = in_frames ? in_frames : 1;
+        if (hr->provider->get_next_buffer(hr->provider, &buf) != 0 || buf.frame_count == 0)
+            break;
+        done += linear_process(&hr->lr, buf.i16, buf.frame_count,
+                               out + done * hr->lr.channels, want - done);
+        hr->provider->release_buffer(hr->provider, &buf);
+    }
+    *outFrameCount = done;
+    return 0;
+}
+
+static int32_t host_resampler_delay_ns(struct resampler_itfe *resampler)
+{
+    struct host_resampler *hr = (struct host_resampler *)resampler;
+
+    return (int32_t)(1000000000LL / hr->lr.in_rate);
+}
+
+int create_resampler(uint32_t inSampleRate, uint32_t outSampleRate,
+                     uint32_t channelCount, uint32_t quality,
+                     struct resampler_buffer_provider *provider,
+                     struct resampler_itfe **resampler)
+{
+    struct host_resampler *hr;
+
+    if (inSampleRate == 0 || outSampleRate == 0 || channelCount == 0 || channelCount > 8)
+        return -EINVAL;
+    hr = calloc(1, sizeof(*hr));
+    if (hr == NULL)
+        return -ENOMEM;
+    hr->itfe.reset = host_resampler_reset;
+    hr->itfe.resample_from_provider = host_resample_from_provider;
+    hr->itfe.resample_from_input = host_resample_from_input;
+    hr->itfe.delay_ns = host_resampler_delay_ns;
+    hr->provider = provider;
+    linear_init(&hr->lr, inSampleRate, outSampleRate, channelCount);
+    *resampler = &hr->itfe;
+    return 0;
+}
+
+void release_resampler(struct resampler_itfe *resampler)
+{
+    free(resampler);
+}
+
+/* speex resampler */
+
+struct SpeexResamplerState_ {
+    struct linear_resampler lr;
+};
+
+SpeexResamplerState *speex_resampler_init(spx_uint32_t nb_channels,
+                                          spx_uint32_t in_rate,
+                                          spx_uint32_t out_rate,
+                                          int quality, int *err)
+{
+    SpeexResamplerState *st;
+
+    if (nb_channels == 0 || nb_channels > 8 || in_rate == 0 || out_rate == 0) {
+        if (err)
+            *err = -1;
+        return NULL;
+    }
+    st = calloc(1, sizeof(*st));
+    if (st)
+        linear_init(&st->lr, in_rate, out_rate, nb_channels);
+    if (err)
+        *err = st ? 0 : -1;
+    return st;
+}
+
+void speex_resampler_destroy(SpeexResamplerState *st)
+{
+    free(st);
+}
+
+int speex_resampler_process_interleaved_int(SpeexResamplerState *st,
+                                            const spx_int16_t *in,
+                                            spx_uint32_t *in_len,
+                                            spx_int16_t *out,
+                                            spx_uint32_t *out_len)
+{
+    *out_len = linear_process(&st->lr, in, *in_len, out, *out_len);
+    return 0;
+}
+
+int speex_resampler_reset_mem(SpeexResamplerState *st)
+{
+    linear_init(&st->lr, st->lr.in_rate, st->lr.out_rate, st->lr.channels);
+    return 0;
+}
+
+/* speex echo canceller and preprocessor, pass through */
+
+struct SpeexEchoState_ {
+    int frame_size;
+    int samplerate;
+};
+
+struct SpeexPreprocessState_ {
+    int frame_size;
+};
+
+SpeexEchoState *speex_echo_state_init(int frame_size, int filter_length)
+{
+    SpeexEchoState *st = calloc(1, sizeof(*st));
+
+    if (st) {
+        st->frame_size = frame_size;
+        st->samplerate = 8000;
+    }
+    return st;
+}
+
+void speex_echo_state_destroy(SpeexEchoState *st)
+{
+    free(st);
+}
+
+void speex_echo_cancellation(SpeexEchoState *st, const spx_int16_t *rec,
+                             const spx_int16_t *play, spx_int16_t *out)
+{
+    memmove(out, rec, st->frame_size * sizeof(spx_int16_t));
+}
+
+void speex_echo_state_reset(SpeexEchoState *st)
+{
+}
+
+int speex_echo_ctl(SpeexEchoState *st, int request, void *ptr)
+{
+    switch (request) {
+    case SPEEX_ECHO_GET_FRAME_SIZE:
+        *(int *)ptr = st->frame_size;
+        return 0;
+    case SPEEX_ECHO_SET_SAMPLING_RATE:
+        st->samplerate = *(int *)ptr;
+        return 0;
+    case SPEEX_ECHO_GET_SAMPLING_RATE:
+        *(int *)ptr = st->samplerate;
+        return 0;
+    }
+    return -1;
+}
+
+SpeexPreprocessState *speex_preprocess_state_init(int frame_size, int sampling_rate)
+{
+    SpeexPreprocessState *st = calloc(1, sizeof(*st));
+
+    if (st)
+        st->frame_size = frame_size;
+    return st;
+}
+
+void speex_preprocess_state_destroy(SpeexPreprocessState *st)
+{
+    free(st);
+}
+
+int speex_preprocess_run(SpeexPreprocessState *st, spx_int16_t *x)
+{
+    return 1;
+}
+
+int speex_preprocess_ctl(SpeexPreprocessState *st, int request, void *ptr)
+{
+    return 0;
+}
+
+/* audio_route, unused by the hal beyond init and free */
+
+struct audio_route *audio_route_init(unsigned int card, const char *xml_path)
+{
+    return NULL;
+}
+
+void audio_route_free(struct audio_route *ar)
+{
+}
+
+/* uevent, no kernel events on the host */
+
+int uevent_init(void)
+{
+    return 0;
+}
+
+int uevent_get_fd(void)
+{
+    return -1;
+}
+
+int uevent_next_event(char *buffer, int buffer_length)
+{
+    return 0;
+}
+
+/* libhardware, the only module is the hal linked into the program */
+
+extern struct audio_module HAL_MODULE_INFO_SYM;
+
+int hw_get_module_by_class(const char *class_id, const char *inst,
+                           const struct hw_module_t **module)
+{
+    if (strcmp(class_id, AUDIO_HARDWARE_MODULE_ID) ||
+        (inst && strcmp(inst, AUDIO_HARDWARE_MODULE_ID_PRIMARY)))
+        return -ENOENT;
+    *module = &HAL_MODULE_INFO_SYM.common;
+    return 0;
+}
+
+int hw_get_module(const char *id, const struct hw_module_t **module)
+{
+    return hw_get_module_by_class(id, NULL, module);
+}
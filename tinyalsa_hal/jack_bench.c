@@ -0,0 +1,359 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file    jack_bench.c
+ * @brief   headphone insert to audio latency, with and without the jack
+ *          monitor preparing the route
+ *
+ * Without -c a pipe stands in for the control device of the codec card:
+ * the bench writes "Headphone Jack" value events into it and answers the
+ * value reads itself, and only the time from the event to the jack
+ * callback is measured.
+ *
+ * With -c the monitor watches the control device of that card and the
+ * bench flips the jack by writing its "Headphone Jack" control, which
+ * needs a card whose jack control can be written, such as card 0 of the
+ * host build. The card plays while the jack toggles, and each switch is
+ * timed from the jack write to audio on the new route:
+ *   before: standby and restart, as the routing call did so far: pcm
+ *           close, playback off route, pcm open, full route, first period
+ *           written
+ *   after:  the callback prepares the route on the route worker, the
+ *           routing call only commits it and the pcm keeps running, so
+ *           the audio is on the new route once the worker applied it
+ * Value changes of the other controls are handed to route_ctl_changed()
+ * like the HAL does. The framework's own dispatch from the jack to the
+ * routing call is the same in both and is not included. On the host,
+ * host.ctl.write_us and host.pcm.open_us give the control writes and the
+ * pcm restart the cost they have on a codec.
+ *
+ * usage: jack_bench [-n switches] [-c card] [-d pcm device]
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <tinyalsa/asoundlib.h>
+
+#include "alsa_audio.h"
+#include "audio_stats.h"
+#include "jack_monitor.h"
+
+#define __force
+#define __bitwise
+#define __user
+#include "asound.h"
+
+#include "codec_config/config.h"
+
+#define BENCH_SWITCHES_DEFAULT  (20)
+#define BENCH_JACK_NUMID        (1000)
+#define BENCH_SETTLE_MS         (20)
+
+static pthread_mutex_t bench_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t bench_cond = PTHREAD_COND_INITIALIZER;
+static long bench_jack_value;
+static unsigned bench_callbacks;
+static int bench_prepare;
+static int64_t bench_callback_ns;
+/* the jack control of the -c card, NULL when the pipe stands in for it */
+static struct mixer_ctl *bench_jack_ctl;
+
+/* the value read of the fake control device */
+static int bench_read_value(int fd, unsigned numid, long *value)
+{
+    pthread_mutex_lock(&bench_lock);
+    *value = bench_jack_value;
+    pthread_mutex_unlock(&bench_lock);
+    return 0;
+}
+
+static unsigned bench_route(unsigned jacks)
+{
+    return (jacks & JACK_HEADPHONE) ? HEADPHONE_NORMAL_ROUTE : SPEAKER_NORMAL_ROUTE;
+}
+
+static void bench_jack_changed(void *arg, unsigned jacks, int64_t event_ns)
+{
+    int64_t now = audio_stats_now_ns();
+
+    // what adev_jack_changed() does with the monitor enabled
+    if (bench_prepare)
+        route_worker_prepare(bench_route(jacks));
+
+    pthread_mutex_lock(&bench_lock);
+    bench_callback_ns = now;
+    bench_callbacks++;
+    pthread_cond_broadcast(&bench_cond);
+    pthread_mutex_unlock(&bench_lock);
+}
+
+/* what adev_ctl_changed() does, the route writes come back as events */
+static void bench_ctl_changed(void *arg, unsigned card, unsigned numid)
+{
+    route_worker_lock();
+    route_ctl_changed(card, numid);
+    route_worker_unlock();
+}
+
+/**
+ * @brief bench_toggle
+ *        flip the jack, on the card or through the pipe, and wait for
+ *        the monitor to report it
+ *
+ * @returns time of the event
+ */
+static int64_t bench_toggle(int fd)
+{
+    struct snd_ctl_event ev;
+    unsigned seen;
+    int64_t start;
+    long value;
+    int ret;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.type = SNDRV_CTL_EVENT_ELEM;
+    ev.data.elem.mask = SNDRV_CTL_EVENT_MASK_VALUE;
+    ev.data.elem.id.numid = BENCH_JACK_NUMID;
+    strcpy((char *)ev.data.elem.id.name, "Headphone Jack");
+
+    pthread_mutex_lock(&bench_lock);
+    bench_jack_value = !bench_jack_value;
+    value = bench_jack_value;
+    seen = bench_callbacks;
+    pthread_mutex_unlock(&bench_lock);
+
+    start = audio_stats_now_ns();
+    if (bench_jack_ctl)
+        ret = (mixer_ctl_set_val(bench_jack_ctl, value) < 0) ? -1 : 0;
+    else
+        ret = (write(fd, &ev, sizeof(ev)) != sizeof(ev)) ? -1 : 0;
+    if (ret < 0)
+        return start;
+
+    pthread_mutex_lock(&bench_lock);
+    while (bench_callbacks == seen)
+        pthread_cond_wait(&bench_cond, &bench_lock);
+    pthread_mutex_unlock(&bench_lock);
+    return start;
+}
+
+/* sorts ns */
+static void bench_report(const char *name, int64_t *ns, int count)
+{
+    int64_t total = 0;
+    int i;
+
+    for (i = 0; i < count; i++)
+        total += ns[i];
+    audio_stats_sort(ns, count);
+    printf("%-10s avg %8.1f us  p50 %8.1f us  max %8.1f us  (%d switches)\n", name,
+           count ? total / 1000.0 / count : 0.0, audio_stats_percentile(ns, count, 500) / 1000.0,
+           audio_stats_percentile(ns, count, 1000) / 1000.0, count);
+}
+
+static struct pcm *bench_pcm_open(int card, int device, struct pcm_config *config)
+{
+    struct pcm *pcm = pcm_open(card, device, PCM_OUT | PCM_MONOTONIC, config);
+
+    if (pcm && !pcm_is_ready(pcm)) {
+        fprintf(stderr, "pcm_open(%d, %d) failed: %s\n", card, device, pcm_get_error(pcm));
+        pcm_close(pcm);
+        return NULL;
+    }
+    return pcm;
+}
+
+/* keep playing between switches, the buffer is full when it returns */
+static void bench_settle(struct pcm *pcm, void *period, unsigned bytes)
+{
+    int64_t end = audio_stats_now_ns() + BENCH_SETTLE_MS * 1000000LL;
+
+    while (audio_stats_now_ns() < end)
+        pcm_write(pcm, period, bytes);
+}
+
+/**
+ * @brief bench_jack_open
+ *        the jack control of the card, the bench writes it to plug and
+ *        unplug, a codec driver usually reports it read only
+ *
+ * @returns the mixer, NULL if the jack cannot be set
+ */
+static struct mixer *bench_jack_open(int card)
+{
+    struct mixer *mixer = mixer_open_legacy(card);
+
+    if (!mixer) {
+        fprintf(stderr, "cannot open the controls of card %d\n", card);
+        return NULL;
+    }
+    bench_jack_ctl = mixer_get_control(mixer, "Headphone Jack", 0);
+    bench_jack_value = !!(jack_monitor_jacks() & JACK_HEADPHONE);
+    // writing the value it has sends no event, and fails if it is read only
+    if (!bench_jack_ctl || (mixer_ctl_set_val(bench_jack_ctl, bench_jack_value) < 0)) {
+        fprintf(stderr, "card %d has no Headphone Jack control the bench can write\n", card);
+        bench_jack_ctl = NULL;
+        mixer_close_legacy(mixer);
+        return NULL;
+    }
+    return mixer;
+}
+
+int main(int argc, char **argv)
+{
+    struct jack_monitor_callbacks cb = { bench_jack_changed, bench_ctl_changed, NULL };
+    struct pcm_config config = {
+        .channels = 2,
+        .rate = 48000,
+        .period_size = 256,
+        .period_count = 4,
+        .format = PCM_FORMAT_S16_LE,
+    };
+    int switches = BENCH_SWITCHES_DEFAULT, card = -1, device = 0;
+    int fds[2] = { -1, -1 }, opt, i, mode, ret = 2;
+    int64_t *ns, start;
+    struct mixer *mixer = NULL;
+    struct pcm *pcm = NULL;
+    void *period;
+    unsigned bytes;
+
+    while ((opt = getopt(argc, argv, "n:c:d:")) != -1) {
+        switch (opt) {
+        case 'n':
+            switches = atoi(optarg);
+            break;
+        case 'c':
+            card = atoi(optarg);
+            break;
+        case 'd':
+            device = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n switches] [-c card] [-d pcm device]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (switches <= 0)
+        switches = BENCH_SWITCHES_DEFAULT;
+
+    ns = calloc(switches, sizeof(*ns));
+    bytes = config.period_size * config.channels * 2;
+    period = calloc(1, bytes);
+    if (!ns || !period || ((card < 0) && (pipe(fds) < 0))) {
+        fprintf(stderr, "setup failed\n");
+        return 2;
+    }
+
+    if ((jack_monitor_start(card, &cb) < 0) ||
+        ((card < 0) && (jack_monitor_add_ctl(fds[0], 0, bench_read_value) < 0))) {
+        fprintf(stderr, "cannot start the jack monitor\n");
+        return 2;
+    }
+    if (card >= 0) {
+        route_init();
+        route_worker_start();
+        mixer = bench_jack_open(card);
+        if (!mixer)
+            goto __exit;
+    }
+
+    for (i = 0; i < switches; i++) {
+        start = bench_toggle(fds[1]);
+        ns[i] = bench_callback_ns - start;
+    }
+    bench_report("dispatch", ns, switches);
+    ret = 0;
+
+    if (card < 0)
+        goto __exit;
+
+    route_worker_open(bench_route(jack_monitor_jacks()));
+    route_worker_sync();
+    pcm = bench_pcm_open(card, device, &config);
+    if (!pcm) {
+        ret = 2;
+        goto __exit;
+    }
+    bench_settle(pcm, period, bytes);
+
+    for (mode = 0; mode < 2; mode++) {
+        bench_prepare = mode;
+        for (i = 0; i < switches; i++) {
+            start = bench_toggle(fds[1]);
+            if (mode == 0) {
+                pcm_close(pcm);
+                route_worker_close(PLAYBACK_OFF_ROUTE);
+                pcm = bench_pcm_open(card, device, &config);
+                route_worker_open(bench_route(jack_monitor_jacks()));
+                route_worker_sync();
+                if (!pcm) {
+                    ret = 2;
+                    goto __exit;
+                }
+                pcm_write(pcm, period, bytes);
+            } else {
+                route_worker_open(bench_route(jack_monitor_jacks()));
+                route_worker_sync();
+            }
+            ns[i] = audio_stats_now_ns() - start;
+            bench_settle(pcm, period, bytes);
+        }
+        bench_report(mode ? "after" : "before", ns, switches);
+    }
+
+__exit:
+    if (pcm)
+        pcm_close(pcm);
+    jack_monitor_stop();
+    if (card >= 0) {
+        route_worker_stop();
+        route_uninit();
+    }
+    if (mixer)
+        mixer_close_legacy(mixer);
+    if (fds[0] >= 0) {
+        close(fds[0]);
+        close(fds[1]);
+    }
+    free(ns);
+    free(period);
+    return ret;
+}
@@ -0,0 +1,566 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file    jack_monitor.c
+ * @brief   watches the jack switches of the codec card and the input
+ *          switch devices on one epoll thread
+ *
+ * Jacks show up either as boolean "... Jack" controls of the sound card,
+ * reported through control events, or as EV_SW switches of an input
+ * device. Both are merged into one set of JACK_ bits and passed to the
+ * jack callback as soon as they change, ahead of the framework routing
+ * the streams. Value changes of other controls go to the control
+ * callback.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "jack_monitor"
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <linux/input.h>
+
+#include <cutils/log.h>
+
+#define __force
+#define __bitwise
+#define __user
+#include "asound.h"
+
+#include "audio_thread.h"
+#include "jack_monitor.h"
+
+#define JACK_SOURCE_MAX     16
+#define JACK_EVENTS_MAX     8
+#define JACK_INPUT_DIR      "/dev/input"
+#define JACK_CTL_PATH       "/dev/snd/controlC%d"
+
+#define BITS_PER_LONG       (sizeof(long) * 8)
+#define BITS_TO_LONGS(x)    (((x) + BITS_PER_LONG - 1) / BITS_PER_LONG)
+#define TEST_BIT(bit, array) ((array[(bit) / BITS_PER_LONG] >> ((bit) % BITS_PER_LONG)) & 1)
+
+enum {
+    JACK_SOURCE_CTL = 0,
+    JACK_SOURCE_INPUT,
+};
+
+struct jack_source {
+    int fd;
+    int type;
+    int card;
+    jack_ctl_read_fn read_value;
+    unsigned jacks;                 // jacks this source reports as present
+    unsigned pending;               // input: switch state before SYN_REPORT
+};
+
+struct jack_monitor {
+    pthread_mutex_t lock;
+    int running;
+    int epoll_fd;
+    int wake_fd[2];
+    struct jack_source sources[JACK_SOURCE_MAX];
+    unsigned source_count;
+    struct jack_monitor_callbacks cb;
+    unsigned jacks;
+    struct jack_monitor_stats stats;
+    audio_thread thread;
+};
+
+static struct jack_monitor monitor = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .epoll_fd = -1,
+    .wake_fd = { -1, -1 },
+};
+
+static int64_t now_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * @brief jack_from_ctl_name
+ *        "Headphone Jack", "Headset Mic Jack", "HDMI/DP,pcm=3 Jack" ...
+ *
+ * @returns the JACK_ bit of a jack control, 0 for any other control
+ */
+static unsigned jack_from_ctl_name(const char *name)
+{
+    size_t len = strlen(name);
+
+    if ((len < 5) || strcmp(name + len - 5, " Jack"))
+        return 0;
+    if (strstr(name, "Mic"))
+        return JACK_MICROPHONE;
+    if (strstr(name, "Headphone") || strstr(name, "Headset"))
+        return JACK_HEADPHONE;
+    if (strstr(name, "Line Out"))
+        return JACK_LINEOUT;
+    if (strstr(name, "HDMI") || strstr(name, "DP"))
+        return JACK_HDMI;
+    return 0;
+}
+
+static int jack_ctl_read(int fd, unsigned numid, long *value)
+{
+    struct snd_ctl_elem_value ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.id.numid = numid;
+    if (ioctl(fd, SNDRV_CTL_IOCTL_ELEM_READ, &ev) < 0)
+        return -errno;
+    *value = ev.value.integer.value[0];
+    return 0;
+}
+
+/**
+ * @brief jack_ctl_scan
+ *        initial state of the jack controls of a card
+ */
+static unsigned jack_ctl_scan(int fd, jack_ctl_read_fn read_value)
+{
+    struct snd_ctl_elem_list list;
+    struct snd_ctl_elem_id *ids;
+    unsigned jacks = 0, jack, n;
+    long value;
+
+    memset(&list, 0, sizeof(list));
+    if ((ioctl(fd, SNDRV_CTL_IOCTL_ELEM_LIST, &list) < 0) || (list.count == 0))
+        return 0;
+    ids = calloc(list.count, sizeof(*ids));
+    if (!ids)
+        return 0;
+    list.space = list.count;
+    list.pids = ids;
+    if (ioctl(fd, SNDRV_CTL_IOCTL_ELEM_LIST, &list) == 0) {
+        for (n = 0; n < list.used; n++) {
+            jack = jack_from_ctl_name((const char *)ids[n].name);
+            if (jack && (read_value(fd, ids[n].numid, &value) == 0) && value)
+                jacks |= jack;
+        }
+    }
+    free(ids);
+    return jacks;
+}
+
+/**
+ * @brief jack_input_probe
+ *
+ * @returns the JACK_ bits the input device can report, 0 if none
+ */
+static unsigned jack_input_probe(int fd, unsigned *present)
+{
+    unsigned long sw_bits[BITS_TO_LONGS(SW_CNT)];
+    unsigned long sw_state[BITS_TO_LONGS(SW_CNT)];
+    unsigned jacks = 0;
+
+    memset(sw_bits, 0, sizeof(sw_bits));
+    memset(sw_state, 0, sizeof(sw_state));
+    if (ioctl(fd, EVIOCGBIT(EV_SW, sizeof(sw_bits)), sw_bits) < 0)
+        return 0;
+    if (TEST_BIT(SW_HEADPHONE_INSERT, sw_bits))
+        jacks |= JACK_HEADPHONE;
+    if (TEST_BIT(SW_MICROPHONE_INSERT, sw_bits))
+        jacks |= JACK_MICROPHONE;
+    if (TEST_BIT(SW_LINEOUT_INSERT, sw_bits))
+        jacks |= JACK_LINEOUT;
+
+    *present = 0;
+    if (jacks && (ioctl(fd, EVIOCGSW(sizeof(sw_state)), sw_state) >= 0)) {
+        if (TEST_BIT(SW_HEADPHONE_INSERT, sw_state))
+            *present |= JACK_HEADPHONE;
+        if (TEST_BIT(SW_MICROPHONE_INSERT, sw_state))
+            *present |= JACK_MICROPHONE;
+        if (TEST_BIT(SW_LINEOUT_INSERT, sw_state))
+            *present |= JACK_LINEOUT;
+    }
+    return jacks;
+}
+
+/**
+ * @brief jack_source_add
+ *        must be called with monitor.lock held
+ */
+static int jack_source_add(int fd, int type, int card, jack_ctl_read_fn read_value, unsigned jacks)
+{
+    struct jack_source *src;
+    struct epoll_event ev;
+
+    if (monitor.source_count == JACK_SOURCE_MAX)
+        return -ENOSPC;
+    // events are drained until EAGAIN, the fd must not block
+    if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0)
+        return -errno;
+    src = &monitor.sources[monitor.source_count];
+    memset(src, 0, sizeof(*src));
+    src->fd = fd;
+    src->type = type;
+    src->card = card;
+    src->read_value = read_value ? read_value : jack_ctl_read;
+    src->jacks = src->pending = jacks;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = src;
+    if (epoll_ctl(monitor.epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0)
+        return -errno;
+    monitor.source_count++;
+    return 0;
+}
+
+static void jack_input_open_all(void)
+{
+    char path[64];
+    struct dirent *de;
+    unsigned present;
+    DIR *dir;
+    int fd;
+    int clk = CLOCK_MONOTONIC;
+
+    dir = opendir(JACK_INPUT_DIR);
+    if (!dir)
+        return;
+    while ((de = readdir(dir)) != NULL) {
+        if (strncmp(de->d_name, "event", 5))
+            continue;
+        snprintf(path, sizeof(path), JACK_INPUT_DIR "/%s", de->d_name);
+        fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0)
+            continue;
+        if (!jack_input_probe(fd, &present)) {
+            close(fd);
+            continue;
+        }
+        // event times on the clock the rest of the HAL uses
+        ioctl(fd, EVIOCSCLOCKID, &clk);
+        if (jack_source_add(fd, JACK_SOURCE_INPUT, -1, NULL, present) < 0) {
+            close(fd);
+            continue;
+        }
+        ALOGD("jack switches on %s, present 0x%x", path, present);
+    }
+    closedir(dir);
+}
+
+/**
+ * @brief jack_update
+ *        merge the jacks of every source and report a change, must be
+ *        called on the monitor thread
+ */
+static void jack_update(int64_t event_ns)
+{
+    unsigned jacks = 0, i;
+    int64_t end;
+
+    pthread_mutex_lock(&monitor.lock);
+    for (i = 0; i < monitor.source_count; i++)
+        jacks |= monitor.sources[i].jacks;
+    if (jacks == monitor.jacks) {
+        pthread_mutex_unlock(&monitor.lock);
+        return;
+    }
+    monitor.jacks = jacks;
+    monitor.stats.jacks = jacks;
+    monitor.stats.jack_changes++;
+    pthread_mutex_unlock(&monitor.lock);
+
+    ALOGD("jacks 0x%x", jacks);
+    if (monitor.cb.jack_changed)
+        monitor.cb.jack_changed(monitor.cb.arg, jacks, event_ns);
+
+    end = now_ns();
+    pthread_mutex_lock(&monitor.lock);
+    monitor.stats.last_dispatch_us = (end - event_ns) / 1000;
+    if (monitor.stats.last_dispatch_us > monitor.stats.max_dispatch_us)
+        monitor.stats.max_dispatch_us = monitor.stats.last_dispatch_us;
+    pthread_mutex_unlock(&monitor.lock);
+}
+
+static void jack_ctl_event(struct jack_source *src, int64_t event_ns)
+{
+    struct snd_ctl_event ev;
+    unsigned jack;
+    long value;
+
+    while (read(src->fd, &ev, sizeof(ev)) == sizeof(ev)) {
+        if ((ev.type != SNDRV_CTL_EVENT_ELEM) ||
+            (ev.data.elem.mask == SNDRV_CTL_EVENT_MASK_REMOVE) ||
+            !(ev.data.elem.mask & SNDRV_CTL_EVENT_MASK_VALUE))
+            continue;
+
+        pthread_mutex_lock(&monitor.lock);
+        monitor.stats.ctl_events++;
+        pthread_mutex_unlock(&monitor.lock);
+
+        jack = jack_from_ctl_name((const char *)ev.data.elem.id.name);
+        if (!jack) {
+            if (monitor.cb.ctl_changed)
+                monitor.cb.ctl_changed(monitor.cb.arg, src->card, ev.data.elem.id.numid);
+            continue;
+        }
+        if (src->read_value(src->fd, ev.data.elem.id.numid, &value) < 0)
+            continue;
+        if (value)
+            src->jacks |= jack;
+        else
+            src->jacks &= ~jack;
+        jack_update(event_ns);
+    }
+}
+
+static void jack_input_event(struct jack_source *src, int64_t event_ns)
+{
+    struct input_event ev;
+    unsigned jack;
+
+    while (read(src->fd, &ev, sizeof(ev)) == sizeof(ev)) {
+        if ((ev.type == EV_SYN) && (ev.code == SYN_REPORT)) {
+            src->jacks = src->pending;
+            // the kernel stamped the switch, the report is what we react to
+            jack_update((int64_t)ev.time.tv_sec * 1000000000LL + ev.time.tv_usec * 1000LL);
+            continue;
+        }
+        if (ev.type != EV_SW)
+            continue;
+
+        pthread_mutex_lock(&monitor.lock);
+        monitor.stats.input_events++;
+        pthread_mutex_unlock(&monitor.lock);
+
+        switch (ev.code) {
+        case SW_HEADPHONE_INSERT:
+            jack = JACK_HEADPHONE;
+            break;
+        case SW_MICROPHONE_INSERT:
+            jack = JACK_MICROPHONE;
+            break;
+        case SW_LINEOUT_INSERT:
+            jack = JACK_LINEOUT;
+            break;
+        default:
+            continue;
+        }
+        if (ev.value)
+            src->pending |= jack;
+        else
+            src->pending &= ~jack;
+    }
+}
+
+static void *jack_monitor_loop(void *arg)
+{
+    struct epoll_event events[JACK_EVENTS_MAX];
+    struct jack_source *src;
+    int64_t event_ns;
+    int n, i;
+    char c;
+
+    for (;;) {
+        n = epoll_wait(monitor.epoll_fd, events, JACK_EVENTS_MAX, -1);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            ALOGE("epoll_wait failed: %s", strerror(errno));
+            break;
+        }
+        event_ns = now_ns();
+        for (i = 0; i < n; i++) {
+            src = events[i].data.ptr;
+            if (src == NULL) {
+                // woken by jack_monitor_stop()
+                while (read(monitor.wake_fd[0], &c, 1) == 1)
+                    ;
+                continue;
+            }
+            if (src->type == JACK_SOURCE_CTL)
+                jack_ctl_event(src, event_ns);
+            else
+                jack_input_event(src, event_ns);
+        }
+
+        pthread_mutex_lock(&monitor.lock);
+        if (!monitor.running) {
+            pthread_mutex_unlock(&monitor.lock);
+            break;
+        }
+        pthread_mutex_unlock(&monitor.lock);
+    }
+    return NULL;
+}
+
+int jack_monitor_start(int card, const struct jack_monitor_callbacks *cb)
+{
+    audio_thread_attr attr;
+    struct epoll_event ev;
+    char path[32];
+    int subscribe = 1, fd, ret;
+
+    pthread_mutex_lock(&monitor.lock);
+    if (monitor.running) {
+        pthread_mutex_unlock(&monitor.lock);
+        return 0;
+    }
+    monitor.cb = *cb;
+    monitor.source_count = 0;
+    monitor.jacks = 0;
+    memset(&monitor.stats, 0, sizeof(monitor.stats));
+
+    monitor.epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if ((monitor.epoll_fd < 0) || (pipe2(monitor.wake_fd, O_NONBLOCK | O_CLOEXEC) < 0)) {
+        ret = -errno;
+        ALOGE("jack_monitor_start() epoll setup failed: %s", strerror(errno));
+        goto __error;
+    }
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    epoll_ctl(monitor.epoll_fd, EPOLL_CTL_ADD, monitor.wake_fd[0], &ev);
+
+    if (card >= 0) {
+        snprintf(path, sizeof(path), JACK_CTL_PATH, card);
+        fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) {
+            ALOGW("jack_monitor_start() cannot open %s: %s", path, strerror(errno));
+        } else if ((ioctl(fd, SNDRV_CTL_IOCTL_SUBSCRIBE_EVENTS, &subscribe) < 0) ||
+                   (jack_source_add(fd, JACK_SOURCE_CTL, card, NULL,
+                                    jack_ctl_scan(fd, jack_ctl_read)) < 0)) {
+            ALOGW("jack_monitor_start() cannot watch %s: %s", path, strerror(errno));
+            close(fd);
+        }
+    }
+    jack_input_open_all();
+
+    monitor.running = 1;
+    pthread_mutex_unlock(&monitor.lock);
+
+    // report what is plugged in at boot like any later change
+    jack_update(now_ns());
+
+    audio_thread_attr_init(&attr, "jack_monitor");
+    audio_thread_attr_from_props(&attr, "media.audio.jack");
+    ret = audio_thread_create(&monitor.thread, &attr, jack_monitor_loop, NULL);
+    if (ret != 0) {
+        pthread_mutex_lock(&monitor.lock);
+        monitor.running = 0;
+        ret = -ret;
+        goto __error;
+    }
+    return 0;
+
+__error:
+    while (monitor.source_count)
+        close(monitor.sources[--monitor.source_count].fd);
+    if (monitor.epoll_fd >= 0)
+        close(monitor.epoll_fd);
+    if (monitor.wake_fd[0] >= 0) {
+        close(monitor.wake_fd[0]);
+        close(monitor.wake_fd[1]);
+    }
+    monitor.epoll_fd = monitor.wake_fd[0] = monitor.wake_fd[1] = -1;
+    pthread_mutex_unlock(&monitor.lock);
+    return ret;
+}
+
+int jack_monitor_add_ctl(int fd, int card, jack_ctl_read_fn read_value)
+{
+    int ret;
+
+    pthread_mutex_lock(&monitor.lock);
+    if (!monitor.running) {
+        pthread_mutex_unlock(&monitor.lock);
+        return -ENODEV;
+    }
+    ret = jack_source_add(fd, JACK_SOURCE_CTL, card, read_value, 0);
+    pthread_mutex_unlock(&monitor.lock);
+    return ret;
+}
+
+void jack_monitor_stop(void)
+{
+    char c = 0;
+
+    pthread_mutex_lock(&monitor.lock);
+    if (!monitor.running) {
+        pthread_mutex_unlock(&monitor.lock);
+        return;
+    }
+    monitor.running = 0;
+    write(monitor.wake_fd[1], &c, 1);
+    pthread_mutex_unlock(&monitor.lock);
+
+    audio_thread_join(&monitor.thread);
+
+    pthread_mutex_lock(&monitor.lock);
+    while (monitor.source_count)
+        close(monitor.sources[--monitor.source_count].fd);
+    close(monitor.epoll_fd);
+    close(monitor.wake_fd[0]);
+    close(monitor.wake_fd[1]);
+    monitor.epoll_fd = monitor.wake_fd[0] = monitor.wake_fd[1] = -1;
+    pthread_mutex_unlock(&monitor.lock);
+}
+
+unsigned jack_monitor_jacks(void)
+{
+    unsigned jacks;
+
+    pthread_mutex_lock(&monitor.lock);
+    jacks = monitor.jacks;
+    pthread_mutex_unlock(&monitor.lock);
+    return jacks;
+}
+
+void jack_monitor_get_stats(struct jack_monitor_stats *stats)
+{
+    pthread_mutex_lock(&monitor.lock);
+    *stats = monitor.stats;
+    pthread_mutex_unlock(&monitor.lock);
+}
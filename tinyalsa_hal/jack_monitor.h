@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file    jack_monitor.h
+ * @brief   watches the jack switches of the codec card and the input
+ *          switch devices on one epoll thread
+ */
+
+#ifndef JACK_MONITOR_H_
+#define JACK_MONITOR_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* jacks reported by jack_monitor_jacks() and the jack callback */
+#define JACK_HEADPHONE      (1 << 0)
+#define JACK_MICROPHONE     (1 << 1)
+#define JACK_LINEOUT        (1 << 2)
+#define JACK_HDMI           (1 << 3)
+
+/* both run on the monitor thread, they must not block on the stream locks */
+struct jack_monitor_callbacks {
+    void (*jack_changed)(void *arg, unsigned jacks, int64_t event_ns);
+    void (*ctl_changed)(void *arg, unsigned card, unsigned numid);
+    void *arg;
+};
+
+/* reads a boolean control for jack_monitor_add_ctl(), 0 on success */
+typedef int (*jack_ctl_read_fn)(int fd, unsigned numid, long *value);
+
+struct jack_monitor_stats {
+    unsigned ctl_events;
+    unsigned input_events;
+    unsigned jack_changes;
+    unsigned jacks;
+    long long last_dispatch_us;     // from the event to the jack callback returning
+    long long max_dispatch_us;
+};
+
+/**
+ * @brief jack_monitor_start
+ *        subscribe to the control events of card, -1 for none, open the
+ *        input devices with headphone, microphone or line out switches and
+ *        start the thread
+ *
+ * @returns 0, or -errno when the thread could not start
+ */
+int jack_monitor_start(int card, const struct jack_monitor_callbacks *cb);
+
+/**
+ * @brief jack_monitor_add_ctl
+ *        watch an fd that delivers struct snd_ctl_event and is already
+ *        subscribed, reading jack values with read_value, NULL for the
+ *        ELEM_READ ioctl. Lets a test stand in for a control device.
+ */
+int jack_monitor_add_ctl(int fd, int card, jack_ctl_read_fn read_value);
+
+void jack_monitor_stop(void);
+unsigned jack_monitor_jacks(void);
+void jack_monitor_get_stats(struct jack_monitor_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,249 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file    mixer_bench.c
+ * @brief   control lookup cost of applying the full rt3261 route table
+ *
+ * Builds an in memory mixer holding every control named by the rt3261
+ * routes, spread among filler controls up to the size of a real codec
+ * card, then times resolving every route entry three ways: the linear
+ * strcmp scan, the hashed mixer_get_control() and the per route cache
+ * used by set_controls() once a route was applied. No sound card is
+ * needed.
+ *
+ * usage: mixer_bench [-n passes] [-c controls]
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "alsa_audio.h"
+#include "audio_stats.h"
+
+#define __force
+#define __bitwise
+#define __user
+#include "asound.h"
+
+#include "codec_config/rt3261_config.h"
+
+#define BENCH_PASSES_DEFAULT (10000)
+#define BENCH_CONTROLS_DEFAULT (220)
+
+/* lookup as mixer_get_control() did before the index */
+static struct mixer_ctl *bench_linear_lookup(struct mixer *mixer, const char *name, unsigned index)
+{
+    unsigned n;
+
+    for (n = 0; n < mixer->count; n++) {
+        if ((mixer->info[n].id.index == index) &&
+            !strcmp(name, (char*) mixer->info[n].id.name))
+            return mixer->ctl + n;
+    }
+    return NULL;
+}
+
+static int bench_has_name(const char **names, unsigned count, const char *name)
+{
+    unsigned i;
+
+    for (i = 0; i < count; i++) {
+        if (!strcmp(names[i], name))
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief bench_mixer_create
+ *        a mixer whose controls are the route names placed evenly among
+ *        filler controls
+ */
+static struct mixer *bench_mixer_create(const struct config_route *routes, unsigned route_count,
+                                        unsigned controls)
+{
+    const char **names;
+    unsigned unique = 0, total = 0, i, j, n;
+    struct mixer *mixer;
+
+    for (i = 0; i < route_count; i++)
+        total += routes[i].controls_count;
+    names = calloc(total ? total : 1, sizeof(char *));
+    if (!names)
+        return NULL;
+    for (i = 0; i < route_count; i++) {
+        for (j = 0; j < routes[i].controls_count; j++) {
+            if (!bench_has_name(names, unique, routes[i].controls[j].ctl_name))
+                names[unique++] = routes[i].controls[j].ctl_name;
+        }
+    }
+    if (controls < unique)
+        controls = unique;
+
+    mixer = calloc(1, sizeof(*mixer));
+    if (!mixer) {
+        free(names);
+        return NULL;
+    }
+    mixer->fd = -1;
+    mixer->count = controls;
+    mixer->info = calloc(controls, sizeof(struct snd_ctl_elem_info));
+    mixer->ctl = calloc(controls, sizeof(struct mixer_ctl));
+    if (!mixer->info || !mixer->ctl) {
+        free(names);
+        mixer_close_legacy(mixer);
+        return NULL;
+    }
+
+    for (n = 0; n < controls; n++) {
+        snprintf((char*) mixer->info[n].id.name, sizeof(mixer->info[n].id.name),
+                 "Filler Control %u", n);
+        mixer->info[n].id.numid = n + 1;
+        mixer->ctl[n].info = mixer->info + n;
+        mixer->ctl[n].mixer = mixer;
+    }
+    for (i = 0; i < unique; i++) {
+        n = (unsigned)((uint64_t)i * controls / unique);
+        strncpy((char*) mixer->info[n].id.name, names[i], sizeof(mixer->info[n].id.name) - 1);
+    }
+    free(names);
+
+    if (mixer_build_index(mixer) < 0) {
+        mixer_close_legacy(mixer);
+        return NULL;
+    }
+    printf("mixer: %u controls, %u named by the route table\n", controls, unique);
+    return mixer;
+}
+
+int main(int argc, char **argv)
+{
+    const struct config_route *routes = (const struct config_route *)&rt3261_config_table;
+    unsigned route_count = sizeof(rt3261_config_table) / sizeof(struct config_route);
+    int passes = BENCH_PASSES_DEFAULT;
+    int controls = BENCH_CONTROLS_DEFAULT;
+    struct mixer_ctl ***cache;
+    struct mixer *mixer;
+    unsigned lookups = 0, i, j;
+    int64_t start, linear_ns, hash_ns, cache_ns;
+    uintptr_t sink = 0;
+    int p, opt;
+
+    while ((opt = getopt(argc, argv, "n:c:")) != -1) {
+        switch (opt) {
+        case 'n':
+            passes = atoi(optarg);
+            break;
+        case 'c':
+            controls = atoi(optarg);
+            break;
+        default:
+            printf("usage: mixer_bench [-n passes] [-c controls]\n");
+            return -1;
+        }
+    }
+    if ((passes <= 0) || (controls <= 0)) {
+        printf("passes and controls must be positive\n");
+        return -1;
+    }
+
+    mixer = bench_mixer_create(routes, route_count, controls);
+    cache = calloc(route_count, sizeof(struct mixer_ctl **));
+    if (!mixer || !cache) {
+        printf("out of memory\n");
+        return -1;
+    }
+
+    // resolve once for the cache and check every method finds the same control
+    for (i = 0; i < route_count; i++) {
+        cache[i] = calloc(routes[i].controls_count ? routes[i].controls_count : 1,
+                          sizeof(struct mixer_ctl *));
+        if (!cache[i]) {
+            printf("out of memory\n");
+            return -1;
+        }
+        for (j = 0; j < routes[i].controls_count; j++) {
+            const char *name = routes[i].controls[j].ctl_name;
+
+            cache[i][j] = mixer_get_control(mixer, name, 0);
+            if (!cache[i][j] || (cache[i][j] != bench_linear_lookup(mixer, name, 0))) {
+                printf("lookup mismatch for %s\n", name);
+                return -1;
+            }
+            lookups++;
+        }
+    }
+    printf("route table: %u routes, %u control entries\n", route_count, lookups);
+
+    start = audio_stats_now_ns();
+    for (p = 0; p < passes; p++)
+        for (i = 0; i < route_count; i++)
+            for (j = 0; j < routes[i].controls_count; j++)
+                sink += (uintptr_t)bench_linear_lookup(mixer, routes[i].controls[j].ctl_name, 0);
+    linear_ns = audio_stats_now_ns() - start;
+
+    start = audio_stats_now_ns();
+    for (p = 0; p < passes; p++)
+        for (i = 0; i < route_count; i++)
+            for (j = 0; j < routes[i].controls_count; j++)
+                sink += (uintptr_t)mixer_get_control(mixer, routes[i].controls[j].ctl_name, 0);
+    hash_ns = audio_stats_now_ns() - start;
+
+    start = audio_stats_now_ns();
+    for (p = 0; p < passes; p++)
+        for (i = 0; i < route_count; i++)
+            for (j = 0; j < routes[i].controls_count; j++)
+                sink += (uintptr_t)(*(struct mixer_ctl * volatile *)&cache[i][j]);
+    cache_ns = audio_stats_now_ns() - start;
+
+    printf("%-8s %12s %12s\n", "lookup", "table us", "entry ns");
+    printf("%-8s %12.2f %12.1f\n", "linear", linear_ns / 1000.0 / passes,
+           (double)linear_ns / passes / lookups);
+    printf("%-8s %12.2f %12.1f\n", "hash", hash_ns / 1000.0 / passes,
+           (double)hash_ns / passes / lookups);
+    printf("%-8s %12.2f %12.1f\n", "cached", cache_ns / 1000.0 / passes,
+           (double)cache_ns / passes / lookups);
+
+    for (i = 0; i < route_count; i++)
+        free(cache[i]);
+    free(cache);
+    mixer_close_legacy(mixer);
+    return sink == 0;
+}
@@ -0,0 +1,490 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file    route_worker.c
+ * @brief   programs the codec routes on a worker thread
+ *
+ * With media.audio.route.async set, route requests from the stream paths
+ * are queued and applied in order by one thread, so a stream can start
+ * its pcm while the codec path is being written over I2C. The first
+ * frames of that stream then play into the previous path, which codecs
+ * that pop on a live path change do not tolerate, so the worker is off
+ * by default and requests are applied inline as before. Callers that
+ * start a pcm on a path other than the stream's own (hfp, hdmi in) wait
+ * for it with route_worker_sync().
+ *
+ * A request for a device route replaces the requests of the same
+ * direction still waiting at the tail of the queue, only the newest path
+ * is worth programming.
+ *
+ * With the worker running, standby can also hold the playback or
+ * capture path for media.audio.route.standby_ms before it is closed,
+ * so streams that come back quickly (notification sounds a few seconds
+ * apart) find the codec still powered instead of paying for a full
+ * power down and up.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "route_worker"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <cutils/log.h>
+#include <cutils/properties.h>
+
+#include "alsa_audio.h"
+#include "audio_thread.h"
+
+#define ROUTE_QUEUE_MAX 16
+
+enum {
+    ROUTE_CMD_OPEN = 0,
+    ROUTE_CMD_CLOSE,
+    ROUTE_CMD_PREPARE,
+};
+
+struct route_cmd {
+    int type;
+    unsigned route;
+    int64_t queued_ns;
+};
+
+/* an off route held back by standby, indexed by is_playback_route() */
+struct route_deferred {
+    int armed;
+    unsigned route;
+    int64_t queued_ns;
+    int64_t due_ns;
+};
+
+struct route_worker {
+    pthread_mutex_t lock;           // queue and stats
+    pthread_cond_t cond;            // queue not empty, or stopping
+    pthread_cond_t idle_cond;       // queue drained and nothing running
+    pthread_mutex_t exec_lock;      // held while the routes are programmed
+    struct route_cmd queue[ROUTE_QUEUE_MAX];
+    unsigned head;
+    unsigned count;
+    int running;
+    int busy;
+    int64_t standby_ns;             // how long standby holds a path, 0 closes it at once
+    struct route_deferred deferred[2];
+    audio_thread thread;
+    struct route_worker_stats stats;
+};
+
+static struct route_worker worker = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .cond = PTHREAD_COND_INITIALIZER,
+    .idle_cond = PTHREAD_COND_INITIALIZER,
+    .exec_lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+extern int is_playback_route(unsigned route);
+
+static int64_t now_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * @brief route_is_device
+ *        routes that select an output or input path, as opposed to the
+ *        off, incall/voip off and hdmi in routes that are applied for
+ *        their side effects
+ */
+static int route_is_device(unsigned route)
+{
+    switch (route) {
+    case PLAYBACK_OFF_ROUTE:
+    case CAPTURE_OFF_ROUTE:
+    case INCALL_OFF_ROUTE:
+    case VOIP_OFF_ROUTE:
+    case HDMI_IN_NORMAL_ROUTE:
+    case HDMI_IN_OFF_ROUTE:
+    case HDMI_IN_CAPTURE_ROUTE:
+    case HDMI_IN_CAPTURE_OFF_ROUTE:
+        return 0;
+    default:
+        return route < MAX_ROUTE;
+    }
+}
+
+/**
+ * @brief route_cmd_supersedes
+ *        a device route open makes a waiting open of the same direction,
+ *        or the close route_pcm_open() would apply itself, useless
+ */
+static int route_cmd_supersedes(const struct route_cmd *cmd, const struct route_cmd *old)
+{
+    int playback = is_playback_route(cmd->route);
+
+    // only the newest guess of the next route is worth preparing
+    if ((cmd->type == ROUTE_CMD_PREPARE) && (old->type == ROUTE_CMD_PREPARE))
+        return is_playback_route(old->route) == playback;
+    if ((cmd->type != ROUTE_CMD_OPEN) || !route_is_device(cmd->route))
+        return 0;
+    if (old->type == ROUTE_CMD_OPEN)
+        return route_is_device(old->route) && (is_playback_route(old->route) == playback);
+    return old->route == (playback ? PLAYBACK_OFF_ROUTE : CAPTURE_OFF_ROUTE);
+}
+
+/**
+ * @brief route_deferred_due
+ *        must be called with worker.lock held
+ *
+ * @returns deadline of the first held path, 0 if none is held
+ */
+static int64_t route_deferred_due()
+{
+    int64_t due = 0;
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        if (worker.deferred[i].armed && (!due || (worker.deferred[i].due_ns < due)))
+            due = worker.deferred[i].due_ns;
+    }
+    return due;
+}
+
+static void route_cmd_run(const struct route_cmd *cmd)
+{
+    int64_t start = now_ns(), end;
+
+    pthread_mutex_lock(&worker.exec_lock);
+    if (cmd->type == ROUTE_CMD_OPEN)
+        route_pcm_open(cmd->route);
+    else if (cmd->type == ROUTE_CMD_PREPARE)
+        route_prepare(cmd->route);
+    else
+        route_pcm_close(cmd->route);
+    pthread_mutex_unlock(&worker.exec_lock);
+
+    end = now_ns();
+    pthread_mutex_lock(&worker.lock);
+    worker.stats.executed++;
+    worker.stats.last_ready_us = (end - cmd->queued_ns) / 1000;
+    worker.stats.total_ready_us += worker.stats.last_ready_us;
+    if (worker.stats.last_ready_us > worker.stats.max_ready_us)
+        worker.stats.max_ready_us = worker.stats.last_ready_us;
+    worker.stats.last_program_us = (end - start) / 1000;
+    pthread_mutex_unlock(&worker.lock);
+
+    ALOGV("route %s %u ready in %lld us, programmed in %lld us",
+          cmd->type == ROUTE_CMD_OPEN ? "open" :
+          (cmd->type == ROUTE_CMD_PREPARE ? "prepare" : "close"), cmd->route,
+          (long long)(end - cmd->queued_ns) / 1000, (long long)(end - start) / 1000);
+}
+
+/**
+ * @brief route_worker_push
+ *        must be called with worker.lock held, waits for room in the queue
+ */
+static void route_worker_push(struct route_cmd cmd)
+{
+    unsigned tail;
+
+    // drop what this request makes useless, newest first
+    while (worker.count) {
+        tail = (worker.head + worker.count - 1) % ROUTE_QUEUE_MAX;
+        if (!route_cmd_supersedes(&cmd, &worker.queue[tail]) &&
+            !((worker.queue[tail].type == cmd.type) && (worker.queue[tail].route == cmd.route)))
+            break;
+        // keep the age of the request that was replaced
+        cmd.queued_ns = worker.queue[tail].queued_ns;
+        worker.count--;
+        worker.stats.coalesced++;
+    }
+
+    while (worker.running && (worker.count == ROUTE_QUEUE_MAX))
+        pthread_cond_wait(&worker.cond, &worker.lock);
+
+    tail = (worker.head + worker.count) % ROUTE_QUEUE_MAX;
+    worker.queue[tail] = cmd;
+    worker.count++;
+    pthread_cond_broadcast(&worker.cond);
+}
+
+/**
+ * @brief route_deferred_flush
+ *        queue the held paths whose deadline is before limit_ns, all of
+ *        them for INT64_MAX. must be called with worker.lock held
+ *
+ * @returns number of paths queued
+ */
+static int route_deferred_flush(int64_t limit_ns)
+{
+    struct route_cmd cmd;
+    int i, flushed = 0;
+
+    for (i = 0; i < 2; i++) {
+        if (!worker.deferred[i].armed || (worker.deferred[i].due_ns > limit_ns))
+            continue;
+        worker.deferred[i].armed = 0;
+        cmd.type = ROUTE_CMD_CLOSE;
+        cmd.route = worker.deferred[i].route;
+        cmd.queued_ns = worker.deferred[i].queued_ns;
+        route_worker_push(cmd);
+        flushed++;
+    }
+    return flushed;
+}
+
+static void *route_worker_loop(void *arg)
+{
+    struct route_cmd cmd;
+    struct timespec ts;
+    int64_t due, now;
+
+    pthread_mutex_lock(&worker.lock);
+    while (worker.running || worker.count) {
+        if (worker.count == 0) {
+            due = route_deferred_due();
+            if (due == 0) {
+                pthread_cond_wait(&worker.cond, &worker.lock);
+                continue;
+            }
+            now = now_ns();
+            if (now < due) {
+                ts.tv_sec = due / 1000000000LL;
+                ts.tv_nsec = due % 1000000000LL;
+                pthread_cond_timedwait(&worker.cond, &worker.lock, &ts);
+                continue;
+            }
+            worker.stats.standby_expired += route_deferred_flush(now);
+            continue;
+        }
+        cmd = worker.queue[worker.head];
+        worker.head = (worker.head + 1) % ROUTE_QUEUE_MAX;
+        worker.count--;
+        worker.busy = 1;
+        pthread_mutex_unlock(&worker.lock);
+
+        route_cmd_run(&cmd);
+
+        pthread_mutex_lock(&worker.lock);
+        worker.busy = 0;
+        if (worker.count == 0)
+            pthread_cond_broadcast(&worker.idle_cond);
+        // queue was full, let the waiting producer in
+        pthread_cond_broadcast(&worker.cond);
+    }
+    pthread_cond_broadcast(&worker.idle_cond);
+    pthread_mutex_unlock(&worker.lock);
+    return NULL;
+}
+
+static void route_worker_queue(int type, unsigned route)
+{
+    struct route_cmd cmd;
+    struct route_deferred *held;
+
+    cmd.type = type;
+    cmd.route = route;
+    cmd.queued_ns = now_ns();
+
+    pthread_mutex_lock(&worker.lock);
+    worker.stats.requests++;
+    if (!worker.running) {
+        pthread_mutex_unlock(&worker.lock);
+        route_cmd_run(&cmd);
+        return;
+    }
+
+    if ((type == ROUTE_CMD_OPEN) && route_is_device(route)) {
+        // the path is still up, the open is a diff against what is programmed
+        held = &worker.deferred[is_playback_route(route) ? 1 : 0];
+        if (held->armed) {
+            held->armed = 0;
+            worker.stats.standby_avoided++;
+            ALOGV("route %u reopened %lld ms into standby", route,
+                  (long long)(cmd.queued_ns - held->queued_ns) / 1000000);
+        }
+    } else if (type == ROUTE_CMD_PREPARE) {
+        // writes nothing, held paths stay held
+        worker.stats.prepared++;
+    } else {
+        // incall, voip, hdmi in and explicit closes keep today's ordering
+        route_deferred_flush(INT64_MAX);
+    }
+
+    route_worker_push(cmd);
+    pthread_mutex_unlock(&worker.lock);
+}
+
+int route_worker_start(void)
+{
+    audio_thread_attr attr;
+    pthread_condattr_t cond_attr;
+    char value[PROPERTY_VALUE_MAX];
+    int ret;
+
+    if (!property_get_bool("media.audio.route.async", false)) {
+        ALOGD("route worker disabled, routes are programmed inline");
+        return 0;
+    }
+
+    pthread_mutex_lock(&worker.lock);
+    if (worker.running) {
+        pthread_mutex_unlock(&worker.lock);
+        return 0;
+    }
+    worker.head = 0;
+    worker.count = 0;
+    memset(worker.deferred, 0, sizeof(worker.deferred));
+    property_get("media.audio.route.standby_ms", value, "0");
+    worker.standby_ns = (int64_t)(atoi(value) > 0 ? atoi(value) : 0) * 1000000LL;
+    worker.stats.standby_ms = worker.standby_ns / 1000000;
+    // nobody waits on cond while the worker is stopped, standby deadlines are monotonic
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_destroy(&worker.cond);
+    pthread_cond_init(&worker.cond, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+    worker.running = 1;
+    pthread_mutex_unlock(&worker.lock);
+
+    audio_thread_attr_init(&attr, "route_worker");
+    audio_thread_attr_from_props(&attr, "media.audio.route");
+    ret = audio_thread_create(&worker.thread, &attr, route_worker_loop, NULL);
+    if (ret != 0) {
+        pthread_mutex_lock(&worker.lock);
+        worker.running = 0;
+        pthread_mutex_unlock(&worker.lock);
+        return -ret;
+    }
+    return 0;
+}
+
+void route_worker_stop(void)
+{
+    pthread_mutex_lock(&worker.lock);
+    if (!worker.running) {
+        pthread_mutex_unlock(&worker.lock);
+        return;
+    }
+    // held paths are closed now, the loop drains the queue before it exits
+    route_deferred_flush(INT64_MAX);
+    worker.running = 0;
+    pthread_cond_broadcast(&worker.cond);
+    pthread_mutex_unlock(&worker.lock);
+
+    audio_thread_join(&worker.thread);
+}
+
+void route_worker_open(unsigned route)
+{
+    route_worker_queue(ROUTE_CMD_OPEN, route);
+}
+
+void route_worker_close(unsigned route)
+{
+    route_worker_queue(ROUTE_CMD_CLOSE, route);
+}
+
+void route_worker_prepare(unsigned route)
+{
+    route_worker_queue(ROUTE_CMD_PREPARE, route);
+}
+
+void route_worker_standby(unsigned route)
+{
+    struct route_deferred *held;
+
+    if ((route != PLAYBACK_OFF_ROUTE) && (route != CAPTURE_OFF_ROUTE)) {
+        route_worker_close(route);
+        return;
+    }
+
+    pthread_mutex_lock(&worker.lock);
+    if (!worker.running || (worker.standby_ns == 0)) {
+        pthread_mutex_unlock(&worker.lock);
+        route_worker_close(route);
+        return;
+    }
+    worker.stats.requests++;
+    worker.stats.standby_held++;
+    held = &worker.deferred[is_playback_route(route) ? 1 : 0];
+    held->armed = 1;
+    held->route = route;
+    held->queued_ns = now_ns();
+    held->due_ns = held->queued_ns + worker.standby_ns;
+    pthread_cond_broadcast(&worker.cond);
+    pthread_mutex_unlock(&worker.lock);
+}
+
+void route_worker_sync(void)
+{
+    pthread_mutex_lock(&worker.lock);
+    while (worker.running && (worker.count || worker.busy))
+        pthread_cond_wait(&worker.idle_cond, &worker.lock);
+    pthread_mutex_unlock(&worker.lock);
+}
+
+void route_worker_lock(void)
+{
+    pthread_mutex_lock(&worker.exec_lock);
+}
+
+void route_worker_unlock(void)
+{
+    pthread_mutex_unlock(&worker.exec_lock);
+}
+
+int route_worker_pending(void)
+{
+    int pending;
+
+    pthread_mutex_lock(&worker.lock);
+    pending = worker.count + worker.busy;
+    pthread_mutex_unlock(&worker.lock);
+    return pending;
+}
+
+void route_worker_get_stats(struct route_worker_stats *stats)
+{
+    pthread_mutex_lock(&worker.lock);
+    *stats = worker.stats;
+    pthread_mutex_unlock(&worker.lock);
+}
@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file    voice_bench.c
+ * @brief   processing time benchmark of the voice process backends
+ *
+ * Feeds every backend the same synthetic far end signal and a capture
+ * holding its echo, and reports the time spent per block, the load
+ * against real time and the echo return loss enhancement (ERLE) over
+ * the second half of the run, once the canceller has converged.
+ *
+ * usage: voice_bench [-n blocks] [-r rate] [-l block] [-d echo_delay_ms] [backend...]
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "audio_stats.h"
+#include "voice_preprocess.h"
+
+#define BENCH_BLOCKS_DEFAULT (1000)
+#define BENCH_BLOCK_MS_DEFAULT (16)
+#define BENCH_DELAY_MS_DEFAULT (20)
+
+static uint32_t bench_seed = 1;
+
+static short bench_noise(int amplitude)
+{
+    bench_seed = bench_seed * 1103515245 + 12345;
+    return (short)((int)((bench_seed >> 16) & 0xffff) - 32768) * amplitude / 32768;
+}
+
+/**
+ * @brief bench_far_end
+ * speech like far end: a few harmonics under a syllable rate envelope
+ * plus some noise
+ *
+ * @param n sample index
+ * @param rate
+ *
+ * @returns
+ */
+static short bench_far_end(long n, int rate)
+{
+    double t = (double)n / rate;
+    double env = 0.5 + 0.5 * sin(2 * M_PI * 4 * t);
+    double v = sin(2 * M_PI * 220 * t) + 0.5 * sin(2 * M_PI * 440 * t)
+               + 0.25 * sin(2 * M_PI * 1230 * t);
+
+    return (short)(env * v * 6000) + bench_noise(1000);
+}
+
+static int bench_run(const char *name, int blocks, int rate, int block, int delay_ms)
+{
+    int delay;
+    rk_voice_api *api;
+    short *far, *play, *cap, *out;
+    int64_t total = 0, max = 0, block_ns;
+    double in_energy = 0, out_energy = 0;
+    int i, j;
+
+    api = rk_voice_backend_load(name);
+    if (api == NULL) {
+        printf("%-8s not available\n", name);
+        return -1;
+    }
+    if ((api->negotiate == NULL) || (api->negotiate(&rate, &block) != 0)) {
+        rate = RK_VOICE_PROCESS_SAMPLERATE;
+        block = RK_VOICE_PROCESS_BLOCK;
+    }
+    delay = delay_ms * rate / 1000;
+    if (api->init(RK_VOICE_PARA_FILE) != 0)
+        printf("%-8s init %s failed, running with defaults\n", name, RK_VOICE_PARA_FILE);
+
+    far = (short *)calloc(block * (blocks + 1) + delay, sizeof(short));
+    play = (short *)malloc(block * sizeof(short));
+    cap = (short *)malloc(block * sizeof(short));
+    out = (short *)malloc(block * sizeof(short));
+    if (!far || !play || !cap || !out) {
+        printf("out of memory\n");
+        free(far);
+        free(play);
+        free(cap);
+        free(out);
+        api->deinit();
+        rk_voice_backend_unload(api);
+        return -1;
+    }
+
+    bench_seed = 1;
+    for (i = delay; i < block * (blocks + 1) + delay; i++)
+        far[i] = bench_far_end(i - delay, rate);
+
+    for (i = 0; i < blocks; i++) {
+        short *ref = far + delay + i * block;
+        int64_t start, ns;
+
+        /* the microphone hears the far end delay samples late, attenuated */
+        for (j = 0; j < block; j++)
+            cap[j] = far[i * block + j] / 2 + bench_noise(30);
+
+        start = audio_stats_now_ns();
+        api->processPlayback(ref, play, block);
+        api->processCapture(cap, play, out, block);
+        ns = audio_stats_now_ns() - start;
+
+        total += ns;
+        if (ns > max)
+            max = ns;
+        if (i >= blocks / 2) {
+            for (j = 0; j < block; j++) {
+                in_energy += (double)cap[j] * cap[j];
+                out_energy += (double)out[j] * out[j];
+            }
+        }
+    }
+
+    block_ns = (int64_t)block * 1000000000LL / rate;
+    printf("%-8s %5d Hz %4d  avg %6lld us  max %6lld us  load %5.2f%%  erle %5.1f dB\n",
+           api->name, rate, block, (long long)(total / blocks / 1000), (long long)(max / 1000),
+           (double)total * 100 / blocks / block_ns,
+           out_energy > 0 ? 10 * log10(in_energy / out_energy) : 0.0);
+
+    api->deinit();
+    rk_voice_backend_unload(api);
+    free(far);
+    free(play);
+    free(cap);
+    free(out);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    static const char *all[] = { "vendor", "speex" };
+    int blocks = BENCH_BLOCKS_DEFAULT;
+    int rate = RK_VOICE_PROCESS_SAMPLERATE;
+    int block = 0;
+    int delay_ms = BENCH_DELAY_MS_DEFAULT;
+    int i;
+
+    for (i = 1; i < argc - 1 && argv[i][0] == '-'; i += 2) {
+        if (!strcmp(argv[i], "-n"))
+            blocks = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-r"))
+            rate = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-l"))
+            block = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "-d"))
+            delay_ms = atoi(argv[i + 1]);
+        else
+            break;
+    }
+    if ((i < argc && argv[i][0] == '-') || blocks <= 0 || rate <= 0 || block < 0 || delay_ms < 0) {
+        printf("usage: voice_bench [-n blocks] [-r rate] [-l block] [-d echo_delay_ms] [backend...]\n");
+        return -1;
+    }
+    /* 16 ms blocks unless asked otherwise, backends may still change both */
+    if (block == 0)
+        block = rate * BENCH_BLOCK_MS_DEFAULT / 1000;
+
+    printf("%d blocks, asking %d samples at %d Hz, echo delay %d ms\n",
+           blocks, block, rate, delay_ms);
+    if (i == argc) {
+        for (i = 0; i < (int)(sizeof(all) / sizeof(all[0])); i++)
+            bench_run(all[i], blocks, rate, block, delay_ms);
+    } else {
+        for (; i < argc; i++)
+            bench_run(argv[i], blocks, rate, block, delay_ms);
+    }
+    return 0;
+}
@@ -0,0 +1,358 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file    voice_jitter_buffer.c
+ * @brief   adaptive jitter buffer for the voice process output queues
+ *
+ * The buffer learns the depth it needs from the consumer: an underrun
+ * raises the target by the missing frames, while a window of reads that
+ * all left spare frames lowers it again. Reads steer the depth toward
+ * the target by consuming slightly more or fewer frames than requested
+ * and resampling them to the request (at most 2%), and a read that
+ * finds too little data repeats the last output with a decaying gain
+ * instead of returning silence.
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "voice_jitter"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <cutils/log.h>
+
+#include "voice_jitter_buffer.h"
+
+/* reads per learning window, about 1s of 20ms reads */
+#define JB_WINDOW_READS (50)
+/* largest time stretch or compression per read, 1/50 of the read */
+#define JB_STRETCH_DIV (50)
+/* consecutive concealed reads before the repeat fades to silence */
+#define JB_CONCEAL_MAX (3)
+
+static int jb_frames(jitter_buffer *jb, int bytes)
+{
+    return bytes / jb->frameSize;
+}
+
+/**
+ * @brief jb_reserve
+ * grow a per buffer sample store, only the first reads allocate
+ *
+ * @param store
+ * @param frames current capacity in frames
+ * @param need frames needed
+ * @param channels
+ *
+ * @returns 0 on success
+ */
+static int jb_reserve(short **store, int *frames, int need, int channels)
+{
+    short *p;
+
+    if (*frames >= need)
+        return 0;
+    p = (short *)realloc(*store, need * channels * sizeof(short));
+    if (p == NULL)
+        return -ENOMEM;
+    *store = p;
+    *frames = need;
+    return 0;
+}
+
+static void jb_pop(jitter_buffer *jb, char *dst, int bytes)
+{
+    int first = jb->capacity - jb->head;
+
+    if (first > bytes)
+        first = bytes;
+    if (dst != NULL) {
+        memcpy(dst, jb->buf + jb->head, first);
+        memcpy(dst + first, jb->buf, bytes - first);
+    }
+    jb->head = (jb->head + bytes) % jb->capacity;
+    jb->size -= bytes;
+    jb->readBytes += bytes;
+}
+
+int jitter_buffer_init(jitter_buffer *jb, int capacity, int channels)
+{
+    memset(jb, 0, sizeof(*jb));
+    jb->channels = channels;
+    jb->frameSize = channels * sizeof(short);
+    jb->capacity = capacity / jb->frameSize * jb->frameSize;
+    jb->buf = (char *)malloc(jb->capacity);
+    if (jb->buf == NULL)
+        return -ENOMEM;
+    jitter_buffer_reset(jb);
+    return 0;
+}
+
+void jitter_buffer_release(jitter_buffer *jb)
+{
+    free(jb->buf);
+    free(jb->scratch);
+    free(jb->last);
+    memset(jb, 0, sizeof(*jb));
+}
+
+void jitter_buffer_reset(jitter_buffer *jb)
+{
+    jb->head = 0;
+    jb->size = 0;
+    jb->readBytes = 0;
+    jb->target = 0;
+    jb->priming = 1;
+    jb->lowWater = INT_MAX;
+    jb->windowReads = 0;
+    jb->concealRun = 0;
+    jb->lastFrames = 0;
+    memset(&jb->stats, 0, sizeof(jb->stats));
+}
+
+/**
+ * @brief jitter_buffer_write
+ * queue processed data, the oldest data is dropped when full
+ *
+ * @param jb
+ * @param data
+ * @param bytes
+ *
+ * @returns bytes queued
+ */
+int jitter_buffer_write(jitter_buffer *jb, const void *data, int bytes)
+{
+    int tail, first;
+
+    bytes = bytes / jb->frameSize * jb->frameSize;
+    if (bytes > jb->capacity) {
+        data = (const char *)data + bytes - jb->capacity;
+        bytes = jb->capacity;
+    }
+    if (jb->size + bytes > jb->capacity) {
+        int drop = jb->size + bytes - jb->capacity;
+
+        jb->stats.overflows += jb_frames(jb, drop);
+        jb_pop(jb, NULL, drop);
+    }
+
+    tail = (jb->head + jb->size) % jb->capacity;
+    first = jb->capacity - tail;
+    if (first > bytes)
+        first = bytes;
+    memcpy(jb->buf + tail, data, first);
+    memcpy(jb->buf, (const char *)data + first, bytes - first);
+    jb->size += bytes;
+    return bytes;
+}
+
+/**
+ * @brief jb_conceal
+ * fill frames with the last output repeated, the gain halves on every
+ * consecutive concealed read and ramps within the read so the level
+ * does not step
+ *
+ * @param jb
+ * @param out
+ * @param frames
+ */
+static void jb_conceal(jitter_buffer *jb, short *out, int frames)
+{
+    int from = jb->concealRun >= JB_CONCEAL_MAX ? 0 : 0x10000 >> jb->concealRun;
+    int to = jb->concealRun + 1 >= JB_CONCEAL_MAX ? 0 : 0x10000 >> (jb->concealRun + 1);
+    int i, c;
+
+    if ((jb->lastFrames == 0) || (from == 0)) {
+        memset(out, 0, frames * jb->frameSize);
+        return;
+    }
+    for (i = 0; i < frames; i++) {
+        short *src = jb->last + (i % jb->lastFrames) * jb->channels;
+        int gain = from + (int)((int64_t)(to - from) * i / frames);
+
+        for (c = 0; c < jb->channels; c++)
+            out[i * jb->channels + c] = (short)((src[c] * gain) >> 16);
+    }
+}
+
+/**
+ * @brief jb_stretch
+ * linear resample in frames of src to out frames of dst
+ *
+ * @param jb
+ * @param src
+ * @param in
+ * @param dst
+ * @param out
+ */
+static void jb_stretch(jitter_buffer *jb, const short *src, int in, short *dst, int out)
+{
+    int64_t step = out > 1 ? ((int64_t)(in - 1) << 16) / (out - 1) : 0;
+    int i, c;
+
+    for (i = 0; i < out; i++) {
+        int64_t pos = step * i;
+        int idx = (int)(pos >> 16);
+        int frac = (int)(pos & 0xffff);
+        const short *a = src + idx * jb->channels;
+        const short *b = idx + 1 < in ? a + jb->channels : a;
+
+        for (c = 0; c < jb->channels; c++)
+            dst[i * jb->channels + c] = (short)(a[c] + (((int64_t)(b[c] - a[c]) * frac) >> 16));
+    }
+}
+
+/**
+ * @brief jb_learn
+ * lower the target when a whole window of reads kept spare frames, the
+ * spare frames beyond half a read are given back half at a time. Depth
+ * above the target is backlog, not margin, and does not count.
+ *
+ * @param jb
+ * @param avail frames queued before this read
+ * @param frames frames per read
+ */
+static void jb_learn(jitter_buffer *jb, int avail, int frames)
+{
+    int slack = (avail < jb->target ? avail : jb->target) - frames;
+
+    if (slack < jb->lowWater)
+        jb->lowWater = slack;
+    if (++jb->windowReads < JB_WINDOW_READS)
+        return;
+
+    if (jb->lowWater > frames / 2) {
+        jb->target -= (jb->lowWater - frames / 2) / 2;
+        if (jb->target < frames)
+            jb->target = frames;
+        ALOGV("target down to %d frames", jb->target);
+    }
+    jb->lowWater = INT_MAX;
+    jb->windowReads = 0;
+}
+
+/**
+ * @brief jitter_buffer_read
+ * always fills bytes of data, concealing what the queue can not provide
+ *
+ * @param jb
+ * @param data
+ * @param bytes
+ *
+ * @returns bytes that came from queued data, 0 if all was concealed
+ */
+int jitter_buffer_read(jitter_buffer *jb, void *data, int bytes)
+{
+    int frames = jb_frames(jb, bytes);
+    int avail = jb_frames(jb, jb->size);
+    int maxTarget = jb_frames(jb, jb->capacity) / 2;
+    short *out = (short *)data;
+    int got = 0;
+
+    if (frames <= 0)
+        return 0;
+    jb->stats.reads++;
+    if (jb->target == 0)
+        jb->target = 2 * frames < maxTarget ? 2 * frames : maxTarget;
+
+    if (jb->priming && avail >= jb->target)
+        jb->priming = 0;
+
+    if (jb->priming) {
+        jb_conceal(jb, out, frames);
+        jb->stats.concealed += frames;
+        if (jb->lastFrames)
+            jb->concealRun++;
+    } else if (avail < frames) {
+        /* underrun: play what is left, conceal the rest and grow */
+        jb_pop(jb, (char *)out, avail * jb->frameSize);
+        jb_conceal(jb, out + avail * jb->channels, frames - avail);
+        got = avail * jb->frameSize;
+        jb->stats.underruns++;
+        jb->stats.concealed += frames - avail;
+        jb->concealRun++;
+        jb->target += frames - avail + frames / 4;
+        if (jb->target > maxTarget)
+            jb->target = maxTarget;
+        jb->priming = 1;
+        ALOGV("underrun, %d of %d frames, target up to %d", avail, frames, jb->target);
+    } else {
+        /* steer toward the target by a small time stretch */
+        int error = avail - jb->target;
+        int limit = frames / JB_STRETCH_DIV;
+        int delta = 0;
+
+        if ((error > frames / 4) || (error < -frames / 4))
+            delta = error / 16;
+        if (delta > limit)
+            delta = limit;
+        if (delta < -limit)
+            delta = -limit;
+        if (frames + delta > avail)
+            delta = avail - frames;
+
+        if ((delta != 0) && (jb_reserve(&jb->scratch, &jb->scratchFrames,
+                             frames + delta, jb->channels) == 0)) {
+            jb_pop(jb, (char *)jb->scratch, (frames + delta) * jb->frameSize);
+            jb_stretch(jb, jb->scratch, frames + delta, out, frames);
+            if (delta > 0)
+                jb->stats.compressed += delta;
+            else
+                jb->stats.stretched += -delta;
+        } else {
+            delta = 0;
+            jb_pop(jb, (char *)out, bytes);
+        }
+        got = bytes;
+        jb->concealRun = 0;
+        jb_learn(jb, avail, frames);
+    }
+
+    if (got && (jb_reserve(&jb->last, &jb->lastFrames, frames, jb->channels) == 0)) {
+        memcpy(jb->last, out, bytes);
+        jb->lastFrames = frames;
+    }
+    return got;
+}
+
+void jitter_buffer_get_stats(jitter_buffer *jb, rk_jitter_stats *stats)
+{
+    *stats = jb->stats;
+    stats->depth = jb_frames(jb, jb->size);
+    stats->target = jb->target;
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef VOICE_JITTER_BUFFER_H_
+#define VOICE_JITTER_BUFFER_H_
+
+#include <stdint.h>
+
+#include "voice_preprocess.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * adaptive jitter buffer between the voice process thread and the
+ * stream that consumes its output. Not locked, the caller serializes
+ * writes and reads.
+ */
+typedef struct jitter_buffer_ {
+    char   *buf;
+    int    capacity;        // bytes
+    int    channels;
+    int    frameSize;       // bytes
+    int    head;            // ring offset of the oldest byte
+    int    size;            // bytes queued
+    int64_t readBytes;      // bytes consumed or dropped since reset
+    int    target;          // learned depth before a read, frames
+    int    priming;
+    int    lowWater;        // least slack left by a read in this window, frames
+    int    windowReads;
+    int    concealRun;      // consecutive concealed reads
+    short  *scratch;
+    int    scratchFrames;
+    short  *last;           // last output, repeated for concealment
+    int    lastFrames;
+    rk_jitter_stats stats;
+} jitter_buffer;
+
+int jitter_buffer_init(jitter_buffer *jb, int capacity, int channels);
+void jitter_buffer_release(jitter_buffer *jb);
+void jitter_buffer_reset(jitter_buffer *jb);
+int jitter_buffer_write(jitter_buffer *jb, const void *data, int bytes);
+int jitter_buffer_read(jitter_buffer *jb, void *data, int bytes);
+void jitter_buffer_get_stats(jitter_buffer *jb, rk_jitter_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -63,7 +63,9 @@
 #include <pthread.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>
+#include <time.h>
 #include <dlfcn.h>  // for dlopen/dlclose
 #include <fcntl.h>
 
@@ -77,13 +79,29 @@
 
 
 #include "voice_preprocess.h"
+#include "voice_jitter_buffer.h"
+#include "audio_thread.h"
+#include "audio_live.h"
 
 #define LOG_TAG "voice_process"
 
 
 #define MAX_BUFFER_SIZE (500 * 1024)
-#define PROCESS_BUFFER_SIZE (256)
-#define FILE_PATH "/etc/RK_VoicePara.bin"
+/* process block length in ms, media.audio.3a.block_ms picks one of these */
+static const int process_block_ms[] = { 16, 10, 5 };
+static const int process_samplerates[] = { 16000, 32000, 48000 };
+#define FILE_PATH RK_VOICE_PARA_FILE
+#define VENDOR_LIB_PATH "/system/lib/libvoiceprocess.so"
+/* blocks between two processing time reports when media.audio.3a.bench is set */
+#define BENCH_REPORT_BLOCKS (1000)
+/* echo reference history kept for delay alignment */
+#define ECHO_REF_HISTORY_MS (500)
+/* smoothing shift of the echo delay estimator, 1/8 per block */
+#define ECHO_DELAY_SMOOTH_SHIFT (3)
+#define NS_PER_SEC (1000000000LL)
+/* default scheduling of the process thread, SCHED_FIFO or the nice fallback */
+#define VOICE_THREAD_RT_PRIORITY (2)
+#define VOICE_THREAD_NICE (-19)
 #define false (0)
 #define true  (1)
 #define bool  int
@@ -98,7 +116,7 @@ FILE *out_playback_debug;
 
 typedef struct voiceThread_t_ {
     bool            running;
-    pthread_t       thread;
+    audio_thread    thread;
     sem_t           sem;
     int             threadStatus;
     pthread_mutex_t queueCapLock;
@@ -107,22 +125,13 @@ typedef struct voiceThread_t_ {
     pthread_mutex_t getPlyOutLock;
 } voiceThread_t;
 
-typedef struct rk_voice_api_ {
-    int (*init)(char *para);
-    void  (*processCapture)(short  *in, short *ref, short *out, int len);
-    void  (*processPlayback)(short *in, short *out, int len);
-    void  (*deinit)();
-} rk_voice_api;
-
-
 typedef struct rk_voice_handle_ {
-    void*   voiceLibHandle;
     rk_voice_api *voiceApi;
     rk_process_api *processApi;
     char*  playBackBuffer;
     char*  captureBuffer;
-    char*  outPlayBuffer;
-    char*  outCaptureBuffer;
+    jitter_buffer outPlayBuffer;
+    jitter_buffer outCaptureBuffer;
     SpeexResamplerState* speexCapureDownResample;
     SpeexResamplerState* speexCapureUpResample;
     SpeexResamplerState* speexPlaybackDownResample;
@@ -130,8 +139,6 @@ typedef struct rk_voice_handle_ {
     voiceThread_t voice_thread;
     int    playbackBufferSize;
     int    captureBufferSize;
-    int    outPlaybackBufferSize;
-    int    outCaptureBufferSize;
     int    captureInSamplerate;
     int    processSamplerate;
     int    playbackInSamplerate;
@@ -141,12 +148,112 @@ typedef struct rk_voice_handle_ {
     int    processBuffersize;
     int    minPlaybackBuffersize;
     int    minCaptureBuffersize;
+    /*
+     * echo reference alignment. refRing holds the processed playback at
+     * the process rate, refWritePos counts the samples ever written to it.
+     * Playback anchors map a refRing position to its presentation time,
+     * capture anchors map a capture stream byte offset to its capture time.
+     */
+    short* refRing;
+    int    refRingSize;
+    int64_t refWritePos;
+    int64_t playAnchorPos;
+    int64_t playAnchorNs;
+    int64_t captureQueuedBytes;
+    int64_t captureReadBytes;
+    int64_t capAnchorBytes;
+    int64_t capAnchorNs;
+    int64_t echoDelayEstimate;
+    int    echoDelay;
+    /* backend processing time, reported when media.audio.3a.bench is set */
+    bool   benchEnable;
+    int    benchBlocks;
+    int64_t benchTotalNs;
+    int64_t benchMaxNs;
 } rk_voice_handle;
 
 
 static rk_voice_handle *voice_handle = NULL;
 static int prop_pcm_record = 0;
 
+/**
+ * @brief vendor_backend_load
+ * the vendor voice process library, loaded at runtime when present
+ *
+ * @param api
+ *
+ * @returns 0 on success
+ */
+static int vendor_backend_load(rk_voice_api *api)
+{
+    void *lib = dlopen(VENDOR_LIB_PATH, RTLD_LAZY);
+
+    if (lib == NULL) {
+        ALOGW("dlopen libvoiceprocess lib error!");
+        return -1;
+    }
+
+    api->init = (int (*)(char *))dlsym(lib, "RK_VOICE_Init");
+    api->processCapture = (void (*)(short *in, short *ref, short *out,
+                                    int len))dlsym(lib, "RK_VOICE_ProcessTx");
+    api->processPlayback = (void (*)(short *in, short *out,
+                                     int len))dlsym(lib, "RK_VOICE_ProcessRx");
+    api->deinit = (void (*)())dlsym(lib, "RK_VOICE_Destory");
+
+    if ((api->init == NULL) || (api->processCapture == NULL)
+            || (api->processPlayback == NULL) || (api->deinit == NULL)) {
+        ALOGE("dlsym voice process lib failed, return");
+        dlclose(lib);
+        return -1;
+    }
+    api->priv = lib;
+    return 0;
+}
+
+static void vendor_backend_unload(rk_voice_api *api)
+{
+    if (api->priv != NULL) {
+        dlclose(api->priv);
+        api->priv = NULL;
+    }
+}
+
+static rk_voice_api vendor_voice_api = {
+    .name = "vendor",
+    .load = vendor_backend_load,
+    .unload = vendor_backend_unload,
+};
+
+/* backends in order of preference, add new ones here */
+static rk_voice_api *voice_backends[] = {
+    &vendor_voice_api,
+    &rk_voice_speex_api,
+};
+
+rk_voice_api* rk_voice_backend_load(const char *name)
+{
+    unsigned i;
+
+    for (i = 0; i < sizeof(voice_backends) / sizeof(voice_backends[0]); i++) {
+        rk_voice_api *api = voice_backends[i];
+
+        if ((name != NULL) && strcmp(name, api->name))
+            continue;
+        if ((api->load == NULL) || (api->load(api) == 0)) {
+            ALOGD("voice process backend: %s", api->name);
+            return api;
+        }
+    }
+    ALOGW("no voice process backend %s available", name ? name : "");
+    return NULL;
+}
+
+void rk_voice_backend_unload(rk_voice_api *api)
+{
+    if ((api != NULL) && (api->unload != NULL))
+        api->unload(api);
+}
+
 static void thread_loop(rk_voice_handle* handle);
 static void*  thread_start(void* argv);
 static void dump_out_data(const void* buffer,size_t bytes, int *size)
@@ -183,15 +290,24 @@ static int start()
     sem_init(&voice_handle->voice_thread.sem, 0, 1);
     voiceHandle->voice_thread.running = true;
 
-    if (voiceHandle->voice_thread.threadStatus == -1)
-        voiceHandle->voice_thread.threadStatus = pthread_create(&voiceHandle->voice_thread.thread, NULL, thread_start, voiceHandle);
+    if (voiceHandle->voice_thread.threadStatus == -1) {
+        audio_thread_attr attr;
+
+        // runs once per block against the stream deadlines, media.audio.3a.* can override
+        audio_thread_attr_init(&attr, "voice_3a");
+        attr.rtPriority = VOICE_THREAD_RT_PRIORITY;
+        attr.nice = VOICE_THREAD_NICE;
+        audio_thread_attr_from_props(&attr, "media.audio.3a");
+        voiceHandle->voice_thread.threadStatus = audio_thread_create(&voiceHandle->voice_thread.thread,
+                                                                     &attr, thread_start, voiceHandle);
+    }
 
     ALOGD("voice process start !, ret = %d", voiceHandle->voice_thread.threadStatus);
 
     return 0;
 }
 
-static int queueCaputureBuffer(void *buf, int size)
+static int queueCaptureBufferTs(void *buf, int size, int64_t capture_ns)
 {
     rk_voice_handle* voiceHandle = getHandle();
 
@@ -204,20 +320,32 @@ static int queueCaputureBuffer(void *buf, int size)
     if (voiceHandle->captureBufferSize + size >= MAX_BUFFER_SIZE) {
         ALOGW("capture buffer size out of range, flush");
         memset(voiceHandle->captureBuffer, 0x00, MAX_BUFFER_SIZE);
+        voiceHandle->captureReadBytes += voiceHandle->captureBufferSize;
         voiceHandle->captureBufferSize = 0;
     }
+    if (capture_ns >= 0) {
+        voiceHandle->capAnchorBytes = voiceHandle->captureQueuedBytes;
+        voiceHandle->capAnchorNs = capture_ns;
+    }
     memcpy((char *)voiceHandle->captureBuffer + voiceHandle->captureBufferSize, (char *)buf, size);
     voiceHandle->captureBufferSize += size;
+    voiceHandle->captureQueuedBytes += size;
     pthread_mutex_unlock(&voiceHandle->voice_thread.queueCapLock);
 
 
     if ((voiceHandle->captureBufferSize >= voiceHandle->minCaptureBuffersize)
             && (voiceHandle->playbackBufferSize >= voiceHandle->minPlaybackBuffersize)) {
+        audio_thread_wake(&voiceHandle->voice_thread.thread);
         sem_post(&voiceHandle->voice_thread.sem);
     }
     return 0;
 }
 
+static int queueCaputureBuffer(void *buf, int size)
+{
+    return queueCaptureBufferTs(buf, size, -1);
+}
+
 static int queuePlaybackBuffer(void *buf, int size)
 {
     rk_voice_handle* voiceHandle = getHandle();
@@ -234,6 +362,7 @@ static int queuePlaybackBuffer(void *buf, int size)
 
     if ((voiceHandle->captureBufferSize >= voiceHandle->minCaptureBuffersize)
             && (voiceHandle->playbackBufferSize >= voiceHandle->minPlaybackBuffersize)) {
+        audio_thread_wake(&voiceHandle->voice_thread.thread);
         sem_post(&voiceHandle->voice_thread.sem);
     }
     return 0;
@@ -243,35 +372,81 @@ static int getCapureBuffer(void *buf, int size)
 {
     rk_voice_handle* voiceHandle = getHandle();
 
-    if (voiceHandle->outCaptureBufferSize < size) {
-        ALOGW("cannot get caputre buffer currently, try next time");
-        return -1;
-    }
     pthread_mutex_lock(&voiceHandle->voice_thread.getCapOutLock);
-    memcpy((char *)buf, voiceHandle->outCaptureBuffer, size);
-    memcpy(voiceHandle->outCaptureBuffer, voiceHandle->outCaptureBuffer+size, MAX_BUFFER_SIZE-size);
-    voiceHandle->outCaptureBufferSize -= size;
+    if (jitter_buffer_read(&voiceHandle->outCaptureBuffer, buf, size) < size) {
+        ALOGV("capture buffer concealed");
+    }
     pthread_mutex_unlock(&voiceHandle->voice_thread.getCapOutLock);
     return 0;
 }
 
-static int getPlaybackBuffer(void *buf, int size)
+/**
+ * @brief outPlayBytesToRefPos
+ * map a byte offset of the processed playback stream to the refRing
+ * position holding the same sample, both advance one block at a time
+ *
+ * @param handle
+ * @param bytes
+ *
+ * @returns
+ */
+static int64_t outPlayBytesToRefPos(rk_voice_handle* handle, int64_t bytes)
+{
+    int64_t block = handle->minPlaybackBuffersize;
+
+    return bytes / block * handle->processBuffersize
+           + bytes % block * handle->processBuffersize / block;
+}
+
+static int getPlaybackBufferTs(void *buf, int size, int64_t present_ns)
 {
     rk_voice_handle* voiceHandle = getHandle();
 
-    if (voiceHandle->outPlaybackBufferSize < size) {
-        ALOGW("cannot get playback buffer currently, try next time");
-        return -1;
-    }
     pthread_mutex_lock(&voiceHandle->voice_thread.getPlyOutLock);
-    memcpy((char *)buf, (char *)voiceHandle->outPlayBuffer, size);
-    memcpy((char *)voiceHandle->outPlayBuffer, (char *)voiceHandle->outPlayBuffer+size, MAX_BUFFER_SIZE-size);
-    voiceHandle->outPlaybackBufferSize -= size;
+    int64_t readBytes = voiceHandle->outPlayBuffer.readBytes;
+    if (jitter_buffer_read(&voiceHandle->outPlayBuffer, buf, size) < size) {
+        ALOGV("playback buffer concealed");
+    } else if (present_ns >= 0) {
+        voiceHandle->playAnchorPos = outPlayBytesToRefPos(voiceHandle, readBytes);
+        voiceHandle->playAnchorNs = present_ns;
+    }
     pthread_mutex_unlock(&voiceHandle->voice_thread.getPlyOutLock);
 
     return 0;
 }
 
+static int getPlaybackBuffer(void *buf, int size)
+{
+    return getPlaybackBufferTs(buf, size, -1);
+}
+
+static int getJitterStats(rk_jitter_stats *playback, rk_jitter_stats *capture)
+{
+    rk_voice_handle* voiceHandle = getHandle();
+
+    if (playback != NULL) {
+        pthread_mutex_lock(&voiceHandle->voice_thread.getPlyOutLock);
+        jitter_buffer_get_stats(&voiceHandle->outPlayBuffer, playback);
+        pthread_mutex_unlock(&voiceHandle->voice_thread.getPlyOutLock);
+    }
+    if (capture != NULL) {
+        pthread_mutex_lock(&voiceHandle->voice_thread.getCapOutLock);
+        jitter_buffer_get_stats(&voiceHandle->outCaptureBuffer, capture);
+        pthread_mutex_unlock(&voiceHandle->voice_thread.getCapOutLock);
+    }
+    return 0;
+}
+
+static int getThreadStats(audio_thread_stats *stats)
+{
+    rk_voice_handle* voiceHandle = getHandle();
+
+    if (voiceHandle->voice_thread.threadStatus != 0)
+        return -1;
+    audio_thread_get_stats(&voiceHandle->voice_thread.thread, stats);
+    return 0;
+}
+
 static int flush()
 {
     rk_voice_handle* voiceHandle = getHandle();
@@ -283,13 +458,74 @@ static int flush()
 
     pthread_mutex_lock(&voiceHandle->voice_thread.queueCapLock);
     memset((char *)voiceHandle->captureBuffer, 0x00, MAX_BUFFER_SIZE);
+    voiceHandle->captureReadBytes += voiceHandle->captureBufferSize;
     voiceHandle->captureBufferSize = 0;
     pthread_mutex_unlock(&voiceHandle->voice_thread.queueCapLock);
 
+    /* playback stopped, the presentation clock is no longer valid */
+    pthread_mutex_lock(&voiceHandle->voice_thread.getPlyOutLock);
+    voiceHandle->playAnchorNs = -1;
+    pthread_mutex_unlock(&voiceHandle->voice_thread.getPlyOutLock);
+
     return 0;
 }
 
 
+static bool voiceProcessRateSupported(int rate)
+{
+    unsigned i;
+
+    for (i = 0; i < sizeof(process_samplerates) / sizeof(process_samplerates[0]); i++)
+        if (process_samplerates[i] == rate)
+            return true;
+    return false;
+}
+
+/**
+ * @brief voiceProcessPickRate
+ * preferred process rate: media.audio.3a.rate if set, else the stream
+ * rate when both streams share a supported one so no resampling is
+ * needed at all, else RK_VOICE_PROCESS_SAMPLERATE
+ *
+ * @param ply_sr
+ * @param cap_sr
+ *
+ * @returns
+ */
+static int voiceProcessPickRate(int ply_sr, int cap_sr)
+{
+    char value[PROPERTY_VALUE_MAX] = "";
+    int rate;
+
+    property_get("media.audio.3a.rate", value, "");
+    rate = atoi(value);
+    if (voiceProcessRateSupported(rate))
+        return rate;
+    if ((ply_sr == cap_sr) && voiceProcessRateSupported(cap_sr))
+        return cap_sr;
+    return RK_VOICE_PROCESS_SAMPLERATE;
+}
+
+/**
+ * @brief voiceProcessPickBlockMs
+ * preferred process block from media.audio.3a.block_ms, 16 ms by default
+ *
+ * @returns
+ */
+static int voiceProcessPickBlockMs()
+{
+    char value[PROPERTY_VALUE_MAX] = "";
+    unsigned i;
+    int ms;
+
+    property_get("media.audio.3a.block_ms", value, "");
+    ms = atoi(value);
+    for (i = 0; i < sizeof(process_block_ms) / sizeof(process_block_ms[0]); i++)
+        if (process_block_ms[i] == ms)
+            return ms;
+    return process_block_ms[0];
+}
+
 rk_process_api* rk_voiceprocess_create(int ply_sr, int ply_ch, int cap_sr, int cap_ch)
 {
     if (voice_handle != NULL) {
@@ -304,66 +540,67 @@ rk_process_api* rk_voiceprocess_create(int ply_sr, int ply_ch, int cap_sr, int c
         goto failed;
     }
 
-    voice_handle->voiceLibHandle        = NULL;
     voice_handle->voiceApi              = NULL;
     voice_handle->processApi            = NULL;
     voice_handle->playBackBuffer        = NULL;
     voice_handle->captureBuffer         = NULL;
+    memset(&voice_handle->outPlayBuffer, 0, sizeof(jitter_buffer));
+    memset(&voice_handle->outCaptureBuffer, 0, sizeof(jitter_buffer));
+    voice_handle->refRing               = NULL;
     voice_handle->speexCapureDownResample   = NULL;
     voice_handle->speexCapureUpResample     = NULL;
     voice_handle->speexPlaybackDownResample = NULL;
     voice_handle->speexPlaybackUpResample   = NULL;
     voice_handle->playbackBufferSize     = 0;
     voice_handle->captureBufferSize      = 0;
-    voice_handle->outPlaybackBufferSize  = 0;
-    voice_handle->outCaptureBufferSize   = 0;
     voice_handle->captureInSamplerate    = cap_sr;
-    voice_handle->processSamplerate      = 16000;
+    voice_handle->processSamplerate      = voiceProcessPickRate(ply_sr, cap_sr);
     voice_handle->playbackInSamplerate   = ply_sr;
     voice_handle->captureInChannels      = cap_ch;
     voice_handle->processChannels        = 1;
     voice_handle->playbackInChannels     = ply_ch;
-
-    voice_handle->minPlaybackBuffersize = PROCESS_BUFFER_SIZE * 2 * voice_handle->playbackInSamplerate / voice_handle->processSamplerate * voice_handle->playbackInChannels;
-    voice_handle->minCaptureBuffersize = PROCESS_BUFFER_SIZE * 2 * voice_handle->captureInSamplerate / voice_handle->processSamplerate * voice_handle->captureInChannels;
+    voice_handle->refWritePos            = 0;
+    voice_handle->playAnchorPos          = 0;
+    voice_handle->playAnchorNs           = -1;
+    voice_handle->captureQueuedBytes     = 0;
+    voice_handle->captureReadBytes       = 0;
+    voice_handle->capAnchorBytes         = 0;
+    voice_handle->capAnchorNs            = -1;
+    voice_handle->echoDelayEstimate      = -1;
+    voice_handle->echoDelay              = 0;
+    voice_handle->benchEnable            = property_get_bool("media.audio.3a.bench", false);
+    voice_handle->benchBlocks            = 0;
+    voice_handle->benchTotalNs           = 0;
+    voice_handle->benchMaxNs             = 0;
 
     voice_handle->voice_thread.running = false;
     voice_handle->voice_thread.threadStatus = -1;
 
-    // open the voice process lib
-    voice_handle->voiceLibHandle = dlopen("/system/lib/libvoiceprocess.so", RTLD_LAZY);
-    if (voice_handle->voiceLibHandle == NULL) {
-        ALOGW("dlopen libvoiceprocess lib error!");
-        goto failed;
-    }
-    voice_handle->voiceApi = (rk_voice_api *)malloc(sizeof(rk_voice_api));
+    // load the voice process backend, media.audio.3a.backend picks one by name
+    char backend[PROPERTY_VALUE_MAX] = "";
+    property_get("media.audio.3a.backend", backend, "");
+    voice_handle->voiceApi = rk_voice_backend_load(backend[0] ? backend : NULL);
     if (voice_handle->voiceApi == NULL) {
-        ALOGE("voiceApi malloc error!  return");
         goto failed;
     }
 
-    memset(voice_handle->voiceApi, 0, sizeof(rk_voice_api));
-
-    voice_handle->voiceApi->init = (int (*)(char *))dlsym(voice_handle->voiceLibHandle,
-                                   "RK_VOICE_Init");
-    voice_handle->voiceApi->processCapture = (void (*)(short  *in,
-            short *ref, short *out,
-            int len))dlsym(voice_handle->voiceLibHandle,
-                           "RK_VOICE_ProcessTx");
-    voice_handle->voiceApi->processPlayback = (void (*)(short  *in,
-            short *out,
-            int len))dlsym(voice_handle->voiceLibHandle,
-                           "RK_VOICE_ProcessRx");
-    voice_handle->voiceApi->deinit= (void (*)())dlsym(voice_handle->voiceLibHandle,
-                                    "RK_VOICE_Destory");
-
-    if ((voice_handle->voiceApi->init == NULL)
-            || (voice_handle->voiceApi->processCapture == NULL)
-            || (voice_handle->voiceApi->processPlayback == NULL)
-            || (voice_handle->voiceApi->deinit == NULL)) {
-        ALOGE("dlsym voice process lib failed, return");
-        goto failed;
+    // agree on the process rate and block with the backend
+    voice_handle->processBuffersize = voice_handle->processSamplerate * voiceProcessPickBlockMs() / 1000;
+    if ((voice_handle->voiceApi->negotiate == NULL)
+            || (voice_handle->voiceApi->negotiate(&voice_handle->processSamplerate,
+                    &voice_handle->processBuffersize) != 0)) {
+        voice_handle->processSamplerate = RK_VOICE_PROCESS_SAMPLERATE;
+        voice_handle->processBuffersize = RK_VOICE_PROCESS_BLOCK;
     }
+    ALOGD("voice process at %d Hz, %d sample blocks, streams playback %d Hz capture %d Hz",
+          voice_handle->processSamplerate, voice_handle->processBuffersize,
+          voice_handle->playbackInSamplerate, voice_handle->captureInSamplerate);
+
+    voice_handle->refRingSize = voice_handle->processSamplerate * ECHO_REF_HISTORY_MS / 1000;
+    voice_handle->minPlaybackBuffersize = voice_handle->processBuffersize * voice_handle->playbackInSamplerate
+                                          / voice_handle->processSamplerate * voice_handle->playbackInChannels * 2;
+    voice_handle->minCaptureBuffersize = voice_handle->processBuffersize * voice_handle->captureInSamplerate
+                                         / voice_handle->processSamplerate * voice_handle->captureInChannels * 2;
 
     // init the voice process lib
     int ret = 0;
@@ -381,15 +618,22 @@ rk_process_api* rk_voiceprocess_create(int ply_sr, int ply_ch, int cap_sr, int c
     voice_handle->processApi->queuePlaybackBuffer = queuePlaybackBuffer;
     voice_handle->processApi->quueCaputureBuffer = queueCaputureBuffer;
     voice_handle->processApi->flush = flush;
+    voice_handle->processApi->queueCaptureBufferTs = queueCaptureBufferTs;
+    voice_handle->processApi->getPlaybackBufferTs = getPlaybackBufferTs;
+    voice_handle->processApi->getJitterStats = getJitterStats;
+    voice_handle->processApi->getThreadStats = getThreadStats;
 
     // malloc process buffers
     voice_handle->playBackBuffer = (char *)malloc(MAX_BUFFER_SIZE);
     voice_handle->captureBuffer = (char *)malloc(MAX_BUFFER_SIZE);
-    voice_handle->outPlayBuffer = (char *)malloc(MAX_BUFFER_SIZE);
-    voice_handle->outCaptureBuffer = (char *)malloc(MAX_BUFFER_SIZE);
+    voice_handle->refRing = (short *)calloc(voice_handle->refRingSize, sizeof(short));
 
     if ((voice_handle->playBackBuffer == NULL) || (voice_handle->captureBuffer == NULL)
-            ||(voice_handle->outPlayBuffer == NULL) || (voice_handle->outCaptureBuffer == NULL)) {
+            || (jitter_buffer_init(&voice_handle->outPlayBuffer, MAX_BUFFER_SIZE,
+                                   voice_handle->playbackInChannels) != 0)
+            || (jitter_buffer_init(&voice_handle->outCaptureBuffer, MAX_BUFFER_SIZE,
+                                   voice_handle->captureInChannels) != 0)
+            || (voice_handle->refRing == NULL)) {
         ALOGE("malloc playback or capure buffer falied!");
         goto failed;
     }
@@ -432,7 +676,7 @@ int rk_voiceprocess_destory()
         voice_handle->voice_thread.running = false;
         sem_post(&voice_handle->voice_thread.sem);
         ALOGD("join thread in");
-        pthread_join(voice_handle->voice_thread.thread, NULL);
+        audio_thread_join(&voice_handle->voice_thread.thread);
         voice_handle->voice_thread.threadStatus = -1;
         ALOGD("join thread out");
 
@@ -444,9 +688,9 @@ int rk_voiceprocess_destory()
         voice_handle->speexCapureDownResample = NULL;
     }
 
-    if (voice_handle->speexCapureDownResample) {
-        speex_resampler_destroy(voice_handle->speexCapureDownResample);
-        voice_handle->speexCapureDownResample = NULL;
+    if (voice_handle->speexCapureUpResample) {
+        speex_resampler_destroy(voice_handle->speexCapureUpResample);
+        voice_handle->speexCapureUpResample = NULL;
     }
 
     if (voice_handle->speexPlaybackUpResample) {
@@ -475,22 +719,23 @@ int rk_voiceprocess_destory()
         pthread_mutex_unlock(&voice_handle->voice_thread.queueCapLock);
     }
 
-    if (voice_handle->outPlayBuffer != NULL) {
+    if (voice_handle->outPlayBuffer.buf != NULL) {
         pthread_mutex_lock(&voice_handle->voice_thread.getPlyOutLock);
-        free(voice_handle->outPlayBuffer);
-        voice_handle->outPlayBuffer = NULL;
-        voice_handle->outPlaybackBufferSize = 0;
+        jitter_buffer_release(&voice_handle->outPlayBuffer);
         pthread_mutex_unlock(&voice_handle->voice_thread.getPlyOutLock);
     }
 
-    if (voice_handle->outCaptureBuffer != NULL) {
+    if (voice_handle->outCaptureBuffer.buf != NULL) {
         pthread_mutex_lock(&voice_handle->voice_thread.getCapOutLock);
-        free(voice_handle->outCaptureBuffer);
-        voice_handle->outCaptureBuffer = NULL;
-        voice_handle->outCaptureBufferSize = 0;
+        jitter_buffer_release(&voice_handle->outCaptureBuffer);
         pthread_mutex_unlock(&voice_handle->voice_thread.getCapOutLock);
     }
 
+    if (voice_handle->refRing != NULL) {
+        free(voice_handle->refRing);
+        voice_handle->refRing = NULL;
+    }
+
     if (voice_handle->processApi) {
         free(voice_handle->processApi);
         voice_handle->processApi = NULL;
@@ -498,16 +743,9 @@ int rk_voiceprocess_destory()
 
     if (voice_handle->voiceApi) {
         voice_handle->voiceApi->deinit();
-    }
-
-    if (voice_handle->voiceApi != NULL) {
-        free(voice_handle->voiceApi);
+        rk_voice_backend_unload(voice_handle->voiceApi);
         voice_handle->voiceApi = NULL;
     }
-    if (voice_handle->voiceLibHandle != NULL) {
-        dlclose(voice_handle->voiceLibHandle);
-        voice_handle->voiceLibHandle = NULL;
-    }
 
     if (voice_handle != NULL) {
         free(voice_handle);
@@ -518,7 +756,7 @@ int rk_voiceprocess_destory()
 }
 
 
-static int processBuffertoMono(void *buffer, int size)
+int processBuffertoMono(void *buffer, int size)
 {
     short *in = (short *)buffer;
     short out[size/4];
@@ -533,7 +771,7 @@ static int processBuffertoMono(void *buffer, int size)
     return 0;
 }
 
-static int processBuffertoStereo(void *buffer, int size)
+int processBuffertoStereo(void *buffer, int size)
 {
     short *in = (short *)buffer;
     short out[size];
@@ -549,6 +787,129 @@ static int processBuffertoStereo(void *buffer, int size)
 }
 
 
+/**
+ * @brief echoRefWrite
+ * append a processed playback block to the echo reference history
+ *
+ * @param handle
+ * @param buf
+ * @param samples
+ */
+static void echoRefWrite(rk_voice_handle* handle, const short *buf, int samples)
+{
+    int i;
+
+    for (i = 0; i < samples; i++)
+        handle->refRing[(handle->refWritePos + i) % handle->refRingSize] = buf[i];
+    handle->refWritePos += samples;
+}
+
+/**
+ * @brief echoRefRead
+ * read the reference history from position pos, samples not (or no
+ * longer) in the history are returned as silence
+ *
+ * @param handle
+ * @param pos
+ * @param buf
+ * @param samples
+ */
+static void echoRefRead(rk_voice_handle* handle, int64_t pos, short *buf, int samples)
+{
+    int i;
+
+    for (i = 0; i < samples; i++, pos++) {
+        if ((pos < 0) || (pos >= handle->refWritePos)
+                || (pos < handle->refWritePos - handle->refRingSize))
+            buf[i] = 0;
+        else
+            buf[i] = handle->refRing[pos % handle->refRingSize];
+    }
+}
+
+/**
+ * @brief echoDelayUpdate
+ * estimate how many samples the capture block lags behind the reference
+ * block processed with it. The reference presented at the capture time
+ * of the block is located through the playback and capture timestamps,
+ * the raw delay is smoothed and only applied once it moves by more than
+ * half a block, so the reference is aligned to within one block without
+ * jumping on timestamp jitter.
+ *
+ * @param handle
+ * @param capBlockBytes capture stream offset of the block
+ * @param blockPos refRing position of the block's own reference
+ */
+static void echoDelayUpdate(rk_voice_handle* handle, int64_t capBlockBytes, int64_t blockPos)
+{
+    int64_t capAnchorBytes, capAnchorNs, playAnchorPos, playAnchorNs;
+    int64_t capNs, raw, maxDelay;
+    int capBytesPerSec = handle->captureInSamplerate * handle->captureInChannels * 2;
+
+    pthread_mutex_lock(&handle->voice_thread.queueCapLock);
+    capAnchorBytes = handle->capAnchorBytes;
+    capAnchorNs = handle->capAnchorNs;
+    pthread_mutex_unlock(&handle->voice_thread.queueCapLock);
+
+    pthread_mutex_lock(&handle->voice_thread.getPlyOutLock);
+    playAnchorPos = handle->playAnchorPos;
+    playAnchorNs = handle->playAnchorNs;
+    pthread_mutex_unlock(&handle->voice_thread.getPlyOutLock);
+
+    if ((capAnchorNs < 0) || (playAnchorNs < 0))
+        return;
+
+    capNs = capAnchorNs + (capBlockBytes - capAnchorBytes) * NS_PER_SEC / capBytesPerSec;
+    raw = blockPos - (playAnchorPos + (capNs - playAnchorNs) * handle->processSamplerate / NS_PER_SEC);
+
+    /* a negative delay means the reference is not processed yet, keep arrival order */
+    maxDelay = handle->refRingSize - 2 * handle->processBuffersize;
+    if (raw < 0)
+        raw = 0;
+    if (raw > maxDelay)
+        raw = maxDelay;
+
+    if (handle->echoDelayEstimate < 0)
+        handle->echoDelayEstimate = raw;
+    else
+        handle->echoDelayEstimate += (raw - handle->echoDelayEstimate) >> ECHO_DELAY_SMOOTH_SHIFT;
+
+    if (llabs(handle->echoDelayEstimate - handle->echoDelay) > handle->processBuffersize / 2) {
+        ALOGD("echo reference delay %d -> %d samples", handle->echoDelay,
+              (int)handle->echoDelayEstimate);
+        handle->echoDelay = (int)handle->echoDelayEstimate;
+    }
+}
+
+/**
+ * @brief benchAccount
+ * account the backend time of one block and report the average and
+ * worst case every BENCH_REPORT_BLOCKS blocks, the load is the share
+ * of the block duration spent in the backend
+ *
+ * @param handle
+ * @param ns
+ */
+static void benchAccount(rk_voice_handle* handle, int64_t ns)
+{
+    int64_t block_ns = handle->processBuffersize * NS_PER_SEC / handle->processSamplerate;
+
+    handle->benchTotalNs += ns;
+    if (ns > handle->benchMaxNs)
+        handle->benchMaxNs = ns;
+    if (++handle->benchBlocks < BENCH_REPORT_BLOCKS)
+        return;
+
+    ALOGD("%s backend: avg %lld us max %lld us per %d sample block, load %lld%%",
+          handle->voiceApi->name,
+          (long long)(handle->benchTotalNs / handle->benchBlocks / 1000),
+          (long long)(handle->benchMaxNs / 1000), handle->processBuffersize,
+          (long long)(handle->benchTotalNs * 100 / handle->benchBlocks / block_ns));
+    handle->benchBlocks = 0;
+    handle->benchTotalNs = 0;
+    handle->benchMaxNs = 0;
+}
+
 static void thread_loop(rk_voice_handle* handle)
 {
     int playback_samplerate = handle->playbackInSamplerate;
@@ -556,16 +917,32 @@ static void thread_loop(rk_voice_handle* handle)
     int process_samplerate = handle->processSamplerate;
     int playback_channel = handle->playbackInChannels;
     int capture_channel = handle->captureInChannels;
-    int process_buffer_size = PROCESS_BUFFER_SIZE * 2;
-
-    int playback_min_buffersize = process_buffer_size * playback_samplerate / process_samplerate * playback_channel;
-    int capture_min_buffersize = process_buffer_size * capture_samplerate / process_samplerate * capture_channel;
-
-    char tmp_playback_buffer[playback_min_buffersize];
-    char tmp_capture_buffer[capture_min_buffersize];
-
-    char tmp_outplayback_buffer[playback_min_buffersize];
-    char tmp_outcapture_buffer[capture_min_buffersize];
+    int process_block = handle->processBuffersize;
+    int process_buffer_size = process_block * 2;
+
+    int playback_min_buffersize = handle->minPlaybackBuffersize;
+    int capture_min_buffersize = handle->minCaptureBuffersize;
+
+    // the stream block and the process block differ when resampling, fit both
+    int tmp_buffersize = process_buffer_size;
+    if (tmp_buffersize < playback_min_buffersize)
+        tmp_buffersize = playback_min_buffersize;
+    if (tmp_buffersize < capture_min_buffersize)
+        tmp_buffersize = capture_min_buffersize;
+
+    char tmp_playback_buffer[tmp_buffersize];
+    char tmp_capture_buffer[tmp_buffersize];
+
+    char tmp_outplayback_buffer[tmp_buffersize];
+    char tmp_outcapture_buffer[tmp_buffersize];
+    char tmp_resample_buffer[tmp_buffersize];
+    short tmp_ref_buffer[process_block];
+    struct audio_live_voice live;
+    rk_jitter_stats liveStats;
+    struct timespec liveNow;
+
+    memset(&live, 0x00, sizeof(live));
+    live.active = 1;
 #ifdef ALSA_3A_DEBUG
     in_capture_debug = fopen("/data/3a_capture_in.pcm","wb");//please touch /data/3a_in.pcm first
     out_capture_debug = fopen("/data/3a_capture_out.pcm","wb");//please touch /data/3a_out.pcm first
@@ -576,10 +953,12 @@ static void thread_loop(rk_voice_handle* handle)
     while (handle->voice_thread.running) {
 
         bool isGetBuffer = false;
+        int64_t capBlockBytes = 0;
 
         //wait the enough raw buffer
         if ((handle->captureBufferSize < capture_min_buffersize) || (handle->playbackBufferSize < playback_min_buffersize)) {
             sem_wait(&handle->voice_thread.sem);
+            audio_thread_woken(&handle->voice_thread.thread);
         }
 
         char value[PROPERTY_VALUE_MAX] = "";
@@ -592,12 +971,16 @@ static void thread_loop(rk_voice_handle* handle)
             memcpy(tmp_capture_buffer, handle->captureBuffer, capture_min_buffersize);
             memcpy(handle->captureBuffer, handle->captureBuffer+capture_min_buffersize, MAX_BUFFER_SIZE-capture_min_buffersize);
             handle->captureBufferSize -= capture_min_buffersize;
+            capBlockBytes = handle->captureReadBytes;
+            handle->captureReadBytes += capture_min_buffersize;
+            live.capture_queued = handle->captureBufferSize;
             pthread_mutex_unlock(&handle->voice_thread.queueCapLock);
 
             pthread_mutex_lock(&handle->voice_thread.queuePlyLock);
             memcpy(tmp_playback_buffer, handle->playBackBuffer, playback_min_buffersize);
             memcpy(handle->playBackBuffer, handle->playBackBuffer+playback_min_buffersize, MAX_BUFFER_SIZE-playback_min_buffersize);
             handle->playbackBufferSize -= playback_min_buffersize;
+            live.playback_queued = handle->playbackBufferSize;
             pthread_mutex_unlock(&handle->voice_thread.queuePlyLock);
             isGetBuffer = true;
         }
@@ -616,11 +999,10 @@ static void thread_loop(rk_voice_handle* handle)
             // resample raw buffer to processed samplerate
             if (playback_samplerate != process_samplerate) {
                 int in_sample = playback_min_buffersize / playback_channel / 2;
-                int out_sample = in_sample;
-                char tmp_resample_buffer[playback_min_buffersize];
+                int out_sample = process_block;
 
                 memcpy(tmp_resample_buffer, tmp_playback_buffer, playback_min_buffersize);
-                memset(tmp_playback_buffer, 0x00, playback_min_buffersize);
+                memset(tmp_playback_buffer, 0x00, tmp_buffersize);
                 speex_resampler_process_interleaved_int(handle->speexPlaybackDownResample,
                                                         (spx_int16_t *)tmp_resample_buffer, &in_sample,
                                                         (spx_int16_t *)tmp_playback_buffer, &out_sample);
@@ -629,10 +1011,10 @@ static void thread_loop(rk_voice_handle* handle)
 
             if (capture_samplerate != process_samplerate) {
                 int in_sample = capture_min_buffersize / capture_channel / 2;
-                int out_sample = in_sample;
-                char tmp_resample_buffer[playback_min_buffersize];
+                int out_sample = process_block;
+
                 memcpy(tmp_resample_buffer, tmp_capture_buffer, capture_min_buffersize);
-                memset(tmp_capture_buffer, 0x00, capture_min_buffersize);
+                memset(tmp_capture_buffer, 0x00, tmp_buffersize);
                 speex_resampler_process_interleaved_int(handle->speexCapureDownResample,
                                                         (spx_int16_t *)tmp_resample_buffer, &in_sample,
                                                         (spx_int16_t *)tmp_capture_buffer, &out_sample);
@@ -641,23 +1023,36 @@ static void thread_loop(rk_voice_handle* handle)
 
             // main process call
             if (handle->voiceApi) {
-                //memcpy((char *)tmp_outplayback_buffer, (char *)tmp_playback_buffer, PROCESS_BUFFER_SIZE * 2);
-                //memcpy((char *)tmp_outcapture_buffer, (char *)tmp_capture_buffer, PROCESS_BUFFER_SIZE * 2);
-                handle->voiceApi->processPlayback((short *)tmp_playback_buffer, (short *)tmp_outplayback_buffer, PROCESS_BUFFER_SIZE);
-                handle->voiceApi->processCapture((short *)tmp_capture_buffer, (short *)tmp_outplayback_buffer, (short *)tmp_outcapture_buffer, PROCESS_BUFFER_SIZE);
+                struct timespec bench_start, bench_end;
+                if (handle->benchEnable)
+                    clock_gettime(CLOCK_MONOTONIC, &bench_start);
+                handle->voiceApi->processPlayback((short *)tmp_playback_buffer, (short *)tmp_outplayback_buffer, process_block);
+
+                // feed the reference that was presented when this capture block was captured
+                echoRefWrite(handle, (short *)tmp_outplayback_buffer, process_block);
+                echoDelayUpdate(handle, capBlockBytes, handle->refWritePos - process_block);
+                echoRefRead(handle, handle->refWritePos - process_block - handle->echoDelay,
+                            tmp_ref_buffer, process_block);
+
+                handle->voiceApi->processCapture((short *)tmp_capture_buffer, tmp_ref_buffer, (short *)tmp_outcapture_buffer, process_block);
+                if (handle->benchEnable) {
+                    clock_gettime(CLOCK_MONOTONIC, &bench_end);
+                    benchAccount(handle, (bench_end.tv_sec - bench_start.tv_sec) * NS_PER_SEC
+                                 + bench_end.tv_nsec - bench_start.tv_nsec);
+                }
 #ifdef ALSA_3A_DEBUG           
-                fwrite(tmp_capture_buffer,sizeof(short),PROCESS_BUFFER_SIZE,in_capture_debug);
-                fwrite(tmp_outcapture_buffer,sizeof(short),PROCESS_BUFFER_SIZE,out_capture_debug);
-                fwrite(tmp_playback_buffer,sizeof(short),PROCESS_BUFFER_SIZE,in_playback_debug);
-		fwrite(tmp_outplayback_buffer,sizeof(short),PROCESS_BUFFER_SIZE,out_playback_debug);
+                fwrite(tmp_capture_buffer,sizeof(short),process_block,in_capture_debug);
+                fwrite(tmp_outcapture_buffer,sizeof(short),process_block,out_capture_debug);
+                fwrite(tmp_playback_buffer,sizeof(short),process_block,in_playback_debug);
+		fwrite(tmp_outplayback_buffer,sizeof(short),process_block,out_playback_debug);
 #endif
             }
 
             // upresample the processed buffer to raw buffer samplerate
             if (playback_samplerate != process_samplerate) {
-                int in_sample = PROCESS_BUFFER_SIZE;
-                int out_sample = playback_min_buffersize;
-                memset(tmp_playback_buffer, 0x00, playback_min_buffersize);
+                int in_sample = process_block;
+                int out_sample = playback_min_buffersize / playback_channel / 2;
+                memset(tmp_playback_buffer, 0x00, tmp_buffersize);
                 memcpy(tmp_playback_buffer, tmp_outplayback_buffer, process_buffer_size);
                 speex_resampler_process_interleaved_int(handle->speexPlaybackUpResample,
                                                         (spx_int16_t *)tmp_playback_buffer, &in_sample,
@@ -667,9 +1062,9 @@ static void thread_loop(rk_voice_handle* handle)
             }
 
             if (capture_samplerate != process_samplerate) {
-                int in_sample = PROCESS_BUFFER_SIZE;
-                int out_sample = capture_min_buffersize;
-                memset(tmp_capture_buffer, 0x00, capture_min_buffersize);
+                int in_sample = process_block;
+                int out_sample = capture_min_buffersize / capture_channel / 2;
+                memset(tmp_capture_buffer, 0x00, tmp_buffersize);
                 memcpy(tmp_capture_buffer, tmp_outcapture_buffer, process_buffer_size);
                 speex_resampler_process_interleaved_int(handle->speexCapureUpResample,
                                                         (spx_int16_t *)tmp_capture_buffer, &in_sample,
@@ -688,17 +1083,33 @@ static void thread_loop(rk_voice_handle* handle)
 
             // queue processed buffer to output list
             pthread_mutex_lock(&handle->voice_thread.getCapOutLock);
-            memcpy((char *)handle->outCaptureBuffer + handle->outCaptureBufferSize, tmp_outcapture_buffer, capture_min_buffersize);
-            handle->outCaptureBufferSize += capture_min_buffersize;
+            jitter_buffer_write(&handle->outCaptureBuffer, tmp_outcapture_buffer, capture_min_buffersize);
+            jitter_buffer_get_stats(&handle->outCaptureBuffer, &liveStats);
             pthread_mutex_unlock(&handle->voice_thread.getCapOutLock);
+            live.capture_depth = liveStats.depth;
+            live.capture_target = liveStats.target;
+            live.capture_underruns = liveStats.underruns;
 
             pthread_mutex_lock(&handle->voice_thread.getPlyOutLock);
-            memcpy((char *)handle->outPlayBuffer + handle->outPlaybackBufferSize, tmp_outplayback_buffer, playback_min_buffersize);
-            handle->outPlaybackBufferSize += playback_min_buffersize;
+            jitter_buffer_write(&handle->outPlayBuffer, tmp_outplayback_buffer, playback_min_buffersize);
+            jitter_buffer_get_stats(&handle->outPlayBuffer, &liveStats);
             pthread_mutex_unlock(&handle->voice_thread.getPlyOutLock);
+            live.playback_depth = liveStats.depth;
+            live.playback_target = liveStats.target;
+            live.playback_underruns = liveStats.underruns;
+
+            // publish the queues for astat, plain stores into the live page
+            clock_gettime(CLOCK_MONOTONIC, &liveNow);
+            live.blocks++;
+            live.echo_delay = handle->echoDelay;
+            live.update_ns = liveNow.tv_sec * NS_PER_SEC + liveNow.tv_nsec;
+            audio_live_voice_update(&live);
         }
     }
 
+    live.active = 0;
+    audio_live_voice_update(&live);
+
 #ifdef ALSA_3A_DEBUG
     fclose(in_capture_debug);
     fclose(out_capture_debug);
@@ -35,11 +35,50 @@
 #ifndef VOICE_PREPROCESS_H_
 #define VOICE_PREPROCESS_H_
 
+#include <stdint.h>
+#include "audio_thread.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#define RK_VOICE_PARA_FILE "/etc/RK_VoicePara.bin"
+#define RK_VOICE_PROCESS_SAMPLERATE (16000)
+#define RK_VOICE_PROCESS_BLOCK (256)
+
+/*
+ * echo cancel / noise suppress backend run by the voice process thread.
+ * load() makes the process functions available and returns 0, unload()
+ * releases what load() took. negotiate() is called before init() with
+ * the preferred process rate and block (in samples) and updates them to
+ * what the backend supports; backends without it run at
+ * RK_VOICE_PROCESS_SAMPLERATE in RK_VOICE_PROCESS_BLOCK blocks.
+ * Processing is mono, len is in samples.
+ */
+typedef struct rk_voice_api_ {
+    const char *name;
+    int   (*load)(struct rk_voice_api_ *api);
+    void  (*unload)(struct rk_voice_api_ *api);
+    int   (*negotiate)(int *samplerate, int *block);
+    int   (*init)(char *para);
+    void  (*processCapture)(short *in, short *ref, short *out, int len);
+    void  (*processPlayback)(short *in, short *out, int len);
+    void  (*deinit)();
+    void  *priv;
+} rk_voice_api;
+
+/* counters of a processed output queue, depth and target in frames */
+typedef struct rk_jitter_stats_ {
+    int depth;
+    int target;
+    unsigned int reads;
+    unsigned int underruns;     // reads that needed concealment
+    unsigned int concealed;     // frames synthesized instead of silence
+    unsigned int stretched;     // frames added by time stretch
+    unsigned int compressed;    // frames removed by time compression
+    unsigned int overflows;     // frames dropped because the queue was full
+} rk_jitter_stats;
+
 typedef struct rk_process_api_ {
     int (*start)();
     int (*quueCaputureBuffer)(void *buf, int size);
@@ -47,8 +86,28 @@ typedef struct rk_process_api_ {
     int (*getCapureBuffer)(void *buf, int size);
     int (*getPlaybackBuffer)(void *buf, int size);
     int (*flush)();
+    /*
+     * timestamped variants, times are CLOCK_MONOTONIC ns, -1 if unknown.
+     * capture_ns is when the first frame of buf was captured, present_ns
+     * is when the first frame returned in buf will be presented. They are
+     * used to align the echo reference with the capture.
+     */
+    int (*queueCaptureBufferTs)(void *buf, int size, int64_t capture_ns);
+    int (*getPlaybackBufferTs)(void *buf, int size, int64_t present_ns);
+    int (*getJitterStats)(rk_jitter_stats *playback, rk_jitter_stats *capture);
+    int (*getThreadStats)(audio_thread_stats *stats);
 } rk_process_api;
 
+/* load the backend called name, or the first available one if name is NULL */
+rk_voice_api* rk_voice_backend_load(const char *name);
+void rk_voice_backend_unload(rk_voice_api *api);
+
+extern rk_voice_api rk_voice_speex_api;
+
+/* in place channel conversion of the process thread, size is the input in bytes */
+int processBuffertoMono(void *buffer, int size);
+int processBuffertoStereo(void *buffer, int size);
+
 rk_process_api* rk_voiceprocess_create(int ply_sr, int ply_ch, int cap_sr, int cap_ch);
 int rk_voiceprocess_destory();
 
@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * @file    voice_speex_process.c
+ * @brief   built-in voice process backend on speex echo canceller and
+ *          preprocessor, used when the vendor library is not present
+ *
+ * Runs at 16, 32 or 48 kHz with any block length. The frame size and
+ * the echo tail are read from properties at init:
+ *   media.audio.3a.frame_ms  speex frame, must divide the block (the block)
+ *   media.audio.3a.tail_ms   echo tail length (128)
+ */
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "voice_speex"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <cutils/log.h>
+#include <cutils/properties.h>
+
+#include <speex/speex.h>
+#include <speex/speex_echo.h>
+#include <speex/speex_preprocess.h>
+
+#include "voice_preprocess.h"
+
+#define SPEEX_TAIL_MS_DEFAULT (128)
+#define SPEEX_NOISE_SUPPRESS (-24)
+
+typedef struct speex_voice_ {
+    SpeexEchoState       *echoState;
+    SpeexPreprocessState *preState;
+    int                  frameSize;
+    int                  tailLength;
+    int                  samplerate;
+    int                  blockSize;
+    int                  warned;
+} speex_voice;
+
+static speex_voice speex_handle = {
+    .samplerate = RK_VOICE_PROCESS_SAMPLERATE,
+    .blockSize = RK_VOICE_PROCESS_BLOCK,
+};
+
+static int speex_get_ms(const char *key, int def)
+{
+    char value[PROPERTY_VALUE_MAX] = "";
+    int ms;
+
+    property_get(key, value, "");
+    ms = atoi(value);
+    return ms > 0 ? ms : def;
+}
+
+static void speex_voice_deinit()
+{
+    if (speex_handle.preState) {
+        speex_preprocess_state_destroy(speex_handle.preState);
+        speex_handle.preState = NULL;
+    }
+    if (speex_handle.echoState) {
+        speex_echo_state_destroy(speex_handle.echoState);
+        speex_handle.echoState = NULL;
+    }
+}
+
+/**
+ * @brief speex_voice_negotiate
+ * the speex canceller works at any rate, keep the wide and full band
+ * rates and fall back to 16 kHz for the rest
+ *
+ * @param samplerate
+ * @param block
+ *
+ * @returns 0
+ */
+static int speex_voice_negotiate(int *samplerate, int *block)
+{
+    if ((*samplerate != 16000) && (*samplerate != 32000) && (*samplerate != 48000)) {
+        *block = *block * RK_VOICE_PROCESS_SAMPLERATE / *samplerate;
+        *samplerate = RK_VOICE_PROCESS_SAMPLERATE;
+    }
+    if (*block <= 0)
+        *block = RK_VOICE_PROCESS_BLOCK;
+
+    speex_handle.samplerate = *samplerate;
+    speex_handle.blockSize = *block;
+    return 0;
+}
+
+/**
+ * @brief speex_voice_init
+ *
+ * @param para vendor parameter file, not used
+ *
+ * @returns 0 on success
+ */
+static int speex_voice_init(char *para)
+{
+    int denoise = 1;
+    int noiseSuppress = SPEEX_NOISE_SUPPRESS;
+
+    speex_voice_deinit();
+    speex_handle.frameSize = speex_get_ms("media.audio.3a.frame_ms", 0)
+                             * speex_handle.samplerate / 1000;
+    if ((speex_handle.frameSize <= 0) || (speex_handle.blockSize % speex_handle.frameSize))
+        speex_handle.frameSize = speex_handle.blockSize;
+    speex_handle.tailLength = speex_get_ms("media.audio.3a.tail_ms", SPEEX_TAIL_MS_DEFAULT)
+                              * speex_handle.samplerate / 1000;
+    speex_handle.warned = 0;
+
+    speex_handle.echoState = speex_echo_state_init(speex_handle.frameSize, speex_handle.tailLength);
+    if (speex_handle.echoState == NULL) {
+        ALOGE("speex echo state init failed");
+        return -1;
+    }
+    speex_echo_ctl(speex_handle.echoState, SPEEX_ECHO_SET_SAMPLING_RATE, &speex_handle.samplerate);
+
+    speex_handle.preState = speex_preprocess_state_init(speex_handle.frameSize, speex_handle.samplerate);
+    if (speex_handle.preState == NULL) {
+        ALOGE("speex preprocess state init failed");
+        speex_voice_deinit();
+        return -1;
+    }
+    speex_preprocess_ctl(speex_handle.preState, SPEEX_PREPROCESS_SET_ECHO_STATE, speex_handle.echoState);
+    speex_preprocess_ctl(speex_handle.preState, SPEEX_PREPROCESS_SET_DENOISE, &denoise);
+    speex_preprocess_ctl(speex_handle.preState, SPEEX_PREPROCESS_SET_NOISE_SUPPRESS, &noiseSuppress);
+
+    ALOGD("speex voice process: frame %d tail %d samples at %d Hz",
+          speex_handle.frameSize, speex_handle.tailLength, speex_handle.samplerate);
+    return 0;
+}
+
+/**
+ * @brief speex_voice_process_capture
+ * cancel the echo of ref from in, then denoise and suppress the residual
+ * echo. len must be a multiple of the speex frame, the rest is copied.
+ *
+ * @param in
+ * @param ref
+ * @param out
+ * @param len
+ */
+static void speex_voice_process_capture(short *in, short *ref, short *out, int len)
+{
+    int i;
+
+    if (speex_handle.echoState == NULL) {
+        memcpy(out, in, len * sizeof(short));
+        return;
+    }
+
+    for (i = 0; i + speex_handle.frameSize <= len; i += speex_handle.frameSize) {
+        speex_echo_cancellation(speex_handle.echoState, in + i, ref + i, out + i);
+        speex_preprocess_run(speex_handle.preState, out + i);
+    }
+
+    if (i < len) {
+        if (!speex_handle.warned) {
+            ALOGW("block of %d samples is not a multiple of the %d sample frame",
+                  len, speex_handle.frameSize);
+            speex_handle.warned = 1;
+        }
+        memcpy(out + i, in + i, (len - i) * sizeof(short));
+    }
+}
+
+static void speex_voice_process_playback(short *in, short *out, int len)
+{
+    if (in != out)
+        memcpy(out, in, len * sizeof(short));
+}
+
+rk_voice_api rk_voice_speex_api = {
+    .name = "speex",
+    .negotiate = speex_voice_negotiate,
+    .init = speex_voice_init,
+    .processCapture = speex_voice_process_capture,
+    .processPlayback = speex_voice_process_playback,
+    .deinit = speex_voice_deinit,
+};
@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2018 Fuzhou Rockchip Electronics Co. Ltd. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *   * Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above
+ *     copyright notice, this list of conditions and the following
+ *     disclaimer in the documentation and/or other materials provided
+ *     with the distribution.
+ *   * Neither the name of The Linux Foundation nor the names of its
+ *     contributors may be used to endorse or promote products derived
+ *     from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED "AS IS" AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/**
+ * @file    volume_check.c
+ * @brief   checks the precomputed voice volume steps against the formula
+ *          route_set_voice_volume() evaluated on every call
+ *
+ * Every control is checked for steps that never go down, raw values and
+ * dB gains within half a control step of the formula, and the volume to
+ * step mapping. The built in
+ * controls use the dB scales of the codecs in codec_config, -c also
+ * checks every control of a sound card that has a dB TLV.
+ *
+ * usage: volume_check [-c card]
+ *
+ * exits with 1 if any check failed
+ */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "alsa_audio.h"
+
+#define __force
+#define __bitwise
+#define __user
+#include "asound.h"
+
+/* a control with a SND_CTL_TLVT_DB_SCALE, min and step in 0.01 dB */
+struct check_scale {
+    const char *name;
+    int vol_min;
+    int vol_max;
+    int dB_min;
+    int dB_step;
+};
+
+static const struct check_scale check_scales[] = {
+    { "DAC1 Playback Volume", 0, 175, -6562, 37 },       // rt5640, rt3261
+    { "Speaker Playback Volume", 0, 39, -4650, 150 },    // rt5640 out mixer
+    { "DAC Playback Volume", 0, 192, -9600, 50 },        // es8316
+    { "ADC Capture Volume", 0, 127, -1762, 37 },         // rt5651
+    { "Headphone Playback Volume", 48, 127, -7300, 100 },// wm8960, starts above 0
+    { "Line Boost Volume", 0, 3, 0, 600 },
+};
+
+static int check_failed;
+
+#define CHECK(cond, ...) do { \
+        if (!(cond)) { \
+            printf("  FAIL: " __VA_ARGS__); \
+            printf("\n"); \
+            check_failed = 1; \
+        } \
+    } while (0)
+
+/* route_set_voice_volume() before the steps were precomputed */
+static long long check_reference(struct mixer_ctl *ctl, unsigned N, float *dB_out)
+{
+    long long vol, vol_min, vol_max;
+    unsigned int Nmax = 6;
+    float e = 2.71828, dB_min, dB_max, dB_step, dB_vol, volFloat;
+
+    mixer_get_ctl_minmax(ctl, &vol_min, &vol_max);
+    mixer_get_dB_range(ctl, (long)vol_min, (long)vol_max, &dB_min, &dB_max, &dB_step);
+
+    dB_vol = 20 * log((Nmax * pow(e, dB_min / 20) + N * (pow(e, dB_max / 20) - pow(e, dB_min / 20))) / Nmax);
+
+    volFloat = vol_min + (dB_vol - dB_min) / dB_step;
+    vol = (long long)volFloat;
+
+    if (((unsigned)(volFloat * 10) % 10) >= 5)
+        vol++;
+
+    *dB_out = dB_vol;
+    return vol;
+}
+
+static void check_ctl(struct mixer_ctl *ctl)
+{
+    const struct mixer_volume *vol = mixer_ctl_get_volume(ctl);
+    long long vol_min, vol_max, ref;
+    float dB_min, dB_max, dB_step, ref_dB;
+    unsigned n, exact = 0;
+
+    printf("%s\n", (char *)ctl->info->id.name);
+    CHECK(vol != NULL, "no volume table");
+    if (!vol)
+        return;
+    mixer_get_ctl_minmax(ctl, &vol_min, &vol_max);
+    mixer_get_dB_range(ctl, (long)vol_min, (long)vol_max, &dB_min, &dB_max, &dB_step);
+
+    for (n = 0; n <= MIXER_VOLUME_STEPS; n++) {
+        ref = check_reference(ctl, n, &ref_dB);
+        printf("  step %u: value %lld (formula %lld) %.3f dB (formula %.3f)\n",
+               n, vol->raw[n], ref, vol->dB[n], ref_dB);
+
+        CHECK((vol->raw[n] >= vol_min) && (vol->raw[n] <= vol_max),
+              "step %u value %lld outside %lld - %lld", n, vol->raw[n], vol_min, vol_max);
+        CHECK(llabs(vol->raw[n] - ref) <= 1 || (ref > vol_max && vol->raw[n] == vol_max),
+              "step %u value %lld, formula %lld", n, vol->raw[n], ref);
+        CHECK(fabsf(vol->dB[n] - ref_dB) <= dB_step / 2 + 0.01f,
+              "step %u %.3f dB, formula %.3f dB", n, vol->dB[n], ref_dB);
+        if (n > 0) {
+            CHECK(vol->raw[n] >= vol->raw[n - 1], "step %u value goes down", n);
+            CHECK(vol->dB[n] >= vol->dB[n - 1], "step %u dB goes down", n);
+        }
+        if (vol->raw[n] == ref)
+            exact++;
+    }
+    CHECK(vol->raw[MIXER_VOLUME_STEPS] == vol_max, "full volume is not the control max");
+    printf("  %u of %u steps equal to the formula\n", exact, MIXER_VOLUME_STEPS + 1);
+}
+
+static void check_steps(void)
+{
+    unsigned i;
+    float volume;
+
+    printf("volume to step\n");
+    for (i = 0; i <= 1000; i++) {
+        volume = i / 1000.0f;
+        CHECK(mixer_volume_step(volume) == (unsigned)(volume * 5 + 1),
+              "volume %f step %u, formula %u", volume, mixer_volume_step(volume),
+              (unsigned)(volume * 5 + 1));
+    }
+    CHECK(mixer_volume_step(-0.5f) == 1, "volume below 0 is not step 1");
+    CHECK(mixer_volume_step(2.0f) == MIXER_VOLUME_STEPS, "volume above 1 is not the top step");
+}
+
+/**
+ * @brief check_mixer_create
+ *        a mixer holding the built in controls, each with a dB scale TLV
+ */
+static struct mixer *check_mixer_create(void)
+{
+    unsigned count = sizeof(check_scales) / sizeof(check_scales[0]), n;
+    struct mixer *mixer;
+    struct snd_ctl_tlv *tlv;
+
+    mixer = calloc(1, sizeof(*mixer));
+    if (!mixer)
+        return NULL;
+    mixer->fd = -1;
+    mixer->count = count;
+    mixer->info = calloc(count, sizeof(struct snd_ctl_elem_info));
+    mixer->ctl = calloc(count, sizeof(struct mixer_ctl));
+    if (!mixer->info || !mixer->ctl) {
+        mixer_close_legacy(mixer);
+        return NULL;
+    }
+
+    for (n = 0; n < count; n++) {
+        strncpy((char *)mixer->info[n].id.name, check_scales[n].name,
+                sizeof(mixer->info[n].id.name) - 1);
+        mixer->info[n].id.numid = n + 1;
+        mixer->info[n].type = SNDRV_CTL_ELEM_TYPE_INTEGER;
+        mixer->info[n].count = 2;
+        mixer->info[n].value.integer.min = check_scales[n].vol_min;
+        mixer->info[n].value.integer.max = check_scales[n].vol_max;
+        mixer->ctl[n].info = mixer->info + n;
+        mixer->ctl[n].mixer = mixer;
+
+        tlv = calloc(1, sizeof(*tlv) + 4 * sizeof(unsigned int));
+        if (!tlv) {
+            mixer_close_legacy(mixer);
+            return NULL;
+        }
+        tlv->numid = n + 1;
+        tlv->length = 4 * sizeof(unsigned int);
+        tlv->tlv[0] = SND_CTL_TLVT_DB_SCALE;
+        tlv->tlv[1] = 2 * sizeof(unsigned int);
+        tlv->tlv[2] = (unsigned int)check_scales[n].dB_min;
+        tlv->tlv[3] = check_scales[n].dB_step;
+        mixer->ctl[n].tlv = tlv;
+    }
+    return mixer;
+}
+
+int main(int argc, char **argv)
+{
+    struct mixer *mixer;
+    int card = -1, opt;
+    unsigned n;
+
+    while ((opt = getopt(argc, argv, "c:")) != -1) {
+        switch (opt) {
+        case 'c':
+            card = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-c card]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    check_steps();
+
+    mixer = check_mixer_create();
+    if (!mixer) {
+        fprintf(stderr, "out of memory\n");
+        return 2;
+    }
+    for (n = 0; n < mixer->count; n++)
+        check_ctl(mixer->ctl + n);
+    mixer_close_legacy(mixer);
+
+    if (card >= 0) {
+        mixer = mixer_open_legacy(card);
+        if (!mixer) {
+            fprintf(stderr, "cannot open the mixer of card %d\n", card);
+            return 2;
+        }
+        for (n = 0; n < mixer->count; n++) {
+            if (mixer->ctl[n].tlv && (mixer->info[n].type == SNDRV_CTL_ELEM_TYPE_INTEGER))
+                check_ctl(mixer->ctl + n);
+        }
+        mixer_close_legacy(mixer);
+    }
+
+    printf("%s\n", check_failed ? "FAILED" : "PASSED");
+    return check_failed ? 1 : 0;
+}